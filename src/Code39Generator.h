@@ -4,6 +4,17 @@
 #include <Arduino.h>
 #include "heltec-eink-modules.h"
 
+// Module sizes chosen for a value by Code39Generator::fit()
+struct Code39Fit {
+    int narrow;     // Narrow bar/space width in pixels
+    int wide;       // Wide bar/space width in pixels
+    int quiet;      // Blank margin on each side in pixels
+    int width;      // Symbol width without the quiet zones
+    bool fits;      // False if nothing met the constraints (smallest symbol returned)
+};
+
+// Canvas is any GFX-style target with fillRect (the panel or an offscreen canvas)
+template <class Canvas = EInkDisplay_VisionMasterE290>
 class Code39Generator {
 private:
     // Code 39 patterns (0 = thin bar/space, 1 = thick bar/space)
@@ -57,7 +68,8 @@ private:
 
     const char* CHARS = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-. $/+%*";
     
-    EInkDisplay_VisionMasterE290* display;
+    Canvas* display;
+    uint16_t barColor;
     
     int findCharIndex(char c) {
         for(int i = 0; i < 44; i++) {
@@ -67,11 +79,12 @@ private:
     }
 
 public:
-    Code39Generator(EInkDisplay_VisionMasterE290* disp) : display(disp) {}
+    Code39Generator(Canvas* disp, uint16_t color = 0x0000) : display(disp), barColor(color) {}
     
-    // Compute the pixel width of the rendered barcode for a given text and narrow bar width
-    int getBarcodeWidth(const char* text, int narrowWidth = 2) {
-        int wideWidth = narrowWidth * 3;
+    // Compute the pixel width of the rendered barcode for a given text and module widths
+    // (wideWidth 0 = 3x narrow)
+    int getBarcodeWidth(const char* text, int narrowWidth = 2, int wideWidth = 0) {
+        if (wideWidth <= 0) wideWidth = narrowWidth * 3;
         int total = 0;
         // start pattern
         const char* startPattern = PATTERNS[43];
@@ -96,8 +109,49 @@ public:
         return total;
     }
     
-    void drawBarcode(const char* text, int x, int y, int height, int narrowWidth = 2) {
-        int wideWidth = narrowWidth * 3;  // Wide bars are 3x narrow bars
+    // Character for a 9-element pattern ("0" narrow, "1" wide), 0 if none
+    char charForPattern(const char* pattern) {
+        for (int i = 0; i < 44; i++) {
+            if (strncmp(PATTERNS[i], pattern, 9) == 0) return CHARS[i];
+        }
+        return 0;
+    }
+
+    // Pick the widest modules that fit availableWidth including a quiet zone of
+    // quietModules narrow widths on each side. Larger narrow width wins first,
+    // then the wide:narrow ratio closest to 3:1 within 2:1..3:1.
+    Code39Fit fit(const char* text, int availableWidth, int quietModules = 10) {
+        // Every character is 6 narrow + 3 wide elements, characters are
+        // separated by one narrow space: width = chars*(6n+3w) + (chars-1)*n
+        int chars = 2;  // Start and stop
+        for (int t = 0; text[t] != '\0'; t++) {
+            if (findCharIndex(toupper(text[t])) != -1) chars++;
+        }
+
+        for (int narrow = availableWidth / (chars * 12); narrow >= 1; narrow--) {
+            for (int wide = narrow * 3; wide >= narrow * 2; wide--) {
+                int width = chars * (6 * narrow + 3 * wide) + (chars - 1) * narrow;
+                int quiet = quietModules * narrow;
+                if (width + 2 * quiet <= availableWidth) {
+                    return {narrow, wide, quiet, width, true};
+                }
+            }
+        }
+
+        // Nothing fits with the quiet zones: keep 1:3 modules if the symbol
+        // itself fits and give the quiet zones whatever is left
+        int wide = 3;
+        int width = chars * (6 + 3 * wide) + (chars - 1);
+        if (width > availableWidth) {
+            wide = 2;
+            width = chars * (6 + 3 * wide) + (chars - 1);
+        }
+        int quiet = max(0, (availableWidth - width) / 2);
+        return {1, wide, quiet, width, false};
+    }
+
+    void drawBarcode(const char* text, int x, int y, int height, int narrowWidth = 2, int wideWidth = 0) {
+        if (wideWidth <= 0) wideWidth = narrowWidth * 3;  // Wide bars are 3x narrow bars by default
         int currentX = x;
         
         // Draw start character *
@@ -126,7 +180,7 @@ private:
         for(int i = 0; i < 9; i++) {
             int width = (pattern[i] == '0') ? narrowWidth : wideWidth;
             if(i % 2 == 0) {  // Draw bar
-                display->fillRect(currentX, y, width, height, 0x0000);
+                display->fillRect(currentX, y, width, height, barColor);
             }
             currentX += width;
         }
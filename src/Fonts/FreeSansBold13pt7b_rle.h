@@ -0,0 +1,145 @@
+// Generated by tools/font_subset.py from FreeSansBold13pt7b.h - do not edit.
+// 44 of 95 glyphs, 1358 bytes (GFX font 3206 bytes, 42%); glyph data 947 bytes, 1369 as a bitmap; runs 4+4 bits
+// Characters:  $%+-./0123456789?ABCDEFGHIJKLMNOPQRSTUVWXYZ
+#pragma once
+#include "../rle_font.h"
+
+const uint8_t FreeSansBold13pt7bRleData[] PROGMEM = {
+  0x01, 0x4A, 0xA0, 0x21, 0x25, 0x2A, 0x48, 0x88, 0x38, 0x22, 0xC4, 0x88,
+  0x28, 0x12, 0xC2, 0x8C, 0x61, 0x76, 0x4A, 0x04, 0x29, 0x21, 0x46, 0x84,
+  0x18, 0x11, 0x72, 0x42, 0x04, 0x09, 0x35, 0xE8, 0x84, 0x4A, 0x05, 0x84,
+  0xA0, 0xB0, 0x63, 0xA2, 0x50, 0x09, 0x1B, 0x33, 0x46, 0x9C, 0xA0, 0x31,
+  0xE2, 0x04, 0x0D, 0x11, 0x38, 0x66, 0x88, 0x40, 0x24, 0x42, 0xCD, 0x88,
+  0x07, 0x23, 0x86, 0xB0, 0x90, 0x93, 0x42, 0x50, 0x0A, 0x19, 0x33, 0x4E,
+  0x8C, 0xA0, 0x71, 0x62, 0x04, 0x0D, 0x13, 0x34, 0x84, 0x94, 0xB0, 0x63,
+  0xE2, 0x8A, 0x89, 0x07, 0x35, 0x74, 0xAE, 0x1E, 0x3C, 0x48, 0x35, 0x74,
+  0x56, 0x00, 0x1E, 0x34, 0x60, 0x25, 0x55, 0x28, 0xA9, 0x42, 0xC9, 0x2A,
+  0x94, 0x54, 0xA1, 0x64, 0x15, 0x4A, 0x14, 0x18, 0x53, 0x68, 0x54, 0x10,
+  0x1A, 0x41, 0xE8, 0xD4, 0x65, 0x76, 0x75, 0x0A, 0x11, 0xA2, 0x21, 0x4A,
+  0x12, 0x1D, 0x14, 0x05, 0x6A, 0x10, 0x99, 0x07, 0x8E, 0xE8, 0xFF, 0x04,
+  0x8D, 0x12, 0x15, 0x84, 0x10, 0x1D, 0x1B, 0x48, 0x1D, 0xCD, 0x2A, 0x23,
+  0x48, 0xEE, 0xC1, 0x03, 0x23, 0x87, 0x54, 0xAC, 0x20, 0x34, 0x62, 0xD4,
+  0xA9, 0x91, 0xC3, 0xCA, 0x11, 0x34, 0x58, 0x90, 0xA4, 0x29, 0x44, 0x0F,
+  0x42, 0xA8, 0x41, 0x27, 0x0A, 0x18, 0xB9, 0xCA, 0x4C, 0x8D, 0x18, 0x35,
+  0x62, 0xD0, 0x90, 0x41, 0x62, 0x66, 0x32, 0x68, 0x88, 0xA8, 0x21, 0x0F,
+  0x1E, 0x98, 0x1B, 0x39, 0x13, 0x20, 0x69, 0x92, 0x28, 0x19, 0x39, 0xA5,
+  0x88, 0x42, 0x2A, 0x56, 0x10, 0x22, 0x48, 0x72, 0xA4, 0x29, 0x44, 0x4F,
+  0xD4, 0x1C, 0x0C, 0x06, 0xE6, 0x50, 0x92, 0x12, 0x44, 0x06, 0x21, 0x24,
+  0x38, 0x84, 0xCC, 0x88, 0x13, 0x2B, 0x08, 0xA1, 0x32, 0x66, 0xD9, 0x21,
+  0x12, 0x6A, 0x12, 0x1D, 0x0C, 0x05, 0xE0, 0x03, 0x83, 0x04, 0x27, 0x24,
+  0x38, 0x90, 0xE0, 0x40, 0x82, 0x03, 0x29, 0x1C, 0x39, 0x21, 0x31, 0x20,
+  0x68, 0x94, 0xA8, 0x20, 0x74, 0xCC, 0xD8, 0x88, 0x41, 0x63, 0x10, 0xA1,
+  0x51, 0x41, 0xE8, 0x98, 0x65, 0x87, 0x1E, 0x84, 0x50, 0x83, 0x4E, 0x14,
+  0x90, 0x43, 0x69, 0x54, 0x10, 0x1A, 0x31, 0xEA, 0x56, 0x88, 0x48, 0x6C,
+  0x62, 0x62, 0x20, 0x41, 0x44, 0x23, 0x2A, 0x49, 0x74, 0x30, 0x18, 0x98,
+  0x62, 0x68, 0x54, 0x90, 0x49, 0x74, 0xCC, 0xD8, 0x40, 0x72, 0xC5, 0xAA,
+  0x1B, 0x48, 0x70, 0x3C, 0x30, 0x82, 0x34, 0x02, 0x56, 0xB8, 0xAC, 0xD9,
+  0xA3, 0x27, 0x49, 0x8C, 0x24, 0x41, 0x70, 0x08, 0x39, 0x32, 0xE3, 0xC8,
+  0x10, 0x1B, 0x44, 0x8A, 0xD4, 0xA8, 0x46, 0x6D, 0xDC, 0x90, 0x23, 0x32,
+  0x90, 0x04, 0x41, 0x12, 0x24, 0x09, 0x24, 0x63, 0xD3, 0xC4, 0x05, 0x31,
+  0x12, 0xE4, 0x46, 0x90, 0x1B, 0x41, 0xAA, 0x44, 0x13, 0x36, 0x2E, 0x88,
+  0x91, 0x20, 0x87, 0xB3, 0x07, 0x24, 0x9A, 0xB0, 0x01, 0x56, 0x32, 0x19,
+  0x1B, 0x13, 0x46, 0x8A, 0x91, 0x20, 0x87, 0xF2, 0x30, 0xBD, 0x26, 0x38,
+  0x82, 0x1C, 0x89, 0x52, 0x45, 0x1A, 0x2D, 0x4B, 0x1B, 0x0E, 0x00, 0x3A,
+  0x36, 0x4D, 0x5C, 0x10, 0x23, 0x41, 0x0E, 0x0F, 0xCF, 0xE1, 0x19, 0x09,
+  0x52, 0x25, 0x9A, 0xB0, 0x59, 0x04, 0xA0, 0x45, 0x2F, 0x88, 0xD2, 0xB4,
+  0x45, 0x17, 0x44, 0xE9, 0xF4, 0xC1, 0x03, 0x06, 0x3F, 0x58, 0x49, 0x4B,
+  0x16, 0x5C, 0x90, 0xA4, 0x5F, 0x82, 0x2B, 0xA9, 0x8C, 0x91, 0x11, 0x23,
+  0xC5, 0x4A, 0x10, 0x44, 0x4D, 0xB3, 0x9D, 0x8E, 0x20, 0x39, 0x82, 0x20,
+  0x11, 0x62, 0x45, 0xDE, 0xAC, 0x10, 0x94, 0x44, 0xA0, 0x38, 0x00, 0xE4,
+  0xF0, 0xBB, 0x07, 0x3F, 0x40, 0x87, 0xBF, 0x23, 0xF0, 0x03, 0x86, 0xF3,
+  0x3F, 0x34, 0x65, 0xD5, 0x99, 0x17, 0x69, 0xCE, 0x85, 0x02, 0x40, 0x8E,
+  0x04, 0x31, 0x22, 0xA4, 0x8A, 0x10, 0x2A, 0x43, 0xA6, 0x10, 0x91, 0x52,
+  0x44, 0x88, 0x91, 0x20, 0x87, 0x30, 0x9D, 0xB2, 0x12, 0xC4, 0xC8, 0x90,
+  0x22, 0x44, 0x51, 0x19, 0x52, 0x45, 0x88, 0x11, 0x21, 0x47, 0x82, 0x5C,
+  0x01, 0x92, 0xF4, 0xFF, 0xCB, 0x07, 0x0F, 0x12, 0x94, 0x63, 0xC6, 0x55,
+  0x2B, 0x47, 0xDE, 0x8C, 0x58, 0x33, 0x02, 0x85, 0x98, 0x11, 0x28, 0x86,
+  0x8C, 0x40, 0x31, 0x44, 0x08, 0x8A, 0x49, 0x90, 0x88, 0x18, 0x82, 0xC4,
+  0x08, 0x92, 0x32, 0x48, 0xCA, 0x20, 0x29, 0x83, 0x86, 0x02, 0x72, 0xE8,
+  0x92, 0x25, 0x53, 0xB5, 0x68, 0x11, 0x1B, 0x14, 0x63, 0x50, 0x10, 0x41,
+  0x42, 0x02, 0xCD, 0x08, 0x34, 0x8C, 0xB6, 0x52, 0x96, 0x1D, 0x31, 0xA3,
+  0xEA, 0x58, 0x19, 0x31, 0x53, 0xAC, 0x08, 0x41, 0x12, 0x24, 0x49, 0x10,
+  0xC5, 0xA7, 0x24, 0x08, 0x12, 0x21, 0x48, 0xA4, 0x18, 0x21, 0x57, 0xEC,
+  0x52, 0x0B, 0x04, 0x90, 0x8A, 0x49, 0x8B, 0x07, 0xC3, 0xF0, 0xEC, 0x81,
+  0x88, 0x16, 0x4C, 0x88, 0xD2, 0xA7, 0xC0, 0x8C, 0xAA, 0x63, 0x65, 0xC4,
+  0x4C, 0xB1, 0x22, 0x04, 0x89, 0x90, 0x1C, 0x41, 0x14, 0xDF, 0x05, 0x21,
+  0x41, 0xEA, 0x08, 0xA9, 0x33, 0xA4, 0xCC, 0xB8, 0x72, 0x86, 0x82, 0xA0,
+  0x28, 0x11, 0x00, 0x54, 0x35, 0x71, 0xF1, 0x80, 0x1C, 0xEE, 0x1E, 0x8C,
+  0x68, 0xD2, 0xC4, 0x05, 0x31, 0x12, 0xE4, 0x46, 0x90, 0x1B, 0x41, 0x6E,
+  0x04, 0xB9, 0x11, 0xE4, 0xD0, 0x11, 0x32, 0xA7, 0x88, 0x0D, 0xA1, 0x12,
+  0xC4, 0x48, 0x90, 0x1B, 0x41, 0xD6, 0x68, 0xBA, 0x65, 0x4A, 0xCD, 0xA2,
+  0xC3, 0x8E, 0x84, 0x25, 0x8D, 0x92, 0x86, 0x03, 0xF0, 0x67, 0x64, 0xE9,
+  0xFF, 0x2B, 0x00, 0xE4, 0xF0, 0xFF, 0xBB, 0x54, 0x44, 0xDA, 0xAC, 0x4A,
+  0x1A, 0x0E, 0xC0, 0xC8, 0x73, 0xE8, 0x48, 0x8C, 0x1B, 0x42, 0x8A, 0x08,
+  0x29, 0x32, 0xA3, 0x06, 0x11, 0x1A, 0x44, 0x86, 0xD4, 0x98, 0x61, 0x63,
+  0x86, 0x91, 0x20, 0x37, 0x62, 0xE0, 0x88, 0x81, 0x27, 0x8B, 0x56, 0x3B,
+  0x0C, 0x00, 0x31, 0x2A, 0x48, 0x51, 0x42, 0x8A, 0x12, 0x42, 0x86, 0x88,
+  0x10, 0x32, 0x44, 0x66, 0x90, 0xA1, 0x41, 0x64, 0xCC, 0x10, 0x22, 0x23,
+  0x44, 0x0C, 0xA9, 0x21, 0x93, 0x90, 0x1A, 0x32, 0xB3, 0x21, 0x33, 0x23,
+  0x31, 0x46, 0x04, 0xB9, 0x11, 0x82, 0x0C, 0x1A, 0x32, 0x68, 0xC8, 0x64,
+  0x21, 0x93, 0xA5, 0x88, 0x12, 0x23, 0x4A, 0x8C, 0x14, 0x00, 0x72, 0x24,
+  0x4A, 0x15, 0x21, 0x45, 0x88, 0x0C, 0x29, 0x32, 0xC4, 0x48, 0x90, 0x4B,
+  0x78, 0xB4, 0x6C, 0xA5, 0x27, 0xD1, 0x91, 0x20, 0x46, 0x86, 0x14, 0x19,
+  0x42, 0xA4, 0x88, 0x94, 0x2A, 0x41, 0x8E, 0x04, 0x00, 0x72, 0xE9, 0x88,
+  0x90, 0x2A, 0x42, 0x8A, 0x10, 0x6D, 0x88, 0x11, 0x21, 0x46, 0x82, 0x20,
+  0xC2, 0xA3, 0x66, 0x09, 0xD3, 0xCF, 0x00, 0xFC, 0x60, 0x25, 0x2D, 0x0B,
+  0x96, 0xA4, 0xB2, 0x60, 0x49, 0x2A, 0x4B, 0x3E, 0x78, 0xC0, 0x00,
+};
+
+const RleGlyph FreeSansBold13pt7bRleGlyphs[] PROGMEM = {
+  {     0,   1,   1,   7,    0,    0 },  // ' '
+  {     9,  12,  22,  14,    1,  -18 },  // '$'
+  {   281,  21,  19,  23,    1,  -17 },  // '%'
+  {   704,  13,  12,  15,    1,  -11 },  // '+'
+  {   781,   7,   4,   8,    1,   -8 },  // '-'
+  {   799,   3,   4,   7,    2,   -3 },  // '.'
+  {   808,   7,  18,   7,    0,  -17 },  // '/'
+  {   923,  12,  19,  14,    1,  -17 },  // '0'
+  {  1089,   8,  18,  14,    2,  -17 },  // '1'
+  {  1145,  12,  18,  14,    1,  -17 },  // '2'
+  {  1284,  12,  19,  14,    1,  -17 },  // '3'
+  {  1482,  12,  18,  14,    1,  -17 },  // '4'
+  {  1676,  12,  19,  14,    1,  -17 },  // '5'
+  {  1857,  12,  19,  14,    1,  -17 },  // '6'
+  {  2065,  12,  18,  14,    1,  -17 },  // '7'
+  {  2204,  12,  19,  14,    1,  -17 },  // '8'
+  {  2403,  12,  19,  14,    1,  -17 },  // '9'
+  {  2587,  12,  19,  16,    2,  -18 },  // '?'
+  {  2752,  17,  19,  18,    1,  -18 },  // 'A'
+  {  3022,  15,  19,  18,    2,  -18 },  // 'B'
+  {  3240,  16,  20,  18,    1,  -18 },  // 'C'
+  {  3442,  15,  19,  18,    2,  -18 },  // 'D'
+  {  3601,  14,  19,  17,    2,  -18 },  // 'E'
+  {  3708,  13,  19,  16,    2,  -18 },  // 'F'
+  {  3791,  17,  20,  20,    1,  -18 },  // 'G'
+  {  4020,  15,  19,  18,    2,  -18 },  // 'H'
+  {  4096,   3,  19,   7,    2,  -18 },  // 'I'
+  {  4116,  11,  20,  14,    1,  -18 },  // 'J'
+  {  4208,  16,  19,  18,    2,  -18 },  // 'K'
+  {  4515,  13,  19,  16,    2,  -18 },  // 'L'
+  {  4574,  18,  19,  21,    2,  -18 },  // 'M'
+  {  4875,  15,  19,  18,    2,  -18 },  // 'N'
+  {  5075,  18,  20,  20,    1,  -18 },  // 'O'
+  {  5304,  14,  19,  17,    2,  -18 },  // 'P'
+  {  5429,  18,  20,  20,    1,  -18 },  // 'Q'
+  {  5685,  15,  19,  18,    2,  -18 },  // 'R'
+  {  5903,  15,  20,  17,    1,  -18 },  // 'S'
+  {  6112,  15,  19,  16,    0,  -18 },  // 'T'
+  {  6164,  15,  20,  18,    2,  -18 },  // 'U'
+  {  6258,  15,  19,  17,    1,  -18 },  // 'V'
+  {  6538,  24,  19,  24,    0,  -18 },  // 'W'
+  {  6987,  16,  19,  17,    1,  -18 },  // 'X'
+  {  7267,  16,  19,  17,    1,  -18 },  // 'Y'
+  {  7446,  14,  19,  16,    1,  -18 },  // 'Z'
+};
+
+const uint8_t FreeSansBold13pt7bRleMap[] PROGMEM = {
+    0, 255, 255, 255,   1,   2, 255, 255, 255, 255, 255,   3, 255,   4,   5,   6,
+    7,   8,   9,  10,  11,  12,  13,  14,  15,  16, 255, 255, 255, 255, 255,  17,
+  255,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,  32,
+   33,  34,  35,  36,  37,  38,  39,  40,  41,  42,  43,
+};
+
+const RleFont FreeSansBold13pt7bRle PROGMEM = {
+  FreeSansBold13pt7bRleData, FreeSansBold13pt7bRleGlyphs, FreeSansBold13pt7bRleMap,
+  0x20, 0x5A, 41, 4, 4 };
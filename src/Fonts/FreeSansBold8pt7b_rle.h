@@ -0,0 +1,155 @@
+// Generated by tools/font_subset.py from FreeSansBold8pt7b.h - do not edit.
+// 70 of 95 glyphs, 1376 bytes (GFX font 1678 bytes, 82%); glyph data 726 bytes, 703 as a bitmap; runs 3+3 bits
+// Characters:  !#'(),-./0123456789:?ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghiklmnoprstuvwy
+#pragma once
+#include "../rle_font.h"
+
+const uint8_t FreeSansBold8pt7bRleData[] PROGMEM = {
+  0x01, 0x3C, 0xC4, 0x68, 0x21, 0x61, 0x48, 0x26, 0x0A, 0x1D, 0x44, 0x12,
+  0x61, 0x48, 0x18, 0x12, 0x1D, 0x42, 0x12, 0xA1, 0x44, 0x18, 0x12, 0x86,
+  0x64, 0x80, 0x0B, 0x28, 0x24, 0x0A, 0xE9, 0x6F, 0x22, 0x59, 0x04, 0x12,
+  0x53, 0xD2, 0x96, 0xA4, 0x29, 0x24, 0x0A, 0x01, 0x28, 0x11, 0x09, 0xE0,
+  0x30, 0xA0, 0x65, 0x8A, 0x25, 0xC5, 0x32, 0xC5, 0x40, 0xA5, 0x89, 0x48,
+  0x26, 0x91, 0x75, 0x93, 0xC8, 0x24, 0x32, 0x89, 0xAD, 0x02, 0x13, 0x1D,
+  0x62, 0xFA, 0x53, 0x69, 0x32, 0x91, 0x49, 0x64, 0x62, 0xA9, 0x70, 0xEB,
+  0xE5, 0x54, 0x9A, 0x4C, 0x64, 0xD2, 0xE1, 0x90, 0x3C, 0x96, 0xC8, 0x24,
+  0xA7, 0x0A, 0x70, 0xC8, 0x26, 0x91, 0x85, 0xB4, 0xC8, 0x24, 0x87, 0x83,
+  0x54, 0x2C, 0x01, 0x59, 0x2E, 0x62, 0xB1, 0x49, 0x34, 0x16, 0xD7, 0x24,
+  0x17, 0x0B, 0xA8, 0x34, 0x99, 0x88, 0xC5, 0xA6, 0xC9, 0x44, 0x26, 0x91,
+  0x49, 0x64, 0x92, 0x53, 0x05, 0xF0, 0x20, 0x9D, 0x2A, 0x4B, 0xC5, 0xAA,
+  0x62, 0x21, 0xA8, 0x34, 0x99, 0xC8, 0x24, 0x32, 0x89, 0xC9, 0x24, 0x6B,
+  0x93, 0x9C, 0x2A, 0xA0, 0xD2, 0x44, 0x24, 0xAB, 0x49, 0x64, 0x92, 0x95,
+  0xB3, 0x44, 0x26, 0xB1, 0x91, 0x00, 0x74, 0x08, 0x4D, 0x68, 0x19, 0x49,
+  0x64, 0xD3, 0xA9, 0x66, 0x39, 0x5C, 0x2C, 0x03, 0xCE, 0x21, 0xE4, 0xB2,
+  0x44, 0x2C, 0x19, 0x8E, 0x84, 0x32, 0xE1, 0x21, 0x74, 0x10, 0x49, 0x45,
+  0xD2, 0xC1, 0x21, 0x72, 0x28, 0x16, 0x0F, 0x93, 0x43, 0x64, 0xD8, 0x78,
+  0x38, 0x54, 0x80, 0x62, 0xDB, 0x68, 0x32, 0xAC, 0x43, 0xE4, 0x10, 0x39,
+  0x44, 0x0E, 0x91, 0x1A, 0x45, 0x87, 0x98, 0x09, 0x70, 0x08, 0x1D, 0x24,
+  0x43, 0xC9, 0xD0, 0x47, 0xC9, 0x6C, 0x72, 0x08, 0xDD, 0x00, 0x9F, 0xC7,
+  0x87, 0xC8, 0x21, 0x32, 0x5E, 0x3E, 0x1C, 0x08, 0x0F, 0xD5, 0xE9, 0xE1,
+  0x50, 0xDD, 0x15, 0x28, 0x3E, 0x8D, 0xAE, 0x74, 0x88, 0x1C, 0x22, 0x74,
+  0x2E, 0x4E, 0x0E, 0x22, 0x4B, 0x40, 0xCA, 0xF5, 0xF0, 0x10, 0xE5, 0x55,
+  0xF0, 0x21, 0xBA, 0xAF, 0x26, 0xD3, 0xC4, 0x64, 0x01, 0xCC, 0x26, 0xA3,
+  0x95, 0x99, 0xB1, 0x6A, 0x9C, 0xCC, 0x46, 0x6B, 0xA2, 0xD9, 0x64, 0x38,
+  0x98, 0xEE, 0xAF, 0x87, 0x83, 0x80, 0x76, 0x88, 0x1D, 0x62, 0x96, 0x58,
+  0x84, 0x22, 0x8A, 0x50, 0x54, 0x28, 0x2A, 0xA4, 0x88, 0x84, 0x34, 0x22,
+  0x8D, 0x48, 0x23, 0xC1, 0xD0, 0x66, 0xA3, 0x88, 0x28, 0x22, 0x92, 0x84,
+  0x74, 0x33, 0xB6, 0x0A, 0xE5, 0xB7, 0xD1, 0xE2, 0x44, 0x2C, 0x11, 0x77,
+  0x96, 0x0C, 0x47, 0x87, 0xA0, 0x0D, 0x70, 0x88, 0x1C, 0x6A, 0xC6, 0xDA,
+  0x81, 0x72, 0x1A, 0x6F, 0x06, 0xCA, 0x6F, 0x23, 0xCA, 0x54, 0x22, 0x96,
+  0x88, 0x3B, 0x46, 0x24, 0x33, 0xD2, 0x41, 0x76, 0x90, 0x83, 0x22, 0x80,
+  0x83, 0xE4, 0x20, 0x19, 0x4A, 0x86, 0x92, 0xD9, 0xE4, 0x10, 0x9A, 0x4D,
+  0x86, 0x92, 0xA1, 0x64, 0x28, 0x19, 0x4A, 0x80, 0xE2, 0xD3, 0x92, 0x50,
+  0x24, 0x87, 0x58, 0xEF, 0x74, 0x88, 0xAA, 0xE4, 0x10, 0xBB, 0x00, 0x1E,
+  0x88, 0x72, 0xFD, 0x0D, 0x30, 0xEC, 0x1F, 0x25, 0x87, 0x90, 0x05, 0x22,
+  0x9C, 0x08, 0x45, 0x33, 0x9D, 0x84, 0x22, 0xA9, 0x44, 0x4A, 0xA6, 0xCF,
+  0x85, 0x80, 0xD9, 0x4C, 0x24, 0x9B, 0x89, 0x64, 0x33, 0xD1, 0x44, 0x12,
+  0x9A, 0x49, 0x34, 0x4A, 0x34, 0x4A, 0x42, 0x12, 0xA1, 0x24, 0x16, 0x09,
+  0xCF, 0xC6, 0xB3, 0xF1, 0x6C, 0x06, 0x99, 0x8D, 0x44, 0xB3, 0x89, 0xB4,
+  0x4A, 0x1F, 0x93, 0x25, 0x42, 0xD1, 0x9A, 0x48, 0x38, 0x11, 0x4E, 0x66,
+  0x4A, 0xB3, 0x89, 0xB4, 0x3C, 0xDF, 0x1B, 0xE0, 0x81, 0x2C, 0x9E, 0x6E,
+  0x16, 0x4F, 0x0F, 0x07, 0xDA, 0xCC, 0x24, 0x9A, 0x8E, 0x2C, 0xA3, 0xD2,
+  0x44, 0xC2, 0x22, 0x10, 0x2B, 0xC5, 0x2E, 0xA3, 0x22, 0xB7, 0xC3, 0xE4,
+  0x02, 0x9A, 0x55, 0x64, 0xAC, 0x6A, 0x95, 0x49, 0x05, 0xBC, 0x26, 0x19,
+  0x5D, 0x26, 0x14, 0x99, 0xDB, 0x44, 0x36, 0x99, 0x90, 0x6E, 0x42, 0x93,
+  0xC8, 0x76, 0x30, 0x2B, 0x8D, 0x2A, 0xA0, 0xC9, 0x68, 0x52, 0x19, 0xED,
+  0x0B, 0x48, 0x78, 0x90, 0xD4, 0xB8, 0x55, 0x26, 0x56, 0xDA, 0x41, 0x20,
+  0x55, 0x92, 0x1C, 0x46, 0x34, 0xBE, 0x09, 0x48, 0x87, 0x83, 0x40, 0xAC,
+  0x69, 0x22, 0x19, 0xD5, 0x6A, 0x26, 0x4D, 0x13, 0x99, 0x04, 0xF0, 0x21,
+  0x18, 0x13, 0x1D, 0x0E, 0x11, 0x4A, 0x4D, 0x46, 0x93, 0xD1, 0x64, 0x34,
+  0x19, 0x4D, 0x46, 0x53, 0x14, 0x5D, 0x46, 0x12, 0x59, 0xDF, 0x66, 0x42,
+  0xCB, 0x48, 0x22, 0xE4, 0x66, 0x19, 0x95, 0x80, 0xB1, 0xCB, 0xA8, 0xC8,
+  0xED, 0x30, 0xB9, 0x88, 0x95, 0x81, 0x93, 0x83, 0x4C, 0x6F, 0x30, 0xA1,
+  0x49, 0x26, 0x99, 0x1A, 0xCB, 0x12, 0xD1, 0xC4, 0x02, 0x19, 0xAD, 0x54,
+  0x46, 0x7B, 0x1B, 0xC8, 0xF8, 0x76, 0x90, 0x58, 0x64, 0x12, 0x99, 0x44,
+  0x24, 0x93, 0xC8, 0x24, 0x32, 0xEA, 0x12, 0x60, 0x24, 0x93, 0x88, 0x26,
+  0x22, 0x09, 0x45, 0x24, 0xA1, 0x88, 0x24, 0x92, 0x88, 0x6C, 0x34, 0x1C,
+  0x0D, 0x47, 0x23, 0xC0, 0x4C, 0x22, 0x93, 0x88, 0x64, 0x12, 0x99, 0x44,
+  0x46, 0x5D, 0x15, 0x0B, 0x69, 0x00,
+};
+
+const RleGlyph FreeSansBold8pt7bRleGlyphs[] PROGMEM = {
+  {     0,   1,   1,   4,    0,    0 },  // ' '
+  {     7,   2,  11,   5,    2,  -10 },  // '!'
+  {    29,   9,  12,   9,    0,  -10 },  // '#'
+  {   204,   2,   4,   4,    1,  -10 },  // '''
+  {   218,   4,  14,   5,    1,  -10 },  // '('
+  {   281,   4,  14,   5,    0,  -10 },  // ')'
+  {   350,   2,   5,   4,    1,   -1 },  // ','
+  {   378,   5,   2,   5,    0,   -4 },  // '-'
+  {   392,   2,   2,   4,    1,   -1 },  // '.'
+  {   399,   4,  11,   4,    0,  -10 },  // '/'
+  {   453,   8,  11,   9,    0,  -10 },  // '0'
+  {   560,   5,  11,   9,    1,  -10 },  // '1'
+  {   595,   8,  11,   9,    0,  -10 },  // '2'
+  {   681,   8,  11,   9,    0,  -10 },  // '3'
+  {   786,   8,  11,   9,    0,  -10 },  // '4'
+  {   887,   8,  11,   9,    0,  -10 },  // '5'
+  {   978,   8,  11,   9,    0,  -10 },  // '6'
+  {  1097,   8,  11,   9,    0,  -10 },  // '7'
+  {  1170,   8,  11,   9,    0,  -10 },  // '8'
+  {  1276,   8,  11,   9,    0,  -10 },  // '9'
+  {  1389,   2,   8,   5,    2,   -7 },  // ':'
+  {  1410,   8,  12,  10,    1,  -11 },  // '?'
+  {  1503,  11,  11,  11,    0,  -10 },  // 'A'
+  {  1643,   9,  11,  11,    1,  -10 },  // 'B'
+  {  1749,  10,  12,  11,    1,  -11 },  // 'C'
+  {  1889,  10,  11,  11,    1,  -10 },  // 'D'
+  {  1997,   9,  11,  10,    1,  -10 },  // 'E'
+  {  2077,   8,  11,  10,    1,  -10 },  // 'F'
+  {  2137,  10,  12,  12,    1,  -11 },  // 'G'
+  {  2250,   9,  11,  11,    1,  -10 },  // 'H'
+  {  2305,   2,  11,   4,    1,  -10 },  // 'I'
+  {  2321,   8,  11,   9,    0,  -10 },  // 'J'
+  {  2375,  10,  11,  11,    1,  -10 },  // 'K'
+  {  2496,   8,  11,  10,    1,  -10 },  // 'L'
+  {  2538,  11,  11,  13,    1,  -10 },  // 'M'
+  {  2715,   9,  11,  11,    1,  -10 },  // 'N'
+  {  2814,  11,  12,  12,    1,  -11 },  // 'O'
+  {  2929,   9,  11,  10,    1,  -10 },  // 'P'
+  {  3015,  11,  13,  12,    1,  -11 },  // 'Q'
+  {  3164,  10,  11,  11,    1,  -10 },  // 'R'
+  {  3325,  10,  12,  10,    0,  -11 },  // 'S'
+  {  3446,   9,  11,  10,    0,  -10 },  // 'T'
+  {  3489,   9,  11,  11,    1,  -10 },  // 'U'
+  {  3545,  10,  11,  10,    0,  -10 },  // 'V'
+  {  3660,  15,  11,  15,    0,  -10 },  // 'W'
+  {  3888,  10,  11,  10,    0,  -10 },  // 'X'
+  {  4008,  10,  11,  10,    0,  -10 },  // 'Y'
+  {  4090,   9,  11,  10,    0,  -10 },  // 'Z'
+  {  4163,   8,   9,   9,    0,   -8 },  // 'a'
+  {  4248,   8,  11,  10,    1,  -10 },  // 'b'
+  {  4328,   7,   9,   9,    1,   -8 },  // 'c'
+  {  4393,   9,  11,  10,    0,  -10 },  // 'd'
+  {  4493,   8,   9,   9,    0,   -8 },  // 'e'
+  {  4564,   5,  11,   5,    0,  -10 },  // 'f'
+  {  4618,   7,  12,  10,    1,   -8 },  // 'g'
+  {  4697,   7,  11,  10,    1,  -10 },  // 'h'
+  {  4758,   2,  11,   4,    1,  -10 },  // 'i'
+  {  4786,   8,  11,   9,    1,  -10 },  // 'k'
+  {  4881,   2,  11,   4,    1,  -10 },  // 'l'
+  {  4897,  12,   9,  14,    1,   -8 },  // 'm'
+  {  5024,   8,   9,  10,    1,   -8 },  // 'n'
+  {  5077,   8,   9,  10,    1,   -8 },  // 'o'
+  {  5149,   8,  12,  10,    1,   -8 },  // 'p'
+  {  5229,   5,   9,   6,    1,   -8 },  // 'r'
+  {  5268,   8,   9,   9,    0,   -8 },  // 's'
+  {  5352,   5,  11,   5,    0,  -10 },  // 't'
+  {  5399,   7,   8,  10,    1,   -7 },  // 'u'
+  {  5438,   8,   8,   9,    0,   -7 },  // 'v'
+  {  5530,  12,   8,  12,    0,   -7 },  // 'w'
+  {  5691,   8,  11,   9,    0,   -7 },  // 'y'
+};
+
+const uint8_t FreeSansBold8pt7bRleMap[] PROGMEM = {
+    0,   1, 255,   2, 255, 255, 255,   3,   4,   5, 255, 255,   6,   7,   8,   9,
+   10,  11,  12,  13,  14,  15,  16,  17,  18,  19,  20, 255, 255, 255, 255,  21,
+  255,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,
+   37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47, 255, 255, 255, 255, 255,
+  255,  48,  49,  50,  51,  52,  53,  54,  55,  56, 255,  57,  58,  59,  60,  61,
+   62, 255,  63,  64,  65,  66,  67,  68, 255,  69,
+};
+
+const RleFont FreeSansBold8pt7bRle PROGMEM = {
+  FreeSansBold8pt7bRleData, FreeSansBold8pt7bRleGlyphs, FreeSansBold8pt7bRleMap,
+  0x20, 0x79, 25, 3, 3 };
@@ -0,0 +1,316 @@
+#ifndef BACKGROUND_SCAN_H
+#define BACKGROUND_SCAN_H
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <BLEScan.h>
+#include "bluetooth_helper.h"
+#include "energy_model.h"
+#include "log_helper.h"
+
+// Opportunistic sync. Between syncs a passive scan runs at a low duty cycle
+// and listens for the phone's advertisement (the permit service UUID). When
+// the phone is seen close enough by RSSI the loop runs a silent sync, so a
+// permit changed in the app lands without the app being opened or the
+// button being pressed.
+//
+// Passive scanning only sees the primary advertisement (no scan requests
+// are sent), so the UUID has to be in the advertising data, which is where
+// the app puts it.
+//
+// Cost control:
+// - The scan listens for BG_SCAN_WINDOW_MS out of every BG_SCAN_INTERVAL_MS.
+// - A sync that finds the permit unchanged doubles the cooldown before
+//   scanning resumes (BG_SCAN_COOLDOWN_MS up to BG_SCAN_COOLDOWN_MAX_MS);
+//   an updated permit resets it.
+// - Scan time and triggered syncs are charged against BG_SCAN_BUDGET_MAH
+//   per BG_SCAN_BUDGET_WINDOW_MS; once spent, scanning waits for the next
+//   window.
+// Scan time is charged at ENERGY_MA_RADIO for the share of time the
+// receiver listens; syncs at what energy_model.h measured for them.
+//
+// Off unless built with -DBG_SCAN_ENABLED=1.
+
+#ifndef BG_SCAN_ENABLED
+#define BG_SCAN_ENABLED 0
+#endif
+#ifndef BG_SCAN_INTERVAL_MS
+#define BG_SCAN_INTERVAL_MS 1280          // Scan interval (multiple of 0.625 ms)
+#endif
+#ifndef BG_SCAN_WINDOW_MS
+#define BG_SCAN_WINDOW_MS 30              // Listening time per interval (~2.3% duty)
+#endif
+#ifndef BG_SCAN_RSSI_MIN
+#define BG_SCAN_RSSI_MIN -75              // dBm; weaker sightings are too far away
+#endif
+#ifndef BG_SCAN_NEAR_HITS
+#define BG_SCAN_NEAR_HITS 2               // Close sightings needed before a sync
+#endif
+#define BG_SCAN_NEAR_SPAN_MS 20000        // ... all within this long
+#ifndef BG_SCAN_COOLDOWN_MS
+#define BG_SCAN_COOLDOWN_MS 300000UL      // After a background sync (5 min)
+#endif
+#ifndef BG_SCAN_COOLDOWN_MAX_MS
+#define BG_SCAN_COOLDOWN_MAX_MS 14400000UL  // Backoff ceiling (4 h)
+#endif
+#ifndef BG_SCAN_BUDGET_MAH
+#define BG_SCAN_BUDGET_MAH 3.0f           // Charge allowed per budget window
+#endif
+#define BG_SCAN_BUDGET_WINDOW_MS 3600000UL  // 1 h
+#define BG_SCAN_ACCOUNT_MS 1000           // How often scan time is charged
+
+enum BgScanState
+{
+    BG_SCAN_OFF = 0,    // Not started, or stopped for a sync / firmware update
+    BG_SCAN_LISTENING,
+    BG_SCAN_COOLDOWN,   // Backing off after a background sync
+    BG_SCAN_BUDGET,     // Budget for this window spent
+    BG_SCAN_STATE_COUNT
+};
+
+static const char *BG_SCAN_STATE_NAMES[BG_SCAN_STATE_COUNT] = {"off", "listening", "cooldown", "over budget"};
+
+struct BgScanStats
+{
+    uint32_t sightings;       // Phone advertisements heard
+    uint32_t nearSightings;   // ... at or above BG_SCAN_RSSI_MIN
+    uint32_t listeningMs;     // Time the scan was running
+    uint32_t triggers;        // Syncs started by the scan
+    uint32_t updated, unchanged, failed;
+    float scanMah;            // Since boot
+    float syncMah;
+};
+
+static BgScanStats bgScanStats;
+static BgScanState bgScanState = BG_SCAN_OFF;
+static bool bgScanWanted = false;           // Between backgroundScanStart() and backgroundScanStop()
+static uint32_t bgScanUntil = 0;            // End of a cooldown or budget wait (millis)
+static uint32_t bgScanCooldownMs = BG_SCAN_COOLDOWN_MS;
+static uint32_t bgScanAccountedAt = 0;
+static uint32_t bgScanWindowStart = 0;
+static float bgScanWindowMah = 0;           // Spent in the current budget window
+static volatile uint8_t bgScanNearHits = 0;
+static volatile uint32_t bgScanFirstNearAt = 0;
+static volatile int8_t bgScanLastRssi = 0;
+
+static inline float bgScanDuty()
+{
+    return (float)BG_SCAN_WINDOW_MS / BG_SCAN_INTERVAL_MS;
+}
+
+class BackgroundScanCallback : public BLEAdvertisedDeviceCallbacks
+{
+    void onResult(BLEAdvertisedDevice device)
+    {
+        if (!device.haveServiceUUID() || !device.isAdvertisingService(serviceUuid))
+        {
+            return;
+        }
+        bgScanStats.sightings++;
+        int rssi = device.getRSSI();
+        bgScanLastRssi = rssi;
+        if (rssi < BG_SCAN_RSSI_MIN)
+        {
+            return;
+        }
+        bgScanStats.nearSightings++;
+        uint32_t now = millis();
+        if (bgScanNearHits == 0 || now - bgScanFirstNearAt > BG_SCAN_NEAR_SPAN_MS)
+        {
+            bgScanNearHits = 0;
+            bgScanFirstNearAt = now;
+        }
+        if (bgScanNearHits < 255)
+        {
+            bgScanNearHits++;
+        }
+    }
+
+    BLEUUID serviceUuid = BLEUUID(BLE_SERVICE_UUID);
+};
+
+static BackgroundScanCallback backgroundScanCallback;
+
+// Charge listening time since the last call
+static void bgScanAccount()
+{
+    uint32_t now = millis();
+    if (bgScanState == BG_SCAN_LISTENING)
+    {
+        uint32_t ms = now - bgScanAccountedAt;
+        float mah = energyProfile.radioMa * bgScanDuty() * ms / 3600000.0f;
+        bgScanStats.listeningMs += ms;
+        bgScanStats.scanMah += mah;
+        bgScanWindowMah += mah;
+    }
+    bgScanAccountedAt = now;
+    if (now - bgScanWindowStart >= BG_SCAN_BUDGET_WINDOW_MS)
+    {
+        bgScanWindowStart = now;
+        bgScanWindowMah = 0;
+    }
+}
+
+static void bgScanListen()
+{
+    bleStackBegin();
+    BLEScan *scan = BLEDevice::getScan();
+    // Duplicates on: RSSI is tracked per advertisement, and the library
+    // keeps no result list, so an endless scan holds no memory
+    scan->setAdvertisedDeviceCallbacks(&backgroundScanCallback, true);
+    scan->setActiveScan(false);
+    scan->setInterval(BG_SCAN_INTERVAL_MS);
+    scan->setWindow(BG_SCAN_WINDOW_MS);
+    bgScanNearHits = 0;
+    bgScanAccount();
+    bgScanState = BG_SCAN_LISTENING;
+    scan->start(0, nullptr, false);  // Until stopped
+    LOG_D("Background scan listening (%.1f%% duty)", 100 * bgScanDuty());
+}
+
+static void bgScanHalt(BgScanState next, uint32_t untilMs = 0)
+{
+    bgScanAccount();
+    if (bgScanState == BG_SCAN_LISTENING)
+    {
+        BLEDevice::getScan()->stop();
+        BLEDevice::getScan()->clearResults();
+    }
+    bgScanState = next;
+    bgScanUntil = untilMs;
+}
+
+// Start (or resume) listening; call once the BLE server is up
+void backgroundScanStart()
+{
+    if (!BG_SCAN_ENABLED || bgScanWanted)
+    {
+        return;
+    }
+    bgScanWanted = true;
+    if (bgScanWindowStart == 0)
+    {
+        bgScanWindowStart = bgScanAccountedAt = millis();
+    }
+    // A cooldown or budget wait carries on; the loop resumes it when it ends
+    if (bgScanState == BG_SCAN_OFF)
+    {
+        bgScanListen();
+    }
+}
+
+// Stop listening before anything else uses the scanner or needs the radio
+// to itself (syncs, firmware updates). Cooldown and budget waits are kept.
+void backgroundScanStop()
+{
+    if (!bgScanWanted)
+    {
+        return;
+    }
+    bgScanWanted = false;
+    if (bgScanState == BG_SCAN_LISTENING)
+    {
+        bgScanHalt(BG_SCAN_OFF);
+    }
+}
+
+// Call from loop(). True when the phone has been seen close by and a
+// silent sync should run now (listening has stopped; report the result
+// with backgroundScanSyncDone()). rssi receives the last sighting.
+bool backgroundScanTick(int *rssi)
+{
+    if (!bgScanWanted)
+    {
+        return false;
+    }
+    uint32_t now = millis();
+    if (now - bgScanAccountedAt >= BG_SCAN_ACCOUNT_MS)
+    {
+        bgScanAccount();
+    }
+
+    if (bgScanState != BG_SCAN_LISTENING)
+    {
+        if ((long)(now - bgScanUntil) < 0)
+        {
+            return false;
+        }
+        if (bgScanState == BG_SCAN_BUDGET && bgScanWindowMah >= BG_SCAN_BUDGET_MAH)
+        {
+            return false;  // Window not rolled over yet
+        }
+        bgScanListen();
+        return false;
+    }
+
+    if (bgScanWindowMah >= BG_SCAN_BUDGET_MAH)
+    {
+        uint32_t windowEnd = bgScanWindowStart + BG_SCAN_BUDGET_WINDOW_MS;
+        LOG_I("Background scan budget spent (%.2f mAh) - pausing for %lu s", bgScanWindowMah,
+              (unsigned long)((windowEnd - now) / 1000));
+        bgScanHalt(BG_SCAN_BUDGET, windowEnd);
+        return false;
+    }
+
+    if (bgScanNearHits < BG_SCAN_NEAR_HITS)
+    {
+        return false;
+    }
+    *rssi = bgScanLastRssi;
+    bgScanStats.triggers++;
+    bgScanHalt(BG_SCAN_COOLDOWN, now + bgScanCooldownMs);
+    return true;
+}
+
+// Outcome of the sync a trigger started; sets the next cooldown
+void backgroundScanSyncDone(EnergyOp outcome)
+{
+    float mah = energyStats[outcome].lastMah;
+    bgScanStats.syncMah += mah;
+    bgScanWindowMah += mah;
+
+    if (outcome == ENERGY_OP_SYNC_UPDATED)
+    {
+        bgScanStats.updated++;
+        bgScanCooldownMs = BG_SCAN_COOLDOWN_MS;
+    }
+    else if (outcome == ENERGY_OP_SYNC_UNCHANGED || outcome == ENERGY_OP_SYNC_SKIPPED)
+    {
+        bgScanStats.unchanged++;
+        bgScanCooldownMs = min(bgScanCooldownMs * 2, (uint32_t)BG_SCAN_COOLDOWN_MAX_MS);
+    }
+    else
+    {
+        bgScanStats.failed++;  // Probably walked off again; keep the cooldown as is
+    }
+    // The cooldown that started with the trigger runs from the end of the sync
+    bgScanUntil = millis() + bgScanCooldownMs;
+    LOG_I("Background scan: next listen in %lu s", (unsigned long)(bgScanCooldownMs / 1000));
+}
+
+// Duty cycle, time and charge spent, and the current state
+void backgroundScanReport()
+{
+    if (!BG_SCAN_ENABLED)
+    {
+        return;
+    }
+    bgScanAccount();
+    uint32_t upMs = max(millis(), 1UL);
+    float hours = upMs / 3600000.0f;
+    LOG_STAT("=== Background scan (%s) ===", BG_SCAN_STATE_NAMES[bgScanState]);
+    LOG_STAT("  Duty %.1f%% (%d/%d ms), listened %lu s of %lu s up (%.1f%% effective)",
+             100 * bgScanDuty(), BG_SCAN_WINDOW_MS, BG_SCAN_INTERVAL_MS,
+             (unsigned long)(bgScanStats.listeningMs / 1000), (unsigned long)(upMs / 1000),
+             100.0f * bgScanStats.listeningMs / upMs * bgScanDuty());
+    LOG_STAT("  Phone heard %lu times (%lu close, last %d dBm); %lu syncs: %lu updated, %lu unchanged, %lu failed",
+             (unsigned long)bgScanStats.sightings, (unsigned long)bgScanStats.nearSightings, bgScanLastRssi,
+             (unsigned long)bgScanStats.triggers, (unsigned long)bgScanStats.updated,
+             (unsigned long)bgScanStats.unchanged, (unsigned long)bgScanStats.failed);
+    LOG_STAT("  Cost: scan %.3f mAh + syncs %.3f mAh = %.2f mAh/h (budget %.2f mAh/h); next cooldown %lu s",
+             bgScanStats.scanMah, bgScanStats.syncMah, (bgScanStats.scanMah + bgScanStats.syncMah) / hours,
+             BG_SCAN_BUDGET_MAH * 3600000.0f / BG_SCAN_BUDGET_WINDOW_MS,
+             (unsigned long)(bgScanCooldownMs / 1000));
+}
+
+#endif
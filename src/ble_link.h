@@ -0,0 +1,173 @@
+#ifndef BLE_LINK_H
+#define BLE_LINK_H
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <esp_gap_ble_api.h>
+#include "log_helper.h"
+
+// Link tuning for the permit transfer. The display is the central on the
+// sync link, so it picks the connection interval: it asks for a short one
+// before connecting and confirms it once connected (the event reports
+// what the link got). Right after connecting it also asks for a PHY:
+// 2M for throughput, or coded (S8, long range) when the phone is at the
+// edge of range - its advertisement was weaker than BLE_LINK_CODED_RSSI,
+// or an earlier attempt in this sync failed. The phone may refuse either;
+// the link then stays on 1M and the phone's interval.
+//
+// The connection itself is always made on 1M: the phone advertises
+// legacy PDUs, so only the transfer after it moves to the faster or more
+// robust PHY. PHY requests need a core with BLE 5 features
+// (SOC_BLE_50_SUPPORTED); without them only the interval is tuned.
+//
+// Each transfer logs the PHY and interval it ran on, its connect and
+// transfer times and the payload size; finishSync() prints the last one
+// and the running totals per PHY.
+
+#define BLE_LINK_INTERVAL_MIN 6     // 7.5 ms (1.25 ms units)
+#define BLE_LINK_INTERVAL_MAX 12    // 15 ms
+#define BLE_LINK_LATENCY 0
+#define BLE_LINK_TIMEOUT 400        // 4 s supervision timeout (10 ms units)
+#ifndef BLE_LINK_CODED_RSSI
+#define BLE_LINK_CODED_RSSI -80     // dBm; weaker advertisements get coded PHY
+#endif
+
+// Indexed by the ESP_BLE_GAP_PHY_* value; 0 = not reported
+static const char *BLE_LINK_PHY_NAMES[] = {"?", "1M", "2M", "coded"};
+#define BLE_LINK_PHY_COUNT 4
+
+struct BleLinkReport
+{
+    bool valid;           // A transfer ran since the last report
+    bool codedWanted;     // Asked for coded PHY rather than 2M
+    int8_t rssi;          // Phone's advertisement, dBm
+    uint8_t txPhy, rxPhy; // ESP_BLE_GAP_PHY_*, 0 = not reported
+    uint16_t interval;    // 1.25 ms units, 0 = not reported
+    uint32_t connectMs;   // Connect and service discovery
+    uint32_t transferMs;  // Sync-type write and permit read
+    uint16_t bytes;
+};
+
+struct BleLinkStats
+{
+    uint32_t transfers[BLE_LINK_PHY_COUNT];  // By receive PHY
+    uint32_t transferMs[BLE_LINK_PHY_COUNT];
+    uint32_t codedRequests;
+};
+
+static BleLinkReport bleLinkReport;
+static BleLinkStats bleLinkStats;
+static volatile uint8_t bleLinkTxPhy = 0, bleLinkRxPhy = 0;
+static volatile uint16_t bleLinkInterval = 0;
+
+static void bleLinkGapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    switch (event)
+    {
+    case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT:
+        if (param->phy_update.status == ESP_BT_STATUS_SUCCESS)
+        {
+            bleLinkTxPhy = param->phy_update.tx_phy;
+            bleLinkRxPhy = param->phy_update.rx_phy;
+        }
+        break;
+    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+        if (param->update_conn_params.status == ESP_BT_STATUS_SUCCESS)
+        {
+            bleLinkInterval = param->update_conn_params.conn_int;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Hook the GAP events; call once the stack is up
+void bleLinkBegin()
+{
+    BLEDevice::setCustomGapHandler(bleLinkGapHandler);
+}
+
+// Before connecting: the parameters the connection is created with
+void bleLinkPrefer(uint8_t *address)
+{
+    esp_ble_gap_set_prefer_conn_params(address, BLE_LINK_INTERVAL_MIN, BLE_LINK_INTERVAL_MAX,
+                                       BLE_LINK_LATENCY, BLE_LINK_TIMEOUT);
+}
+
+// Right after connecting, before discovery: ask for the PHY and confirm
+// the interval. Results arrive as GAP events while the transfer runs.
+void bleLinkTune(uint8_t *address, bool coded)
+{
+    bleLinkTxPhy = ESP_BLE_GAP_PHY_1M;  // Until told otherwise
+    bleLinkRxPhy = ESP_BLE_GAP_PHY_1M;
+    bleLinkInterval = 0;
+#ifdef SOC_BLE_50_SUPPORTED
+    esp_ble_gap_phy_mask_t mask = coded ? ESP_BLE_GAP_PHY_CODED_PREF_MASK : ESP_BLE_GAP_PHY_2M_PREF_MASK;
+    if (esp_ble_gap_set_preferred_phy(address, 0, mask, mask,
+                                      coded ? ESP_BLE_GAP_PHY_OPTIONS_PREF_S8_CODING : ESP_BLE_GAP_PHY_OPTIONS_NO_PREF) != ESP_OK)
+    {
+        LOG_D("PHY request not sent");
+    }
+#endif
+    esp_ble_conn_update_params_t params = {};
+    memcpy(params.bda, address, sizeof(params.bda));
+    params.min_int = BLE_LINK_INTERVAL_MIN;
+    params.max_int = BLE_LINK_INTERVAL_MAX;
+    params.latency = BLE_LINK_LATENCY;
+    params.timeout = BLE_LINK_TIMEOUT;
+    esp_ble_gap_update_conn_params(&params);
+}
+
+// File one transfer. phy and interval come from the GAP events when the
+// link reported them (the real BLE link); 0 otherwise.
+void bleLinkRecord(bool codedWanted, int8_t rssi, uint32_t connectMs, uint32_t transferMs, size_t bytes,
+                   bool reported)
+{
+    BleLinkReport &r = bleLinkReport;
+    r.valid = true;
+    r.codedWanted = codedWanted;
+    r.rssi = rssi;
+    r.txPhy = reported ? bleLinkTxPhy : 0;
+    r.rxPhy = reported ? bleLinkRxPhy : 0;
+    r.interval = reported ? bleLinkInterval : 0;
+    r.connectMs = connectMs;
+    r.transferMs = transferMs;
+    r.bytes = (uint16_t)bytes;
+
+    uint8_t phy = r.rxPhy < BLE_LINK_PHY_COUNT ? r.rxPhy : 0;
+    bleLinkStats.transfers[phy]++;
+    bleLinkStats.transferMs[phy] += transferMs;
+    bleLinkStats.codedRequests += codedWanted ? 1 : 0;
+
+    LOG_STAT("BLE link: PHY %s/%s (asked %s, RSSI %d), interval %.2f ms, connect %lu ms, %u bytes in %lu ms",
+             BLE_LINK_PHY_NAMES[r.txPhy < BLE_LINK_PHY_COUNT ? r.txPhy : 0], BLE_LINK_PHY_NAMES[phy],
+             codedWanted ? "coded" : "2M", rssi, r.interval * 1.25f, (unsigned long)connectMs,
+             (unsigned)r.bytes, (unsigned long)transferMs);
+}
+
+// Per-sync summary: the last transfer and the totals per PHY
+void bleLinkPrintReport()
+{
+    if (!bleLinkReport.valid)
+    {
+        return;
+    }
+    const BleLinkReport &r = bleLinkReport;
+    LOG_STAT("Permit transfer: %s PHY, %.2f ms interval, %u bytes in %lu ms (connect %lu ms)",
+             BLE_LINK_PHY_NAMES[r.rxPhy < BLE_LINK_PHY_COUNT ? r.rxPhy : 0], r.interval * 1.25f,
+             (unsigned)r.bytes, (unsigned long)r.transferMs, (unsigned long)r.connectMs);
+    for (int phy = 0; phy < BLE_LINK_PHY_COUNT; phy++)
+    {
+        if (bleLinkStats.transfers[phy])
+        {
+            LOG_STAT("  %-5s %lu transfers, mean %lu ms", BLE_LINK_PHY_NAMES[phy],
+                     (unsigned long)bleLinkStats.transfers[phy],
+                     (unsigned long)(bleLinkStats.transferMs[phy] / bleLinkStats.transfers[phy]));
+        }
+    }
+    LOG_STAT("  Coded PHY asked for in %lu transfers", (unsigned long)bleLinkStats.codedRequests);
+    bleLinkReport.valid = false;
+}
+
+#endif
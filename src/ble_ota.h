@@ -0,0 +1,503 @@
+#ifndef BLE_OTA_H
+#define BLE_OTA_H
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLE2902.h>
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_heap_caps.h>
+#include <freertos/stream_buffer.h>
+#include "ota_stream.h"
+#include "permit_auth.h"
+#include "log_helper.h"
+
+// Firmware update over BLE (see tools/ota_send.py for the sender).
+//
+// Two characteristics on the display service:
+//   control (write + notify)      BEGIN / END / ABORT, progress and result
+//   data (write without response) zlib-compressed image, MTU-sized chunks
+//
+// Control writes, little-endian:
+//   BEGIN  [0x01][u32 compressed size][u32 image size][32 byte SHA-256 of image]
+//          [u32 counter][32 byte HMAC-SHA256 over everything before it]
+//   END    [0x02]
+//   ABORT  [0x03]
+// Notifications: [u8 OtaState][u8 OtaError][u32 compressed bytes consumed]
+//
+// Data is queued into a stream buffer from the BLE callback and inflated
+// into the inactive OTA partition by a worker task. The sender must keep
+// less than OTA_WINDOW_BYTES unacknowledged (progress is notified every
+// OTA_ACK_BYTES). The new image gets OTA_MAX_BOOT_TRIES boots to reach
+// otaMarkHealthy(); after that the previous one is booted again.
+//
+// That fallback is done by the new image itself (otaBootCheck()), not by
+// the bootloader: the Arduino core ships a bootloader built without
+// CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE, and changing it needs an ESP-IDF
+// build of the framework. So it only covers an image that gets as far as
+// otaBootCheck() and then crashes or resets before otaMarkHealthy(). An
+// image that fails earlier (static constructors, core start-up) or hangs
+// without a reset keeps being booted and needs a USB flash. The SHA-256
+// check before the switch is what guards against a damaged image.
+//
+// Both characteristics need an encrypted, bonded link (as pairing does),
+// and BEGIN must be signed with the payload key shared at pairing
+// (permit_auth.h). The image hash comes from the same sender as the
+// image, so the signature over it is what stops a stranger in range from
+// flashing the display. The counter must be higher than the last accepted
+// one (kept in NVS), so an old signed BEGIN cannot bring back an older
+// image; tools/ota_send.py uses the current time. An unpaired display
+// takes no updates over BLE.
+
+#define BLE_OTA_CONTROL_CHAR_UUID "0000ff12-0000-1000-8000-00805f9b34fb"
+#define BLE_OTA_DATA_CHAR_UUID "0000ff13-0000-1000-8000-00805f9b34fb"
+
+#define OTA_BUFFER_BYTES 16384       // Stream buffer between BLE and the worker
+#define OTA_WINDOW_BYTES 12288       // Max unacknowledged bytes the sender may have in flight
+#define OTA_ACK_BYTES 4096           // Progress notification interval
+#define OTA_IDLE_TIMEOUT_MS 10000    // Give up when the sender goes quiet
+#define OTA_TASK_STACK 4096
+#define OTA_TASK_PRIORITY 2
+#define OTA_MAX_BOOT_TRIES 3
+#define OTA_NVS_NAMESPACE "ota"
+#define OTA_BEGIN_SIGNED_LEN 45      // BEGIN up to and including the counter
+#define OTA_BEGIN_LEN (OTA_BEGIN_SIGNED_LEN + PERMIT_AUTH_TAG_SIZE)
+
+enum OtaOp
+{
+    OTA_OP_BEGIN = 1,
+    OTA_OP_END = 2,
+    OTA_OP_ABORT = 3,
+};
+
+enum OtaState
+{
+    OTA_IDLE = 0,
+    OTA_RECEIVING,  // Ready for / receiving data
+    OTA_APPLIED,    // Image verified and set to boot; restarting
+    OTA_FAILED,
+};
+
+enum OtaError
+{
+    OTA_ERR_NONE = 0,
+    OTA_ERR_BUSY,          // BEGIN while an update is running
+    OTA_ERR_BAD_REQUEST,   // Malformed control write or image too big
+    OTA_ERR_NO_MEMORY,
+    OTA_ERR_FLASH,         // esp_ota_begin/write/end failed (end also checks the image)
+    OTA_ERR_OVERFLOW,      // Sender exceeded the window
+    OTA_ERR_DECODE,
+    OTA_ERR_SIZE,
+    OTA_ERR_HASH,
+    OTA_ERR_TIMEOUT,
+    OTA_ERR_ABORTED,
+    OTA_ERR_AUTH,          // BEGIN unsigned, badly signed or replayed, or display not paired
+    OTA_ERR_COUNT
+};
+
+static const char *OTA_ERROR_NAMES[OTA_ERR_COUNT] = {
+    "none", "busy", "bad request", "out of memory", "flash error", "window overflow",
+    "decode error", "size mismatch", "hash mismatch", "timeout", "aborted", "not authorized"};
+
+struct OtaSession
+{
+    volatile OtaState state;
+    volatile bool endRequested;
+    volatile bool abortRequested;
+    volatile bool overflow;
+    OtaError error;
+    uint32_t compressedSize;
+    uint32_t imageSize;
+    uint8_t sha[32];
+    uint32_t counter;          // Of the BEGIN being applied; saved once it starts
+    const esp_partition_t *partition;
+    esp_ota_handle_t handle;
+    OtaInflateState *inflate;   // Allocated for the duration of an update only
+    OtaStream stream;
+    uint32_t startMs;
+};
+
+static OtaSession ota;
+static BLECharacteristic *otaControlChar = nullptr;
+
+// Stream buffer is static so the BLE callback can always write to it safely
+static uint8_t otaBufferStorage[OTA_BUFFER_BYTES + 1];
+static StaticStreamBuffer_t otaBufferStruct;
+static StreamBufferHandle_t otaBuffer = nullptr;
+
+static inline uint32_t otaReadU32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t otaLastCounter = 0;
+static bool otaCounterLoaded = false;
+
+// Check a BEGIN's signature and counter against the pairing key.
+// lastCounter is the highest counter accepted so far.
+template <class Sha = PermitAuthShaHw>
+static bool otaBeginAuthorized(const uint8_t *msg, size_t len, uint32_t lastCounter)
+{
+    if (!permitAuth.paired || len != OTA_BEGIN_LEN)
+    {
+        return false;
+    }
+    uint8_t tag[PERMIT_AUTH_TAG_SIZE];
+    permitAuthHmac<Sha>(permitAuth.key, msg, OTA_BEGIN_SIGNED_LEN, tag);
+    uint8_t diff = 0;
+    for (int i = 0; i < PERMIT_AUTH_TAG_SIZE; i++)
+    {
+        diff |= tag[i] ^ msg[OTA_BEGIN_SIGNED_LEN + i];
+    }
+    return diff == 0 && otaReadU32(msg + OTA_BEGIN_SIGNED_LEN - 4) > lastCounter;
+}
+
+static void otaSaveCounter(uint32_t counter)
+{
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NAMESPACE, false);
+    prefs.putUInt("ctr", counter);
+    prefs.end();
+}
+
+static void otaNotify(OtaState state, OtaError error)
+{
+    uint32_t consumed = ota.stream.bytesIn();
+    uint8_t msg[6] = {(uint8_t)state, (uint8_t)error,
+                      (uint8_t)consumed, (uint8_t)(consumed >> 8),
+                      (uint8_t)(consumed >> 16), (uint8_t)(consumed >> 24)};
+    otaControlChar->setValue(msg, sizeof(msg));
+    otaControlChar->notify();
+}
+
+static bool otaFlashSink(void *ctx, const uint8_t *data, size_t len)
+{
+    return esp_ota_write(ota.handle, data, len) == ESP_OK;
+}
+
+static OtaError otaStreamError(OtaStreamResult result)
+{
+    switch (result)
+    {
+    case OTA_STREAM_ERR_SINK:
+        return OTA_ERR_FLASH;
+    case OTA_STREAM_ERR_SIZE:
+        return OTA_ERR_SIZE;
+    case OTA_STREAM_ERR_HASH:
+        return OTA_ERR_HASH;
+    default:
+        return OTA_ERR_DECODE;
+    }
+}
+
+// Remember where to go back to if the new image never comes up healthy
+static void otaArmRollback()
+{
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NAMESPACE, false);
+    prefs.putString("prev", esp_ota_get_running_partition()->label);
+    prefs.putUChar("tries", 0);
+    prefs.putBool("pending", true);
+    prefs.end();
+}
+
+static void otaTask(void *)
+{
+    OtaError error = OTA_ERR_NONE;
+    bool begun = false;
+
+#ifdef OTA_WITH_SEQUENTIAL_WRITES
+    size_t eraseSize = OTA_WITH_SEQUENTIAL_WRITES;  // Erase sector by sector while writing
+#else
+    size_t eraseSize = ota.imageSize;
+#endif
+    otaSaveCounter(ota.counter);  // Before any flash work, so the BEGIN cannot be replayed
+    if (esp_ota_begin(ota.partition, eraseSize, &ota.handle) == ESP_OK)
+    {
+        begun = true;
+        ota.stream.begin(ota.inflate, ota.imageSize, ota.sha, otaFlashSink, nullptr);
+        otaNotify(OTA_RECEIVING, OTA_ERR_NONE);
+    }
+    else
+    {
+        error = OTA_ERR_FLASH;
+    }
+
+    uint8_t chunk[512];
+    uint32_t lastData = millis();
+    uint32_t lastAck = 0;
+    while (error == OTA_ERR_NONE && !ota.stream.done())
+    {
+        if (ota.abortRequested)
+        {
+            error = OTA_ERR_ABORTED;
+            break;
+        }
+        if (ota.overflow)
+        {
+            error = OTA_ERR_OVERFLOW;
+            break;
+        }
+
+        size_t n = xStreamBufferReceive(otaBuffer, chunk, sizeof(chunk), pdMS_TO_TICKS(100));
+        if (n > 0)
+        {
+            lastData = millis();
+            OtaStreamResult result = ota.stream.feed(chunk, n, false);
+            if (result != OTA_STREAM_OK && result != OTA_STREAM_DONE)
+            {
+                error = otaStreamError(result);
+            }
+            else if (ota.stream.bytesIn() - lastAck >= OTA_ACK_BYTES)
+            {
+                lastAck = ota.stream.bytesIn();
+                otaNotify(OTA_RECEIVING, OTA_ERR_NONE);
+            }
+        }
+        else if (ota.endRequested)
+        {
+            error = OTA_ERR_DECODE;  // Sender finished but the zlib stream did not
+        }
+        else if (millis() - lastData > OTA_IDLE_TIMEOUT_MS)
+        {
+            error = OTA_ERR_TIMEOUT;
+        }
+    }
+
+    // esp_ota_end() validates the image header and checksum as well
+    if (error == OTA_ERR_NONE && esp_ota_end(ota.handle) != ESP_OK)
+    {
+        error = OTA_ERR_FLASH;
+        begun = false;  // esp_ota_end releases the handle even on failure
+    }
+    if (error == OTA_ERR_NONE && esp_ota_set_boot_partition(ota.partition) != ESP_OK)
+    {
+        error = OTA_ERR_FLASH;
+    }
+
+    uint32_t ms = millis() - ota.startMs;
+    heap_caps_free(ota.inflate);
+    ota.inflate = nullptr;
+
+    if (error != OTA_ERR_NONE)
+    {
+        ota.stream.abort();
+        if (begun)
+        {
+            esp_ota_abort(ota.handle);
+        }
+        ota.error = error;
+        ota.state = OTA_FAILED;
+        otaNotify(OTA_FAILED, error);
+        LOG_E("OTA failed after %lu ms: %s", (unsigned long)ms, OTA_ERROR_NAMES[error]);
+        vTaskDelete(nullptr);
+        return;
+    }
+
+    otaArmRollback();
+    ota.state = OTA_APPLIED;
+    otaNotify(OTA_APPLIED, OTA_ERR_NONE);
+    LOG_STAT("OTA: %lu KB compressed -> %lu KB image in %lu ms (%.1f KB/s over BLE)",
+             (unsigned long)(ota.compressedSize / 1024), (unsigned long)(ota.imageSize / 1024),
+             (unsigned long)ms, ms ? ota.compressedSize / 1.024f / ms : 0.0f);
+    LOG_W("New firmware written to %s - restarting", ota.partition->label);
+    logFlush();
+    delay(500);  // Let the notification go out
+    ESP.restart();
+}
+
+static void otaBegin(const uint8_t *msg, size_t len)
+{
+    if (ota.state == OTA_RECEIVING || ota.state == OTA_APPLIED)
+    {
+        otaNotify(ota.state, OTA_ERR_BUSY);
+        return;
+    }
+
+    if (!otaCounterLoaded)
+    {
+        Preferences prefs;
+        prefs.begin(OTA_NVS_NAMESPACE, true);
+        otaLastCounter = prefs.getUInt("ctr", 0);
+        prefs.end();
+        otaCounterLoaded = true;
+    }
+    if (!otaBeginAuthorized(msg, len, otaLastCounter))
+    {
+        LOG_W("OTA BEGIN rejected: %s", permitAuth.paired ? "bad signature or counter" : "display not paired");
+        otaNotify(OTA_FAILED, OTA_ERR_AUTH);
+        return;
+    }
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(nullptr);
+    if (!partition || otaReadU32(msg + 5) > partition->size)
+    {
+        otaNotify(OTA_FAILED, OTA_ERR_BAD_REQUEST);
+        return;
+    }
+
+    ota.inflate = (OtaInflateState *)heap_caps_malloc(sizeof(OtaInflateState), MALLOC_CAP_8BIT);
+    if (!ota.inflate)
+    {
+        otaNotify(OTA_FAILED, OTA_ERR_NO_MEMORY);
+        return;
+    }
+
+    ota.compressedSize = otaReadU32(msg + 1);
+    ota.imageSize = otaReadU32(msg + 5);
+    memcpy(ota.sha, msg + 9, 32);
+    ota.counter = otaReadU32(msg + 41);
+    otaLastCounter = ota.counter;
+    ota.partition = partition;
+    ota.endRequested = false;
+    ota.abortRequested = false;
+    ota.overflow = false;
+    ota.error = OTA_ERR_NONE;
+    ota.startMs = millis();
+    xStreamBufferReset(otaBuffer);
+    ota.state = OTA_RECEIVING;
+
+    LOG_W("OTA started: %lu bytes compressed, %lu byte image -> %s",
+          (unsigned long)ota.compressedSize, (unsigned long)ota.imageSize, partition->label);
+    xTaskCreate(otaTask, "ota", OTA_TASK_STACK, nullptr, OTA_TASK_PRIORITY, nullptr);
+}
+
+class OtaControlCallbacks : public BLECharacteristicCallbacks
+{
+    void onWrite(BLECharacteristic *pCharacteristic)
+    {
+        const uint8_t *msg = pCharacteristic->getData();
+        size_t len = pCharacteristic->getLength();
+        if (len == 0)
+        {
+            return;
+        }
+
+        switch (msg[0])
+        {
+        case OTA_OP_BEGIN:
+            otaBegin(msg, len);
+            break;
+        case OTA_OP_END:
+            ota.endRequested = true;
+            break;
+        case OTA_OP_ABORT:
+            ota.abortRequested = true;
+            break;
+        default:
+            otaNotify(ota.state, OTA_ERR_BAD_REQUEST);
+            break;
+        }
+    }
+};
+
+class OtaDataCallbacks : public BLECharacteristicCallbacks
+{
+    // Runs in the BLE stack's task: only queue the bytes, never block
+    void onWrite(BLECharacteristic *pCharacteristic)
+    {
+        if (ota.state != OTA_RECEIVING)
+        {
+            return;
+        }
+        size_t len = pCharacteristic->getLength();
+        if (xStreamBufferSend(otaBuffer, pCharacteristic->getData(), len, 0) != len)
+        {
+            ota.overflow = true;
+        }
+    }
+};
+
+static OtaControlCallbacks otaControlCallbacks;
+static OtaDataCallbacks otaDataCallbacks;
+
+// Add the OTA characteristics to the display service (before service->start())
+void otaAttach(BLEService *service)
+{
+    otaBuffer = xStreamBufferCreateStatic(OTA_BUFFER_BYTES, 1, otaBufferStorage, &otaBufferStruct);
+
+    otaControlChar = service->createCharacteristic(
+        BLE_OTA_CONTROL_CHAR_UUID,
+        BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY);
+    otaControlChar->setAccessPermissions(ESP_GATT_PERM_WRITE_ENCRYPTED);
+    otaControlChar->addDescriptor(new BLE2902());  // Created once with the server
+    otaControlChar->setCallbacks(&otaControlCallbacks);
+
+    BLECharacteristic *dataChar = service->createCharacteristic(
+        BLE_OTA_DATA_CHAR_UUID,
+        BLECharacteristic::PROPERTY_WRITE_NR);
+    dataChar->setAccessPermissions(ESP_GATT_PERM_WRITE_ENCRYPTED);
+    dataChar->setCallbacks(&otaDataCallbacks);
+}
+
+// True while an image is being received (syncs would tear down the link)
+bool otaActive()
+{
+    return ota.state == OTA_RECEIVING || ota.state == OTA_APPLIED;
+}
+
+// Arduino marks a pending image valid at startup unless told otherwise;
+// we do it ourselves from otaMarkHealthy() once setup() got through. With
+// the stock bootloader (no app rollback) there is no pending state and
+// this changes nothing; it is kept for framework builds that enable it.
+extern "C" bool verifyRollbackLater()
+{
+    return true;
+}
+
+// Call early in setup(): count boots of a freshly written image and go back
+// to the previous one if it keeps failing before otaMarkHealthy(). Only
+// boots that get this far are counted (see the top of this file).
+void otaBootCheck()
+{
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NAMESPACE, false);
+    if (!prefs.getBool("pending", false))
+    {
+        prefs.end();
+        return;
+    }
+
+    uint8_t tries = prefs.getUChar("tries", 0) + 1;
+    if (tries > OTA_MAX_BOOT_TRIES)
+    {
+        char prev[17] = "";
+        prefs.getString("prev", prev, sizeof(prev));
+        prefs.putBool("pending", false);
+        prefs.end();
+
+        const esp_partition_t *partition =
+            esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, prev);
+        LOG_E("New firmware failed to start %d times - rolling back to %s", OTA_MAX_BOOT_TRIES, prev);
+        logFlush();
+        if (partition && esp_ota_set_boot_partition(partition) == ESP_OK)
+        {
+            ESP.restart();
+        }
+        return;
+    }
+
+    prefs.putUChar("tries", tries);
+    prefs.end();
+    LOG_W("Running new firmware, boot attempt %d of %d", tries, OTA_MAX_BOOT_TRIES);
+}
+
+// Call once the firmware has proven itself (display, flash and BLE up)
+void otaMarkHealthy()
+{
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NAMESPACE, false);
+    if (prefs.getBool("pending", false))
+    {
+        prefs.putBool("pending", false);
+        LOG_W("New firmware confirmed");
+    }
+    prefs.end();
+
+    // Only matters when the bootloader has rollback enabled
+    esp_ota_mark_app_valid_cancel_rollback();
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef BLE_PAIRING_H
+#define BLE_PAIRING_H
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLESecurity.h>
+#include <Preferences.h>
+#include "permit_auth.h"
+#include "log_helper.h"
+
+// Sharing the payload key with the phone (see permit_auth.h).
+//
+// Holding the button while the display boots opens a pairing window. While
+// it is open the app writes a 32-byte key to the pairing characteristic on
+// the display service. The characteristic needs an encrypted link (LE
+// Secure Connections, bonded), so the key never goes over the air in the
+// clear, and writes outside the window are ignored. The key is kept in NVS;
+// pairing again replaces it and restarts the replay counter.
+//
+// The display advertises no IO capability (ESP_IO_CAP_NONE), so the bond
+// is made with Just Works: the link is encrypted against a passive
+// listener, but nothing authenticates the peer and an attacker in the
+// middle during pairing would see the key. What limits that is the window:
+// it only opens with the button held at power-on and closes after
+// PAIRING_WINDOW_MS, so pair close to the car. Showing a passkey on the
+// panel (ESP_IO_CAP_OUT) would close the gap at the cost of a typed code
+// in the app. The encrypted OTA characteristics (ble_ota.h) ride on the
+// same bond.
+
+#define BLE_PAIRING_CHAR_UUID "0000ff14-0000-1000-8000-00805f9b34fb"
+#define PAIRING_WINDOW_MS 120000
+#define PAIRING_NVS_NAMESPACE "auth"
+
+static volatile bool pairingKeyPending = false;
+static uint8_t pairingPendingKey[PERMIT_AUTH_KEY_SIZE];
+static unsigned long pairingWindowEnd = 0;  // millis() when the window closes (0 = closed)
+static BLESecurity pairingSecurity;
+
+// Load the key saved by an earlier pairing; call once at boot
+void pairingBegin()
+{
+    Preferences prefs;
+    prefs.begin(PAIRING_NVS_NAMESPACE, true);
+    permitAuth.paired = prefs.getBytes("key", permitAuth.key, PERMIT_AUTH_KEY_SIZE) == PERMIT_AUTH_KEY_SIZE;
+    prefs.end();
+
+    if (permitAuth.paired)
+    {
+        LOG_I("Payload key loaded - only signed permits are accepted");
+    }
+    else
+    {
+        LOG_W("No payload key - accepting unsigned permits until paired");
+    }
+}
+
+void pairingOpenWindow()
+{
+    pairingWindowEnd = max(1UL, millis() + PAIRING_WINDOW_MS);
+    LOG_I("Pairing window open for %lu s", (unsigned long)(PAIRING_WINDOW_MS / 1000));
+}
+
+bool pairingWindowOpen()
+{
+    return pairingWindowEnd != 0;
+}
+
+class PairingCallbacks : public BLECharacteristicCallbacks
+{
+    // Runs in the BLE stack's task: copy the key, loop() stores it
+    void onWrite(BLECharacteristic *pCharacteristic)
+    {
+        if (!pairingWindowOpen() || pairingKeyPending)
+        {
+            LOG_W("Pairing write ignored (window closed)");
+            return;
+        }
+        if (pCharacteristic->getLength() != PERMIT_AUTH_KEY_SIZE)
+        {
+            LOG_W("Pairing write ignored: %u bytes, expected %d",
+                  (unsigned)pCharacteristic->getLength(), PERMIT_AUTH_KEY_SIZE);
+            return;
+        }
+        memcpy(pairingPendingKey, pCharacteristic->getData(), PERMIT_AUTH_KEY_SIZE);
+        pairingKeyPending = true;
+    }
+};
+
+static PairingCallbacks pairingCallbacks;
+
+// Add the pairing characteristic to the display service (before service->start())
+void pairingAttach(BLEService *service)
+{
+    pairingSecurity.setAuthenticationMode(ESP_LE_AUTH_REQ_SC_BOND);
+    pairingSecurity.setCapability(ESP_IO_CAP_NONE);  // Just Works, no MITM protection (see above)
+    pairingSecurity.setInitEncryptionKeys(ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK);
+
+    BLECharacteristic *pairingChar = service->createCharacteristic(
+        BLE_PAIRING_CHAR_UUID,
+        BLECharacteristic::PROPERTY_WRITE);
+    pairingChar->setAccessPermissions(ESP_GATT_PERM_WRITE_ENCRYPTED);
+    pairingChar->setCallbacks(&pairingCallbacks);
+}
+
+// Save a new payload key and start using it; the replay counter restarts.
+// Also used by USB provisioning (usb_provision.h). False if NVS refused it.
+bool pairingStoreKey(const uint8_t key[PERMIT_AUTH_KEY_SIZE])
+{
+    Preferences prefs;
+    prefs.begin(PAIRING_NVS_NAMESPACE, false);
+    bool ok = prefs.putBytes("key", key, PERMIT_AUTH_KEY_SIZE) == PERMIT_AUTH_KEY_SIZE;
+    prefs.end();
+
+    memcpy(permitAuth.key, key, PERMIT_AUTH_KEY_SIZE);
+    permitAuth.paired = true;
+    permitAuth.lastCounter = 0;
+
+    if (ok)
+    {
+        LOG_I("Paired: payload key stored");
+    }
+    else
+    {
+        LOG_E("Paired, but the key could not be saved - pair again after reboot");
+    }
+    return ok;
+}
+
+// Call from loop(). Stores a key written during the window and closes the
+// window when it runs out. True when a new key was just stored (the replay
+// counter has been reset and needs saving).
+bool pairingTick()
+{
+    if (pairingWindowEnd && (long)(millis() - pairingWindowEnd) >= 0)
+    {
+        pairingWindowEnd = 0;
+        LOG_I("Pairing window closed");
+    }
+    if (!pairingKeyPending)
+    {
+        return false;
+    }
+
+    pairingStoreKey(pairingPendingKey);
+    memset(pairingPendingKey, 0, sizeof(pairingPendingKey));
+    pairingKeyPending = false;
+    pairingWindowEnd = 0;
+    return true;
+}
+
+#endif
@@ -8,17 +8,25 @@
 #include <BLEServer.h>
 #include <BLE2902.h>
 #include <ArduinoJson.h>
+#include "energy_model.h"
+#include "permit_data.h"
+#include "permit_queue.h"
+#include "permit_ingest.h"
+#include "permit_auth.h"
+#include "sync_policy.h"
+#include "permit_source.h"
+#include "permit_store.h"
+#include "log_helper.h"
+#include "ble_ota.h"
+#include "ble_pairing.h"
+#include "render_profiler.h"
+#include "ble_link.h"
 
 // UUIDs for ESP32 as client (connecting to phone to get permit)
 #define BLE_SERVICE_UUID "0000ff00-0000-1000-8000-00805f9b34fb"
 #define BLE_PERMIT_CHAR_UUID "0000ff01-0000-1000-8000-00805f9b34fb"
 #define BLE_SYNC_TYPE_CHAR_UUID "0000ff02-0000-1000-8000-00805f9b34fb"
 
-// Sync types - written to phone before reading permit
-#define SYNC_TYPE_AUTO 1    // Reboot/auto sync - no notification if same permit
-#define SYNC_TYPE_MANUAL 2  // Button press - always show notification
-#define SYNC_TYPE_FORCE 3   // Long press - always show notification
-
 // UUIDs for ESP32 as server (receiving commands from phone)
 #define BLE_DISPLAY_SERVICE_UUID "0000ff10-0000-1000-8000-00805f9b34fb"
 #define BLE_COMMAND_CHAR_UUID "0000ff11-0000-1000-8000-00805f9b34fb"
@@ -29,263 +37,507 @@
 
 // Scan settings
 #define BLE_SCAN_TIME 10       // seconds to scan for phone
-#define BLE_CONNECT_TIMEOUT 10 // seconds to wait for connection
-#define BLE_MAX_RETRIES 2      // number of connection retries
+
+// Permit version tag in the phone's advertisement: service data for the
+// permit service, a format byte followed by a 32-bit tag (little endian).
+// The app derives the tag from the permit, queue and settings it would
+// serve (not from the signature, which changes on every read). An auto
+// sync that sees the tag of the last payload it applied skips the
+// connection: the phone has nothing new.
+#define PHONE_ADVERT_TAG_FORMAT 1
+#define PHONE_ADVERT_TAG_LEN 5
 
 // Command received flag (checked in main loop)
 static volatile int pendingCommand = 0;  // 0=none, 1=sync, 2=force
 
-// Permit data structure
-struct PermitData {
-  char permitNumber[20];
-  char plateNumber[20];
-  char validFrom[30];
-  char validTo[30];
-  char barcodeValue[20];
-  char barcodeLabel[20];
-  bool displayFlipped;
+// ============ Phone link (transport used by the sync path) ============
+
+enum PhoneLinkStatus
+{
+    LINK_OK = 0,
+    LINK_NOT_FOUND,       // Phone not advertising / out of range
+    LINK_CONNECT_FAILED,  // Found but connection attempts failed
+    LINK_NO_SERVICE,      // Connected but permit service missing
+    LINK_NO_PERMIT_CHAR,  // Service present but permit characteristic missing
+    LINK_STATUS_COUNT
+};
+
+static const char *PHONE_LINK_STATUS_NAMES[LINK_STATUS_COUNT] = {
+    "OK", "Phone not found in range", "Connection failed", "Service not found", "Characteristic not found"};
+
+// What the sync path needs from the phone. The BLE implementation below
+// is the real one; phone_sim.h provides a scripted stand-in.
+// A found phone stays valid across connect()/disconnect() cycles so retries
+// reuse it; release() forgets it and shuts the radio down.
+class PhoneLink
+{
+public:
+    virtual ~PhoneLink() {}
+    virtual bool scan(uint32_t seconds) = 0;                 // Find the phone's advertisement
+    virtual PhoneLinkStatus connect() = 0;                   // One attempt to connect and discover the service
+    virtual bool writeSyncType(uint8_t syncType) = 0;        // false if the characteristic is missing
+    virtual PhoneLinkStatus readPermit(std::string *out) = 0;
+    virtual void disconnect() = 0;                           // Drop the connection, keep the phone
+    virtual void release() = 0;                              // Forget the phone found by scan()
+    virtual void abort() {}                                  // End a running scan() early (from another task)
+    virtual const char *peerName() = 0;
+    virtual bool advertisedTag(uint32_t *tag) { return false; }  // Permit version tag seen by scan(), if any
+    virtual bool linkTuning(bool *coded, int8_t *rssi) { return false; }  // PHY asked for by connect(), if tuned
+    virtual void wait(uint32_t ms) { delay(ms); }            // Pause between attempts
+    virtual uint32_t now() { return millis(); }              // Clock used for retry deadlines
 };
 
+// The BLE stack is brought up once and then kept: the display advertises
+// its command service whenever it is not syncing, so tearing the stack
+// down for each sync only cost a re-init and leaked the library objects
+// created on top of it. Client, scan callback and server are created once
+// and reused, so repeated sync/server cycles allocate nothing new.
+static bool bleStackUp = false;
+
+static void bleStackBegin()
+{
+    if (!bleStackUp)
+    {
+        BLEDevice::init("ParkingDisplay");
+        BLEDevice::setMTU(517);  // Large MTU for OTA chunks and permit reads
+        bleLinkBegin();
+        bleStackUp = true;
+    }
+}
+
 static BLEClient *bleClient = nullptr;
-static BLEAdvertisedDevice *targetDevice = nullptr;
-static bool deviceFound = false;
+
+// Phone found by the last scan (address only, no BLEAdvertisedDevice copy)
+static esp_bd_addr_t targetAddress;
+static esp_ble_addr_type_t targetAddressType;
+static int8_t targetRssi = 0;
+static volatile bool deviceFound = false;
+static uint32_t targetAdvertTag = 0;
+static bool targetHasAdvertTag = false;
+
+static void formatAddress(char *out, const uint8_t *addr)
+{
+    sprintf(out, "%02x:%02x:%02x:%02x:%02x:%02x",
+            addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]);
+}
+
+// Read the permit version tag from an advertisement (see PHONE_ADVERT_TAG_FORMAT)
+static bool readAdvertTag(BLEAdvertisedDevice &device, const BLEUUID &serviceUuid, uint32_t *tag)
+{
+    for (int i = 0; i < device.getServiceDataCount(); i++)
+    {
+        if (!device.getServiceDataUUID(i).equals(serviceUuid))
+        {
+            continue;
+        }
+        std::string data = device.getServiceData(i);
+        if (data.length() >= PHONE_ADVERT_TAG_LEN && (uint8_t)data[0] == PHONE_ADVERT_TAG_FORMAT)
+        {
+            const uint8_t *p = (const uint8_t *)data.data() + 1;
+            *tag = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+            return true;
+        }
+    }
+    return false;
+}
 
 class PermitScanCallback : public BLEAdvertisedDeviceCallbacks
 {
     void onResult(BLEAdvertisedDevice advertisedDevice)
     {
+        BLEAddress address = advertisedDevice.getAddress();
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
         // Debug: print all devices found
-        Serial.print("  Found: ");
         if (advertisedDevice.haveName()) {
-            Serial.print(advertisedDevice.getName().c_str());
+            LOG_D("  Found: %s", advertisedDevice.getName().c_str());
         } else {
-            Serial.print(advertisedDevice.getAddress().toString().c_str());
+            char text[18];
+            formatAddress(text, *address.getNative());
+            LOG_D("  Found: %s", text);
         }
-        if (advertisedDevice.haveServiceUUID()) {
-            Serial.print(" UUID: ");
-            Serial.print(advertisedDevice.getServiceUUID().toString().c_str());
-        }
-        Serial.println();
+#endif
 
         if (advertisedDevice.haveServiceUUID() &&
-            advertisedDevice.isAdvertisingService(BLEUUID(BLE_SERVICE_UUID)))
+            advertisedDevice.isAdvertisingService(serviceUuid))
         {
-            Serial.println("Found Parking Permit Sync phone!");
+            LOG_I("Found Parking Permit Sync phone!");
 
-            // Store device and stop scan
-            targetDevice = new BLEAdvertisedDevice(advertisedDevice);
+            // Remember the address and stop scan
+            memcpy(targetAddress, *address.getNative(), sizeof(targetAddress));
+            targetAddressType = advertisedDevice.getAddressType();
+            targetRssi = advertisedDevice.getRSSI();
+            targetHasAdvertTag = readAdvertTag(advertisedDevice, serviceUuid, &targetAdvertTag);
             deviceFound = true;
             BLEDevice::getScan()->stop();
         }
     }
+
+    BLEUUID serviceUuid = BLEUUID(BLE_SERVICE_UUID);
 };
 
-// Scan for the Android phone
-bool scanForPhone()
-{
-    Serial.println("\n=== Bluetooth Scan ===");
-    Serial.println("Looking for Parking Permit Sync app...");
+static PermitScanCallback permitScanCallback;
 
-    deviceFound = false;
-    if (targetDevice)
+class BlePhoneLink : public PhoneLink
+{
+public:
+    bool scan(uint32_t seconds)
     {
-        delete targetDevice;
-        targetDevice = nullptr;
+        release();
+        bleStackBegin();
+        attempts = 0;
+
+        BLEScan *scan = BLEDevice::getScan();
+        scan->setAdvertisedDeviceCallbacks(&permitScanCallback);
+        scan->setActiveScan(true);
+        scan->setInterval(100);
+        scan->setWindow(99);
+
+        scanning = true;
+        energyRadioOn();
+        scan->start(seconds, false);
+        energyRadioOff();
+        scanning = false;
+        scan->clearResults();  // Results are kept in a map otherwise
+
+        return deviceFound;
     }
 
-    BLEDevice::init("ParkingDisplay");
-    BLEScan *scan = BLEDevice::getScan();
-    scan->setAdvertisedDeviceCallbacks(new PermitScanCallback());
-    scan->setActiveScan(true);
-    scan->setInterval(100);
-    scan->setWindow(99);
+    PhoneLinkStatus connect()
+    {
+        if (!deviceFound)
+        {
+            return LINK_NOT_FOUND;
+        }
+
+        bleStackBegin();
+        if (!bleClient)
+        {
+            bleClient = BLEDevice::createClient();
+        }
 
-    scan->start(BLE_SCAN_TIME, false);
+        // Single attempt; retries and backoff are up to the caller's policy.
+        // A retry means the last attempt failed, so it goes long range.
+        codedWanted = targetRssi < BLE_LINK_CODED_RSSI || attempts > 0;
+        attempts++;
+        bleLinkPrefer(targetAddress);
+        energyRadioOn();  // Until disconnect()
+        linkOpen = true;
+        if (!bleClient->connect(BLEAddress(targetAddress), targetAddressType))
+        {
+            disconnect();
+            return LINK_CONNECT_FAILED;
+        }
+        bleLinkTune(targetAddress, codedWanted);
 
-    if (!deviceFound)
-    {
-        Serial.println("Phone not found in range");
-        BLEDevice::deinit(false);
-        return false;
+        service = bleClient->getService(serviceUuid);
+        if (!service)
+        {
+            disconnect();
+            return LINK_NO_SERVICE;
+        }
+        return LINK_OK;
     }
 
-    return true;
-}
-
-// Connect to phone and read permit data
-// Returns: 0 = error, 1 = updated, 2 = already up to date
-// syncType: 1=auto, 2=manual, 3=force
-int downloadPermitViaBluetooth(PermitData *data, const char *currentPermitNumber, uint8_t syncType = SYNC_TYPE_AUTO)
-{
-    if (!targetDevice)
+    bool writeSyncType(uint8_t syncType)
     {
-        Serial.println("No device to connect to");
-        return 0;
+        BLERemoteCharacteristic *syncTypeChar = service->getCharacteristic(syncTypeUuid);
+        if (!syncTypeChar)
+        {
+            return false;
+        }
+        syncTypeChar->writeValue(&syncType, 1, false);  // false = no response needed
+        delay(50);  // Let write complete
+        return true;
     }
 
-    Serial.print("Connecting to ");
-    Serial.println(targetDevice->getAddress().toString().c_str());
-
-    bleClient = BLEDevice::createClient();
-
-    // Connect with timeout
-    unsigned long startTime = millis();
-    bool connected = false;
-
-    while (millis() - startTime < BLE_CONNECT_TIMEOUT * 1000)
+    PhoneLinkStatus readPermit(std::string *out)
     {
-        if (bleClient->connect(targetDevice))
+        BLERemoteCharacteristic *permitChar = service->getCharacteristic(permitUuid);
+        if (!permitChar)
         {
-            connected = true;
-            break;
+            return LINK_NO_PERMIT_CHAR;
         }
-        delay(500);
+        *out = permitChar->readValue();
+        return LINK_OK;
     }
 
-    if (!connected)
+    void disconnect()
     {
-        Serial.println("Connection failed");
-        delete bleClient;
-        bleClient = nullptr;
-        BLEDevice::deinit(false);
-        return 0;
+        service = nullptr;
+        if (bleClient && bleClient->isConnected())
+        {
+            bleClient->disconnect();
+            delay(50);  // Let disconnect complete
+        }
+        if (linkOpen)
+        {
+            linkOpen = false;
+            energyRadioOff();
+        }
     }
 
-    Serial.println("Connected!");
+    // Forget the phone. The client and the stack are kept for the next sync.
+    void release()
+    {
+        disconnect();
+        deviceFound = false;
+    }
 
-    // Get the permit service
-    BLERemoteService *service = bleClient->getService(BLEUUID(BLE_SERVICE_UUID));
-    if (!service)
+    void abort()
     {
-        Serial.println("Service not found");
-        bleClient->disconnect();
-        delete bleClient;
-        bleClient = nullptr;
-        BLEDevice::deinit(false);
-        return 0;
+        if (scanning)
+        {
+            BLEDevice::getScan()->stop();
+        }
     }
 
-    // Write sync type before reading permit (so phone knows what kind of sync this is)
-    BLERemoteCharacteristic *syncTypeChar = service->getCharacteristic(BLEUUID(BLE_SYNC_TYPE_CHAR_UUID));
-    if (syncTypeChar)
+    bool advertisedTag(uint32_t *tag)
     {
-        Serial.print("Writing sync type: ");
-        Serial.println(syncType);
-        syncTypeChar->writeValue(&syncType, 1, false);  // false = no response needed
-        delay(50);  // Let write complete
+        *tag = targetAdvertTag;
+        return deviceFound && targetHasAdvertTag;
     }
-    else
+
+    bool linkTuning(bool *coded, int8_t *rssi)
     {
-        Serial.println("Sync type characteristic not found (old app version?)");
+        *coded = codedWanted;
+        *rssi = targetRssi;
+        return true;
     }
 
-    // Get the permit characteristic
-    BLERemoteCharacteristic *permitChar = service->getCharacteristic(BLEUUID(BLE_PERMIT_CHAR_UUID));
-    if (!permitChar)
+    const char *peerName()
     {
-        Serial.println("Characteristic not found");
-        bleClient->disconnect();
-        delete bleClient;
-        bleClient = nullptr;
-        BLEDevice::deinit(false);
-        return 0;
+        static char text[18];
+        if (!deviceFound)
+        {
+            return "?";
+        }
+        formatAddress(text, targetAddress);
+        return text;
     }
 
-    // Read the permit JSON
-    std::string permitJsonStd = permitChar->readValue();
-    String permitJson = permitJsonStd.c_str();
+private:
+    volatile bool scanning = false;
+    uint8_t attempts = 0;     // connect() calls since the phone was found
+    bool codedWanted = false;
+    bool linkOpen = false;    // connect() started, radio time counted until disconnect()
+    BLERemoteService *service = nullptr;
+    BLEUUID serviceUuid = BLEUUID(BLE_SERVICE_UUID);
+    BLEUUID syncTypeUuid = BLEUUID(BLE_SYNC_TYPE_CHAR_UUID);
+    BLEUUID permitUuid = BLEUUID(BLE_PERMIT_CHAR_UUID);
+};
 
-    Serial.println("Received permit data:");
-    Serial.println(permitJson.c_str());
+static BlePhoneLink blePhoneLink;
+static PhoneLink *phoneLink = &blePhoneLink;
 
-    // Disconnect first before any other operations
-    bleClient->disconnect();
-    delay(50);  // Let disconnect complete
-    delete bleClient;
-    bleClient = nullptr;
-    BLEDevice::deinit(false);
-    delay(100);  // Let BLE deinit fully complete before any Serial operations
+// Swap the transport used to reach the phone (e.g. for the simulator)
+void setPhoneLink(PhoneLink *link)
+{
+    phoneLink = link;
+}
 
-    // Parse JSON
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, permitJson);
+// Scan for the Android phone
+bool scanForPhone()
+{
+    LOG_I("\n=== Bluetooth Scan ===");
+    LOG_I("Looking for Parking Permit Sync app...");
 
-    if (error)
+    if (!phoneLink->scan(BLE_SCAN_TIME))
     {
-        Serial.print("JSON parse error: ");
-        Serial.println(error.c_str());
-        return 0;
+        LOG_W("Phone not found in range");
+        return false;
     }
+    return true;
+}
 
-    // Check if permit number exists
-    if (!doc["permitNumber"].is<const char *>())
+// Failure class of the last downloadPermitViaBluetooth() call
+static SyncFailure lastSyncFailure = SYNC_FAIL_NONE;
+static uint32_t syncFailureCounts[SYNC_FAIL_CLASS_COUNT];
+
+static SyncFailure classifyLinkFailure(PhoneLinkStatus status)
+{
+    switch (status)
     {
-        Serial.println("No permit number in response");
-        return 0;
+    case LINK_OK:
+        return SYNC_FAIL_NONE;
+    case LINK_NOT_FOUND:
+        return SYNC_FAIL_OUT_OF_RANGE;
+    case LINK_CONNECT_FAILED:
+        return SYNC_FAIL_GATT;
+    default:
+        return SYNC_FAIL_MISSING_SERVICE;
     }
+}
 
-    const char *newPermitNumber = doc["permitNumber"];
+// Connect to phone and read permit data
+// Returns: 0 = error, 1 = updated, 2 = already up to date
+// syncType: 1=auto, 2=manual, 3=force
+// queue (optional) receives upcoming permits sent with the current one
+int downloadPermitViaBluetooth(PermitData *data, const char *currentPermitNumber, uint8_t syncType = SYNC_TYPE_AUTO,
+                               PermitQueue *queue = nullptr)
+{
+    LOG_I("Connecting to %s", phoneLink->peerName());
 
-    // Check for empty permit
-    if (strlen(newPermitNumber) == 0)
+    lastSyncFailure = SYNC_FAIL_NONE;
+    uint32_t connectStart = phoneLink->now();
+    PhoneLinkStatus status = phoneLink->connect();
+    uint32_t connectMs = phoneLink->now() - connectStart;
+    if (status != LINK_OK)
     {
-        Serial.println("Empty permit received (phone may not have synced yet)");
+        LOG_W("%s", PHONE_LINK_STATUS_NAMES[status]);
+        lastSyncFailure = classifyLinkFailure(status);
         return 0;
     }
 
-    // Validate required fields exist
-    const char *plateNum = doc["plateNumber"] | "";
-    const char *validFrom = doc["validFrom"] | "";
-    const char *validTo = doc["validTo"] | "";
-    const char *barcodeVal = doc["barcodeValue"] | "";
-    const char *barcodeLbl = doc["barcodeLabel"] | "";
+    LOG_I("Connected!");
+
+    // Write sync type before reading permit (so phone knows what kind of sync this is)
+    LOG_I("Writing sync type: %d", syncType);
+    if (!phoneLink->writeSyncType(syncType))
+    {
+        LOG_W("Sync type characteristic not found (old app version?)");
+    }
+
+    // Read the permit JSON, then disconnect before any other operations
+    std::string permitJson;
+    status = phoneLink->readPermit(&permitJson);
+    uint32_t transferMs = phoneLink->now() - connectStart - connectMs;
+    if (status == LINK_OK)
+    {
+        bool coded = false;
+        int8_t rssi = 0;
+        bool tuned = phoneLink->linkTuning(&coded, &rssi);
+        bleLinkRecord(coded, rssi, connectMs, transferMs, permitJson.length(), tuned);
+    }
+    phoneLink->disconnect();
 
-    if (strlen(plateNum) == 0 || strlen(validFrom) == 0 || strlen(validTo) == 0 ||
-        strlen(barcodeVal) == 0 || strlen(barcodeLbl) == 0)
+    if (status != LINK_OK)
     {
-        Serial.println("ERROR: Incomplete permit data - missing required fields");
-        Serial.printf("  permitNumber: %s\n", strlen(newPermitNumber) > 0 ? "OK" : "MISSING");
-        Serial.printf("  plateNumber: %s\n", strlen(plateNum) > 0 ? "OK" : "MISSING");
-        Serial.printf("  validFrom: %s\n", strlen(validFrom) > 0 ? "OK" : "MISSING");
-        Serial.printf("  validTo: %s\n", strlen(validTo) > 0 ? "OK" : "MISSING");
-        Serial.printf("  barcodeValue: %s\n", strlen(barcodeVal) > 0 ? "OK" : "MISSING");
-        Serial.printf("  barcodeLabel: %s\n", strlen(barcodeLbl) > 0 ? "OK" : "MISSING");
+        LOG_W("%s", PHONE_LINK_STATUS_NAMES[status]);
+        lastSyncFailure = classifyLinkFailure(status);
         return 0;
     }
 
-    // Copy permit data - zero out struct first to ensure null termination
-    memset(data, 0, sizeof(PermitData));
-    strncpy(data->permitNumber, newPermitNumber, sizeof(data->permitNumber) - 1);
-    strncpy(data->plateNumber, plateNum, sizeof(data->plateNumber) - 1);
-    strncpy(data->validFrom, validFrom, sizeof(data->validFrom) - 1);
-    strncpy(data->validTo, validTo, sizeof(data->validTo) - 1);
-    strncpy(data->barcodeValue, doc["barcodeValue"] | "", sizeof(data->barcodeValue) - 1);
-    strncpy(data->barcodeLabel, doc["barcodeLabel"] | "", sizeof(data->barcodeLabel) - 1);
-    data->displayFlipped = doc["displayFlipped"] | false;
-
-    // Check if permit changed (with null safety)
-    if (currentPermitNumber != nullptr && strcmp(data->permitNumber, currentPermitNumber) == 0)
+    // Signature check, parse and copy (shared with the other sources)
+    return acceptPermitPayload((const uint8_t *)permitJson.data(), permitJson.length(), false,
+                               currentPermitNumber, data, queue, &lastSyncFailure);
+}
+
+// Connect and download, retrying per failure class (see sync_policy.h).
+// Retries reuse the phone found by the last scan. Returns like
+// downloadPermitViaBluetooth; lastSyncFailure holds the final class.
+// No further attempts are started once *cancelled is set.
+int fetchPermitWithRetries(PermitData *data, const char *currentPermitNumber, uint8_t syncType,
+                           PermitQueue *queue, const volatile bool *cancelled = nullptr)
+{
+    uint8_t failures[SYNC_FAIL_CLASS_COUNT] = {0};
+    uint32_t start = phoneLink->now();
+    int result = 0;
+
+    for (int attempt = 1;; attempt++)
     {
-        Serial.println("Permit unchanged");
-        delay(10);  // Let serial flush
-        return 2; // Already up to date (but data is still populated)
+        result = downloadPermitViaBluetooth(data, currentPermitNumber, syncType, queue);
+        if (result != 0)
+        {
+            break; // Success or already up to date
+        }
+
+        SyncFailure failure = lastSyncFailure;
+        syncFailureCounts[failure]++;
+        failures[failure]++;
+
+        if (cancelled && *cancelled)
+        {
+            LOG_W("Stopped after %d attempt(s): %s", attempt, SYNC_FAILURE_NAMES[failure]);
+            lastSyncFailure = SYNC_FAIL_CANCELLED;
+            break;
+        }
+
+        const RetryPolicy &policy = retryPolicies[failure];
+        if (!retryAllowed(policy, failures[failure], phoneLink->now() - start))
+        {
+            LOG_W("Giving up after %d attempt(s): %s", attempt, SYNC_FAILURE_NAMES[failure]);
+            break;
+        }
+
+        uint32_t backoff = retryBackoffMs(policy, failures[failure], esp_random());
+        LOG_W("Retry %d (%s) in %lu ms...", attempt, SYNC_FAILURE_NAMES[failure], (unsigned long)backoff);
+        phoneLink->wait(backoff);
     }
 
-    Serial.print("New permit received: ");
-    Serial.println(data->permitNumber);
+    // Done with the phone either way - drop the link before rendering
+    phoneLink->release();
+    return result;
+}
+
+// Auto syncs skipped because the phone advertised the payload already applied
+static uint32_t advertSkippedSyncs = 0;
 
-    return 1; // Updated
+// True when the phone found by the last scan advertises the tag of the
+// payload we applied last, so an auto sync has nothing to fetch. Manual
+// and forced syncs always connect (the app reports those to the user).
+// *tag receives the advertised tag; false in *tagged if there was none.
+bool phoneAdvertUnchanged(uint8_t syncType, uint32_t *tag, bool *tagged)
+{
+    *tagged = phoneLink->advertisedTag(tag) && *tag != 0;
+    return *tagged && syncType == SYNC_TYPE_AUTO && permitStoreAdvertTag == *tag;
 }
 
-// Clean up BLE resources
-void cleanupBluetooth()
+// The phone as a permit source: scan, then connect and read with retries.
+// An auto sync stops after the scan when the advertisement says nothing changed.
+class BlePermitSource : public PermitSource
 {
-    if (targetDevice)
+public:
+    const char *name()
+    {
+        return "BLE";
+    }
+
+    int fetch(const PermitRequest &request, PermitFetch *out)
+    {
+        out->hasQueue = true;
+        if (!scanForPhone() || cancelled)
+        {
+            out->failure = cancelled ? SYNC_FAIL_CANCELLED : SYNC_FAIL_OUT_OF_RANGE;
+            phoneLink->release();
+            return 0;
+        }
+        uint32_t tag;
+        bool tagged;
+        if (phoneAdvertUnchanged(request.syncType, &tag, &tagged))
+        {
+            LOG_I("Phone advertises permit tag %08lx, already applied - not connecting", (unsigned long)tag);
+            advertSkippedSyncs++;
+            out->data = *request.current;
+            out->hasQueue = false;  // Keep ours
+            out->failure = SYNC_FAIL_NONE;
+            out->skipped = true;
+            phoneLink->release();
+            return 2;
+        }
+        int result = fetchPermitWithRetries(&out->data, request.current->permitNumber, request.syncType,
+                                            &out->queue, &cancelled);
+        out->failure = result ? SYNC_FAIL_NONE : lastSyncFailure;
+        if (result && tagged)
+        {
+            permitStoreAdvertTag = tag;  // Saved with the permit record
+        }
+        return result;
+    }
+
+    void cancel()
     {
-        delete targetDevice;
-        targetDevice = nullptr;
+        PermitSource::cancel();
+        phoneLink->abort();
     }
-    deviceFound = false;
+};
+
+static BlePermitSource blePermitSource;
+
+// Done with the phone (the stack stays up for the command server)
+void cleanupBluetooth()
+{
+    phoneLink->release();
 }
 
 // ============ BLE Server (for receiving commands from phone) ============
@@ -298,17 +550,18 @@ class CommandCallbacks : public BLECharacteristicCallbacks
 {
     void onWrite(BLECharacteristic *pCharacteristic)
     {
-        std::string value = pCharacteristic->getValue();
-        if (value.length() > 0)
+        // Compare in place rather than copying the value into a std::string
+        const char *value = (const char *)pCharacteristic->getData();
+        size_t len = pCharacteristic->getLength();
+        if (len > 0)
         {
-            Serial.print("Received command: ");
-            Serial.println(value.c_str());
+            LOG_I("Received command: %.*s", (int)len, value);
 
-            if (value == CMD_SYNC)
+            if (len == strlen(CMD_SYNC) && memcmp(value, CMD_SYNC, len) == 0)
             {
                 pendingCommand = 1;
             }
-            else if (value == CMD_FORCE)
+            else if (len == strlen(CMD_FORCE) && memcmp(value, CMD_FORCE, len) == 0)
             {
                 pendingCommand = 2;
             }
@@ -318,57 +571,80 @@ class CommandCallbacks : public BLECharacteristicCallbacks
 
 class ServerCallbacks : public BLEServerCallbacks
 {
-    void onConnect(BLEServer *pServer)
+    // The server also sees the links the sync client opens, so only react
+    // while it is actually advertising for the phone
+    void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
     {
-        Serial.println("Phone connected to display");
+        if (serverRunning)
+        {
+            LOG_I("Phone connected to display");
+            // The phone is the central here, so only ask (speeds up OTA chunks)
+            pServer->updateConnParams(param->connect.remote_bda, BLE_LINK_INTERVAL_MIN, BLE_LINK_INTERVAL_MAX,
+                                      BLE_LINK_LATENCY, BLE_LINK_TIMEOUT);
+        }
     }
 
     void onDisconnect(BLEServer *pServer)
     {
-        Serial.println("Phone disconnected from display");
-        // Restart advertising
-        pServer->startAdvertising();
+        if (serverRunning)
+        {
+            LOG_I("Phone disconnected from display");
+            // Restart advertising
+            pServer->startAdvertising();
+        }
     }
 };
 
+static CommandCallbacks commandCallbacks;
+static ServerCallbacks serverCallbacks;
+
 // Start BLE server to listen for commands
 void startBleServer()
 {
     if (serverRunning)
     {
-        Serial.println("BLE server already running");
+        LOG_I("BLE server already running");
         return;
     }
 
-    Serial.println("Starting BLE server...");
+    LOG_I("Starting BLE server...");
 
-    BLEDevice::init("ParkingDisplay");
+    bleStackBegin();
 
-    bleServer = BLEDevice::createServer();
-    bleServer->setCallbacks(new ServerCallbacks());
+    // Service and advertising data are set up once and survive stop/start
+    if (!bleServer)
+    {
+        bleServer = BLEDevice::createServer();
+        bleServer->setCallbacks(&serverCallbacks);
 
-    BLEService *service = bleServer->createService(BLE_DISPLAY_SERVICE_UUID);
+        BLEService *service = bleServer->createService(BLE_DISPLAY_SERVICE_UUID);
 
-    commandChar = service->createCharacteristic(
-        BLE_COMMAND_CHAR_UUID,
-        BLECharacteristic::PROPERTY_WRITE);
+        commandChar = service->createCharacteristic(
+            BLE_COMMAND_CHAR_UUID,
+            BLECharacteristic::PROPERTY_WRITE);
 
-    commandChar->setCallbacks(new CommandCallbacks());
+        commandChar->setCallbacks(&commandCallbacks);
 
-    service->start();
+        otaAttach(service);
+        pairingAttach(service);
+        renderProfileAttach(service);
 
-    BLEAdvertising *advertising = BLEDevice::getAdvertising();
-    advertising->addServiceUUID(BLE_DISPLAY_SERVICE_UUID);
-    advertising->setScanResponse(true);
-    advertising->setMinPreferred(0x06);
-    advertising->setMinPreferred(0x12);
-    BLEDevice::startAdvertising();
+        service->start();
+
+        BLEAdvertising *advertising = BLEDevice::getAdvertising();
+        advertising->addServiceUUID(BLE_DISPLAY_SERVICE_UUID);
+        advertising->setScanResponse(true);
+        advertising->setMinPreferred(0x06);
+        advertising->setMinPreferred(0x12);
+    }
 
     serverRunning = true;
-    Serial.println("BLE server started, waiting for commands...");
+    BLEDevice::startAdvertising();
+    LOG_I("BLE server started, waiting for commands...");
 }
 
-// Stop BLE server (before doing client operations)
+// Stop BLE server (before doing client operations).
+// Only advertising stops; the stack and the service stay up.
 void stopBleServer()
 {
     if (!serverRunning)
@@ -376,13 +652,9 @@ void stopBleServer()
         return;
     }
 
-    Serial.println("Stopping BLE server...");
-    BLEDevice::stopAdvertising();
-    BLEDevice::deinit(false);
-    bleServer = nullptr;
-    commandChar = nullptr;
+    LOG_I("Stopping BLE server...");
     serverRunning = false;
-    delay(100);
+    BLEDevice::stopAdvertising();
 }
 
 // Check if there's a pending command from phone
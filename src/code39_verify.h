@@ -0,0 +1,392 @@
+#ifndef CODE39_VERIFY_H
+#define CODE39_VERIFY_H
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <math.h>
+#include "Code39Generator.h"
+#include "permit_config.h"
+#include "log_helper.h"
+
+// Code 39 decoder for checking what Code39Generator actually renders.
+//
+// The barcode is drawn into a GFXcanvas1 with the same template the panel
+// and the pre-render path use, one scanline is read back and decoded the
+// way a scanner would: threshold, run lengths, three widest of nine
+// elements are wide. The decoder reports the narrowest bar and space and
+// the wide/narrow separation left, and the benchmark degrades the scanline
+// with blur and ghosting to find how much of either a symbol survives.
+// Built into the phone simulator env (-DPHONE_SIM) and run at boot.
+
+#ifndef BARCODE_VERIFY_RUNS
+#define BARCODE_VERIFY_RUNS 2000
+#endif
+#define BARCODE_VERIFY_MAX_LEN 12          // Random values are 1..this many characters
+#define BARCODE_VERIFY_MAX_NARROW 6        // Per-width stats; wider modules are pooled in the last row
+#define BARCODE_VERIFY_SIGMA_STEP 0.25f    // Blur sweep step (gaussian sigma, px)
+#define BARCODE_VERIFY_SIGMA_MAX 3.0f
+#define BARCODE_VERIFY_GHOST_STEP 0.05f    // Ghost sweep step (fraction of the previous image)
+#define BARCODE_VERIFY_GHOST_MAX 0.5f
+#define CODE39_VERIFY_MAX_W 512            // Longest scanline the decoder accepts
+#define CODE39_VERIFY_MIN_CONTRAST 64.0f   // Black/white difference needed to threshold at all
+
+struct Code39Decode
+{
+    bool ok;
+    char text[24];
+    int minBar;       // Narrowest bar in the symbol, px
+    int minSpace;     // Narrowest space (inter-character gaps included), px
+    int quietLeft;    // Blank run before the first bar, px
+    int quietRight;
+    float margin;     // Worst (narrowest wide - widest narrow) / widest narrow over all characters
+};
+
+// Split nine element widths into wide/narrow: the three widest are wide
+static bool code39Classify(const uint16_t *w, char *bits, float *margin)
+{
+    uint8_t order[9];
+    for (int k = 0; k < 9; k++)
+    {
+        order[k] = k;
+    }
+    for (int k = 1; k < 9; k++)
+    {
+        for (int j = k; j > 0 && w[order[j]] > w[order[j - 1]]; j--)
+        {
+            uint8_t t = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = t;
+        }
+    }
+
+    uint16_t minWide = w[order[2]];
+    uint16_t maxNarrow = w[order[3]];
+    if (minWide <= maxNarrow)
+    {
+        return false;
+    }
+    for (int k = 0; k < 9; k++)
+    {
+        bits[k] = '0';
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        bits[order[k]] = '1';
+    }
+    *margin = (float)(minWide - maxNarrow) / maxNarrow;
+    return true;
+}
+
+// Decode one scanline of intensities (0 = black .. 255 = white).
+// Expects exactly one symbol, start and stop '*' included.
+static bool code39DecodeRow(const float *row, int len, Code39Decode *out)
+{
+    static Code39Generator<GFXcanvas1> table(nullptr);
+    static uint16_t runs[CODE39_VERIFY_MAX_W + 1];
+
+    memset(out, 0, sizeof(*out));
+    out->minBar = out->minSpace = len;
+    out->margin = 1e9f;
+    if (len > CODE39_VERIFY_MAX_W)
+    {
+        return false;
+    }
+
+    float lo = 255, hi = 0;
+    for (int x = 0; x < len; x++)
+    {
+        lo = min(lo, row[x]);
+        hi = max(hi, row[x]);
+    }
+    if (hi - lo < CODE39_VERIFY_MIN_CONTRAST)
+    {
+        return false;
+    }
+    float threshold = (lo + hi) / 2;
+
+    // Run lengths; even indexes are white (the first one may be empty)
+    int count = 0;
+    bool black = false;
+    runs[0] = 0;
+    for (int x = 0; x < len; x++)
+    {
+        bool b = row[x] < threshold;
+        if (b != black)
+        {
+            runs[++count] = 0;
+            black = b;
+        }
+        runs[count]++;
+    }
+    count++;
+    out->quietLeft = runs[0];
+
+    int chars = 0;  // Decoded so far, start character included
+    int i = 1;
+    for (;;)
+    {
+        if (i + 9 > count)
+        {
+            return false;
+        }
+        char bits[9];
+        float margin;
+        if (!code39Classify(&runs[i], bits, &margin))
+        {
+            return false;
+        }
+        char c = table.charForPattern(bits);
+        if (!c || (chars == 0 && c != '*'))
+        {
+            return false;
+        }
+        for (int k = 0; k < 9; k++)
+        {
+            if (k % 2 == 0)
+            {
+                out->minBar = min(out->minBar, (int)runs[i + k]);
+            }
+            else
+            {
+                out->minSpace = min(out->minSpace, (int)runs[i + k]);
+            }
+        }
+        out->margin = min(out->margin, margin);
+        i += 9;
+
+        if (chars > 0 && c == '*')
+        {
+            break;
+        }
+        if (chars > 0)
+        {
+            if (chars > (int)sizeof(out->text) - 1)
+            {
+                return false;
+            }
+            out->text[chars - 1] = c;
+        }
+        chars++;
+
+        // Inter-character gap
+        if (i >= count - 1)
+        {
+            return false;
+        }
+        out->minSpace = min(out->minSpace, (int)runs[i]);
+        i++;
+    }
+
+    // Only the trailing quiet zone may follow the stop character
+    if (i < count - 1)
+    {
+        return false;
+    }
+    out->quietRight = i < count ? runs[i] : 0;
+    out->ok = true;
+    return true;
+}
+
+// Read a canvas row as intensities (canvas ink = 1 = black)
+static void code39ReadRow(GFXcanvas1 *canvas, int y, float *row, int len)
+{
+    for (int x = 0; x < len; x++)
+    {
+        row[x] = canvas->getPixel(x, y) ? 0.0f : 255.0f;
+    }
+}
+
+// Degrade a clean scanline the way the panel and a scanner do:
+// ghost = fraction of the previous image left behind,
+// sigma = gaussian blur in px (ink spread, defocus). Paper beyond the edges.
+static void code39Degrade(const float *clean, const float *previous, int len,
+                          float ghost, float sigma, float *out)
+{
+    static float mixed[CODE39_VERIFY_MAX_W];
+    for (int x = 0; x < len; x++)
+    {
+        mixed[x] = clean[x] * (1 - ghost) + previous[x] * ghost;
+    }
+    if (sigma <= 0)
+    {
+        memcpy(out, mixed, len * sizeof(float));
+        return;
+    }
+
+    float kernel[17];
+    int radius = min(8, (int)ceilf(3 * sigma));
+    float sum = 0;
+    for (int k = -radius; k <= radius; k++)
+    {
+        kernel[k + radius] = expf(-(k * k) / (2 * sigma * sigma));
+        sum += kernel[k + radius];
+    }
+    for (int x = 0; x < len; x++)
+    {
+        float acc = 0;
+        for (int k = -radius; k <= radius; k++)
+        {
+            int sx = x + k;
+            acc += kernel[k + radius] * ((sx < 0 || sx >= len) ? 255.0f : mixed[sx]);
+        }
+        out[x] = acc / sum;
+    }
+}
+
+static bool code39DecodesAs(const float *clean, const float *previous, int len,
+                            float ghost, float sigma, const char *expected)
+{
+    static float row[CODE39_VERIFY_MAX_W];
+    Code39Decode dec;
+    code39Degrade(clean, previous, len, ghost, sigma, row);
+    return code39DecodeRow(row, len, &dec) && strcmp(dec.text, expected) == 0;
+}
+
+struct BarcodeVerifyStats
+{
+    uint32_t runs;
+    uint32_t failures;   // Clean render did not decode to the value
+    int minBar;
+    int minSpace;
+    float minMargin;
+    float sumSigma;      // Largest blur each symbol survived
+    float minSigma;
+    float sumGhost;      // Largest ghost each symbol survived
+    float minGhost;
+};
+
+static void barcodeVerifyRandomValue(char *out, int len)
+{
+    // Every encodable character except the start/stop '*'
+    static const char *charset = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-. $/+%";
+    for (int i = 0; i < len; i++)
+    {
+        out[i] = charset[random(43)];
+    }
+    out[len] = '\0';
+}
+
+// Render random values with the layout's fitted module widths (even runs)
+// and random ones (odd runs), decode them clean, then sweep blur and ghost
+// until decoding breaks. Fails if any clean render does not decode.
+bool barcodeVerifyBenchmark(int runs)
+{
+    static float clean[SCREEN_W];
+    static float previous[SCREEN_W];
+    BarcodeVerifyStats stats[BARCODE_VERIFY_MAX_NARROW];
+    for (BarcodeVerifyStats &s : stats)
+    {
+        s = {0, 0, SCREEN_W, SCREEN_W, 1e9f, 0, 1e9f, 0, 1e9f};
+    }
+    uint32_t fitFailures = 0, randomFailures = 0, noFit = 0, skipped = 0;
+
+    LOG_STAT("\n=== Barcode verify: %d runs ===", runs);
+    GFXcanvas1 canvas(SCREEN_W, 2);  // Row 0 current symbol, row 1 previous one (ghost source)
+    if (!canvas.getBuffer())
+    {
+        LOG_E("Not enough memory for barcode verify canvas");
+        return false;
+    }
+    Code39Generator<GFXcanvas1> gen(&canvas, 1);
+    unsigned long wallStart = millis();
+
+    for (int i = 0; i < runs; i++)
+    {
+        char value[BARCODE_VERIFY_MAX_LEN + 1];
+        char prevValue[BARCODE_VERIFY_MAX_LEN + 1];
+        barcodeVerifyRandomValue(value, 1 + random(BARCODE_VERIFY_MAX_LEN));
+        barcodeVerifyRandomValue(prevValue, 1 + random(BARCODE_VERIFY_MAX_LEN));
+
+        bool fitted = i % 2 == 0;
+        int narrow, wide, x;
+        if (fitted)
+        {
+            Code39Fit fit = gen.fit(value, BARCODE_AREA_W, BARCODE_QUIET_MODULES);
+            narrow = fit.narrow;
+            wide = fit.wide;
+            x = BARCODE_X + max(0, (BARCODE_AREA_W - fit.width) / 2);  // As drawPermitLayout places it
+            noFit += fit.fits ? 0 : 1;
+        }
+        else
+        {
+            narrow = 1 + random(3);
+            wide = narrow * 2 + random(narrow + 1);
+            int width = gen.getBarcodeWidth(value, narrow, wide);
+            if (width + 2 * narrow * BARCODE_QUIET_MODULES > SCREEN_W)
+            {
+                skipped++;
+                continue;
+            }
+            x = (SCREEN_W - width) / 2;
+        }
+        int prevX = max(0, (SCREEN_W - gen.getBarcodeWidth(prevValue, narrow, wide)) / 2);
+
+        canvas.fillScreen(0);
+        gen.drawBarcode(value, x, 0, 1, narrow, wide);
+        gen.drawBarcode(prevValue, prevX, 1, 1, narrow, wide);
+        code39ReadRow(&canvas, 0, clean, SCREEN_W);
+        code39ReadRow(&canvas, 1, previous, SCREEN_W);
+
+        BarcodeVerifyStats &s = stats[min(narrow, BARCODE_VERIFY_MAX_NARROW) - 1];
+        s.runs++;
+
+        Code39Decode dec;
+        if (!code39DecodeRow(clean, SCREEN_W, &dec) || strcmp(dec.text, value) != 0)
+        {
+            s.failures++;
+            (fitted ? fitFailures : randomFailures)++;
+            if (fitFailures + randomFailures <= 5)
+            {
+                LOG_W("Barcode \"%s\" (%d/%d px at x=%d) decoded as \"%s\"",
+                      value, narrow, wide, x, dec.ok ? dec.text : "(nothing)");
+            }
+            continue;
+        }
+        s.minBar = min(s.minBar, dec.minBar);
+        s.minSpace = min(s.minSpace, dec.minSpace);
+        s.minMargin = min(s.minMargin, dec.margin);
+
+        float sigma = 0;
+        while (sigma + BARCODE_VERIFY_SIGMA_STEP <= BARCODE_VERIFY_SIGMA_MAX &&
+               code39DecodesAs(clean, previous, SCREEN_W, 0, sigma + BARCODE_VERIFY_SIGMA_STEP, value))
+        {
+            sigma += BARCODE_VERIFY_SIGMA_STEP;
+        }
+        float ghost = 0;
+        while (ghost + BARCODE_VERIFY_GHOST_STEP <= BARCODE_VERIFY_GHOST_MAX &&
+               code39DecodesAs(clean, previous, SCREEN_W, ghost + BARCODE_VERIFY_GHOST_STEP, 0, value))
+        {
+            ghost += BARCODE_VERIFY_GHOST_STEP;
+        }
+        s.sumSigma += sigma;
+        s.minSigma = min(s.minSigma, sigma);
+        s.sumGhost += ghost;
+        s.minGhost = min(s.minGhost, ghost);
+    }
+
+    LOG_STAT("Runs: %d in %lu ms wall time (%lu skipped: too wide for the panel)",
+             runs, millis() - wallStart, (unsigned long)skipped);
+    LOG_STAT("  clean decode failures: %lu with layout fit, %lu with random modules; %lu values had no fit with quiet zones",
+             (unsigned long)fitFailures, (unsigned long)randomFailures, (unsigned long)noFit);
+    for (int n = 0; n < BARCODE_VERIFY_MAX_NARROW; n++)
+    {
+        BarcodeVerifyStats &s = stats[n];
+        uint32_t decoded = s.runs - s.failures;
+        if (!decoded)
+        {
+            continue;
+        }
+        LOG_STAT("  narrow %d%s px: %lu runs, min bar %d, min space %d, margin %.2f, "
+                 "blur sigma mean %.2f min %.2f, ghost mean %.0f%% min %.0f%%",
+                 n + 1, n + 1 == BARCODE_VERIFY_MAX_NARROW ? "+" : "", (unsigned long)s.runs,
+                 s.minBar, s.minSpace, s.minMargin,
+                 s.sumSigma / decoded, s.minSigma,
+                 100 * s.sumGhost / decoded, 100 * s.minGhost);
+    }
+
+    bool ok = fitFailures + randomFailures == 0;
+    LOG_STAT("Barcode verify %s", ok ? "PASSED" : "FAILED");
+    return ok;
+}
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <Arduino.h>
+#include "log_helper.h"
+
+// ========== CURRENT PROFILE (mA) ==========
+// Defaults are typical ESP32-S3 figures; override with -D build flags
+// once a board has been measured.
+//
+// An operation is charged by wall time at each CPU frequency, not by the
+// time the CPU was busy: nothing here can tell a delay() or a wait on the
+// BLE stack from work. A sync is mostly such waits, so the ENERGY_MA_AWAKE_*
+// figures are the current of a core that is clocked but blocked (radio
+// off), and the short bursts of real work (HMAC, JSON, drawing) are
+// charged at that rate too. Measure a whole sync on the bench and set
+// them from that if the estimate has to be closer.
+#ifndef ENERGY_MA_AWAKE_240
+#define ENERGY_MA_AWAKE_240 28.0f  // Awake at 240 MHz, mostly blocked, radio off
+#endif
+#ifndef ENERGY_MA_AWAKE_160
+#define ENERGY_MA_AWAKE_160 23.0f  // Awake at 160 MHz, mostly blocked, radio off
+#endif
+#ifndef ENERGY_MA_AWAKE_80
+#define ENERGY_MA_AWAKE_80 17.0f   // Awake at 80 MHz or below, mostly blocked, radio off
+#endif
+#ifndef ENERGY_MA_RADIO
+#define ENERGY_MA_RADIO 75.0f     // Added while BLE/WiFi radio is on
+#endif
+#ifndef ENERGY_MA_PANEL
+#define ENERGY_MA_PANEL 8.0f      // Added while e-ink refresh waveform runs
+#endif
+#ifndef ENERGY_MA_IDLE
+#define ENERGY_MA_IDLE 30.0f      // Main loop between syncs: waiting, advertising
+#endif
+
+// ========== USAGE PATTERN (per day) ==========
+#ifndef ENERGY_BOOTS_PER_DAY
+#define ENERGY_BOOTS_PER_DAY 2          // Car ignition cycles
+#endif
+#ifndef ENERGY_MANUAL_SYNCS_PER_DAY
+#define ENERGY_MANUAL_SYNCS_PER_DAY 1   // Button presses / app sync taps
+#endif
+#ifndef ENERGY_UPDATES_PER_DAY
+#define ENERGY_UPDATES_PER_DAY 0.15f    // Permit actually changes (~weekly)
+#endif
+#ifndef ENERGY_FAILED_SYNC_RATIO
+#define ENERGY_FAILED_SYNC_RATIO 0.3f   // Share of syncs where phone is not found
+#endif
+#ifndef ENERGY_AWAKE_HOURS_PER_DAY
+#define ENERGY_AWAKE_HOURS_PER_DAY 2.0f // Powered and idling in the loop
+#endif
+
+// Operations we account energy for
+enum EnergyOp
+{
+    ENERGY_OP_BOOT_SYNC = 0,   // Auto-sync on boot (any outcome)
+    ENERGY_OP_SYNC_UPDATED,    // Sync that received and drew a new permit
+    ENERGY_OP_SYNC_UNCHANGED,  // Sync that found the permit unchanged
+    ENERGY_OP_SYNC_SKIPPED,    // Unchanged, told by the phone's advertisement (no connection)
+    ENERGY_OP_SYNC_FAILED,     // Phone not found / connection failed
+    ENERGY_OP_REFRESH,         // A single full panel refresh
+    ENERGY_OP_COUNT
+};
+
+// CPU frequency buckets for awake (wall) time
+enum EnergyCpuBucket
+{
+    ENERGY_CPU_240 = 0,
+    ENERGY_CPU_160,
+    ENERGY_CPU_80,
+    ENERGY_CPU_BUCKETS
+};
+
+struct EnergyProfile
+{
+    float awakeMa[ENERGY_CPU_BUCKETS];
+    float radioMa;
+    float panelMa;
+    float idleMa;
+};
+
+// Counters collected while an operation is running
+struct EnergySample
+{
+    uint32_t awakeMs[ENERGY_CPU_BUCKETS];  // Wall time at each frequency, busy or blocked
+    uint32_t radioMs;
+    uint32_t refreshMs;
+    uint16_t refreshCount;
+};
+
+struct EnergyOpStats
+{
+    uint32_t count;
+    float totalMah;
+    float lastMah;
+};
+
+static EnergyProfile energyProfile = {
+    {ENERGY_MA_AWAKE_240, ENERGY_MA_AWAKE_160, ENERGY_MA_AWAKE_80},
+    ENERGY_MA_RADIO,
+    ENERGY_MA_PANEL,
+    ENERGY_MA_IDLE};
+
+static const char *ENERGY_OP_NAMES[ENERGY_OP_COUNT] = {
+    "boot sync", "sync updated", "sync unchanged", "sync skipped", "sync failed", "panel refresh"};
+
+static EnergySample energySample;
+static EnergyOpStats energyStats[ENERGY_OP_COUNT];
+static bool energyActive = false;
+static uint32_t energyCheckpointMs = 0;
+static uint32_t energyRadioOnMs = 0;
+static uint32_t energyRefreshStartMs = 0;
+static uint8_t energyRadioUsers = 0;  // Scans, links and WiFi sessions keeping the radio busy
+static portMUX_TYPE energyRadioMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ---- Pure model (no hardware access, usable from a host build) ----
+
+static inline int energyCpuBucket(uint32_t mhz)
+{
+    if (mhz >= 240) return ENERGY_CPU_240;
+    if (mhz >= 160) return ENERGY_CPU_160;
+    return ENERGY_CPU_80;
+}
+
+// Charge in mAh for the counters in a sample
+static inline float energyEstimateMah(const EnergySample &s, const EnergyProfile &p)
+{
+    float maMs = 0;
+    for (int i = 0; i < ENERGY_CPU_BUCKETS; i++)
+    {
+        maMs += p.awakeMa[i] * s.awakeMs[i];
+    }
+    maMs += p.radioMa * s.radioMs;
+    maMs += p.panelMa * s.refreshMs;
+    return maMs / 3600000.0f;
+}
+
+static inline float energyAverageMah(int op)
+{
+    const EnergyOpStats &st = energyStats[op];
+    return st.count ? st.totalMah / st.count : 0.0f;
+}
+
+// Estimated mAh per day for the configured usage pattern,
+// using averages measured so far for each operation
+static inline float energyEstimateDailyMah()
+{
+    float manual = ENERGY_MANUAL_SYNCS_PER_DAY;
+    float failed = manual * ENERGY_FAILED_SYNC_RATIO;
+    float updated = min((float)ENERGY_UPDATES_PER_DAY, manual - failed);
+    float unchanged = manual - failed - updated;
+
+    // Boot syncs are usually silent and unchanged; use that until measured
+    float bootMah = energyStats[ENERGY_OP_BOOT_SYNC].count ? energyAverageMah(ENERGY_OP_BOOT_SYNC)
+                                                           : energyAverageMah(ENERGY_OP_SYNC_UNCHANGED);
+
+    return ENERGY_BOOTS_PER_DAY * bootMah +
+           failed * energyAverageMah(ENERGY_OP_SYNC_FAILED) +
+           updated * energyAverageMah(ENERGY_OP_SYNC_UPDATED) +
+           unchanged * energyAverageMah(ENERGY_OP_SYNC_UNCHANGED) +
+           ENERGY_AWAKE_HOURS_PER_DAY * energyProfile.idleMa;
+}
+
+// ---- Instrumentation hooks ----
+
+// Charge wall time since the last checkpoint to the current CPU frequency.
+// The firmware runs at one frequency per build (board_build.f_cpu), so the
+// checkpoint at energyEnd() is enough; anything that changes it mid-sync
+// must call this first.
+static inline void energyCheckpoint()
+{
+    if (!energyActive) return;
+    uint32_t now = millis();
+    energySample.awakeMs[energyCpuBucket(getCpuFrequencyMhz())] += now - energyCheckpointMs;
+    energyCheckpointMs = now;
+}
+
+// Bracket each window the radio is really working: a scan, a connection,
+// a WiFi session. Sources run in parallel tasks, so the windows nest and
+// radio time is counted while any of them is open. Idle advertising
+// between syncs is left out (it is in the idle current).
+static inline void energyRadioOn()
+{
+    portENTER_CRITICAL(&energyRadioMux);
+    if (energyRadioUsers++ == 0)
+    {
+        energyRadioOnMs = millis();
+    }
+    portEXIT_CRITICAL(&energyRadioMux);
+}
+
+static inline void energyRadioOff()
+{
+    portENTER_CRITICAL(&energyRadioMux);
+    if (energyRadioUsers && --energyRadioUsers == 0 && energyActive)
+    {
+        energySample.radioMs += millis() - energyRadioOnMs;
+    }
+    portEXIT_CRITICAL(&energyRadioMux);
+}
+
+static inline void energyRefreshBegin()
+{
+    energyRefreshStartMs = millis();
+}
+
+static inline void energyRefreshEnd()
+{
+    uint32_t ms = millis() - energyRefreshStartMs;
+
+    // Every refresh is also accounted on its own
+    EnergySample one = {};
+    one.awakeMs[energyCpuBucket(getCpuFrequencyMhz())] = ms;
+    one.refreshMs = ms;
+    one.refreshCount = 1;
+    float mah = energyEstimateMah(one, energyProfile);
+    energyStats[ENERGY_OP_REFRESH].count++;
+    energyStats[ENERGY_OP_REFRESH].totalMah += mah;
+    energyStats[ENERGY_OP_REFRESH].lastMah = mah;
+
+    if (energyActive)
+    {
+        energySample.refreshMs += ms;
+        energySample.refreshCount++;
+    }
+}
+
+// Start accounting a sync operation
+static inline void energyBegin()
+{
+    memset(&energySample, 0, sizeof(energySample));
+    energyActive = true;
+    energyCheckpointMs = millis();
+    if (energyRadioUsers)
+    {
+        energyRadioOnMs = energyCheckpointMs;
+    }
+}
+
+// Finish the operation, charge it to op and print a summary
+static inline float energyEnd(EnergyOp op)
+{
+    if (!energyActive) return 0;
+
+    energyCheckpoint();
+    if (energyRadioUsers)
+    {
+        uint32_t now = millis();
+        energySample.radioMs += now - energyRadioOnMs;
+        energyRadioOnMs = now;
+    }
+    energyActive = false;
+
+    float mah = energyEstimateMah(energySample, energyProfile);
+    energyStats[op].count++;
+    energyStats[op].totalMah += mah;
+    energyStats[op].lastMah = mah;
+
+    uint32_t awakeMs = 0;
+    for (int i = 0; i < ENERGY_CPU_BUCKETS; i++) awakeMs += energySample.awakeMs[i];
+
+    LOG_STAT("Energy [%s]: %.4f mAh (awake %lu ms [240:%lu 160:%lu 80:%lu], radio %lu ms, %u refresh %lu ms)",
+             ENERGY_OP_NAMES[op], mah, (unsigned long)awakeMs,
+             (unsigned long)energySample.awakeMs[ENERGY_CPU_240],
+             (unsigned long)energySample.awakeMs[ENERGY_CPU_160],
+             (unsigned long)energySample.awakeMs[ENERGY_CPU_80],
+             (unsigned long)energySample.radioMs,
+             energySample.refreshCount, (unsigned long)energySample.refreshMs);
+    return mah;
+}
+
+// Print per-operation averages and the per-day estimate
+static inline void energyPrintReport()
+{
+    LOG_STAT("=== Energy estimate ===");
+    for (int i = 0; i < ENERGY_OP_COUNT; i++)
+    {
+        if (energyStats[i].count == 0) continue;
+        LOG_STAT("  %-15s n=%lu avg %.4f mAh, last %.4f mAh",
+                 ENERGY_OP_NAMES[i], (unsigned long)energyStats[i].count,
+                 energyAverageMah(i), energyStats[i].lastMah);
+    }
+    LOG_STAT("  Per day (%d boots, %d manual syncs, %.1f h awake): %.1f mAh",
+             ENERGY_BOOTS_PER_DAY, ENERGY_MANUAL_SYNCS_PER_DAY,
+             ENERGY_AWAKE_HOURS_PER_DAY, energyEstimateDailyMah());
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef FONT_BENCH_H
+#define FONT_BENCH_H
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include "Fonts/FreeSansBold8pt7b.h"
+#include "Fonts/FreeSansBold13pt7b.h"
+#include "Fonts/FreeSansBold8pt7b_rle.h"
+#include "Fonts/FreeSansBold13pt7b_rle.h"
+#include "permit_config.h"
+#include "log_helper.h"
+
+// Subset RLE fonts (rle_font.h) against the GFX fonts they were made from:
+// flash taken by each, time to draw the permit's strings, and whether both
+// put the same pixels in the frame. Drawn into a GFXcanvas1 (the pre-render
+// path) and into the panel's own memory. Built into the phone simulator env
+// (-DPHONE_SIM), the only build that still links the GFX fonts.
+
+#ifndef FONT_BENCH_RUNS
+#define FONT_BENCH_RUNS 200
+#endif
+
+struct FontBenchCase
+{
+    const GFXfont *gfx;
+    const RleFont *rle;
+    const char *text;
+};
+
+static const FontBenchCase FONT_BENCH_CASES[] = {
+    {&FreeSansBold8pt7b, &FreeSansBold8pt7bRle, "Permit #: T6103268"},
+    {&FreeSansBold8pt7b, &FreeSansBold8pt7bRle, "Plate #: CSEB187"},
+    {&FreeSansBold8pt7b, &FreeSansBold8pt7bRle, "Sep 05, 2025: 01:08"},
+    {&FreeSansBold8pt7b, &FreeSansBold8pt7bRle, "Temporary parking"},
+    {&FreeSansBold13pt7b, &FreeSansBold13pt7bRle, "00435"},
+};
+#define FONT_BENCH_CASE_COUNT (sizeof(FONT_BENCH_CASES) / sizeof(FONT_BENCH_CASES[0]))
+#define FONT_BENCH_BASELINE 40
+
+// Time runs draws of every case; returns us per pass over all of them
+template <class Draw>
+static uint32_t fontBenchTime(int runs, Draw draw)
+{
+    uint32_t start = micros();
+    for (int i = 0; i < runs; i++)
+    {
+        for (const FontBenchCase &c : FONT_BENCH_CASES)
+        {
+            draw(c);
+        }
+    }
+    return (micros() - start) / runs;
+}
+
+template <class Panel>
+bool fontBenchmark(Panel *panel, int runs)
+{
+    LOG_STAT("\n=== Font benchmark: %d runs ===", runs);
+    size_t gfxBytes = sizeof(FreeSansBold8pt7bBitmaps) + sizeof(FreeSansBold8pt7bGlyphs) +
+                      sizeof(FreeSansBold13pt7bBitmaps) + sizeof(FreeSansBold13pt7bGlyphs);
+    size_t rleBytes = sizeof(FreeSansBold8pt7bRleData) + sizeof(FreeSansBold8pt7bRleGlyphs) +
+                      sizeof(FreeSansBold8pt7bRleMap) + sizeof(FreeSansBold13pt7bRleData) +
+                      sizeof(FreeSansBold13pt7bRleGlyphs) + sizeof(FreeSansBold13pt7bRleMap);
+    LOG_STAT("Font flash: GFX %u bytes, subset RLE %u bytes (%u%%)",
+             (unsigned)gfxBytes, (unsigned)rleBytes, (unsigned)(100 * rleBytes / gfxBytes));
+
+    GFXcanvas1 gfxCanvas(SCREEN_W, SCREEN_H);
+    GFXcanvas1 rleCanvas(SCREEN_W, SCREEN_H);
+    if (!gfxCanvas.getBuffer() || !rleCanvas.getBuffer())
+    {
+        LOG_E("Not enough memory for font benchmark canvases");
+        return false;
+    }
+
+    // Same pixels, case by case
+    int glyphs = 0, mismatches = 0;
+    for (const FontBenchCase &c : FONT_BENCH_CASES)
+    {
+        gfxCanvas.fillScreen(0);
+        rleCanvas.fillScreen(0);
+        gfxCanvas.setFont(c.gfx);
+        gfxCanvas.setTextColor(1);
+        gfxCanvas.setCursor(0, FONT_BENCH_BASELINE);
+        gfxCanvas.print(c.text);
+        rleDrawText(&rleCanvas, c.rle, 0, FONT_BENCH_BASELINE, c.text, 1);
+        if (memcmp(gfxCanvas.getBuffer(), rleCanvas.getBuffer(), ((SCREEN_W + 7) / 8) * SCREEN_H) != 0)
+        {
+            LOG_W("Font mismatch drawing \"%s\"", c.text);
+            mismatches++;
+        }
+        glyphs += strlen(c.text);
+    }
+
+    uint32_t gfxCanvasUs = fontBenchTime(runs, [&](const FontBenchCase &c) {
+        gfxCanvas.setFont(c.gfx);
+        gfxCanvas.setCursor(0, FONT_BENCH_BASELINE);
+        gfxCanvas.print(c.text);
+    });
+    uint32_t rleCanvasUs = fontBenchTime(runs, [&](const FontBenchCase &c) {
+        rleDrawText(&rleCanvas, c.rle, 0, FONT_BENCH_BASELINE, c.text, 1);
+    });
+    uint32_t gfxPanelUs = fontBenchTime(runs, [&](const FontBenchCase &c) {
+        panel->setFont(c.gfx);
+        panel->setTextColor(0x0000);
+        panel->setCursor(0, FONT_BENCH_BASELINE);
+        panel->print(c.text);
+    });
+    uint32_t rlePanelUs = fontBenchTime(runs, [&](const FontBenchCase &c) {
+        rleDrawText(panel, c.rle, 0, FONT_BENCH_BASELINE, c.text, 0x0000);
+    });
+    panel->clearMemory();
+
+    LOG_STAT("Font draw, %d glyphs per pass: canvas GFX %lu us, RLE %lu us (%.1fx); panel GFX %lu us, RLE %lu us (%.1fx)",
+             glyphs, (unsigned long)gfxCanvasUs, (unsigned long)rleCanvasUs,
+             rleCanvasUs ? (float)gfxCanvasUs / rleCanvasUs : 0.0f,
+             (unsigned long)gfxPanelUs, (unsigned long)rlePanelUs,
+             rlePanelUs ? (float)gfxPanelUs / rlePanelUs : 0.0f);
+    LOG_STAT("Font output: %d of %d strings identical", (int)FONT_BENCH_CASE_COUNT - mismatches,
+             (int)FONT_BENCH_CASE_COUNT);
+    return mismatches == 0;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef LOG_HELPER_H
+#define LOG_HELPER_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Logging macros with compile-time levels and a RAM ring buffer.
+//
+// LOG_E/W/I/D format into the ring and return; a low-priority task drains
+// it to Serial, so callers never wait on USB CDC. Levels above LOG_LEVEL
+// compile to nothing (format strings included). When the ring is full,
+// messages are dropped and counted rather than blocking.
+//
+// LOG_STAT is for measurement output (timings, energy, memory) and is
+// controlled by LOG_STATS instead of LOG_LEVEL, so a quiet build can still
+// be measured. Every macro appends the newline.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#ifndef LOG_STATS
+#define LOG_STATS 1
+#endif
+
+#define LOG_RING_SIZE 4096     // Power of two
+#define LOG_LINE_MAX 192       // Longer messages are cut
+#define LOG_TASK_STACK 3072
+#define LOG_TASK_PRIORITY 0    // Only runs when nothing else wants the CPU
+
+#if LOG_LEVEL > LOG_LEVEL_NONE || LOG_STATS
+#define LOG_ENABLED 1
+#else
+#define LOG_ENABLED 0
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(...) logWrite(__VA_ARGS__)
+#else
+#define LOG_E(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(...) logWrite(__VA_ARGS__)
+#else
+#define LOG_W(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(...) logWrite(__VA_ARGS__)
+#else
+#define LOG_I(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(...) logWrite(__VA_ARGS__)
+#else
+#define LOG_D(...) do {} while (0)
+#endif
+#if LOG_STATS
+#define LOG_STAT(...) logWrite(__VA_ARGS__)
+#else
+#define LOG_STAT(...) do {} while (0)
+#endif
+
+struct LogStats
+{
+    uint32_t messages;
+    uint32_t bytes;
+    uint32_t dropped;   // Messages lost to a full ring
+    uint32_t totalUs;   // Time spent in logWrite() (what callers pay)
+    uint32_t maxUs;
+};
+
+static LogStats logStats;
+
+#if LOG_ENABLED
+
+static char logRing[LOG_RING_SIZE];
+static volatile uint32_t logHead = 0;  // Free-running write index
+static volatile uint32_t logTail = 0;  // Free-running read index
+static portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t logTaskHandle = nullptr;
+static StaticTask_t logTaskBuffer;
+static StackType_t logTaskStack[LOG_TASK_STACK];
+
+static void logWrite(const char *fmt, ...)
+{
+    uint32_t start = micros();
+    char line[LOG_LINE_MAX];
+
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line) - 1, fmt, args);
+    va_end(args);
+    if (len < 0)
+    {
+        return;
+    }
+    if (len > (int)sizeof(line) - 2)
+    {
+        len = sizeof(line) - 2;
+    }
+    line[len++] = '\n';
+
+    bool stored = false;
+    portENTER_CRITICAL(&logMux);
+    if (LOG_RING_SIZE - (logHead - logTail) >= (uint32_t)len)
+    {
+        for (int i = 0; i < len; i++)
+        {
+            logRing[(logHead + i) & (LOG_RING_SIZE - 1)] = line[i];
+        }
+        logHead += len;
+        stored = true;
+    }
+    portEXIT_CRITICAL(&logMux);
+
+    if (stored)
+    {
+        logStats.messages++;
+        logStats.bytes += len;
+        if (logTaskHandle)
+        {
+            xTaskNotifyGive(logTaskHandle);
+        }
+    }
+    else
+    {
+        logStats.dropped++;
+    }
+
+    uint32_t us = micros() - start;
+    logStats.totalUs += us;
+    if (us > logStats.maxUs)
+    {
+        logStats.maxUs = us;
+    }
+}
+
+static void logTask(void *)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        uint32_t head = logHead;
+        while (logTail != head)
+        {
+            // Write the contiguous part up to the end of the ring
+            uint32_t offset = logTail & (LOG_RING_SIZE - 1);
+            uint32_t chunk = min(head - logTail, (uint32_t)(LOG_RING_SIZE - offset));
+            Serial.write((const uint8_t *)&logRing[offset], chunk);
+
+            portENTER_CRITICAL(&logMux);
+            logTail += chunk;
+            portEXIT_CRITICAL(&logMux);
+            head = logHead;
+        }
+    }
+}
+
+// Start the drain task; call right after Serial.begin()
+void logBegin()
+{
+    logTaskHandle = xTaskCreateStaticPinnedToCore(logTask, "log", LOG_TASK_STACK, nullptr,
+                                                  LOG_TASK_PRIORITY, logTaskStack,
+                                                  &logTaskBuffer, tskNO_AFFINITY);
+}
+
+// Wait until everything logged so far has been handed to Serial
+void logFlush(uint32_t timeoutMs = 1000)
+{
+    uint32_t start = millis();
+    while (logTail != logHead && millis() - start < timeoutMs)
+    {
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    Serial.flush();
+}
+
+#else
+
+void logBegin() {}
+void logFlush(uint32_t timeoutMs = 1000) {}
+
+#endif
+
+// What logging has cost the callers so far
+void logPrintStats()
+{
+    LOG_STAT("Log: %lu messages, %lu bytes, %lu dropped, %lu us total in callers (max %lu us)",
+             (unsigned long)logStats.messages, (unsigned long)logStats.bytes,
+             (unsigned long)logStats.dropped, (unsigned long)logStats.totalUs,
+             (unsigned long)logStats.maxUs);
+}
+
+#endif
@@ -1,15 +1,38 @@
-// Parking Permit Display - BLE Only Version
+// Parking Permit Display - phone (BLE), with optional WiFi and USB serial sources
 #include <Arduino.h>
 #include "heltec-eink-modules.h"
-#include <Preferences.h>
+#include <Adafruit_GFX.h>
 
-#include "Fonts/FreeSansBold8pt7b.h"
-#include "Fonts/FreeSansBold13pt7b.h"
+#include "Fonts/FreeSansBold8pt7b_rle.h"
+#include "Fonts/FreeSansBold13pt7b_rle.h"
 
 #include "Code39Generator.h"
 #include "imgs/toronto_logo.h"
 #include "permit_config.h"
+#include "energy_model.h"
 #include "bluetooth_helper.h"
+#include "permit_broadcast.h"
+#include "permit_serial.h"
+#include "sync_coordinator.h"
+#include "usb_provision.h"
+#ifdef PERMIT_WIFI
+#include "wifi_helper.h"
+#endif
+#include "permit_store.h"
+#include "panel_async.h"
+#include "render_profiler.h"
+#include "background_scan.h"
+#include "mem_telemetry.h"
+#include "log_helper.h"
+#ifdef PHONE_SIM
+#include "phone_sim.h"
+#include "code39_verify.h"
+#include "font_bench.h"
+#include "ota_selftest.h"
+#endif
+#ifdef SYNC_PATH_BENCH
+#include "sync_path_bench.h"
+#endif
 
 // Create display pointer locally
 EInkDisplay_VisionMasterE290 *display = nullptr;
@@ -17,20 +40,114 @@ EInkDisplay_VisionMasterE290 *display = nullptr;
 const int LED_PIN = 45;
 const int BUTTON_PIN = 21; // User button on Heltec Vision Master E290
 
-// Preferences for storing permit data
-Preferences preferences;
-
 // Global permit data
 PermitData currentPermit;
 
-void displayPermit(const char *permitNumber, const char *plateNumber,
-                   const char *validFrom, const char *validTo,
-                   const char *barcodeValue, const char *barcodeLabel)
+// Upcoming permits and the pre-rendered frame for the first one
+PermitQueue permitQueue;
+GFXcanvas1 *nextFrame = nullptr;
+char nextFramePermit[sizeof(PermitData::permitNumber)] = "";
+const unsigned long QUEUE_CHECK_INTERVAL_MS = 1000;
+
+// Status band state (partial refresh overlay on top of the permit)
+bool permitOnScreen = false;      // Panel currently shows the permit layout
+bool statusShown = false;
+int statusPartialCount = 0;       // Partial refreshes since the last full one
+unsigned long statusClearAt = 0;  // millis() when a held status should be cleared (0 = none)
+
+// Where permits come from, in priority order (see sync_coordinator.h)
+SyncPlan syncPlan = {
+  (SyncMode)SYNC_MODE,
+#ifdef PERMIT_WIFI
+  3,
+#else
+  2,
+#endif
+  {
+#ifdef PERMIT_BROADCAST
+    {&broadcastPermitSource, SYNC_BLE_DEADLINE_MS + BROADCAST_LISTEN_MS},  // Falls back to blePermitSource
+#else
+    {&blePermitSource, SYNC_BLE_DEADLINE_MS},
+#endif
+#ifdef PERMIT_WIFI
+    {&wifiPermitSource, SYNC_WIFI_DEADLINE_MS},
+#endif
+    {&serialPermitSource, 0},
+  }};
+
+// True while the boot auto-sync runs (charged separately in the energy model)
+bool bootSyncInProgress = false;
+unsigned long syncStartedAt = 0;
+
+// Start pushing the framebuffer to the panel and return without waiting.
+// The refresh runs on the panel task (see panel_async.h), which also does
+// the energy accounting and logs the wall time.
+PanelTicket refreshDisplay()
+{
+  return panelUpdateAsync();
+}
+
+// Close accounting for the sync in progress: duration, energy estimate,
+// memory and what logging cost along the way
+void finishSync(EnergyOp outcome)
+{
+  LOG_STAT("Sync finished in %lu ms", millis() - syncStartedAt);
+  energyEnd(bootSyncInProgress ? ENERGY_OP_BOOT_SYNC : outcome);
+  energyPrintReport();
+  bleLinkPrintReport();
+  backgroundScanReport();
+  memPrintReport("after sync");
+  logPrintStats();
+}
+
+// Barcode module fits for the permits on screen and pre-rendered, so the
+// solver runs once per permit instead of on every redraw. Two slots because
+// the current and next permit are drawn alternately.
+struct BarcodeFitSlot
 {
-  display->clearMemory();
-  display->setFont((GFXfont *)&FreeSansBold8pt7b);
-  display->setTextSize(1);
+  char value[sizeof(PermitData::barcodeValue)];
+  Code39Fit fit;
+};
+BarcodeFitSlot barcodeFitCache[2] = {};
+int barcodeFitNext = 0;  // Slot to overwrite on a miss
+
+const Code39Fit &barcodeFitFor(const char *value)
+{
+  for (BarcodeFitSlot &slot : barcodeFitCache)
+  {
+    if (slot.fit.narrow && strcmp(slot.value, value) == 0)
+    {
+      return slot.fit;
+    }
+  }
+
+  BarcodeFitSlot &slot = barcodeFitCache[barcodeFitNext];
+  barcodeFitNext = (barcodeFitNext + 1) % 2;
+  strncpy(slot.value, value, sizeof(slot.value) - 1);
+  slot.value[sizeof(slot.value) - 1] = '\0';
+  Code39Generator<> solver(nullptr);
+  slot.fit = solver.fit(value, BARCODE_AREA_W, BARCODE_QUIET_MODULES);
+  if (slot.fit.fits)
+  {
+    LOG_I("Barcode %s: %d/%d px modules, %d px wide, %d px quiet zones",
+          value, slot.fit.narrow, slot.fit.wide, slot.fit.width, slot.fit.quiet);
+  }
+  else
+  {
+    LOG_W("Barcode %s does not fit %d px with quiet zones (%d px wide, %d px margins)",
+          value, BARCODE_AREA_W, slot.fit.width, slot.fit.quiet);
+  }
+  return slot.fit;
+}
 
+// Draw the permit layout onto any GFX-style target (the panel or an offscreen canvas)
+// ink/paper are the target's colors for black and white
+template <class Gfx>
+void drawPermitLayout(Gfx *gfx, const char *permitNumber, const char *plateNumber,
+                      const char *validFrom, const char *validTo,
+                      const char *barcodeValue, const char *barcodeLabel,
+                      uint16_t ink, uint16_t paper)
+{
   const int PLATE_X = PERMIT_X;
   const int PLATE_Y = PERMIT_Y + PLATE_Y_OFFSET;
   const int VALID_FROM_X = PERMIT_X;
@@ -43,70 +160,142 @@ void displayPermit(const char *permitNumber, const char *plateNumber,
   sprintf(permit_no, "Permit #: %s", permitNumber);
   sprintf(plate_no, "Plate #: %s", plateNumber);
 
-  display->setCursor(PERMIT_X, PERMIT_Y);
-  display->print(permit_no);
-
-  display->setCursor(PLATE_X, PLATE_Y);
-  display->print(plate_no);
+  rleDrawText(gfx, &FreeSansBold8pt7bRle, PERMIT_X, PERMIT_Y, permit_no, ink);
+  rleDrawText(gfx, &FreeSansBold8pt7bRle, PLATE_X, PLATE_Y, plate_no, ink);
 
   int lineY = PLATE_Y + HORIZONTAL_LINE_Y_OFFSET;
-  display->drawLine(PERMIT_X, lineY, SCREEN_W - 5, lineY, 0x0000);
-
-  display->setCursor(VALID_FROM_X, VALID_FROM_Y);
-  display->print(validFrom);
+  gfx->drawLine(PERMIT_X, lineY, SCREEN_W - 5, lineY, ink);
 
-  display->setCursor(VALID_TO_X, VALID_TO_Y);
-  display->print(validTo);
+  rleDrawText(gfx, &FreeSansBold8pt7bRle, VALID_FROM_X, VALID_FROM_Y, validFrom, ink);
+  rleDrawText(gfx, &FreeSansBold8pt7bRle, VALID_TO_X, VALID_TO_Y, validTo, ink);
 
-  Code39Generator barcodeGen(display);
-  barcodeGen.drawBarcode(barcodeValue, BARCODE_X, BARCODE_Y, BARCODE_HEIGHT, NARROW_BAR_WIDTH);
+  const Code39Fit &fit = barcodeFitFor(barcodeValue);
+  // Centered in the area; a value too long for it starts at the left edge
+  int barcodeX = BARCODE_X + max(0, (BARCODE_AREA_W - fit.width) / 2);
+  Code39Generator<Gfx> barcodeGen(gfx, ink);
+  barcodeGen.drawBarcode(barcodeValue, barcodeX, BARCODE_Y, BARCODE_HEIGHT, fit.narrow, fit.wide);
 
-  int barcodePixelWidth = barcodeGen.getBarcodeWidth(barcodeValue, NARROW_BAR_WIDTH);
+  int barcodePixelWidth = fit.width;
   int16_t x3, y3;
   uint16_t w, h;
-  display->setFont(&FreeSansBold13pt7b);
-  display->getTextBounds(barcodeLabel, 0, 0, &x3, &y3, &w, &h);
-  int labelX = BARCODE_X + (barcodePixelWidth / 2) - (w / 2);
-  display->setCursor(labelX, BARCODE_Y + BARCODE_HEIGHT + BARCODE_LABEL_Y_OFFSET);
-  display->print(barcodeLabel);
+  rleTextBounds(&FreeSansBold13pt7bRle, barcodeLabel, 0, 0, &x3, &y3, &w, &h);
+  int labelX = barcodeX + (barcodePixelWidth / 2) - (w / 2);
+  rleDrawText(gfx, &FreeSansBold13pt7bRle, labelX, BARCODE_Y + BARCODE_HEIGHT + BARCODE_LABEL_Y_OFFSET,
+              barcodeLabel, ink);
 
-  int logoX = BARCODE_X + (barcodePixelWidth / 2) - (LOGO_WIDTH / 2);
+  int logoX = barcodeX + (barcodePixelWidth / 2) - (LOGO_WIDTH / 2);
   int logoY = BARCODE_Y + BARCODE_HEIGHT + LOGO_Y_OFFSET;
 
-  display->fillRect(logoX, logoY, LOGO_WIDTH, LOGO_HEIGHT, 0x0000);
-  display->drawBitmap(logoX, logoY, logo_toronto, LOGO_WIDTH, LOGO_HEIGHT, 0xFFFF);
+  gfx->fillRect(logoX, logoY, LOGO_WIDTH, LOGO_HEIGHT, ink);
+  gfx->drawBitmap(logoX, logoY, logo_toronto, LOGO_WIDTH, LOGO_HEIGHT, paper);
 
   const char *permitText1 = "Temporary parking";
   const char *permitText2 = "permit";
   int permitTextX = logoX + LOGO_WIDTH + TEMP_PARKING_X_OFFSET;
   int permitTextY1 = logoY + TEMP_PARKING_Y1_OFFSET;
   int permitTextY2 = permitTextY1 + TEMP_PARKING_Y2_OFFSET;
-  display->setFont(&FreeSansBold8pt7b);
-  display->setTextSize(1);
-  display->setCursor(permitTextX, permitTextY1);
-  display->print(permitText1);
-  display->setCursor(permitTextX, permitTextY2);
-  display->print(permitText2);
-
-  display->update();
+  rleDrawText(gfx, &FreeSansBold8pt7bRle, permitTextX, permitTextY1, permitText1, ink);
+  rleDrawText(gfx, &FreeSansBold8pt7bRle, permitTextX, permitTextY2, permitText2, ink);
 }
 
-void displayMessage(const char *message, int textSize = 1)
+void displayPermit(const char *permitNumber, const char *plateNumber,
+                   const char *validFrom, const char *validTo,
+                   const char *barcodeValue, const char *barcodeLabel)
 {
-  display->clearMemory();
-  display->setFont(&FreeSansBold8pt7b);
-  display->setTextSize(textSize);
+  panelWaitIdle();
+  ProfiledGfx<EInkDisplay_VisionMasterE290> gfx(display);
+  gfx.clearMemory();
+  drawPermitLayout(&gfx, permitNumber, plateNumber, validFrom, validTo,
+                   barcodeValue, barcodeLabel, 0x0000, 0xFFFF);
+  RenderSample render = gfx.finish();
+  renderProfileRecord(RENDER_PERMIT, render, refreshDisplay());
+  permitOnScreen = true;
+  statusShown = false;
+  statusPartialCount = 0;
+}
+
+void displayMessage(const char *message)
+{
+  panelWaitIdle();
+  ProfiledGfx<EInkDisplay_VisionMasterE290> gfx(display);
+  gfx.clearMemory();
 
   int16_t x1, y1;
   uint16_t w, h;
-  display->getTextBounds((char *)message, 0, 0, &x1, &y1, &w, &h);
+  rleTextBounds(&FreeSansBold8pt7bRle, message, 0, 0, &x1, &y1, &w, &h);
 
   int x = (SCREEN_W - w) / 2;
   int y = (SCREEN_H + h) / 2;
 
-  display->setCursor(x, y);
-  display->print(message);
-  display->update();
+  rleDrawText(&gfx, &FreeSansBold8pt7bRle, x, y, message, 0x0000);
+  RenderSample render = gfx.finish();
+  renderProfileRecord(RENDER_MESSAGE, render, refreshDisplay());
+  permitOnScreen = false;
+  statusShown = false;
+}
+
+void redisplayCurrentPermit()
+{
+  displayPermit(currentPermit.permitNumber, currentPermit.plateNumber,
+                currentPermit.validFrom, currentPermit.validTo,
+                currentPermit.barcodeValue, currentPermit.barcodeLabel);
+}
+
+// Draw text (or nothing) into the status band and push only that region with a fast partial refresh
+void refreshStatusBand(const char *text)
+{
+  panelWaitIdle();
+  display->setWindow(STATUS_BAND_X, STATUS_BAND_Y, STATUS_BAND_W, STATUS_BAND_H);
+  display->fastmodeOn();
+  ProfiledGfx<EInkDisplay_VisionMasterE290> gfx(display);
+  gfx.fillRect(STATUS_BAND_X, STATUS_BAND_Y, STATUS_BAND_W, STATUS_BAND_H, 0xFFFF);
+  if (text)
+  {
+    rleDrawText(&gfx, &FreeSansBold8pt7bRle, STATUS_BAND_X, STATUS_BAND_Y + STATUS_BAND_H - 2, text, 0x0000);
+  }
+  RenderSample render = gfx.finish();
+  // Window and fast mode are panel state the worker is still using
+  PanelTicket ticket = refreshDisplay();
+  panelUpdateWait(ticket);
+  renderProfileRecord(RENDER_STATUS, render, ticket);
+  display->fastmodeOff();
+  display->fullscreen();
+  statusPartialCount++;
+}
+
+// Show a short status message over the permit without redrawing it.
+// holdMs > 0 clears it automatically from loop() after that long.
+// Falls back to a full-screen message when no permit is on screen.
+void showStatus(const char *text, unsigned long holdMs = 0)
+{
+  LOG_I("Status: %s", text);
+  if (!permitOnScreen)
+  {
+    displayMessage(text);
+    return;
+  }
+  refreshStatusBand(text);
+  statusShown = true;
+  statusClearAt = holdMs ? max(1UL, millis() + holdMs) : 0;
+}
+
+// Remove the status message. Uses a partial refresh unless enough partials
+// have piled up that a full redraw is due to clear ghosting.
+void clearStatus()
+{
+  statusClearAt = 0;
+  if (!statusShown || !permitOnScreen)
+  {
+    return;
+  }
+  if (statusPartialCount >= STATUS_MAX_PARTIALS)
+  {
+    LOG_I("Status: full refresh to clear ghosting");
+    redisplayCurrentPermit();
+    return;
+  }
+  refreshStatusBand(nullptr);
+  statusShown = false;
 }
 
 bool displayInit()
@@ -116,7 +305,7 @@ bool displayInit()
     display = new EInkDisplay_VisionMasterE290();
     if (!display)
     {
-      Serial.println("Library constructor failed, trying explicit fallback...");
+      LOG_W("Library constructor failed, trying explicit fallback...");
       display = new DEPG0290BNS800(4, 3, 6);
       return false;
     }
@@ -129,6 +318,7 @@ bool displayInit()
 // Apply display rotation based on setting
 void applyDisplayRotation(bool flipped)
 {
+  panelWaitIdle();
   if (flipped) {
     display->setRotation(3);  // 180° from normal landscape
   } else {
@@ -136,116 +326,149 @@ void applyDisplayRotation(bool flipped)
   }
 }
 
-// Save permit data to flash
-void savePermitData(PermitData *data)
+// Draw a framebuffer pushed over USB (see usb_provision.h). It stays on the
+// panel until the next permit redraw.
+void displayProvisionedFrame()
 {
-  preferences.begin("permit", false);
-  preferences.putString("permitNum", data->permitNumber);
-  preferences.putString("plateNum", data->plateNumber);
-  preferences.putString("validFrom", data->validFrom);
-  preferences.putString("validTo", data->validTo);
-  preferences.putString("barcode", data->barcodeValue);
-  preferences.putString("barLabel", data->barcodeLabel);
-  preferences.putBool("flipped", data->displayFlipped);
-  preferences.end();
-  Serial.println("Permit data saved to flash");
+  panelWaitIdle();
+  ProfiledGfx<EInkDisplay_VisionMasterE290> gfx(display);
+  gfx.clearMemory();
+  gfx.drawBitmap(0, 0, provisionFrameBuffer(), SCREEN_W, SCREEN_H, 0x0000);
+  provisionFrameRelease();
+  RenderSample render = gfx.finish();
+  renderProfileRecord(RENDER_FRAME, render, refreshDisplay());
+  permitOnScreen = false;
+  statusShown = false;
 }
 
-// Load permit data from flash
-bool loadPermitData(PermitData *data)
+// Pre-render the next queued permit offscreen so the switch-over is one blit + one refresh
+void prerenderNextPermit()
 {
-  preferences.begin("permit", true);
-  String permitNum = preferences.getString("permitNum", "");
-  if (permitNum.length() == 0)
+  if (permitQueue.count == 0)
+  {
+    nextFramePermit[0] = '\0';
+    return;
+  }
+  if (nextFrame && strcmp(nextFramePermit, permitQueue.entries[0].permitNumber) == 0)
   {
-    preferences.end();
-    return false;
+    return;  // Already rendered
   }
+  nextFramePermit[0] = '\0';
 
-  strncpy(data->permitNumber, permitNum.c_str(), sizeof(data->permitNumber) - 1);
-  strncpy(data->plateNumber, preferences.getString("plateNum", "").c_str(), sizeof(data->plateNumber) - 1);
-  strncpy(data->validFrom, preferences.getString("validFrom", "").c_str(), sizeof(data->validFrom) - 1);
-  strncpy(data->validTo, preferences.getString("validTo", "").c_str(), sizeof(data->validTo) - 1);
-  strncpy(data->barcodeValue, preferences.getString("barcode", "").c_str(), sizeof(data->barcodeValue) - 1);
-  strncpy(data->barcodeLabel, preferences.getString("barLabel", "").c_str(), sizeof(data->barcodeLabel) - 1);
-  data->displayFlipped = preferences.getBool("flipped", false);
-  preferences.end();
+  if (!nextFrame)
+  {
+    nextFrame = new GFXcanvas1(SCREEN_W, SCREEN_H);
+    if (!nextFrame->getBuffer())
+    {
+      LOG_E("Not enough memory for pre-render buffer");
+      delete nextFrame;
+      nextFrame = nullptr;
+      return;
+    }
+  }
 
-  Serial.print("Loaded permit from flash: ");
-  Serial.println(data->permitNumber);
-  return true;
+  const PermitData *next = &permitQueue.entries[0];
+  ProfiledGfx<GFXcanvas1> gfx(nextFrame);
+  gfx.fillScreen(0);
+  drawPermitLayout(&gfx, next->permitNumber, next->plateNumber,
+                   next->validFrom, next->validTo,
+                   next->barcodeValue, next->barcodeLabel, 1, 0);
+  RenderSample render = gfx.finish();
+  strncpy(nextFramePermit, next->permitNumber, sizeof(nextFramePermit) - 1);
+  LOG_STAT("Pre-rendered next permit %s (starts %s) in %lu us",
+           next->permitNumber, next->validFrom, (unsigned long)render.rasterUs);
+  renderProfileRecord(RENDER_PRERENDER, render);
 }
 
-// Sync permit via Bluetooth
-// silent = true means don't update display unless permit changed (for boot sync)
-void syncViaBluetooth(bool forceUpdate = false, bool silent = false)
+// Switch to the head of the queue once its validFrom time has passed
+void checkPermitQueue()
 {
-  Serial.println("\n=== Bluetooth Sync ===");
+  static unsigned long lastCheck = 0;
+  if (permitQueue.count == 0 || millis() - lastCheck < QUEUE_CHECK_INTERVAL_MS)
+  {
+    return;
+  }
+  lastCheck = millis();
+
+  int started = permitClockValid() ? permitQueueStarted(&permitQueue, time(nullptr)) : 0;
+  if (started == 0)
+  {
+    return;
+  }
+
+  // After a long power-off several may have started: go straight to the
+  // latest, with one refresh and one write
+  currentPermit = permitQueue.entries[started - 1];
+  LOG_I("Queued permit %s is now valid - switching (%d started)", currentPermit.permitNumber, started);
+  bool prerendered = nextFrame && strcmp(nextFramePermit, currentPermit.permitNumber) == 0;
+  permitQueuePop(&permitQueue, started);
+  savePermitData(&currentPermit);
+  savePermitQueue(&permitQueue);
+
+  applyDisplayRotation(currentPermit.displayFlipped);
+  if (prerendered)
+  {
+    ProfiledGfx<EInkDisplay_VisionMasterE290> gfx(display);
+    gfx.clearMemory();
+    gfx.drawBitmap(0, 0, nextFrame->getBuffer(), SCREEN_W, SCREEN_H, 0x0000);
+    RenderSample render = gfx.finish();
+    renderProfileRecord(RENDER_FRAME, render, refreshDisplay());
+    permitOnScreen = true;
+    statusShown = false;
+    statusPartialCount = 0;
+  }
+  else
+  {
+    displayPermit(currentPermit.permitNumber, currentPermit.plateNumber,
+                  currentPermit.validFrom, currentPermit.validTo,
+                  currentPermit.barcodeValue, currentPermit.barcodeLabel);
+  }
+
+  prerenderNextPermit();
+}
+
+// Sync the permit from every source in syncPlan
+// silent = true means don't update display unless permit changed (boot and background syncs)
+// Returns the outcome it was accounted as (updated, unchanged or failed)
+EnergyOp syncPermit(bool forceUpdate = false, bool silent = false)
+{
+  LOG_I("\n=== Permit Sync ===");
+  syncStartedAt = millis();
+  energyBegin();
 
   // Determine sync type for phone notification
   uint8_t syncType;
   if (forceUpdate)
   {
     syncType = SYNC_TYPE_FORCE;
-    Serial.println("FORCE UPDATE - Will update display regardless of permit number");
-    displayMessage("Force syncing...", 1);
+    LOG_I("FORCE UPDATE - Will update display regardless of permit number");
+    showStatus("Force syncing...");
   }
   else if (silent)
   {
     syncType = SYNC_TYPE_AUTO;
-    Serial.println("Silent sync mode (auto)");
+    LOG_I("Silent sync mode (auto)");
   }
   else
   {
     syncType = SYNC_TYPE_MANUAL;
-    Serial.println("Normal sync (manual)");
-    displayMessage("Syncing...", 1);
+    LOG_I("Normal sync (manual)");
+    showStatus("Syncing...");
   }
 
-  if (!scanForPhone())
-  {
-    if (!silent)
-    {
-      displayMessage("Phone not found", 1);
-      delay(2000);
-      // Redisplay current permit if we have one
-      if (strlen(currentPermit.permitNumber) > 0)
-      {
-        displayPermit(currentPermit.permitNumber, currentPermit.plateNumber,
-                      currentPermit.validFrom, currentPermit.validTo,
-                      currentPermit.barcodeValue, currentPermit.barcodeLabel);
-      }
-    }
-    else
-    {
-      Serial.println("Phone not found - keeping current display");
-    }
-    cleanupBluetooth();
-    return;
-  }
-
-  PermitData newPermit;
-  int result = 0;
-
-  // Retry logic for connection failures
-  for (int attempt = 1; attempt <= BLE_MAX_RETRIES; attempt++)
-  {
-    result = downloadPermitViaBluetooth(&newPermit, currentPermit.permitNumber, syncType);
-    if (result != 0)
-    {
-      break; // Success or already up to date
-    }
-    if (attempt < BLE_MAX_RETRIES)
-    {
-      Serial.printf("Retry %d/%d...\n", attempt, BLE_MAX_RETRIES);
-      delay(500);
-    }
-  }
+  // Sources race (or take turns) until one has a permit; see sync_coordinator.h
+  PermitRequest request = {&currentPermit, syncType};
+  static SyncOutcome outcome;
+  int result = syncCoordinatorRun(syncPlan, request, &outcome);
+  const PermitData &newPermit = outcome.fetch.data;
+  EnergyOp syncOutcome = ENERGY_OP_SYNC_FAILED;
+  permitStoreAuthCounter = permitAuth.lastCounter;  // Saved below once the payload is applied
+  uint32_t writesBefore = permitStoreStats.writes;
 
   if (result == 1 || (result == 2 && forceUpdate))
   {
     // New permit received or force update
-    Serial.println("Permit received!");
+    LOG_I("Permit received!");
 
     currentPermit = newPermit;
     savePermitData(&currentPermit);
@@ -257,59 +480,90 @@ void syncViaBluetooth(bool forceUpdate = false, bool silent = false)
                   currentPermit.validFrom, currentPermit.validTo,
                   currentPermit.barcodeValue, currentPermit.barcodeLabel);
 
-    Serial.println("Display updated!");
+    LOG_I("Display updated!");
+    syncOutcome = ENERGY_OP_SYNC_UPDATED;
   }
   else if (result == 2)
   {
     // Permit unchanged - but check if settings changed
-    Serial.println("Permit unchanged - checking settings...");
-    Serial.printf("  Current flip: %d, New flip: %d\n", currentPermit.displayFlipped, newPermit.displayFlipped);
+    LOG_I("Permit unchanged - checking settings...");
+    LOG_D("  Current flip: %d, New flip: %d", currentPermit.displayFlipped, newPermit.displayFlipped);
 
     // Check if flip setting changed
     if (newPermit.displayFlipped != currentPermit.displayFlipped)
     {
-      Serial.println("Flip setting changed - updating display");
+      LOG_I("Flip setting changed - updating display");
       currentPermit.displayFlipped = newPermit.displayFlipped;
       savePermitData(&currentPermit);
       applyDisplayRotation(currentPermit.displayFlipped);
       displayPermit(currentPermit.permitNumber, currentPermit.plateNumber,
                     currentPermit.validFrom, currentPermit.validTo,
                     currentPermit.barcodeValue, currentPermit.barcodeLabel);
-      Serial.println("Display flipped!");
+      LOG_I("Display flipped!");
     }
     else if (!silent && strlen(currentPermit.permitNumber) > 0)
     {
-      Serial.println("No setting changes, restoring display");
-      // Restore permit display if we showed "Syncing..."
-      displayPermit(currentPermit.permitNumber, currentPermit.plateNumber,
-                    currentPermit.validFrom, currentPermit.validTo,
-                    currentPermit.barcodeValue, currentPermit.barcodeLabel);
+      LOG_I("No setting changes, clearing status");
+      // Remove "Syncing..." from the status band
+      if (permitOnScreen)
+      {
+        clearStatus();
+      }
+      else
+      {
+        redisplayCurrentPermit();
+      }
     }
-    delay(100);  // Let BLE fully cleanup before continuing
+    syncOutcome = outcome.fetch.skipped ? ENERGY_OP_SYNC_SKIPPED : ENERGY_OP_SYNC_UNCHANGED;
   }
   else
   {
     // Error
-    Serial.println("Sync failed");
+    LOG_W("Sync failed");
     if (!silent)
     {
-      displayMessage("Sync failed", 1);
-      delay(2000);
-
-      if (strlen(currentPermit.permitNumber) > 0)
-      {
-        displayPermit(currentPermit.permitNumber, currentPermit.plateNumber,
-                      currentPermit.validFrom, currentPermit.validTo,
-                      currentPermit.barcodeValue, currentPermit.barcodeLabel);
-      }
+      // Held in the status band, cleared from loop()
+      const char *text = outcome.failure == SYNC_FAIL_AUTH           ? "Permit not signed"
+                         : outcome.failure == SYNC_FAIL_OUT_OF_RANGE ? "Phone not found"
+                                                                     : "Sync failed";
+      showStatus(text, STATUS_HOLD_MS);
     }
     else
     {
-      Serial.println("Keeping current display");
+      LOG_I("Keeping current display");
     }
   }
 
+  if (result != 0 && outcome.fetch.hasQueue)
+  {
+    // Phone's list of upcoming permits replaces ours
+    permitQueue = outcome.fetch.queue;
+    savePermitQueue(&permitQueue);
+    prerenderNextPermit();
+  }
+  if (result != 0)
+  {
+    // The payload was applied even if the permit was not new (queue, clock,
+    // tag). Its counter is written now if the permit or queue changed, else
+    // every few syncs (see savePermitAuthCounter()).
+    savePermitAuthCounter(permitStoreStats.writes != writesBefore);
+    savePermitAdvertTag();
+  }
+
   cleanupBluetooth();
+  finishSync(syncOutcome);
+  return syncOutcome;
+}
+
+// Helper to perform sync (stops server and background scan, syncs, restarts them)
+EnergyOp doSync(bool forceUpdate, bool silent = false)
+{
+  backgroundScanStop();
+  stopBleServer();
+  EnergyOp outcome = syncPermit(forceUpdate, silent);
+  startBleServer();
+  backgroundScanStart();
+  return outcome;
 }
 
 void setup()
@@ -318,7 +572,10 @@ void setup()
   pinMode(LED_PIN, OUTPUT);
   digitalWrite(LED_PIN, LOW); // LED on immediately
 
+  Serial.setRxBufferSize(PROVISION_RX_BUFFER);  // Room for a whole provisioning frame
   Serial.begin(115200);
+  logBegin();
+  otaBootCheck();
 
   // Longer delay for USB CDC
   for (int i = 0; i < 30; i++) {
@@ -328,69 +585,179 @@ void setup()
   Serial.println();
 
   pinMode(BUTTON_PIN, INPUT_PULLUP);
+  bool pairingRequested = digitalRead(BUTTON_PIN) == LOW;  // Button held at power-on
 
-  Serial.println("\n=== Parking Permit Display (BLE) ===");
-  Serial.println("Initializing display...");
-  Serial.flush();
+  LOG_I("\n=== Parking Permit Display (BLE) ===");
+  LOG_I("Initializing display...");
+  logFlush();
 
   if (!displayInit())
   {
-    Serial.println("Display initialization failed!");
+    LOG_E("Display initialization failed!");
+    logFlush();
+    while (1)
+      ;
+  }
+  LOG_I("Display ready.");
+  panelAsyncBegin(display);
+
+  pairingBegin();
+
+#ifdef PHONE_SIM
+  phoneSimInstall();
+  phoneSimBenchmark(PHONE_SIM_RUNS);
+  if (!phoneSimSoak(PHONE_SIM_SOAK_CYCLES, doSync))
+  {
+    LOG_E("Soak test FAILED - heap lost across syncs");
+    displayMessage("Soak test FAILED\nSee serial log");
+    logFlush();
     while (1)
       ;
   }
-  Serial.println("Display ready.");
+  backgroundScanStop();  // Started again after the boot sync
+  stopBleServer();
+  phoneSimAuthBenchmark(PHONE_SIM_AUTH_RUNS);
+  phoneSimCorpusBenchmark(PHONE_SIM_CORPUS_RUNS);
+  phoneSimSyncBenchmark(PHONE_SIM_SYNC_RUNS);
+  barcodeVerifyBenchmark(BARCODE_VERIFY_RUNS);
+  fontBenchmark(display, FONT_BENCH_RUNS);
+  otaSelfTest(OTA_SELFTEST_RUNS);
+#endif
 
   // Load saved permit data
   bool hasSavedData = loadPermitData(&currentPermit);
+  permitAuth.lastCounter = permitStoreAuthCounter;
+  loadPermitQueue(&permitQueue);
+  prerenderNextPermit();
+  provisionBegin(&currentPermit, &permitQueue);
+#ifdef SYNC_PATH_BENCH
+  syncPathBenchmark(&currentPermit, SYNC_PATH_BENCH_RUNS);
+#endif
+#ifdef WIFI_BENCH
+  wifiBenchmark();
+#endif
 
   if (!hasSavedData)
   {
-    displayMessage("No permit data\nPress button to sync", 1);
-    Serial.println("No saved permit. Press button to sync via Bluetooth.");
+    displayMessage("No permit data\nPress button to sync");
+    LOG_I("No saved permit. Press button to sync.");
     strcpy(currentPermit.permitNumber, "");
   }
   else
   {
-    Serial.println("Permit loaded from flash.");
+    LOG_I("Permit loaded from flash.");
     // Apply saved rotation setting
     applyDisplayRotation(currentPermit.displayFlipped);
     // E-ink retains image, no need to redraw unless data changed
+    permitOnScreen = true;
   }
 
-  Serial.println("\nReady!");
-  Serial.println("Short press (BOOT): Sync via Bluetooth");
-  Serial.println("Long press (3s): Force update");
+  LOG_I("\nReady!");
+  LOG_I("Short press (BOOT): Sync");
+  LOG_I("Long press (3s): Force update");
+  LOG_I("Hold at power-on: Pair with the phone");
 
   // Auto-sync on boot (silent if we already have a permit displayed)
-  Serial.println("\nAuto-syncing on boot...");
+  LOG_I("\nAuto-syncing on boot...");
   bool silentSync = (strlen(currentPermit.permitNumber) > 0);
-  syncViaBluetooth(false, silentSync);
+  bootSyncInProgress = true;
+  syncPermit(false, silentSync);
+  bootSyncInProgress = false;
 
   // Start BLE server to listen for commands from phone
   startBleServer();
-}
+  backgroundScanStart();
 
-// Helper to perform sync (stops server, syncs, restarts server)
-void doSync(bool forceUpdate)
-{
-  stopBleServer();
-  syncViaBluetooth(forceUpdate);
-  startBleServer();
+  if (pairingRequested)
+  {
+    pairingOpenWindow();
+    showStatus("Pairing...", PAIRING_WINDOW_MS);
+  }
+
+  // Display, flash and BLE all came up: keep this firmware
+  otaMarkHealthy();
 }
 
 void loop()
 {
+#ifdef PHONE_SIM
+  phoneSimTick();
+#endif
+
+  renderProfileTick();
+
+  // Local switch-over to a queued permit (no BLE needed)
+  checkPermitQueue();
+
+  // Clear a held status message once its time is up
+  if (statusClearAt && (long)(millis() - statusClearAt) >= 0)
+  {
+    clearStatus();
+  }
+
+  // Leave the BLE link alone while a firmware update is coming in.
+  // A successful update restarts the device, so leaving this state means it failed.
+  static bool otaShown = false;
+  if (otaActive())
+  {
+    if (!otaShown)
+    {
+      backgroundScanStop();
+      showStatus("Updating firmware...");
+      otaShown = true;
+    }
+    delay(10);
+    return;
+  }
+  if (otaShown)
+  {
+    otaShown = false;
+    showStatus("Update failed", STATUS_HOLD_MS);
+    backgroundScanStart();
+  }
+
+  // New payload key from the phone: restart the replay counter with it
+  if (pairingTick())
+  {
+    permitStoreAuthCounter = 0;
+    savePermitAuthCounter();
+    showStatus("Paired", STATUS_HOLD_MS);
+  }
+
+  // Bench provisioning over USB; writes are already saved when this returns
+  uint8_t provisioned = provisionPoll();
+  if (provisioned & PROVISION_FRAME)
+  {
+    displayProvisionedFrame();
+  }
+  else if ((provisioned & (PROVISION_PERMIT | PROVISION_SETTINGS)) && strlen(currentPermit.permitNumber) > 0)
+  {
+    applyDisplayRotation(currentPermit.displayFlipped);
+    redisplayCurrentPermit();
+  }
+  if (provisioned & (PROVISION_PERMIT | PROVISION_QUEUE | PROVISION_SETTINGS))
+  {
+    prerenderNextPermit();
+  }
+
+  // Phone seen close by between syncs: pick up a changed permit quietly
+  int rssi;
+  if (backgroundScanTick(&rssi))
+  {
+    LOG_I("Phone nearby (%d dBm) - background sync", rssi);
+    backgroundScanSyncDone(doSync(false, true));
+  }
+
   // Check for commands from phone
   int cmd = getPendingCommand();
   if (cmd == 1)
   {
-    Serial.println("Sync command received from phone");
+    LOG_I("Sync command received from phone");
     doSync(false);
   }
   else if (cmd == 2)
   {
-    Serial.println("Force sync command received from phone");
+    LOG_I("Force sync command received from phone");
     doSync(true);
   }
 
@@ -408,7 +775,7 @@ void loop()
       {
         if (!longPressTriggered && (millis() - pressStart) >= 3000)
         {
-          Serial.println("Long press detected - Force update!");
+          LOG_I("Long press detected - Force update!");
           longPressTriggered = true;
           doSync(true); // Force update
           break;
@@ -425,11 +792,11 @@ void loop()
       // Short press - normal sync
       if (!longPressTriggered)
       {
-        Serial.println("Short press detected - Normal sync");
+        LOG_I("Short press detected - Normal sync");
         doSync(false);
       }
     }
   }
 
-  delay(10);
+  delay(provisionActive() ? 1 : 10);
 }
@@ -0,0 +1,61 @@
+#ifndef MEM_TELEMETRY_H
+#define MEM_TELEMETRY_H
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "log_helper.h"
+
+// Heap and stack telemetry. Sync and server paths are meant to reach a
+// steady state with no net allocations, so free heap and the largest free
+// block should stay flat across cycles once everything is warmed up.
+
+// Tasks whose stack high-water marks are reported (missing ones are skipped)
+static const char *MEM_TASK_NAMES[] = {
+    "loopTask", "panel", "BTC_TASK", "BTU_TASK", "btController", "hciT"};
+#define MEM_TASK_COUNT (sizeof(MEM_TASK_NAMES) / sizeof(MEM_TASK_NAMES[0]))
+
+struct MemSample
+{
+    uint32_t freeHeap;
+    uint32_t largestBlock;
+    uint32_t minFreeHeap;                   // Low-water mark since boot
+    uint32_t stackFree[MEM_TASK_COUNT];     // Bytes never used; 0 if task absent
+};
+
+static void memSample(MemSample *s)
+{
+    s->freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    s->largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    s->minFreeHeap = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    for (size_t i = 0; i < MEM_TASK_COUNT; i++)
+    {
+        TaskHandle_t task = xTaskGetHandle(MEM_TASK_NAMES[i]);
+        // High-water mark is in bytes on ESP-IDF (StackType_t is uint8_t)
+        s->stackFree[i] = task ? uxTaskGetStackHighWaterMark(task) : 0;
+    }
+}
+
+void memPrintReport(const char *label)
+{
+    MemSample s;
+    memSample(&s);
+
+    LOG_STAT("=== Memory (%s) ===", label);
+    LOG_STAT("  Heap: %lu free, %lu largest block, %lu min free",
+             (unsigned long)s.freeHeap, (unsigned long)s.largestBlock,
+             (unsigned long)s.minFreeHeap);
+    char line[LOG_LINE_MAX];
+    int len = 0;
+    for (size_t i = 0; i < MEM_TASK_COUNT && len < (int)sizeof(line); i++)
+    {
+        if (s.stackFree[i])
+        {
+            len += snprintf(line + len, sizeof(line) - len, " %s %lu;",
+                            MEM_TASK_NAMES[i], (unsigned long)s.stackFree[i]);
+        }
+    }
+    line[min(len, (int)sizeof(line) - 1)] = '\0';
+    LOG_STAT("  Stack headroom:%s", line);
+}
+
+#endif
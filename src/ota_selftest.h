@@ -0,0 +1,320 @@
+#ifndef OTA_SELFTEST_H
+#define OTA_SELFTEST_H
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "ota_stream.h"
+#include "ble_ota.h"
+#include "permit_auth.h"
+#include "log_helper.h"
+
+// Stand-in sender for the OTA path: builds zlib streams of a known image
+// the way tools/ota_send.py would, feeds them to OtaStream in MTU-sized
+// chunks of random length and checks the result code and every byte that
+// reaches the sink. Covers clean streams (stored blocks, and a real deflate
+// stream from zlib), wrong hash, announced size too small and too large,
+// truncated and corrupted streams and a refusing sink, then the BEGIN
+// signature and counter checks. Runs at boot in the phone simulator build.
+
+#ifndef OTA_SELFTEST_RUNS
+#define OTA_SELFTEST_RUNS 5                 // Passes over every case, each with new chunk sizes
+#endif
+#define OTA_SELFTEST_IMAGE_SIZE 40000       // Over one inflate window, so the window wraps
+#define OTA_SELFTEST_STORED_BLOCK 7000      // Stored blocks per stream: several, the last one short
+#define OTA_SELFTEST_CHUNK_MIN 20           // Default MTU payload
+#define OTA_SELFTEST_CHUNK_MAX 512
+
+// Test image: byte i is (i >> 6) & 0xFF
+static inline uint8_t otaSelfTestByte(uint32_t i)
+{
+    return (i >> 6) & 0xFF;
+}
+
+// zlib.compress(bytes((i >> 6) & 0xFF for i in range(40000)), 9)
+static const uint8_t OTA_SELFTEST_DEFLATE[] = {
+    0x78, 0xda, 0xed, 0xdb, 0xd7, 0xc2, 0x10, 0x02, 0x00, 0x06, 0xd0, 0x5f, 0xc8, 0xa8, 0xd0, 0x42,
+    0x69, 0x50, 0x84, 0x8a, 0x50, 0x49, 0x46, 0xca, 0x28, 0x33, 0x9b, 0x8a, 0xc8, 0x6a, 0xa7, 0x21,
+    0x92, 0x51, 0xa8, 0x94, 0x59, 0x49, 0x85, 0x92, 0x59, 0x69, 0x98, 0x4d, 0x64, 0x95, 0xd5, 0xd0,
+    0xde, 0x85, 0x36, 0xca, 0x8a, 0x86, 0xb2, 0x7a, 0x88, 0x73, 0xe3, 0xe2, 0x3b, 0xef, 0x71, 0x0a,
+    0x0a, 0xcc, 0x5e, 0xa8, 0x10, 0xda, 0x1b, 0xed, 0x83, 0xf6, 0x45, 0x85, 0xd1, 0x7e, 0x68, 0x7f,
+    0x74, 0x00, 0x3a, 0x10, 0x15, 0x41, 0x45, 0x51, 0x31, 0x74, 0x10, 0x3a, 0x18, 0x1d, 0x82, 0x8a,
+    0xa3, 0x12, 0xa8, 0x24, 0x2a, 0x85, 0x4a, 0xa3, 0x43, 0xd1, 0x61, 0xe8, 0x70, 0x54, 0x06, 0x95,
+    0x45, 0x47, 0xa0, 0x72, 0xa8, 0x3c, 0xaa, 0x80, 0x2a, 0xa2, 0x23, 0xd1, 0x51, 0xa8, 0x12, 0xaa,
+    0x8c, 0x8e, 0x46, 0xc7, 0xa0, 0x2a, 0xe8, 0x58, 0x74, 0x1c, 0x3a, 0x1e, 0x55, 0x45, 0xd5, 0x50,
+    0x75, 0x74, 0x02, 0x3a, 0x11, 0xd5, 0x40, 0x27, 0xa1, 0x93, 0xd1, 0x29, 0xa8, 0x26, 0xaa, 0x85,
+    0x6a, 0xa3, 0x53, 0x51, 0x1d, 0x74, 0x1a, 0xaa, 0x8b, 0x4e, 0x47, 0x67, 0xa0, 0x33, 0xd1, 0x59,
+    0xa8, 0x1e, 0x3a, 0x1b, 0xd5, 0x47, 0x0d, 0xd0, 0x39, 0xe8, 0x5c, 0x74, 0x1e, 0x3a, 0x1f, 0x35,
+    0x44, 0x8d, 0xd0, 0x05, 0xe8, 0x42, 0x74, 0x11, 0xba, 0x18, 0x5d, 0x82, 0x2e, 0x45, 0x8d, 0xd1,
+    0x65, 0xe8, 0x72, 0x74, 0x05, 0xba, 0x12, 0x5d, 0x85, 0xae, 0x46, 0xd7, 0xa0, 0x6b, 0xd1, 0x75,
+    0xa8, 0x09, 0x6a, 0x8a, 0x9a, 0xa1, 0xeb, 0xd1, 0x0d, 0xa8, 0x39, 0xba, 0x11, 0xdd, 0x84, 0x5a,
+    0xa0, 0x9b, 0xd1, 0x2d, 0xe8, 0x56, 0x74, 0x1b, 0xba, 0x1d, 0xb5, 0x44, 0xad, 0x50, 0x6b, 0xd4,
+    0x06, 0xb5, 0x45, 0xed, 0x50, 0x7b, 0xd4, 0x01, 0xdd, 0x81, 0x3a, 0xa2, 0x4e, 0xa8, 0x33, 0xea,
+    0x82, 0xee, 0x44, 0x5d, 0xd1, 0x5d, 0xe8, 0x6e, 0xd4, 0x0d, 0xdd, 0x83, 0xba, 0xa3, 0x7b, 0xd1,
+    0x7d, 0xe8, 0x7e, 0xf4, 0x00, 0xea, 0x81, 0x7a, 0xa2, 0x07, 0xd1, 0x43, 0xe8, 0x61, 0xd4, 0x0b,
+    0xf5, 0x46, 0x7d, 0xd0, 0x23, 0xa8, 0x2f, 0xea, 0x87, 0x1e, 0x45, 0x8f, 0xa1, 0xc7, 0xd1, 0x13,
+    0xe8, 0x49, 0xf4, 0x14, 0xea, 0x8f, 0x06, 0xa0, 0x81, 0xe8, 0x69, 0x34, 0x08, 0x3d, 0x83, 0x06,
+    0xa3, 0x21, 0x68, 0x28, 0x7a, 0x16, 0x3d, 0x87, 0x9e, 0x47, 0xc3, 0xd0, 0x70, 0xf4, 0x02, 0x1a,
+    0x81, 0x5e, 0x44, 0x2f, 0xa1, 0x97, 0xd1, 0x2b, 0xe8, 0x55, 0xf4, 0x1a, 0x1a, 0x89, 0x46, 0xa1,
+    0xd1, 0xe8, 0x75, 0x34, 0x06, 0x8d, 0x45, 0xe3, 0xd0, 0x78, 0xf4, 0x06, 0x7a, 0x13, 0xbd, 0x85,
+    0xde, 0x46, 0xef, 0xa0, 0x77, 0xd1, 0x04, 0x34, 0x11, 0x4d, 0x42, 0x93, 0xd1, 0x14, 0x34, 0x15,
+    0xbd, 0x87, 0xde, 0x47, 0x1f, 0xa0, 0x69, 0xe8, 0x43, 0xf4, 0x11, 0xfa, 0x18, 0x7d, 0x82, 0x3e,
+    0x45, 0xd3, 0xd1, 0x0c, 0xf4, 0x19, 0xfa, 0x1c, 0x7d, 0x81, 0xbe, 0x44, 0x5f, 0xa1, 0x99, 0x68,
+    0x16, 0x9a, 0x8d, 0xe6, 0xa0, 0xaf, 0xd1, 0x5c, 0x34, 0x0f, 0xcd, 0x47, 0x0b, 0xd0, 0x42, 0xb4,
+    0x08, 0x2d, 0x46, 0x4b, 0xd0, 0x52, 0xb4, 0x0c, 0x2d, 0x47, 0x2b, 0xd0, 0x4a, 0xb4, 0x0a, 0xad,
+    0x46, 0xdf, 0xa0, 0x6f, 0xd1, 0x77, 0x68, 0x0d, 0x5a, 0x8b, 0xd6, 0xa1, 0xf5, 0x68, 0x03, 0xda,
+    0x88, 0x36, 0xa1, 0xef, 0xd1, 0x0f, 0xe8, 0x47, 0xb4, 0x19, 0x6d, 0x41, 0x3f, 0xa1, 0x9f, 0xd1,
+    0x2f, 0xe8, 0x57, 0xf4, 0x1b, 0xda, 0x8a, 0x7e, 0x47, 0x7f, 0xa0, 0x6d, 0x68, 0x3b, 0xda, 0x81,
+    0x76, 0xa2, 0x3f, 0xd1, 0x2e, 0xb4, 0x1b, 0xfd, 0x85, 0xfe, 0x46, 0xff, 0xa0, 0x7f, 0xd1, 0x7f,
+    0xa8, 0x20, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f,
+    0xff, 0x3f, 0xff, 0x3f, 0xff, 0x3f, 0xff, 0xff, 0x7f, 0xf3, 0xff, 0xf7, 0x00, 0xe2, 0x92, 0xf2,
+    0x0c,
+};
+
+struct OtaSelfTestSink
+{
+    uint32_t pos;
+    uint32_t mismatches;
+    uint32_t refuseAt;  // Refuse the write that reaches this offset, 0 = never
+};
+
+static bool otaSelfTestSink(void *ctx, const uint8_t *data, size_t len)
+{
+    OtaSelfTestSink *s = (OtaSelfTestSink *)ctx;
+    if (s->refuseAt && s->pos + len >= s->refuseAt)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        s->mismatches += data[i] != otaSelfTestByte(s->pos + i) ? 1 : 0;
+    }
+    s->pos += len;
+    return true;
+}
+
+// Wrap the image in a zlib stream of stored blocks; returns its length
+static size_t otaSelfTestStoredStream(uint8_t *out)
+{
+    size_t n = 0;
+    out[n++] = 0x78;  // Deflate, 32 KB window
+    out[n++] = 0x01;  // No dictionary, fastest; header check bits make it a multiple of 31
+    uint32_t a = 1, b = 0;
+    for (uint32_t pos = 0; pos < OTA_SELFTEST_IMAGE_SIZE; pos += OTA_SELFTEST_STORED_BLOCK)
+    {
+        uint16_t blockLen = (uint16_t)min((uint32_t)OTA_SELFTEST_STORED_BLOCK, (uint32_t)OTA_SELFTEST_IMAGE_SIZE - pos);
+        out[n++] = pos + blockLen == OTA_SELFTEST_IMAGE_SIZE ? 1 : 0;  // BFINAL, BTYPE 00
+        out[n++] = blockLen & 0xFF;
+        out[n++] = blockLen >> 8;
+        out[n++] = ~blockLen & 0xFF;
+        out[n++] = (uint16_t)~blockLen >> 8;
+        for (uint32_t i = 0; i < blockLen; i++)
+        {
+            uint8_t v = otaSelfTestByte(pos + i);
+            out[n++] = v;
+            a = (a + v) % 65521;
+            b = (b + a) % 65521;
+        }
+    }
+    uint32_t adler = (b << 16) | a;
+    out[n++] = adler >> 24;  // Adler-32, big-endian
+    out[n++] = adler >> 16;
+    out[n++] = adler >> 8;
+    out[n++] = adler;
+    return n;
+}
+
+struct OtaSelfTestCase
+{
+    const char *name;
+    bool stored;              // Stored-block stream rather than the deflate fixture
+    int32_t sizeDelta;        // Added to the announced image size
+    bool badHash;
+    uint32_t truncate;        // Bytes dropped from the end of the stream
+    uint32_t corruptAt;       // Stream offset whose byte is flipped, 0 = none
+    uint32_t refuseAt;        // See OtaSelfTestSink
+    OtaStreamResult expect;
+};
+
+static const OtaSelfTestCase OTA_SELFTEST_CASES[] = {
+    {"stored", true, 0, false, 0, 0, 0, OTA_STREAM_DONE},
+    {"deflate", false, 0, false, 0, 0, 0, OTA_STREAM_DONE},
+    {"wrong hash", false, 0, true, 0, 0, 0, OTA_STREAM_ERR_HASH},
+    {"size too small", false, -1, false, 0, 0, 0, OTA_STREAM_ERR_SIZE},
+    {"size too large", true, 1, false, 0, 0, 0, OTA_STREAM_ERR_SIZE},
+    {"truncated", true, 0, false, 100, 0, 0, OTA_STREAM_ERR_DECODE},
+    {"truncated zlib", false, 0, false, 1, 0, 0, OTA_STREAM_ERR_DECODE},
+    {"corrupt data", true, 0, false, 0, 20000, 0, OTA_STREAM_ERR_DECODE},  // Adler-32 catches it
+    {"corrupt block", true, 0, false, 0, 3, 0, OTA_STREAM_ERR_DECODE},     // Stored length check
+    {"sink refuses", true, 0, false, 0, 0, 30000, OTA_STREAM_ERR_SINK},
+};
+#define OTA_SELFTEST_CASE_COUNT (sizeof(OTA_SELFTEST_CASES) / sizeof(OTA_SELFTEST_CASES[0]))
+
+// Feed one stream in random chunks, the way BLE writes arrive
+static OtaStreamResult otaSelfTestFeed(OtaStream &stream, const uint8_t *data, size_t len, uint32_t *us)
+{
+    OtaStreamResult result = OTA_STREAM_OK;
+    unsigned long start = micros();
+    size_t sent = 0;
+    while (result == OTA_STREAM_OK && sent < len)
+    {
+        size_t chunk = min((size_t)random(OTA_SELFTEST_CHUNK_MIN, OTA_SELFTEST_CHUNK_MAX + 1), len - sent);
+        result = stream.feed(data + sent, chunk, sent + chunk == len);
+        sent += chunk;
+    }
+    *us += micros() - start;
+    stream.abort();  // No-op once finished
+    return result;
+}
+
+// BEGIN signature and counter checks, with a throwaway key in place of
+// the paired one
+static bool otaSelfTestBeginAuth()
+{
+    PermitAuthState saved = permitAuth;
+    permitAuth.paired = true;
+    for (int i = 0; i < PERMIT_AUTH_KEY_SIZE; i++)
+    {
+        permitAuth.key[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    uint8_t begin[OTA_BEGIN_LEN] = {0x01};
+    for (int i = 1; i < OTA_BEGIN_SIGNED_LEN - 4; i++)
+    {
+        begin[i] = (uint8_t)i;
+    }
+    const uint32_t counter = 100;
+    memcpy(begin + OTA_BEGIN_SIGNED_LEN - 4, &counter, 4);  // Little-endian target
+    permitAuthHmac<PermitAuthShaHw>(permitAuth.key, begin, OTA_BEGIN_SIGNED_LEN, begin + OTA_BEGIN_SIGNED_LEN);
+
+    uint8_t tampered[OTA_BEGIN_LEN];
+    memcpy(tampered, begin, sizeof(tampered));
+    tampered[5] ^= 0x01;  // Image size
+
+    struct
+    {
+        const char *name;
+        const uint8_t *msg;
+        size_t len;
+        uint32_t lastCounter;
+        bool paired;
+        bool expect;
+    } cases[] = {
+        {"signed", begin, sizeof(begin), counter - 1, true, true},
+        {"tampered", tampered, sizeof(tampered), counter - 1, true, false},
+        {"replayed", begin, sizeof(begin), counter, true, false},
+        {"unsigned", begin, OTA_BEGIN_SIGNED_LEN - 4, 0, true, false},  // The old 41 byte BEGIN
+        {"not paired", begin, sizeof(begin), counter - 1, false, false},
+    };
+
+    bool ok = true;
+    for (auto &c : cases)
+    {
+        permitAuth.paired = c.paired;
+        bool accepted = otaBeginAuthorized<PermitAuthShaHw>(c.msg, c.len, c.lastCounter);
+        bool pass = accepted == c.expect;
+        ok &= pass;
+        LOG_STAT("  BEGIN %-12s %-9s %s", c.name, accepted ? "accepted" : "rejected", pass ? "pass" : "FAIL");
+    }
+    permitAuth = saved;
+    return ok;
+}
+
+// Returns false if any case ends with the wrong result, or a clean
+// stream delivers a wrong byte
+bool otaSelfTest(int runs)
+{
+    LOG_STAT("\n=== OTA self-test: %d runs of %u cases ===", runs, (unsigned)OTA_SELFTEST_CASE_COUNT);
+
+    size_t storedMax = OTA_SELFTEST_IMAGE_SIZE + 6 +
+                       5 * ((OTA_SELFTEST_IMAGE_SIZE + OTA_SELFTEST_STORED_BLOCK - 1) / OTA_SELFTEST_STORED_BLOCK);
+    OtaInflateState *inflate = (OtaInflateState *)heap_caps_malloc(sizeof(OtaInflateState), MALLOC_CAP_8BIT);
+    uint8_t *stored = (uint8_t *)malloc(storedMax);
+    uint8_t *scratch = (uint8_t *)malloc(storedMax);  // Stream as sent, with the case's damage
+    if (!inflate || !stored || !scratch)
+    {
+        LOG_E("Not enough memory for OTA self-test");
+        free(inflate);
+        free(stored);
+        free(scratch);
+        return false;
+    }
+    size_t storedLen = otaSelfTestStoredStream(stored);
+
+    uint8_t sha[32];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    SHA256_STARTS(&ctx);
+    for (uint32_t i = 0; i < OTA_SELFTEST_IMAGE_SIZE; i++)
+    {
+        uint8_t v = otaSelfTestByte(i);
+        SHA256_UPDATE(&ctx, &v, 1);
+    }
+    SHA256_FINISH(&ctx, sha);
+    mbedtls_sha256_free(&ctx);
+
+    bool ok = true;
+    uint32_t cleanUs[2] = {0, 0};  // Stored, deflate
+    OtaStream stream;
+    for (size_t c = 0; c < OTA_SELFTEST_CASE_COUNT; c++)
+    {
+        const OtaSelfTestCase &tc = OTA_SELFTEST_CASES[c];
+        size_t len = tc.stored ? storedLen : sizeof(OTA_SELFTEST_DEFLATE);
+        memcpy(scratch, tc.stored ? stored : OTA_SELFTEST_DEFLATE, len);
+        len -= tc.truncate;
+        if (tc.corruptAt)
+        {
+            scratch[tc.corruptAt] ^= 0x5A;
+        }
+        uint8_t expectSha[32];
+        memcpy(expectSha, sha, 32);
+        expectSha[0] ^= tc.badHash ? 0xFF : 0;
+
+        int failures = 0;
+        OtaStreamResult result = OTA_STREAM_OK;
+        uint32_t us = 0;
+        for (int r = 0; r < runs; r++)
+        {
+            OtaSelfTestSink sink = {0, 0, tc.refuseAt};
+            stream.begin(inflate, OTA_SELFTEST_IMAGE_SIZE + tc.sizeDelta, expectSha, otaSelfTestSink, &sink);
+            result = otaSelfTestFeed(stream, scratch, len, &us);
+            bool pass = result == tc.expect;
+            if (tc.expect == OTA_STREAM_DONE)
+            {
+                pass &= sink.pos == OTA_SELFTEST_IMAGE_SIZE && sink.mismatches == 0;
+            }
+            failures += pass ? 0 : 1;
+        }
+        if (tc.expect == OTA_STREAM_DONE)
+        {
+            cleanUs[tc.stored ? 0 : 1] = us;
+        }
+        ok &= failures == 0;
+        LOG_STAT("  %-15s %-14s %s", tc.name, OTA_STREAM_RESULT_NAMES[result],
+                 failures ? "FAIL" : "pass");
+    }
+
+    ok &= otaSelfTestBeginAuth();
+
+    float imageKb = OTA_SELFTEST_IMAGE_SIZE / 1024.0f * runs;
+    LOG_STAT("Decode: stored %.0f KB/s, deflate %.0f KB/s of image (%u byte stream)",
+             imageKb / max(cleanUs[0], (uint32_t)1) * 1e6f, imageKb / max(cleanUs[1], (uint32_t)1) * 1e6f,
+             (unsigned)sizeof(OTA_SELFTEST_DEFLATE));
+    LOG_STAT("OTA self-test %s", ok ? "passed" : "FAILED");
+
+    free(inflate);
+    free(stored);
+    free(scratch);
+    return ok;
+}
+
+#endif
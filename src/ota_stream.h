@@ -0,0 +1,160 @@
+#ifndef OTA_STREAM_H
+#define OTA_STREAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include "sha256_compat.h"
+
+#if defined(ESP_PLATFORM)
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/miniz.h"
+#else
+#include "esp32/rom/miniz.h"
+#endif
+#else
+#include "miniz.h"  // Host builds: miniz single-file library
+#endif
+
+// Streaming decode of a zlib-compressed firmware image: inflate with the
+// ROM copy of miniz's tinfl into a 32 KB window, hash the output with
+// SHA-256 and hand it to a sink as it is produced. No BLE, flash or Serial
+// calls in here so it can be built and fed on the host; ble_ota.h wires it
+// to the GATT service and the OTA partition.
+
+enum OtaStreamResult
+{
+    OTA_STREAM_OK = 0,        // Consumed, more input expected
+    OTA_STREAM_DONE,          // End of zlib stream reached, size and hash match
+    OTA_STREAM_ERR_DECODE,    // Corrupt or truncated compressed data
+    OTA_STREAM_ERR_SINK,      // Sink refused the data (flash write failed)
+    OTA_STREAM_ERR_SIZE,      // Image larger or smaller than announced
+    OTA_STREAM_ERR_HASH,      // SHA-256 of the image does not match
+};
+
+static const char *OTA_STREAM_RESULT_NAMES[] = {
+    "ok", "done", "decode error", "write error", "size mismatch", "hash mismatch"};
+
+// Sink for decompressed bytes; return false to abort
+typedef bool (*OtaSink)(void *ctx, const uint8_t *data, size_t len);
+
+// Big buffers, allocated by the caller only for the duration of an update
+struct OtaInflateState
+{
+    tinfl_decompressor inflator;
+    uint8_t window[TINFL_LZ_DICT_SIZE];
+};
+
+class OtaStream
+{
+public:
+    void begin(OtaInflateState *state, uint32_t imageSize, const uint8_t expectedSha[32],
+               OtaSink sink, void *sinkCtx)
+    {
+        this->state = state;
+        this->imageSize = imageSize;
+        memcpy(this->expectedSha, expectedSha, 32);
+        this->sink = sink;
+        this->sinkCtx = sinkCtx;
+        windowPos = 0;
+        consumed = 0;
+        produced = 0;
+        finished = false;
+        tinfl_init(&state->inflator);
+        mbedtls_sha256_init(&sha);
+        SHA256_STARTS(&sha);
+    }
+
+    // Feed compressed bytes. last = no more input will follow.
+    OtaStreamResult feed(const uint8_t *in, size_t len, bool last)
+    {
+        if (finished)
+        {
+            return len ? OTA_STREAM_ERR_SIZE : OTA_STREAM_DONE;
+        }
+
+        uint32_t flags = TINFL_FLAG_PARSE_ZLIB_HEADER | (last ? 0 : TINFL_FLAG_HAS_MORE_INPUT);
+        for (;;)
+        {
+            size_t inBytes = len;
+            size_t outBytes = TINFL_LZ_DICT_SIZE - windowPos;
+            tinfl_status status = tinfl_decompress(&state->inflator, in, &inBytes,
+                                                   state->window, state->window + windowPos,
+                                                   &outBytes, flags);
+            in += inBytes;
+            len -= inBytes;
+            consumed += inBytes;
+
+            if (outBytes)
+            {
+                produced += outBytes;
+                if (produced > imageSize)
+                {
+                    return OTA_STREAM_ERR_SIZE;
+                }
+                const uint8_t *out = state->window + windowPos;
+                SHA256_UPDATE(&sha, out, outBytes);
+                if (!sink(sinkCtx, out, outBytes))
+                {
+                    return OTA_STREAM_ERR_SINK;
+                }
+                windowPos = (windowPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+            }
+
+            if (status < TINFL_STATUS_DONE)
+            {
+                return OTA_STREAM_ERR_DECODE;
+            }
+            if (status == TINFL_STATUS_DONE)
+            {
+                finished = true;
+                return verify();
+            }
+            if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0)
+            {
+                return last ? OTA_STREAM_ERR_DECODE : OTA_STREAM_OK;
+            }
+            // TINFL_STATUS_HAS_MORE_OUTPUT: window is full, go round again
+        }
+    }
+
+    // Release the hash context when an update is abandoned part way
+    void abort()
+    {
+        if (!finished)
+        {
+            mbedtls_sha256_free(&sha);
+            finished = true;
+        }
+    }
+
+    uint32_t bytesIn() const { return consumed; }
+    uint32_t bytesOut() const { return produced; }
+    bool done() const { return finished; }
+
+private:
+    OtaStreamResult verify()
+    {
+        uint8_t digest[32];
+        SHA256_FINISH(&sha, digest);
+        mbedtls_sha256_free(&sha);
+        if (produced != imageSize)
+        {
+            return OTA_STREAM_ERR_SIZE;
+        }
+        return memcmp(digest, expectedSha, 32) == 0 ? OTA_STREAM_DONE : OTA_STREAM_ERR_HASH;
+    }
+
+    OtaInflateState *state = nullptr;
+    mbedtls_sha256_context sha;
+    uint8_t expectedSha[32];
+    OtaSink sink = nullptr;
+    void *sinkCtx = nullptr;
+    uint32_t imageSize = 0;
+    uint32_t windowPos = 0;
+    uint32_t consumed = 0;
+    uint32_t produced = 0;
+    bool finished = false;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef PANEL_ASYNC_H
+#define PANEL_ASYNC_H
+
+#include <Arduino.h>
+#include "heltec-eink-modules.h"
+#include "energy_model.h"
+#include "log_helper.h"
+
+// Non-blocking panel updates. display->update() blocks for the SPI transfer
+// plus the whole refresh waveform (~1-2 s for a full refresh), so it runs
+// in a worker task instead and the caller gets a ticket it can wait on.
+// The panel's BUSY line is watched by an interrupt to timestamp the end of
+// the waveform.
+//
+// Rule: anything that touches the display buffer must call panelWaitIdle()
+// first, since the worker reads the buffer while it transfers.
+
+#define PANEL_BUSY_PIN 6           // Vision Master E290 panel BUSY (high while refreshing)
+#define PANEL_TASK_STACK 4096
+#define PANEL_TASK_PRIORITY 1      // Below BLE host and loop()
+#define PANEL_TASK_CORE 0
+
+typedef uint32_t PanelTicket;
+
+static EInkDisplay_VisionMasterE290 *panelAsyncDisplay = nullptr;
+static TaskHandle_t panelTaskHandle = nullptr;
+static SemaphoreHandle_t panelStartSem = nullptr;
+static StaticTask_t panelTaskBuffer;
+static StackType_t panelTaskStack[PANEL_TASK_STACK];
+static StaticSemaphore_t panelStartSemBuffer;
+static volatile PanelTicket panelRequested = 0;  // Last ticket handed out
+static volatile PanelTicket panelCompleted = 0;  // Last ticket finished
+static volatile uint32_t panelBusyEndUs = 0;     // Set by BUSY falling edge
+static uint32_t panelLastWallMs = 0;
+
+static void IRAM_ATTR panelBusyIsr()
+{
+    panelBusyEndUs = micros();
+}
+
+static void panelTask(void *)
+{
+    for (;;)
+    {
+        xSemaphoreTake(panelStartSem, portMAX_DELAY);
+        PanelTicket ticket = panelRequested;
+
+        uint32_t startUs = micros();
+        panelBusyEndUs = 0;
+        energyRefreshBegin();
+        panelAsyncDisplay->update();
+        energyRefreshEnd();
+        uint32_t doneUs = micros();
+
+        panelLastWallMs = (doneUs - startUs) / 1000;
+        uint32_t busyEnd = panelBusyEndUs;
+        if (busyEnd)
+        {
+            LOG_STAT("Panel refresh #%lu: %lu ms wall, waveform ended at +%lu ms",
+                     (unsigned long)ticket, (unsigned long)panelLastWallMs,
+                     (unsigned long)((busyEnd - startUs) / 1000));
+        }
+        else
+        {
+            LOG_STAT("Panel refresh #%lu: %lu ms wall",
+                     (unsigned long)ticket, (unsigned long)panelLastWallMs);
+        }
+
+        panelCompleted = ticket;
+    }
+}
+
+// Start the worker task; call once after the display is constructed
+void panelAsyncBegin(EInkDisplay_VisionMasterE290 *disp)
+{
+    panelAsyncDisplay = disp;
+    panelStartSem = xSemaphoreCreateBinaryStatic(&panelStartSemBuffer);
+    panelTaskHandle = xTaskCreateStaticPinnedToCore(panelTask, "panel", PANEL_TASK_STACK, nullptr,
+                                                    PANEL_TASK_PRIORITY, panelTaskStack,
+                                                    &panelTaskBuffer, PANEL_TASK_CORE);
+    attachInterrupt(digitalPinToInterrupt(PANEL_BUSY_PIN), panelBusyIsr, FALLING);
+}
+
+static inline bool panelUpdateDone(PanelTicket ticket)
+{
+    return (int32_t)(panelCompleted - ticket) >= 0;
+}
+
+// Wait for a ticket to complete; false on timeout
+bool panelUpdateWait(PanelTicket ticket, uint32_t timeoutMs = portMAX_DELAY)
+{
+    uint32_t start = millis();
+    while (!panelUpdateDone(ticket))
+    {
+        if (timeoutMs != portMAX_DELAY && millis() - start >= timeoutMs)
+        {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    return true;
+}
+
+// Block until no update is in flight (call before touching the buffer)
+void panelWaitIdle()
+{
+    if (panelTaskHandle)
+    {
+        panelUpdateWait(panelRequested);
+    }
+}
+
+// Push the framebuffer to the panel without waiting for it.
+// Falls back to a blocking update if the worker was never started.
+PanelTicket panelUpdateAsync()
+{
+    if (!panelTaskHandle)
+    {
+        uint32_t startMs = millis();
+        energyRefreshBegin();
+        panelAsyncDisplay->update();
+        energyRefreshEnd();
+        panelLastWallMs = millis() - startMs;
+        panelCompleted = ++panelRequested;
+        return panelRequested;
+    }
+
+    panelWaitIdle();
+    PanelTicket ticket = panelRequested + 1;
+    panelRequested = ticket;
+    xSemaphoreGive(panelStartSem);
+    return ticket;
+}
+
+#endif
@@ -0,0 +1,377 @@
+#ifndef PERMIT_AUTH_H
+#define PERMIT_AUTH_H
+
+#include <stdint.h>
+#include <string.h>
+#include "sha256_compat.h"
+
+// Authenticated permit payloads. Once a key has been shared at pairing
+// (ble_pairing.h), the phone appends a trailer to the permit JSON:
+//
+//   [JSON]["PAU1"][u32 counter, little-endian][32 byte HMAC-SHA256]
+//
+// The HMAC covers everything before it (JSON, magic and counter) under the
+// pairing key. The phone increases the counter for every payload; one at
+// or below the last accepted counter is a replay. The last accepted counter
+// is saved with the permit record (permit_store.h).
+//
+// HMAC runs on mbedTLS, which uses the ESP32-S3 SHA accelerator. A plain C
+// SHA-256 with the same interface is kept to compare against and for host
+// builds. No BLE, flash or Serial calls in here.
+
+#define PERMIT_AUTH_KEY_SIZE 32
+#define PERMIT_AUTH_TAG_SIZE 32
+#define PERMIT_AUTH_MAGIC "PAU1"
+#define PERMIT_AUTH_TRAILER_SIZE (4 + 4 + PERMIT_AUTH_TAG_SIZE)
+
+enum PermitAuthResult
+{
+    AUTH_OK = 0,        // Tag valid and counter new
+    AUTH_UNPAIRED,      // No key yet: accepted as before (trailer dropped if present)
+    AUTH_ERR_MISSING,   // Paired, but the payload has no trailer
+    AUTH_ERR_TAG,       // Wrong key or modified payload
+    AUTH_ERR_REPLAY,    // Counter not above the last accepted one
+    AUTH_RESULT_COUNT
+};
+
+static const char *PERMIT_AUTH_RESULT_NAMES[AUTH_RESULT_COUNT] = {
+    "ok", "unpaired", "not signed", "bad signature", "replayed"};
+
+// mbedTLS SHA-256 (hardware accelerated on the ESP32-S3)
+struct PermitAuthShaHw
+{
+    mbedtls_sha256_context ctx;
+
+    void begin()
+    {
+        mbedtls_sha256_init(&ctx);
+        SHA256_STARTS(&ctx);
+    }
+    void update(const uint8_t *data, size_t len)
+    {
+        SHA256_UPDATE(&ctx, data, len);
+    }
+    void finish(uint8_t out[32])
+    {
+        SHA256_FINISH(&ctx, out);
+        mbedtls_sha256_free(&ctx);
+    }
+};
+
+// Portable SHA-256 (FIPS 180-4) with the same interface
+struct PermitAuthShaSw
+{
+    uint32_t state[8];
+    uint8_t block[64];
+    uint64_t total;
+    size_t fill;
+
+    void begin()
+    {
+        static const uint32_t INIT[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        memcpy(state, INIT, sizeof(state));
+        total = 0;
+        fill = 0;
+    }
+
+    void update(const uint8_t *data, size_t len)
+    {
+        total += len;
+        while (len > 0)
+        {
+            size_t n = 64 - fill < len ? 64 - fill : len;
+            memcpy(block + fill, data, n);
+            fill += n;
+            data += n;
+            len -= n;
+            if (fill == 64)
+            {
+                compress();
+                fill = 0;
+            }
+        }
+    }
+
+    void finish(uint8_t out[32])
+    {
+        uint64_t bits = total * 8;
+        uint8_t pad = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (fill != 56)
+        {
+            update(&pad, 1);
+        }
+        uint8_t len[8];
+        for (int i = 0; i < 8; i++)
+        {
+            len[i] = (uint8_t)(bits >> (56 - 8 * i));
+        }
+        update(len, 8);
+        for (int i = 0; i < 8; i++)
+        {
+            out[4 * i] = (uint8_t)(state[i] >> 24);
+            out[4 * i + 1] = (uint8_t)(state[i] >> 16);
+            out[4 * i + 2] = (uint8_t)(state[i] >> 8);
+            out[4 * i + 3] = (uint8_t)state[i];
+        }
+    }
+
+private:
+    static uint32_t ror(uint32_t x, int n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    void compress()
+    {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+        {
+            w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+                   (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+        }
+        for (int i = 16; i < 64; i++)
+        {
+            uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+};
+
+// HMAC key block: the 32-byte key is shorter than the block, so just zero-padded
+static inline void permitAuthPad(const uint8_t key[PERMIT_AUTH_KEY_SIZE], uint8_t fill, uint8_t pad[64])
+{
+    memset(pad, fill, 64);
+    for (int i = 0; i < PERMIT_AUTH_KEY_SIZE; i++)
+    {
+        pad[i] ^= key[i];
+    }
+}
+
+// HMAC-SHA256 with a 32-byte key
+template <class Sha>
+static void permitAuthHmac(const uint8_t key[PERMIT_AUTH_KEY_SIZE], const uint8_t *msg, size_t len,
+                           uint8_t out[PERMIT_AUTH_TAG_SIZE])
+{
+    uint8_t pad[64];
+    Sha sha;
+
+    permitAuthPad(key, 0x36, pad);
+    sha.begin();
+    sha.update(pad, sizeof(pad));
+    sha.update(msg, len);
+    sha.finish(out);
+
+    permitAuthPad(key, 0x5c, pad);
+    sha.begin();
+    sha.update(pad, sizeof(pad));
+    sha.update(out, PERMIT_AUTH_TAG_SIZE);
+    sha.finish(out);
+}
+
+struct PermitAuthState
+{
+    bool paired;
+    uint8_t key[PERMIT_AUTH_KEY_SIZE];
+    uint32_t lastCounter;  // Highest counter accepted so far
+};
+
+static PermitAuthState permitAuth;
+
+// Length of the JSON part if the payload ends in a trailer, else 0
+static inline size_t permitAuthJsonLength(const uint8_t *payload, size_t len)
+{
+    if (len <= PERMIT_AUTH_TRAILER_SIZE)
+    {
+        return 0;
+    }
+    size_t jsonLen = len - PERMIT_AUTH_TRAILER_SIZE;
+    return memcmp(payload + jsonLen, PERMIT_AUTH_MAGIC, 4) == 0 ? jsonLen : 0;
+}
+
+// Build a trailer for json (the phone's side; used by the simulator and tests)
+template <class Sha = PermitAuthShaHw>
+static void permitAuthSign(const uint8_t key[PERMIT_AUTH_KEY_SIZE], const char *json, size_t jsonLen,
+                           uint32_t counter, uint8_t *signedOut)
+{
+    memcpy(signedOut, json, jsonLen);
+    uint8_t *trailer = signedOut + jsonLen;
+    memcpy(trailer, PERMIT_AUTH_MAGIC, 4);
+    for (int i = 0; i < 4; i++)
+    {
+        trailer[4 + i] = (uint8_t)(counter >> (8 * i));
+    }
+    permitAuthHmac<Sha>(key, signedOut, jsonLen + 8, trailer + 8);
+}
+
+// Check a payload against the pairing key and the replay counter.
+// *jsonLen is set to the length of the JSON part for AUTH_OK and
+// AUTH_UNPAIRED; the counter only advances on AUTH_OK.
+template <class Sha = PermitAuthShaHw>
+static PermitAuthResult permitAuthVerify(const uint8_t *payload, size_t len, size_t *jsonLen)
+{
+    size_t json = permitAuthJsonLength(payload, len);
+    if (!permitAuth.paired)
+    {
+        *jsonLen = json ? json : len;
+        return AUTH_UNPAIRED;
+    }
+    if (!json)
+    {
+        return AUTH_ERR_MISSING;
+    }
+
+    const uint8_t *trailer = payload + json;
+    uint8_t tag[PERMIT_AUTH_TAG_SIZE];
+    permitAuthHmac<Sha>(permitAuth.key, payload, json + 8, tag);
+
+    // Constant time, so a forger learns nothing from how long the compare took
+    uint8_t diff = 0;
+    for (int i = 0; i < PERMIT_AUTH_TAG_SIZE; i++)
+    {
+        diff |= tag[i] ^ trailer[8 + i];
+    }
+    if (diff)
+    {
+        return AUTH_ERR_TAG;
+    }
+
+    uint32_t counter = trailer[4] | (uint32_t)trailer[5] << 8 |
+                       (uint32_t)trailer[6] << 16 | (uint32_t)trailer[7] << 24;
+    if (counter <= permitAuth.lastCounter)
+    {
+        return AUTH_ERR_REPLAY;
+    }
+    permitAuth.lastCounter = counter;
+    *jsonLen = json;
+    return AUTH_OK;
+}
+
+// permitAuthVerify() for a payload read off a socket, without holding it
+// all: begin(), update() with every byte of the JSON as it goes past, then
+// finish() with whatever followed the JSON (the trailer, and possibly
+// whitespace before it).
+template <class Sha = PermitAuthShaHw>
+struct PermitAuthStreamVerify
+{
+    Sha sha;
+    bool hashing = false;
+
+    void begin()
+    {
+        hashing = permitAuth.paired;
+        if (hashing)
+        {
+            uint8_t pad[64];
+            permitAuthPad(permitAuth.key, 0x36, pad);
+            sha.begin();
+            sha.update(pad, sizeof(pad));
+        }
+    }
+
+    void update(const uint8_t *data, size_t len)
+    {
+        if (hashing)
+        {
+            sha.update(data, len);
+        }
+    }
+
+    // Payload abandoned before finish(): release the hash context
+    void abort()
+    {
+        if (hashing)
+        {
+            uint8_t tag[PERMIT_AUTH_TAG_SIZE];
+            sha.finish(tag);
+            hashing = false;
+        }
+    }
+
+    // *extraJson is set to how many bytes of tail still belong to the JSON part
+    PermitAuthResult finish(const uint8_t *tail, size_t tailLen, size_t *extraJson)
+    {
+        uint8_t tag[PERMIT_AUTH_TAG_SIZE];
+        bool hasTrailer = tailLen >= PERMIT_AUTH_TRAILER_SIZE &&
+                          memcmp(tail + tailLen - PERMIT_AUTH_TRAILER_SIZE, PERMIT_AUTH_MAGIC, 4) == 0;
+        *extraJson = hasTrailer ? tailLen - PERMIT_AUTH_TRAILER_SIZE : tailLen;
+        if (!hashing)
+        {
+            return AUTH_UNPAIRED;
+        }
+        hashing = false;
+        if (!hasTrailer)
+        {
+            sha.finish(tag);  // Release the context
+            return AUTH_ERR_MISSING;
+        }
+        const uint8_t *trailer = tail + tailLen - PERMIT_AUTH_TRAILER_SIZE;
+        sha.update(tail, tailLen - PERMIT_AUTH_TAG_SIZE);
+        sha.finish(tag);
+
+        uint8_t pad[64];
+        permitAuthPad(permitAuth.key, 0x5c, pad);
+        sha.begin();
+        sha.update(pad, sizeof(pad));
+        sha.update(tag, PERMIT_AUTH_TAG_SIZE);
+        sha.finish(tag);
+
+        uint8_t diff = 0;
+        for (int i = 0; i < PERMIT_AUTH_TAG_SIZE; i++)
+        {
+            diff |= tag[i] ^ trailer[8 + i];
+        }
+        if (diff)
+        {
+            return AUTH_ERR_TAG;
+        }
+        uint32_t counter = trailer[4] | (uint32_t)trailer[5] << 8 |
+                           (uint32_t)trailer[6] << 16 | (uint32_t)trailer[7] << 24;
+        if (counter <= permitAuth.lastCounter)
+        {
+            return AUTH_ERR_REPLAY;
+        }
+        permitAuth.lastCounter = counter;
+        return AUTH_OK;
+    }
+};
+
+#endif
@@ -0,0 +1,412 @@
+#ifndef PERMIT_BROADCAST_H
+#define PERMIT_BROADCAST_H
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <BLEScan.h>
+#include "bluetooth_helper.h"
+#include "permit_source.h"
+#include "permit_store.h"
+#include "log_helper.h"
+
+// Connectionless permit delivery. The app can broadcast the whole permit in
+// a BLE 5 extended advertisement. In broadcast mode (-DPERMIT_BROADCAST) an
+// auto sync first listens for it with a passive extended scan and applies
+// it without connecting: no connection setup, no GATT discovery and no
+// BLEClient. If nothing usable is heard within BROADCAST_LISTEN_MS the sync
+// carries on over the connected path (bluetooth_helper.h), and so do
+// manual and forced syncs, which the app reports to the user and so needs
+// the sync-type write for.
+//
+// The broadcast is service data for the permit service in the extended
+// advertising data (a legacy advertisement holds 31 bytes, this up to 190):
+//   format   1 byte   PHONE_ADVERT_PERMIT_FORMAT
+//   tag      4 bytes  permit version tag, as in PHONE_ADVERT_TAG_FORMAT
+//   flags    1 byte   bit 0 = displayFlipped
+//   now      4 bytes  phone's local clock in seconds, 0 if not sent
+//   fields   6 x (length byte, ASCII): permitNumber, plateNumber,
+//            validFrom, validTo, barcodeValue, barcodeLabel
+//   trailer  the signature trailer of a GATT read (permit_auth.h), over all of the above
+// Integers are little endian. The queue is not broadcast; the display
+// keeps its own until a connected sync brings a new one.
+//
+// Anyone in range can advertise, so unlike a GATT read a broadcast is only
+// taken from a paired phone: valid signature and a fresh counter. One
+// carrying the tag of the payload applied last is up to date without
+// being checked, as with the advertised tag alone.
+//
+// Extended scanning needs a core built with BLE 5 features
+// (SOC_BLE_50_SUPPORTED, e.g. the ESP32-S3); without them every sync
+// takes the connected path.
+
+#define PHONE_ADVERT_PERMIT_FORMAT 2
+#define BROADCAST_HEADER_LEN 10        // Format, tag, flags, clock
+#define BROADCAST_PAYLOAD_MAX 240      // Service data after the UUID
+#define BROADCAST_AD_SERVICE_DATA16 0x16
+#define BROADCAST_SERVICE_UUID16 0xFF00  // BLE_SERVICE_UUID
+
+#ifndef BROADCAST_LISTEN_MS
+#define BROADCAST_LISTEN_MS 3000       // A few of the app's advertising intervals
+#endif
+#define BROADCAST_SCAN_INTERVAL 160    // 100 ms in 0.625 ms units
+#define BROADCAST_SCAN_WINDOW 160      // Listen all the time while it lasts
+
+static inline void broadcastPut32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static inline uint32_t broadcastGet32(const uint8_t *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Build a signed broadcast for permit (the phone's side; used by the
+// simulator). out needs BROADCAST_PAYLOAD_MAX bytes. Returns the length.
+template <class Sha = PermitAuthShaHw>
+static size_t broadcastEncodePermit(const PermitData *permit, uint32_t tag, uint32_t clockSeconds,
+                                    const uint8_t key[PERMIT_AUTH_KEY_SIZE], uint32_t counter, uint8_t *out)
+{
+    uint8_t body[BROADCAST_PAYLOAD_MAX - PERMIT_AUTH_TRAILER_SIZE];
+    size_t len = 0;
+    body[len++] = PHONE_ADVERT_PERMIT_FORMAT;
+    broadcastPut32(body + len, tag);
+    len += 4;
+    body[len++] = permit->displayFlipped ? 1 : 0;
+    broadcastPut32(body + len, clockSeconds);
+    len += 4;
+    // In PERMIT_FIELD_NAMES order
+    const char *fields[PERMIT_FIELD_COUNT] = {permit->permitNumber, permit->plateNumber, permit->validFrom,
+                                              permit->validTo, permit->barcodeValue, permit->barcodeLabel};
+    for (const char *field : fields)
+    {
+        size_t n = strnlen(field, 255);
+        body[len++] = (uint8_t)n;
+        memcpy(body + len, field, n);
+        len += n;
+    }
+    permitAuthSign<Sha>(key, (const char *)body, len, counter, out);
+    return len + PERMIT_AUTH_TRAILER_SIZE;
+}
+
+// Decode the body of a broadcast (signature already checked), validating
+// it like a JSON payload. data is filled for INGEST_UPDATED and INGEST_UNCHANGED.
+static PermitIngestResult broadcastDecodePermit(const uint8_t *body, size_t len, const char *currentPermitNumber,
+                                                PermitData *data, PermitIngestInfo *info)
+{
+    memset(info, 0, sizeof(PermitIngestInfo));
+    memset(data, 0, sizeof(PermitData));
+    if (len < BROADCAST_HEADER_LEN || body[0] != PHONE_ADVERT_PERMIT_FORMAT)
+    {
+        info->parseError = "not a permit broadcast";
+        return INGEST_ERROR_PARSE;
+    }
+    data->displayFlipped = body[5] & 1;
+    info->clockSeconds = broadcastGet32(body + 6);
+
+    char *dest[PERMIT_FIELD_COUNT] = {data->permitNumber, data->plateNumber, data->validFrom,
+                                      data->validTo, data->barcodeValue, data->barcodeLabel};
+    const size_t destSize[PERMIT_FIELD_COUNT] = {sizeof(data->permitNumber), sizeof(data->plateNumber),
+                                                 sizeof(data->validFrom), sizeof(data->validTo),
+                                                 sizeof(data->barcodeValue), sizeof(data->barcodeLabel)};
+    size_t pos = BROADCAST_HEADER_LEN;
+    for (int i = 0; i < PERMIT_FIELD_COUNT; i++)
+    {
+        if (pos >= len || pos + 1 + body[pos] > len)
+        {
+            info->parseError = "field runs past the end";
+            return INGEST_ERROR_PARSE;
+        }
+        char value[256];
+        size_t n = body[pos];
+        memcpy(value, body + pos + 1, n);
+        value[n] = '\0';
+        pos += 1 + n;
+        if (i == 0 && n == 0)
+        {
+            return INGEST_ERROR_EMPTY;
+        }
+        ingestCopyField(dest[i], destSize[i], value, 1 << i, info);
+    }
+    if (info->missingFields)
+    {
+        return INGEST_ERROR_INCOMPLETE;
+    }
+    if (currentPermitNumber != nullptr && strcmp(data->permitNumber, currentPermitNumber) == 0)
+    {
+        return INGEST_UNCHANGED;
+    }
+    return INGEST_UPDATED;
+}
+
+// Check and decode a broadcast (the service data after the UUID).
+// Returns 0 = rejected (*failure set), 1 = updated, 2 = already up to date.
+int acceptPermitBroadcast(const uint8_t *payload, size_t len, const char *currentPermitNumber,
+                          PermitData *data, SyncFailure *failure)
+{
+    if (permitAcceptLock)
+    {
+        xSemaphoreTake(permitAcceptLock, portMAX_DELAY);
+    }
+    *failure = SYNC_FAIL_NONE;
+
+    size_t bodyLen = 0;
+    uint32_t authStart = micros();
+    PermitAuthResult auth = permitAuthVerify(payload, len, &bodyLen);
+    uint32_t authUs = micros() - authStart;
+    if (auth != AUTH_OK)
+    {
+        // Unpaired too: without the key anyone nearby could set the permit
+        LOG_W("Permit broadcast rejected: %s (%u bytes)", PERMIT_AUTH_RESULT_NAMES[auth], (unsigned)len);
+        *failure = SYNC_FAIL_AUTH;
+        if (permitAcceptLock)
+        {
+            xSemaphoreGive(permitAcceptLock);
+        }
+        return 0;
+    }
+    LOG_STAT("Auth: broadcast ok in %lu us (counter %lu)", (unsigned long)authUs,
+             (unsigned long)permitAuth.lastCounter);
+
+    PermitIngestInfo info;
+    uint32_t ingestStart = micros();
+    PermitIngestResult result = broadcastDecodePermit(payload, bodyLen, currentPermitNumber, data, &info);
+    uint32_t ingestUs = micros() - ingestStart;
+    permitIngestRecord(result, bodyLen, ingestUs);
+    logPermitIngest(result, &info, bodyLen, ingestUs);
+    if ((result == INGEST_UPDATED || result == INGEST_UNCHANGED) && info.clockSeconds)
+    {
+        permitSetClock(info.clockSeconds);
+    }
+    if (permitAcceptLock)
+    {
+        xSemaphoreGive(permitAcceptLock);
+    }
+
+    switch (result)
+    {
+    case INGEST_UNCHANGED:
+        LOG_I("Permit unchanged");
+        return 2;
+    case INGEST_UPDATED:
+        LOG_I("New permit received: %s", data->permitNumber);
+        return 1;
+    case INGEST_ERROR_PARSE:
+        *failure = SYNC_FAIL_PARSE;
+        return 0;
+    default:
+        *failure = SYNC_FAIL_BAD_DATA;
+        return 0;
+    }
+}
+
+// Last broadcast heard, handed from the scan callback to the sync task.
+// The callback leaves it alone while broadcastHeard is set.
+static uint8_t broadcastPayload[BROADCAST_PAYLOAD_MAX];
+static size_t broadcastPayloadLen = 0;
+static volatile bool broadcastHeard = false;
+static volatile uint32_t broadcastHeardAt = 0;
+static int8_t broadcastRssi = 0;
+
+// Look for a permit broadcast in advertising data (AD structures); true if
+// one was taken. Called by the scan callback, and by the simulator.
+bool broadcastReceive(const uint8_t *adv, size_t len, int8_t rssi)
+{
+    if (broadcastHeard)
+    {
+        return false;
+    }
+    size_t pos = 0;
+    while (pos + 1 < len)
+    {
+        size_t fieldLen = adv[pos];
+        if (fieldLen == 0 || pos + 1 + fieldLen > len)
+        {
+            break;
+        }
+        const uint8_t *field = adv + pos + 1;
+        if (field[0] == BROADCAST_AD_SERVICE_DATA16 && fieldLen > 4 &&
+            (field[1] | field[2] << 8) == BROADCAST_SERVICE_UUID16 && field[3] == PHONE_ADVERT_PERMIT_FORMAT &&
+            fieldLen - 3 <= sizeof(broadcastPayload))
+        {
+            broadcastPayloadLen = fieldLen - 3;
+            memcpy(broadcastPayload, field + 3, broadcastPayloadLen);
+            broadcastRssi = rssi;
+            broadcastHeardAt = millis();
+            broadcastHeard = true;
+            return true;
+        }
+        pos += 1 + fieldLen;
+    }
+    return false;
+}
+
+#ifdef SOC_BLE_50_SUPPORTED
+// Extended reports may come in pieces (chained AUX PDUs): put one
+// advertiser's pieces back together before looking inside
+class PermitBroadcastCallback : public BLEExtAdvertisingCallbacks
+{
+    void onResult(esp_ble_gap_ext_adv_reprot_t report)
+    {
+        if (broadcastHeard)
+        {
+            return;
+        }
+        if (assemblyLen && memcmp(report.addr, assemblyAddr, sizeof(esp_bd_addr_t)) != 0)
+        {
+            assemblyLen = 0;  // Another advertiser cut in; start over with this one
+        }
+        if (assemblyLen + report.adv_data_len > sizeof(assembly))
+        {
+            assemblyLen = 0;
+            return;
+        }
+        memcpy(assemblyAddr, report.addr, sizeof(esp_bd_addr_t));
+        memcpy(assembly + assemblyLen, report.adv_data, report.adv_data_len);
+        assemblyLen += report.adv_data_len;
+        if (report.data_status == ESP_BLE_GAP_EXT_ADV_DATA_INCOMPLETE)
+        {
+            return;
+        }
+        size_t len = assemblyLen;
+        assemblyLen = 0;
+        if (report.data_status == ESP_BLE_GAP_EXT_ADV_DATA_COMPLETE)
+        {
+            broadcastReceive(assembly, len, report.rssi);
+        }
+    }
+
+    uint8_t assembly[BROADCAST_PAYLOAD_MAX + 16];
+    size_t assemblyLen = 0;
+    esp_bd_addr_t assemblyAddr;
+};
+
+static PermitBroadcastCallback permitBroadcastCallback;
+#endif
+
+// Broadcast mode: listen for the permit, fall back to the connected source
+class BroadcastPermitSource : public PermitSource
+{
+public:
+    explicit BroadcastPermitSource(PermitSource *connected) : connected(connected) {}
+
+    const char *name()
+    {
+        return "BLE broadcast";
+    }
+
+    int fetch(const PermitRequest &request, PermitFetch *out)
+    {
+        connected->reset();
+        if (request.syncType == SYNC_TYPE_AUTO)
+        {
+            int result = listen(request, out);
+            if (result || cancelled)
+            {
+                return result;
+            }
+            LOG_I("No usable permit broadcast, connecting to the phone");
+        }
+        return connected->fetch(request, out);
+    }
+
+    void cancel()
+    {
+        PermitSource::cancel();
+        connected->cancel();
+    }
+
+    uint32_t stackSize()
+    {
+        return connected->stackSize();
+    }
+
+    // Apply a heard broadcast; 0 to keep listening
+    int take(const PermitRequest &request, PermitFetch *out)
+    {
+        uint32_t tag = broadcastGet32(broadcastPayload + 1);
+        out->hasQueue = false;  // Keep ours
+        if (tag != 0 && tag == permitStoreAdvertTag)
+        {
+            LOG_I("Permit broadcast tag %08lx already applied", (unsigned long)tag);
+            advertSkippedSyncs++;
+            out->data = *request.current;
+            out->failure = SYNC_FAIL_NONE;
+            out->skipped = true;
+            return 2;
+        }
+        int result = acceptPermitBroadcast(broadcastPayload, broadcastPayloadLen, request.current->permitNumber,
+                                           &out->data, &out->failure);
+        if (result)
+        {
+            permitStoreAdvertTag = tag;  // Saved with the permit record
+        }
+        return result;
+    }
+
+private:
+    PermitSource *connected;
+
+    int listen(const PermitRequest &request, PermitFetch *out)
+    {
+        out->failure = SYNC_FAIL_OUT_OF_RANGE;
+#ifdef SOC_BLE_50_SUPPORTED
+        bleStackBegin();
+        BLEScan *scan = BLEDevice::getScan();
+        esp_ble_ext_scan_params_t params = {};
+        params.own_addr_type = BLE_ADDR_TYPE_PUBLIC;
+        params.filter_policy = BLE_SCAN_FILTER_ALLOW_ALL;
+        params.scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE;
+        params.cfg_mask = ESP_BLE_GAP_EXT_SCAN_CFG_UNCODE_MASK;
+        params.uncoded_cfg = {BLE_SCAN_TYPE_PASSIVE, BROADCAST_SCAN_INTERVAL, BROADCAST_SCAN_WINDOW};
+        scan->setExtendedScanCallback(&permitBroadcastCallback);
+        scan->setExtScanParams(&params);
+
+        LOG_I("Listening for a permit broadcast (%d ms)...", BROADCAST_LISTEN_MS);
+        broadcastHeard = false;
+        uint32_t start = millis();
+        energyRadioOn();
+        scan->startExtScan(BROADCAST_LISTEN_MS / 10, 0);  // Duration in 10 ms units
+        int result = 0;
+        while (!cancelled && millis() - start < BROADCAST_LISTEN_MS)
+        {
+            if (!broadcastHeard)
+            {
+                delay(10);
+                continue;
+            }
+            LOG_D("Permit broadcast heard after %lu ms (%u bytes, RSSI %d)",
+                  (unsigned long)(broadcastHeardAt - start), (unsigned)broadcastPayloadLen, broadcastRssi);
+            result = take(request, out);
+            if (result)
+            {
+                break;
+            }
+            broadcastHeard = false;  // Rejected; another may follow
+        }
+        scan->stopExtScan();
+        energyRadioOff();
+        broadcastHeard = false;
+        if (cancelled)
+        {
+            out->failure = SYNC_FAIL_CANCELLED;
+        }
+        else if (result)
+        {
+            LOG_STAT("Broadcast: permit %s in %lu ms, no connection",
+                     result == 1 ? "updated" : "unchanged", (unsigned long)(millis() - start));
+        }
+        return result;
+#else
+        LOG_D("Core built without BLE 5 - not listening for permit broadcasts");
+        return 0;
+#endif
+    }
+};
+
+static BroadcastPermitSource broadcastPermitSource(&blePermitSource);
+
+#endif
@@ -25,7 +25,8 @@ const int VALID_TO_Y_OFFSET = 17;     // Offset from VALID_FROM_Y
 const int BARCODE_X = 0;
 const int BARCODE_Y = 0;
 const int BARCODE_HEIGHT = 52;
-const int NARROW_BAR_WIDTH = 1;
+const int BARCODE_AREA_W = PERMIT_X - 2;  // Room left of the text column; module widths are fitted to it
+const int BARCODE_QUIET_MODULES = 2;      // Quiet zone per side in narrow modules (panel border adds the rest)
 const int BARCODE_LABEL_Y_OFFSET = 22;  // Offset below barcode
 
 // ========== LOGO SETTINGS ==========
@@ -39,4 +40,14 @@ const int TEMP_PARKING_Y2_OFFSET = 16;  // Second line offset from first line
 // ========== SEPARATOR LINE SETTINGS ==========
 const int HORIZONTAL_LINE_Y_OFFSET = 8;  // Offset below plate text
 
+// ========== STATUS BAND SETTINGS ==========
+// Empty strip between "valid to" and "Temporary parking" used for status
+// messages with fast partial refresh (must not overlap the permit layout)
+const int STATUS_BAND_X = PERMIT_X;
+const int STATUS_BAND_Y = 79;
+const int STATUS_BAND_W = SCREEN_W - PERMIT_X;
+const int STATUS_BAND_H = 14;
+const int STATUS_MAX_PARTIALS = 6;           // Full redraw after this many partials
+const unsigned long STATUS_HOLD_MS = 3000;   // How long error messages stay up
+
 #endif
\ No newline at end of file
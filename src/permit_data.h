@@ -0,0 +1,23 @@
+#ifndef PERMIT_DATA_H
+#define PERMIT_DATA_H
+
+// Permit data structure (shared by the BLE and WiFi paths and the flash record)
+struct PermitData {
+  char permitNumber[20];
+  char plateNumber[20];
+  char validFrom[30];
+  char validTo[30];
+  char barcodeValue[20];
+  char barcodeLabel[20];
+  bool displayFlipped;
+};
+
+// Upcoming permits, sorted by validFrom
+#define PERMIT_QUEUE_MAX 3
+
+struct PermitQueue {
+  uint8_t count;
+  PermitData entries[PERMIT_QUEUE_MAX];
+};
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef PERMIT_INGEST_H
+#define PERMIT_INGEST_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <ArduinoJson.h>
+#include "permit_data.h"
+
+// Permit payload ingest: JSON parsing, validation, change detection and
+// field copying. No BLE, flash or Serial calls in here so it can be built
+// and measured on its own; callers do the logging and I/O.
+
+enum PermitIngestResult
+{
+    INGEST_UPDATED = 0,       // Valid permit, different from current
+    INGEST_UNCHANGED,         // Valid permit, same number as current
+    INGEST_ERROR_PARSE,       // Not valid JSON
+    INGEST_ERROR_NO_PERMIT,   // permitNumber missing or not a string
+    INGEST_ERROR_EMPTY,       // permitNumber is "" (phone not synced yet)
+    INGEST_ERROR_INCOMPLETE,  // One or more required fields missing
+    INGEST_RESULT_COUNT
+};
+
+// Bit per field, used for the missing/truncated/non-ASCII masks
+enum PermitField
+{
+    FIELD_PERMIT_NUMBER = 1 << 0,
+    FIELD_PLATE_NUMBER = 1 << 1,
+    FIELD_VALID_FROM = 1 << 2,
+    FIELD_VALID_TO = 1 << 3,
+    FIELD_BARCODE_VALUE = 1 << 4,
+    FIELD_BARCODE_LABEL = 1 << 5,
+};
+
+struct PermitIngestInfo
+{
+    uint8_t missingFields;
+    uint8_t truncatedFields;  // Longer than the PermitData buffer
+    uint8_t nonAsciiFields;
+    uint32_t clockSeconds;    // Phone's "now" field, 0 if absent
+    const char *parseError;   // Set for INGEST_ERROR_PARSE
+};
+
+static const char *INGEST_RESULT_NAMES[INGEST_RESULT_COUNT] = {
+    "updated", "unchanged", "parse error", "no permit number", "empty permit", "incomplete"};
+
+static const char *PERMIT_FIELD_NAMES[] = {
+    "permitNumber", "plateNumber", "validFrom", "validTo", "barcodeValue", "barcodeLabel"};
+#define PERMIT_FIELD_COUNT 6
+
+#ifndef PERMIT_JSON_ARENA_SIZE
+#define PERMIT_JSON_ARENA_SIZE 8192  // Payload with a full queue peaks well under this
+#endif
+
+// Fixed arena backing the payload JsonDocument so ingest never touches the
+// heap. Bump allocation with a size header per block; frees are no-ops and
+// the arena is reset for each payload. Not reentrant.
+class PermitJsonArena : public ArduinoJson::Allocator
+{
+public:
+    void reset()
+    {
+        used = 0;
+        last = nullptr;
+    }
+
+    size_t peak() const
+    {
+        return peakUsed;
+    }
+
+    // Start a new high-water mark (benchmarks measure it per payload kind)
+    void resetPeak()
+    {
+        peakUsed = used;
+    }
+
+    void *allocate(size_t size) override
+    {
+        size_t need = HEADER + align(size);
+        if (used + need > PERMIT_JSON_ARENA_SIZE)
+        {
+            return nullptr;  // ArduinoJson reports NoMemory
+        }
+        uint8_t *block = arena + used;
+        *(size_t *)block = size;
+        used += need;
+        if (used > peakUsed)
+        {
+            peakUsed = used;
+        }
+        last = block + HEADER;
+        return last;
+    }
+
+    void deallocate(void *) override {}
+
+    void *reallocate(void *ptr, size_t newSize) override
+    {
+        if (!ptr)
+        {
+            return allocate(newSize);
+        }
+        size_t *header = (size_t *)((uint8_t *)ptr - HEADER);
+        size_t oldSize = *header;
+
+        // Most reallocs are the string being built or a pool being shrunk,
+        // which is the last block: resize it in place
+        if (ptr == last)
+        {
+            size_t start = (uint8_t *)ptr - arena;
+            if (start + align(newSize) > PERMIT_JSON_ARENA_SIZE)
+            {
+                return nullptr;
+            }
+            *header = newSize;
+            used = start + align(newSize);
+            if (used > peakUsed)
+            {
+                peakUsed = used;
+            }
+            return ptr;
+        }
+        if (newSize <= oldSize)
+        {
+            *header = newSize;
+            return ptr;
+        }
+
+        void *moved = allocate(newSize);
+        if (moved)
+        {
+            memcpy(moved, ptr, oldSize);
+        }
+        return moved;
+    }
+
+private:
+    static const size_t ALIGN = sizeof(void *) * 2;
+    static const size_t HEADER = ALIGN;
+
+    static size_t align(size_t n)
+    {
+        return (n + ALIGN - 1) & ~(ALIGN - 1);
+    }
+
+    alignas(sizeof(void *) * 2) uint8_t arena[PERMIT_JSON_ARENA_SIZE];
+    size_t used = 0;
+    size_t peakUsed = 0;
+    uint8_t *last = nullptr;
+};
+
+static PermitJsonArena permitJsonArena;
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static inline int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d)
+{
+    y -= m <= 2;
+    const int32_t era = (y >= 0 ? y : y - 399) / 400;
+    const uint32_t yoe = (uint32_t)(y - era * 400);
+    const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+// Parse a permit time like "Sep 05, 2025: 01:08" into local seconds
+static inline bool parsePermitTime(const char *text, time_t *out)
+{
+    static const char *MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char mon[4] = {0};
+    int day, year, hour, minute;
+
+    if (sscanf(text, "%3s %d, %d: %d:%d", mon, &day, &year, &hour, &minute) != 5)
+    {
+        return false;
+    }
+
+    const char *found = strstr(MONTHS, mon);
+    if (strlen(mon) != 3 || !found || (found - MONTHS) % 3 != 0)
+    {
+        return false;
+    }
+    int month = (found - MONTHS) / 3 + 1;
+    if (day < 1 || day > 31 || hour > 23 || minute > 59)
+    {
+        return false;
+    }
+
+    *out = (time_t)daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60;
+    return true;
+}
+
+// Copy one field, recording whether it was missing, cut short or non-ASCII
+static inline void ingestCopyField(char *dest, size_t destSize, const char *value,
+                                   uint8_t bit, PermitIngestInfo *info)
+{
+    size_t len = strlen(value);
+    if (len == 0)
+    {
+        info->missingFields |= bit;
+    }
+    if (len >= destSize)
+    {
+        info->truncatedFields |= bit;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if ((uint8_t)value[i] >= 0x80)
+        {
+            info->nonAsciiFields |= bit;
+            break;
+        }
+    }
+    strncpy(dest, value, destSize - 1);
+    dest[destSize - 1] = '\0';
+}
+
+// Copy one permit object from JSON; false if required fields are missing
+static inline bool permitFromJson(PermitData *data, JsonVariant obj, PermitIngestInfo *info)
+{
+    memset(data, 0, sizeof(PermitData));
+    ingestCopyField(data->permitNumber, sizeof(data->permitNumber), obj["permitNumber"] | "", FIELD_PERMIT_NUMBER, info);
+    ingestCopyField(data->plateNumber, sizeof(data->plateNumber), obj["plateNumber"] | "", FIELD_PLATE_NUMBER, info);
+    ingestCopyField(data->validFrom, sizeof(data->validFrom), obj["validFrom"] | "", FIELD_VALID_FROM, info);
+    ingestCopyField(data->validTo, sizeof(data->validTo), obj["validTo"] | "", FIELD_VALID_TO, info);
+    ingestCopyField(data->barcodeValue, sizeof(data->barcodeValue), obj["barcodeValue"] | "", FIELD_BARCODE_VALUE, info);
+    ingestCopyField(data->barcodeLabel, sizeof(data->barcodeLabel), obj["barcodeLabel"] | "", FIELD_BARCODE_LABEL, info);
+    return info->missingFields == 0;
+}
+
+// Fill queue from the optional "queue" array of a permit payload.
+// Entries without a parseable validFrom are dropped; result is sorted by start.
+static inline void permitQueueFromJson(PermitQueue *queue, JsonVariant arr, bool flipped)
+{
+    queue->count = 0;
+    for (JsonVariant item : arr.as<JsonArray>())
+    {
+        if (queue->count >= PERMIT_QUEUE_MAX)
+        {
+            break;
+        }
+        PermitData *p = &queue->entries[queue->count];
+        PermitIngestInfo itemInfo = {};
+        time_t start;
+        if (permitFromJson(p, item, &itemInfo) && parsePermitTime(p->validFrom, &start))
+        {
+            p->displayFlipped = flipped;
+            queue->count++;
+        }
+    }
+
+    // Insertion sort by start time (at most PERMIT_QUEUE_MAX entries)
+    for (int i = 1; i < queue->count; i++)
+    {
+        PermitData key = queue->entries[i];
+        time_t keyStart;
+        parsePermitTime(key.validFrom, &keyStart);
+        int j = i - 1;
+        time_t jStart;
+        while (j >= 0 && parsePermitTime(queue->entries[j].validFrom, &jStart) && jStart > keyStart)
+        {
+            queue->entries[j + 1] = queue->entries[j];
+            j--;
+        }
+        queue->entries[j + 1] = key;
+    }
+}
+
+// Entries at the head of the queue that have started by now. The queue is
+// sorted by start, so the last of them is the one to show.
+static inline int permitQueueStarted(const PermitQueue *queue, time_t now)
+{
+    int started = 0;
+    time_t start;
+    while (started < queue->count && parsePermitTime(queue->entries[started].validFrom, &start) && start <= now)
+    {
+        started++;
+    }
+    return started;
+}
+
+// Drop the first n entries
+static inline void permitQueuePop(PermitQueue *queue, int n = 1)
+{
+    n = min(n, (int)queue->count);
+    for (int i = n; i < queue->count; i++)
+    {
+        queue->entries[i - n] = queue->entries[i];
+    }
+    queue->count -= n;
+}
+
+// Drop entries for a permit that is already current
+static inline void permitQueueRemove(PermitQueue *queue, const char *permitNumber)
+{
+    int kept = 0;
+    for (int i = 0; i < queue->count; i++)
+    {
+        if (strcmp(queue->entries[i].permitNumber, permitNumber) != 0)
+        {
+            queue->entries[kept++] = queue->entries[i];
+        }
+    }
+    queue->count = kept;
+}
+
+// Validate a parsed permit document and copy it out (see ingestPermitPayload)
+static inline PermitIngestResult ingestPermitDocument(JsonDocument &doc, const char *currentPermitNumber,
+                                                      PermitData *data, PermitQueue *queue,
+                                                      PermitIngestInfo *info)
+{
+    if (!doc["permitNumber"].is<const char *>())
+    {
+        return INGEST_ERROR_NO_PERMIT;
+    }
+    if (strlen(doc["permitNumber"].as<const char *>()) == 0)
+    {
+        return INGEST_ERROR_EMPTY;
+    }
+
+    if (!permitFromJson(data, doc, info))
+    {
+        return INGEST_ERROR_INCOMPLETE;
+    }
+    data->displayFlipped = doc["displayFlipped"] | false;
+
+    if (doc["now"].is<uint32_t>())
+    {
+        info->clockSeconds = doc["now"].as<uint32_t>();
+    }
+
+    if (queue)
+    {
+        permitQueueFromJson(queue, doc["queue"], data->displayFlipped);
+        permitQueueRemove(queue, data->permitNumber);
+    }
+
+    if (currentPermitNumber != nullptr && strcmp(data->permitNumber, currentPermitNumber) == 0)
+    {
+        return INGEST_UNCHANGED;
+    }
+    return INGEST_UPDATED;
+}
+
+// Parse and validate a permit payload.
+// data is filled for INGEST_UPDATED and INGEST_UNCHANGED; queue (optional)
+// receives upcoming permits, minus the one in data.
+static inline PermitIngestResult ingestPermitPayload(const char *json, size_t len,
+                                                     const char *currentPermitNumber,
+                                                     PermitData *data, PermitQueue *queue,
+                                                     PermitIngestInfo *info)
+{
+    memset(info, 0, sizeof(PermitIngestInfo));
+
+    permitJsonArena.reset();
+    JsonDocument doc(&permitJsonArena);
+    DeserializationError error = deserializeJson(doc, json, len);
+    if (error)
+    {
+        info->parseError = error.c_str();
+        return INGEST_ERROR_PARSE;
+    }
+    return ingestPermitDocument(doc, currentPermitNumber, data, queue, info);
+}
+
+// Running totals for ingest calls, reported after each sync
+struct PermitIngestStats
+{
+    uint32_t calls;
+    uint32_t results[INGEST_RESULT_COUNT];
+    uint32_t bytes;
+    uint32_t totalUs;
+    uint32_t maxUs;
+};
+
+static PermitIngestStats permitIngestStats;
+
+static inline void permitIngestRecord(PermitIngestResult result, size_t len, uint32_t us)
+{
+    permitIngestStats.calls++;
+    permitIngestStats.results[result]++;
+    permitIngestStats.bytes += len;
+    permitIngestStats.totalUs += us;
+    if (us > permitIngestStats.maxUs)
+    {
+        permitIngestStats.maxUs = us;
+    }
+}
+
+#endif
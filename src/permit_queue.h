@@ -0,0 +1,147 @@
+#ifndef PERMIT_QUEUE_H
+#define PERMIT_QUEUE_H
+
+#include <Arduino.h>
+#include <sys/time.h>
+#include <time.h>
+#include "permit_store.h"
+#include "permit_ingest.h"
+
+// Upcoming permits sent ahead of time by the phone. The display switches
+// to the head of the queue on its own once its validFrom time is reached.
+//
+// Times are local wall-clock: validFrom strings are parsed as-is and the
+// phone's "now" field is local time expressed as seconds since 1970, so no
+// timezone handling is needed on the device.
+
+// Stored like the permit record (permit_store.h): a CRC-checked record
+// written to two alternating slots, highest valid sequence wins, so a
+// power cut mid-write keeps the previous queue.
+#define PERMIT_QUEUE_SLOT_A "queA"
+#define PERMIT_QUEUE_SLOT_B "queB"
+#define PERMIT_QUEUE_MAGIC 0x5051  // "PQ"
+#define PERMIT_QUEUE_VERSION 1
+
+// Anything before this means the clock was never set from the phone
+#define PERMIT_CLOCK_VALID_AFTER 1577836800  // 2020-01-01
+
+struct PermitQueueRecord
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t count;
+    uint32_t sequence;  // Incremented on every write; highest valid wins
+    PermitData entries[PERMIT_QUEUE_MAX];
+    uint32_t crc;       // CRC-32 of all bytes before this field
+};
+
+static PermitQueueRecord permitQueueLast;
+static bool permitQueueHaveLast = false;
+
+static inline bool permitClockValid()
+{
+    return time(nullptr) > PERMIT_CLOCK_VALID_AFTER;
+}
+
+// Set the local clock from the phone's "now" field
+static inline void permitSetClock(uint32_t localSeconds)
+{
+    if (localSeconds <= PERMIT_CLOCK_VALID_AFTER)
+    {
+        return;
+    }
+    struct timeval tv = {(time_t)localSeconds, 0};
+    settimeofday(&tv, nullptr);
+}
+
+static inline void permitQueueBuildRecord(PermitQueueRecord *rec, const PermitQueue *queue, uint32_t sequence)
+{
+    memset(rec, 0, sizeof(PermitQueueRecord));
+    rec->magic = PERMIT_QUEUE_MAGIC;
+    rec->version = PERMIT_QUEUE_VERSION;
+    rec->count = queue->count;
+    rec->sequence = sequence;
+    for (int i = 0; i < queue->count; i++)
+    {
+        permitNormalize(&rec->entries[i], &queue->entries[i]);
+    }
+    rec->crc = crc32(rec, offsetof(PermitQueueRecord, crc));
+}
+
+static inline bool permitQueueReadSlot(const char *key, PermitQueueRecord *rec)
+{
+    if (permitPrefs.getBytesLength(key) != sizeof(PermitQueueRecord))
+    {
+        return false;
+    }
+    permitPrefs.getBytes(key, rec, sizeof(PermitQueueRecord));
+    return rec->magic == PERMIT_QUEUE_MAGIC && rec->version == PERMIT_QUEUE_VERSION &&
+           rec->count <= PERMIT_QUEUE_MAX && rec->crc == crc32(rec, offsetof(PermitQueueRecord, crc));
+}
+
+// Load queued permits from flash
+bool loadPermitQueue(PermitQueue *queue)
+{
+    queue->count = 0;
+
+    PermitQueueRecord a, b;
+    permitPrefs.begin(PERMIT_NVS_NAMESPACE, true);
+    bool haveA = permitQueueReadSlot(PERMIT_QUEUE_SLOT_A, &a);
+    bool haveB = permitQueueReadSlot(PERMIT_QUEUE_SLOT_B, &b);
+    permitPrefs.end();
+
+    if (!haveA && !haveB)
+    {
+        return false;
+    }
+
+    // Newest by sequence (wrap-safe)
+    const PermitQueueRecord *rec = !haveB ? &a : !haveA ? &b
+                                 : ((int32_t)(a.sequence - b.sequence) > 0 ? &a : &b);
+    permitQueueLast = *rec;
+    permitQueueHaveLast = true;
+    queue->count = rec->count;
+    memcpy(queue->entries, rec->entries, sizeof(queue->entries));
+    LOG_I("Loaded %d queued permit(s) from flash (record #%lu)", queue->count, (unsigned long)rec->sequence);
+    return true;
+}
+
+// Save queued permits to flash (no-op if unchanged)
+bool savePermitQueue(const PermitQueue *queue)
+{
+    PermitQueueRecord rec;
+    permitQueueBuildRecord(&rec, queue, permitQueueHaveLast ? permitQueueLast.sequence + 1 : 1);
+
+    if (permitQueueHaveLast && rec.count == permitQueueLast.count &&
+        memcmp(rec.entries, permitQueueLast.entries, sizeof(rec.entries)) == 0)
+    {
+        return true;
+    }
+    // An empty queue that was never stored needs no write either
+    if (!permitQueueHaveLast && queue->count == 0)
+    {
+        return true;
+    }
+
+    // To the slot not holding the newest record
+    const char *slot = (rec.sequence & 1) ? PERMIT_QUEUE_SLOT_A : PERMIT_QUEUE_SLOT_B;
+    permitPrefs.begin(PERMIT_NVS_NAMESPACE, false);
+    bool ok = permitPrefs.putBytes(slot, &rec, sizeof(rec)) == sizeof(rec);
+    permitPrefs.end();
+
+    if (ok)
+    {
+        permitQueueLast = rec;
+        permitQueueHaveLast = true;
+        permitStoreStats.writes++;
+        permitStoreStats.bytesWritten += sizeof(rec);
+        LOG_I("Permit queue saved (%d upcoming, record #%lu)", queue->count, (unsigned long)rec.sequence);
+    }
+    else
+    {
+        LOG_E("Permit queue write failed");
+    }
+    return ok;
+}
+
+#endif
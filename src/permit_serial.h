@@ -0,0 +1,118 @@
+#ifndef PERMIT_SERIAL_H
+#define PERMIT_SERIAL_H
+
+#include <Arduino.h>
+#include "permit_source.h"
+#include "log_helper.h"
+
+// Permit pushed from a host over USB serial while a sync is running. The
+// host writes a header line and then exactly that many payload bytes (the
+// permit JSON as the phone would send it, trailer optional):
+//
+//   PERMIT <length>\n<payload>
+//
+// USB needs the device in hand, so unsigned payloads are accepted even when
+// paired. The source is passive: it listens for as long as the sync lasts
+// and never keeps it going by itself.
+
+#define SERIAL_PERMIT_MAX 2048
+#define SERIAL_PERMIT_HEADER "PERMIT "
+#define SERIAL_PERMIT_BODY_TIMEOUT_MS 2000  // Between header and the last payload byte
+
+class SerialPermitSource : public PermitSource
+{
+public:
+    const char *name()
+    {
+        return "serial";
+    }
+
+    bool passive()
+    {
+        return true;
+    }
+
+    uint32_t stackSize()
+    {
+        return 4096;
+    }
+
+    int fetch(const PermitRequest &request, PermitFetch *out)
+    {
+        static uint8_t payload[SERIAL_PERMIT_MAX];
+        out->hasQueue = true;
+
+        size_t len = 0;
+        while (!cancelled && !readHeader(&len))
+        {
+            delay(10);
+        }
+        if (cancelled)
+        {
+            out->failure = SYNC_FAIL_CANCELLED;
+            return 0;
+        }
+        if (len == 0 || len > sizeof(payload))
+        {
+            LOG_W("Serial permit: bad length %u (max %d)", (unsigned)len, SERIAL_PERMIT_MAX);
+            out->failure = SYNC_FAIL_BAD_DATA;
+            return 0;
+        }
+
+        size_t got = 0;
+        unsigned long start = millis();
+        while (got < len && millis() - start < SERIAL_PERMIT_BODY_TIMEOUT_MS && !cancelled)
+        {
+            int n = Serial.available();
+            if (n > 0)
+            {
+                got += Serial.readBytes(payload + got, min((size_t)n, len - got));
+            }
+            else
+            {
+                delay(2);
+            }
+        }
+        if (got < len)
+        {
+            LOG_W("Serial permit: %u of %u bytes arrived", (unsigned)got, (unsigned)len);
+            out->failure = cancelled ? SYNC_FAIL_CANCELLED : SYNC_FAIL_PARSE;
+            return 0;
+        }
+        return acceptPermitPayload(payload, len, true, request.current->permitNumber,
+                                   &out->data, &out->queue, &out->failure);
+    }
+
+private:
+    char line[24];
+    size_t lineLen = 0;
+
+    // Collect a line from what has arrived so far; true once a valid header is in
+    bool readHeader(size_t *len)
+    {
+        while (Serial.available() > 0)
+        {
+            int c = Serial.read();
+            if (c != '\n')
+            {
+                if (c != '\r' && lineLen < sizeof(line) - 1)
+                {
+                    line[lineLen++] = (char)c;
+                }
+                continue;
+            }
+            line[lineLen] = '\0';
+            lineLen = 0;
+            if (strncmp(line, SERIAL_PERMIT_HEADER, strlen(SERIAL_PERMIT_HEADER)) == 0)
+            {
+                *len = strtoul(line + strlen(SERIAL_PERMIT_HEADER), nullptr, 10);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static SerialPermitSource serialPermitSource;
+
+#endif
@@ -0,0 +1,447 @@
+#ifndef PERMIT_SOURCE_H
+#define PERMIT_SOURCE_H
+
+#include <Arduino.h>
+#include "permit_data.h"
+#include "permit_ingest.h"
+#include "permit_auth.h"
+#include "permit_queue.h"
+#include "sync_policy.h"
+#include "log_helper.h"
+
+// Where permits come from. The phone over BLE (bluetooth_helper.h), the
+// permit server over WiFi (wifi_helper.h) and a host on USB serial
+// (permit_serial.h) each implement PermitSource, and sync_coordinator.h runs
+// them. Sources only fetch: saving and displaying the permit stays with the
+// caller, so it is the same whichever source delivered.
+//
+// Every payload goes through acceptPermitPayload(), the one place that checks
+// signatures and parses. It takes a lock because it uses the shared JSON
+// arena and the replay counter, so sources in parallel tasks only overlap
+// while they wait on their radios.
+
+// Sync types - written to the phone before reading the permit
+#define SYNC_TYPE_AUTO 1    // Reboot/auto sync - no notification if same permit
+#define SYNC_TYPE_MANUAL 2  // Button press - always show notification
+#define SYNC_TYPE_FORCE 3   // Long press - always show notification
+
+struct PermitRequest
+{
+    const PermitData *current;  // Permit on screen (empty permitNumber if none)
+    uint8_t syncType;
+};
+
+struct PermitFetch
+{
+    int result;           // 0 = error, 1 = updated, 2 = already up to date
+    SyncFailure failure;  // Why it failed (result 0)
+    PermitData data;      // Filled for results 1 and 2
+    PermitQueue queue;
+    bool hasQueue;        // The source sends the upcoming permits (the permit server does not)
+    bool skipped;         // Result 2 known without fetching (the phone's advertised tag)
+    uint32_t elapsedMs;
+};
+
+class PermitSource
+{
+public:
+    virtual ~PermitSource() {}
+    virtual const char *name() = 0;
+    // Blocking; may run in its own task. Returns out->result.
+    virtual int fetch(const PermitRequest &request, PermitFetch *out) = 0;
+    // Ask a running fetch() to give up soon (from another task)
+    virtual void cancel()
+    {
+        cancelled = true;
+    }
+    // Passive sources only wait for someone to push a permit, so they never
+    // keep a sync going on their own
+    virtual bool passive()
+    {
+        return false;
+    }
+    virtual uint32_t stackSize()
+    {
+        return 8192;
+    }
+    void reset()
+    {
+        cancelled = false;
+    }
+
+protected:
+    volatile bool cancelled = false;
+};
+
+static SemaphoreHandle_t permitAcceptLock = nullptr;
+
+// Create the lock; call before sources run in parallel
+void permitSourcesBegin()
+{
+    if (!permitAcceptLock)
+    {
+        permitAcceptLock = xSemaphoreCreateMutex();
+    }
+}
+
+// Log the outcome of one permit ingest
+void logPermitIngest(PermitIngestResult result, const PermitIngestInfo *info, size_t len, uint32_t us)
+{
+    switch (result)
+    {
+    case INGEST_ERROR_PARSE:
+        LOG_W("JSON parse error: %s", info->parseError);
+        break;
+    case INGEST_ERROR_NO_PERMIT:
+        LOG_W("No permit number in response");
+        break;
+    case INGEST_ERROR_EMPTY:
+        LOG_W("Empty permit received (phone may not have synced yet)");
+        break;
+    case INGEST_ERROR_INCOMPLETE:
+        LOG_E("ERROR: Incomplete permit data - missing required fields");
+        for (int i = 0; i < PERMIT_FIELD_COUNT; i++)
+        {
+            LOG_E("  %s: %s", PERMIT_FIELD_NAMES[i],
+                  (info->missingFields & (1 << i)) ? "MISSING" : "OK");
+        }
+        break;
+    default:
+        break;
+    }
+
+    for (int i = 0; i < PERMIT_FIELD_COUNT; i++)
+    {
+        if (info->truncatedFields & (1 << i))
+        {
+            LOG_W("  Warning: %s too long, truncated", PERMIT_FIELD_NAMES[i]);
+        }
+        if (info->nonAsciiFields & (1 << i))
+        {
+            LOG_W("  Warning: %s has non-ASCII characters", PERMIT_FIELD_NAMES[i]);
+        }
+    }
+
+    LOG_STAT("Ingest: %s, %u bytes in %lu us (%lu calls, avg %lu us, max %lu us, JSON arena peak %u)",
+             INGEST_RESULT_NAMES[result], (unsigned)len, (unsigned long)us,
+             (unsigned long)permitIngestStats.calls,
+             (unsigned long)(permitIngestStats.totalUs / permitIngestStats.calls),
+             (unsigned long)permitIngestStats.maxUs, (unsigned)permitJsonArena.peak());
+}
+
+static void permitAcceptTake()
+{
+    if (permitAcceptLock)
+    {
+        xSemaphoreTake(permitAcceptLock, portMAX_DELAY);
+    }
+}
+
+static void permitAcceptGive()
+{
+    if (permitAcceptLock)
+    {
+        xSemaphoreGive(permitAcceptLock);
+    }
+}
+
+static bool permitBlank(const uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (p[i] != ' ' && p[i] != '\t' && p[i] != '\r' && p[i] != '\n')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// True when the bytes are one JSON object closing on the last non-blank
+// byte. A read cut short loses the trailer first, then the end of the
+// JSON, so a payload without a trailer that is not whole was truncated
+// rather than sent unsigned.
+static bool permitJsonWhole(const uint8_t *p, size_t len)
+{
+    int depth = 0;
+    bool inString = false, escaped = false;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t c = p[i];
+        if (inString)
+        {
+            if (escaped)
+            {
+                escaped = false;
+            }
+            else if (c == '\\')
+            {
+                escaped = true;
+            }
+            else if (c == '"')
+            {
+                inString = false;
+            }
+            continue;
+        }
+        if (c == '"')
+        {
+            inString = true;
+        }
+        else if (c == '{' || c == '[')
+        {
+            depth++;
+        }
+        else if ((c == '}' || c == ']') && --depth == 0)
+        {
+            return permitBlank(p + i + 1, len - i - 1);
+        }
+    }
+    return false;
+}
+
+// Whether a payload with this auth result may be used (see acceptPermitPayload).
+// whole: without a trailer, the payload still arrived complete. A
+// truncated read is a parse failure (read again), not an unsigned payload.
+static bool permitAuthAllowed(PermitAuthResult auth, bool trusted, bool whole, uint32_t authUs, size_t len,
+                              SyncFailure *failure)
+{
+    if (auth == AUTH_ERR_MISSING && !whole)
+    {
+        LOG_W("Permit payload cut short: no trailer and incomplete JSON (%u bytes)", (unsigned)len);
+        *failure = SYNC_FAIL_PARSE;
+        return false;
+    }
+    if (trusted && auth == AUTH_ERR_MISSING)
+    {
+        LOG_STAT("Auth: unsigned, trusted transport");
+        return true;
+    }
+    if (auth == AUTH_OK || auth == AUTH_UNPAIRED)
+    {
+        LOG_STAT("Auth: %s in %lu us (counter %lu)", PERMIT_AUTH_RESULT_NAMES[auth],
+                 (unsigned long)authUs, (unsigned long)permitAuth.lastCounter);
+        return true;
+    }
+    LOG_W("Permit payload rejected: %s (%u bytes)", PERMIT_AUTH_RESULT_NAMES[auth], (unsigned)len);
+    *failure = SYNC_FAIL_AUTH;
+    return false;
+}
+
+// Record and log an ingest, and take the sender's clock. Under the accept lock.
+static void permitIngestApply(PermitIngestResult result, const PermitIngestInfo *info, size_t jsonLen,
+                              uint32_t us, const PermitQueue *queue)
+{
+    permitIngestRecord(result, jsonLen, us);
+    logPermitIngest(result, info, jsonLen, us);
+
+    if (result == INGEST_UPDATED || result == INGEST_UNCHANGED)
+    {
+        // Sender's local clock, needed to switch to queued permits on time
+        if (info->clockSeconds)
+        {
+            permitSetClock(info->clockSeconds);
+        }
+        if (queue)
+        {
+            LOG_I("Upcoming permits in queue: %d", queue->count);
+        }
+    }
+}
+
+static int permitIngestOutcome(PermitIngestResult result, const PermitData *data, SyncFailure *failure)
+{
+    switch (result)
+    {
+    case INGEST_UNCHANGED:
+        LOG_I("Permit unchanged");
+        return 2; // Already up to date (but data is still populated)
+    case INGEST_UPDATED:
+        LOG_I("New permit received: %s", data->permitNumber);
+        return 1;
+    case INGEST_ERROR_PARSE:
+        *failure = SYNC_FAIL_PARSE;
+        return 0;
+    default:
+        *failure = SYNC_FAIL_BAD_DATA;
+        return 0;
+    }
+}
+
+// Check and parse a payload from any source.
+// trusted: the transport already authenticated the sender (USB, bench serial),
+// so an unsigned payload is taken even when paired. Signed ones are always checked.
+// Returns 0 = error (*failure set), 1 = updated, 2 = already up to date.
+int acceptPermitPayload(const uint8_t *payload, size_t len, bool trusted, const char *currentPermitNumber,
+                        PermitData *data, PermitQueue *queue, SyncFailure *failure)
+{
+    permitAcceptTake();
+    *failure = SYNC_FAIL_NONE;
+
+    // Check the signature and replay counter before parsing anything
+    size_t jsonLen = len;
+    uint32_t authStart = micros();
+    PermitAuthResult auth = permitAuthVerify(payload, len, &jsonLen);
+    uint32_t authUs = micros() - authStart;
+    if (!permitAuthAllowed(auth, trusted, auth != AUTH_ERR_MISSING || permitJsonWhole(payload, len), authUs,
+                           len, failure))
+    {
+        permitAcceptGive();
+        return 0;
+    }
+
+    LOG_D("Received permit data: %.*s", (int)jsonLen, (const char *)payload);
+
+    // Parse, validate and copy
+    PermitIngestInfo info;
+    uint32_t ingestStart = micros();
+    PermitIngestResult result = ingestPermitPayload((const char *)payload, jsonLen,
+                                                    currentPermitNumber, data, queue, &info);
+    uint32_t ingestUs = micros() - ingestStart;
+    permitIngestApply(result, &info, jsonLen, ingestUs, queue);
+    permitAcceptGive();
+
+    return permitIngestOutcome(result, data, failure);
+}
+
+// Most a streamed body may carry after its JSON: the trailer, and some
+// whitespace before it
+#define PERMIT_STREAM_TAIL_MAX (PERMIT_AUTH_TRAILER_SIZE + 16)
+
+// JSON reader over a socket that feeds the HMAC everything the parser takes
+template <class Source>
+struct PermitStreamReader
+{
+    Source *in;
+    PermitAuthStreamVerify<> *verify;
+    size_t count;
+    size_t max;
+
+    int read()
+    {
+        char c;
+        return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+    }
+
+    size_t readBytes(char *buf, size_t len)
+    {
+        len = min(len, max - count);  // Past max the parser sees the body end: incomplete JSON
+        size_t got = len ? in->readBytes(buf, len) : 0;
+        verify->update((const uint8_t *)buf, got);
+        count += got;
+        return got;
+    }
+};
+
+// What follows the JSON, up to the end of the body (remaining bytes, or
+// until the server closes if unknown). *tooLong if there was more than max.
+template <class Source>
+static size_t permitStreamTail(Source &in, int remaining, uint8_t *buf, size_t max, bool *tooLong)
+{
+    size_t len = 0;
+    unsigned long lastData = millis();
+    *tooLong = remaining > (int)max;
+    while (!*tooLong && (remaining < 0 || len < (size_t)remaining) && millis() - lastData < 2000)
+    {
+        if (in.available())
+        {
+            if (len == max)
+            {
+                *tooLong = true;
+                break;
+            }
+            int n = in.read(buf + len, max - len);
+            if (n > 0)
+            {
+                len += n;
+                lastData = millis();
+            }
+        }
+        else if (!in.connected())
+        {
+            break;
+        }
+        else
+        {
+            delay(2);
+        }
+    }
+    return len;
+}
+
+// acceptPermitPayload() for a body read off a socket (the WiFi download).
+// The JSON is parsed into the JSON arena as it arrives, the HMAC runs over
+// the same bytes, and the trailer after it is checked before any field is
+// used, so the body is never held whole. size is the Content-Length, -1 if
+// the server sent none; bodies over maxLen are refused. The accept lock is
+// held while the body arrives (a few hundred bytes).
+template <class Source>
+int acceptPermitStream(Source &in, int size, size_t maxLen, bool trusted, const char *currentPermitNumber,
+                       PermitData *data, PermitQueue *queue, SyncFailure *failure)
+{
+    if (size > (int)maxLen)
+    {
+        LOG_W("Permit body larger than %u bytes", (unsigned)maxLen);
+        *failure = SYNC_FAIL_BAD_DATA;
+        return 0;
+    }
+    permitAcceptTake();
+    *failure = SYNC_FAIL_NONE;
+
+    PermitAuthStreamVerify<> verify;
+    verify.begin();
+    PermitStreamReader<Source> reader = {&in, &verify, 0, size >= 0 ? (size_t)size : maxLen};
+    PermitIngestInfo info;
+    memset(&info, 0, sizeof(info));
+
+    uint32_t ingestStart = micros();
+    permitJsonArena.reset();
+    JsonDocument doc(&permitJsonArena);
+    DeserializationError error = deserializeJson(doc, reader);
+    uint32_t parseUs = micros() - ingestStart;
+    size_t jsonLen = reader.count;
+
+    PermitIngestResult result = INGEST_ERROR_PARSE;
+    if (error)
+    {
+        verify.abort();
+        info.parseError = error.c_str();
+    }
+    else
+    {
+        uint8_t tail[PERMIT_STREAM_TAIL_MAX];
+        bool tooLong;
+        size_t tailLen = permitStreamTail(in, size >= 0 ? size - (int)jsonLen : -1, tail, sizeof(tail), &tooLong);
+        if (tooLong)
+        {
+            verify.abort();
+            LOG_W("Permit payload rejected: %u bytes after the JSON", (unsigned)tailLen);
+            *failure = SYNC_FAIL_BAD_DATA;
+            permitAcceptGive();
+            return 0;
+        }
+
+        size_t bodyLen = jsonLen + tailLen;
+        size_t extraJson;
+        uint32_t authStart = micros();
+        PermitAuthResult auth = verify.finish(tail, tailLen, &extraJson);
+        uint32_t authUs = micros() - authStart;
+        jsonLen += extraJson;
+        // The JSON parsed, so only the trailer can have been cut off
+        if (!permitAuthAllowed(auth, trusted, permitBlank(tail, tailLen), authUs, bodyLen, failure))
+        {
+            permitAcceptGive();
+            return 0;
+        }
+        result = ingestPermitDocument(doc, currentPermitNumber, data, queue, &info);
+    }
+    uint32_t ingestUs = micros() - ingestStart;
+    LOG_STAT("Streamed parse: %u byte JSON parsed off the socket in %lu us", (unsigned)jsonLen,
+             (unsigned long)parseUs);
+    permitIngestApply(result, &info, jsonLen, ingestUs, queue);
+    permitAcceptGive();
+
+    return permitIngestOutcome(result, data, failure);
+}
+
+#endif
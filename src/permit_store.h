@@ -0,0 +1,318 @@
+#ifndef PERMIT_STORE_H
+#define PERMIT_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "permit_data.h"
+#include "crc32.h"
+#include "log_helper.h"
+
+// Permit persistence: one versioned, CRC-checked binary record written to
+// two alternating NVS slots. A save always goes to the slot that does not
+// hold the newest record, so losing power mid-write leaves the previous
+// record intact. Saves are skipped when the record bytes would not change.
+// Besides the permit it holds the phone's advertised permit version tag
+// (bluetooth_helper.h). The replay counter of the last authenticated
+// payload (permit_auth.h) has its own small key, since it advances on
+// every sync (see savePermitAuthCounter()).
+
+#define PERMIT_NVS_NAMESPACE "permit"
+#define PERMIT_SLOT_A "recA"
+#define PERMIT_SLOT_B "recB"
+#define PERMIT_COUNTER_KEY "authCtr"
+#ifndef PERMIT_COUNTER_SAVE_EVERY
+#define PERMIT_COUNTER_SAVE_EVERY 16  // Applied payloads that changed nothing stored, per counter write
+#endif
+
+#define PERMIT_RECORD_MAGIC 0x5052  // "PR"
+#define PERMIT_RECORD_VERSION 1
+
+struct PermitRecord
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t reserved;
+    uint32_t sequence;     // Incremented on every write; highest valid wins
+    uint32_t advertTag;    // Version tag of the last phone payload applied (0 = none)
+    PermitData data;
+    uint32_t crc;          // CRC-32 of all bytes before this field
+};
+
+struct PermitStoreStats
+{
+    uint32_t writes;         // Records (and counter keys) written to flash
+    uint32_t skippedWrites;  // Saves skipped because nothing changed
+    uint32_t bytesWritten;
+    uint32_t lastLoadUs;
+    uint32_t lastSaveUs;
+};
+
+static Preferences permitPrefs;
+static PermitRecord permitStoreLast;     // Newest record known to be in flash
+static bool permitStoreHaveLast = false;
+static PermitStoreStats permitStoreStats;
+
+// Replay counter of the last accepted payload. Loaded by loadPermitData();
+// the sync path sets it after a verified payload and saves it with
+// savePermitAuthCounter() once the payload is applied.
+static uint32_t permitStoreAuthCounter = 0;
+static uint32_t permitStoreSavedCounter = 0;  // What flash holds
+static uint8_t permitCounterDeferred = 0;     // Applied payloads since it was written
+
+// Version tag the phone advertised for the last payload it served that was
+// applied (0 = none). It is written with every record;
+// savePermitAdvertTag() writes it on its own.
+static uint32_t permitStoreAdvertTag = 0;
+
+static inline uint32_t permitRecordCrc(const PermitRecord *rec)
+{
+    return crc32(rec, offsetof(PermitRecord, crc));
+}
+
+static inline bool permitRecordValid(const PermitRecord *rec)
+{
+    return rec->magic == PERMIT_RECORD_MAGIC &&
+           rec->version == PERMIT_RECORD_VERSION &&
+           rec->crc == permitRecordCrc(rec) &&
+           rec->data.permitNumber[0] != '\0';
+}
+
+// Copy fields into a zeroed struct so padding and bytes after each
+// terminator are deterministic (needed for byte-wise change detection)
+static inline void permitNormalize(PermitData *out, const PermitData *in)
+{
+    memset(out, 0, sizeof(PermitData));
+    strncpy(out->permitNumber, in->permitNumber, sizeof(out->permitNumber) - 1);
+    strncpy(out->plateNumber, in->plateNumber, sizeof(out->plateNumber) - 1);
+    strncpy(out->validFrom, in->validFrom, sizeof(out->validFrom) - 1);
+    strncpy(out->validTo, in->validTo, sizeof(out->validTo) - 1);
+    strncpy(out->barcodeValue, in->barcodeValue, sizeof(out->barcodeValue) - 1);
+    strncpy(out->barcodeLabel, in->barcodeLabel, sizeof(out->barcodeLabel) - 1);
+    out->displayFlipped = in->displayFlipped;
+}
+
+static inline bool permitReadSlot(const char *key, PermitRecord *rec)
+{
+    if (permitPrefs.getBytesLength(key) != sizeof(PermitRecord))
+    {
+        return false;
+    }
+    permitPrefs.getBytes(key, rec, sizeof(PermitRecord));
+    return permitRecordValid(rec);
+}
+
+// Read one of the pre-record key layouts (prefs must be open).
+// Layout from the BLE firmware: barcode/barLabel/flipped.
+// Layout from the WiFi firmware: barcodeVal/barcodeLabel, no flip setting.
+static inline bool permitReadLegacy(PermitData *data)
+{
+    if (!permitPrefs.isKey("permitNum"))
+    {
+        return false;
+    }
+
+    memset(data, 0, sizeof(PermitData));
+    permitPrefs.getString("permitNum", data->permitNumber, sizeof(data->permitNumber));
+    permitPrefs.getString("plateNum", data->plateNumber, sizeof(data->plateNumber));
+    permitPrefs.getString("validFrom", data->validFrom, sizeof(data->validFrom));
+    permitPrefs.getString("validTo", data->validTo, sizeof(data->validTo));
+
+    if (permitPrefs.isKey("barcodeVal"))
+    {
+        permitPrefs.getString("barcodeVal", data->barcodeValue, sizeof(data->barcodeValue));
+        permitPrefs.getString("barcodeLabel", data->barcodeLabel, sizeof(data->barcodeLabel));
+    }
+    else
+    {
+        permitPrefs.getString("barcode", data->barcodeValue, sizeof(data->barcodeValue));
+        permitPrefs.getString("barLabel", data->barcodeLabel, sizeof(data->barcodeLabel));
+    }
+    data->displayFlipped = permitPrefs.getBool("flipped", false);
+
+    return data->permitNumber[0] != '\0';
+}
+
+static inline void permitRemoveLegacy()
+{
+    static const char *LEGACY_KEYS[] = {
+        "permitNum", "plateNum", "validFrom", "validTo",
+        "barcode", "barLabel", "barcodeVal", "barcodeLabel", "flipped"};
+    for (size_t i = 0; i < sizeof(LEGACY_KEYS) / sizeof(LEGACY_KEYS[0]); i++)
+    {
+        if (permitPrefs.isKey(LEGACY_KEYS[i]))
+        {
+            permitPrefs.remove(LEGACY_KEYS[i]);
+        }
+    }
+}
+
+// Write a record to the slot not holding the newest one (prefs must be open rw)
+static inline bool permitWriteRecord(const PermitData *normalized)
+{
+    PermitRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = PERMIT_RECORD_MAGIC;
+    rec.version = PERMIT_RECORD_VERSION;
+    rec.sequence = permitStoreHaveLast ? permitStoreLast.sequence + 1 : 1;
+    rec.advertTag = permitStoreAdvertTag;
+    rec.data = *normalized;
+    rec.crc = permitRecordCrc(&rec);
+
+    const char *slot = (rec.sequence & 1) ? PERMIT_SLOT_A : PERMIT_SLOT_B;
+    if (permitPrefs.putBytes(slot, &rec, sizeof(rec)) != sizeof(rec))
+    {
+        LOG_E("Permit record write failed");
+        return false;
+    }
+
+    permitStoreLast = rec;
+    permitStoreHaveLast = true;
+    permitStoreStats.writes++;
+    permitStoreStats.bytesWritten += sizeof(rec);
+    return true;
+}
+
+// Load permit data from flash
+bool loadPermitData(PermitData *data)
+{
+    uint32_t start = micros();
+    PermitRecord a, b;
+
+    permitPrefs.begin(PERMIT_NVS_NAMESPACE, true);
+    bool haveA = permitReadSlot(PERMIT_SLOT_A, &a);
+    bool haveB = permitReadSlot(PERMIT_SLOT_B, &b);
+    permitStoreAuthCounter = permitStoreSavedCounter = permitPrefs.getUInt(PERMIT_COUNTER_KEY, 0);
+    permitPrefs.end();
+
+    if (haveA || haveB)
+    {
+        // Newest by sequence (wrap-safe)
+        const PermitRecord *rec = !haveB ? &a : !haveA ? &b
+                                 : ((int32_t)(a.sequence - b.sequence) > 0 ? &a : &b);
+        permitStoreLast = *rec;
+        permitStoreHaveLast = true;
+        permitStoreAdvertTag = rec->advertTag;
+        *data = rec->data;
+        permitStoreStats.lastLoadUs = micros() - start;
+
+        LOG_I("Loaded permit from flash: %s (record #%lu, %lu us)",
+              data->permitNumber, (unsigned long)rec->sequence,
+              (unsigned long)permitStoreStats.lastLoadUs);
+        return true;
+    }
+
+    // No record yet - migrate from an older key layout if present
+    permitPrefs.begin(PERMIT_NVS_NAMESPACE, false);
+    PermitData legacy;
+    bool migrated = permitReadLegacy(&legacy);
+    if (migrated && permitWriteRecord(&legacy))
+    {
+        permitRemoveLegacy();
+    }
+    permitPrefs.end();
+
+    if (!migrated)
+    {
+        return false;
+    }
+
+    *data = legacy;
+    permitStoreStats.lastLoadUs = micros() - start;
+    LOG_I("Migrated permit from legacy keys: %s", data->permitNumber);
+    return true;
+}
+
+// Save permit data to flash (no-op if the record would be unchanged)
+bool savePermitData(const PermitData *data)
+{
+    uint32_t start = micros();
+    PermitData normalized;
+    permitNormalize(&normalized, data);
+
+    if (permitStoreHaveLast && memcmp(&normalized, &permitStoreLast.data, sizeof(PermitData)) == 0)
+    {
+        permitStoreStats.skippedWrites++;
+        LOG_I("Permit data unchanged - flash write skipped");
+        return true;
+    }
+
+    permitPrefs.begin(PERMIT_NVS_NAMESPACE, false);
+    bool ok = permitWriteRecord(&normalized);
+    permitPrefs.end();
+    permitStoreStats.lastSaveUs = micros() - start;
+
+    if (ok)
+    {
+        LOG_I("Permit data saved to flash (record #%lu, %u bytes, %lu us, %lu writes total)",
+              (unsigned long)permitStoreLast.sequence, (unsigned)sizeof(PermitRecord),
+              (unsigned long)permitStoreStats.lastSaveUs, (unsigned long)permitStoreStats.writes);
+    }
+    return ok;
+}
+
+// Write the newest record again with the current tag
+static inline bool permitRewriteLast()
+{
+    PermitData data = permitStoreLast.data;
+    permitPrefs.begin(PERMIT_NVS_NAMESPACE, false);
+    bool ok = permitWriteRecord(&data);
+    permitPrefs.end();
+    return ok;
+}
+
+// Save the replay counter. force: the payload changed what is stored
+// (permit or queue), or the counter was reset by pairing, so it is written
+// now; an older payload replayed after a reboot could otherwise undo it.
+// Payloads that changed nothing stored are saved every
+// PERMIT_COUNTER_SAVE_EVERY: after a power cut, at most that many of them
+// could be replayed, and all they would set is the clock as it was when
+// they were sent.
+bool savePermitAuthCounter(bool force = true)
+{
+    if (permitStoreAuthCounter == permitStoreSavedCounter)
+    {
+        permitCounterDeferred = 0;
+        return true;
+    }
+    if (!force && ++permitCounterDeferred < PERMIT_COUNTER_SAVE_EVERY)
+    {
+        return true;
+    }
+
+    permitPrefs.begin(PERMIT_NVS_NAMESPACE, false);
+    bool ok = permitPrefs.putUInt(PERMIT_COUNTER_KEY, permitStoreAuthCounter) == sizeof(uint32_t);
+    permitPrefs.end();
+    if (ok)
+    {
+        permitStoreSavedCounter = permitStoreAuthCounter;
+        permitCounterDeferred = 0;
+        permitStoreStats.writes++;
+        permitStoreStats.bytesWritten += sizeof(uint32_t);
+        LOG_I("Replay counter %lu saved", (unsigned long)permitStoreAuthCounter);
+    }
+    else
+    {
+        LOG_E("Replay counter write failed");
+    }
+    return ok;
+}
+
+// Write the newest record again if only the advertised tag changed (a sync
+// that found the permit unchanged, but the phone's payload was new to us)
+bool savePermitAdvertTag()
+{
+    if (!permitStoreHaveLast || permitStoreLast.advertTag == permitStoreAdvertTag)
+    {
+        return true;
+    }
+
+    bool ok = permitRewriteLast();
+    if (ok)
+    {
+        LOG_I("Advertised permit tag %08lx saved (record #%lu)", (unsigned long)permitStoreAdvertTag,
+              (unsigned long)permitStoreLast.sequence);
+    }
+    return ok;
+}
+
+#endif
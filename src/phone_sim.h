@@ -0,0 +1,643 @@
+#ifndef PHONE_SIM_H
+#define PHONE_SIM_H
+
+#include <Arduino.h>
+#include "bluetooth_helper.h"
+#include "sync_coordinator.h"
+#include "mem_telemetry.h"
+#include "panel_async.h"
+#include "log_helper.h"
+
+// Simulated phone peer (build with -DPHONE_SIM, see env:vision_e290_phonesim).
+//
+// Stands in for the Android app's GATT service behind the PhoneLink seam so
+// the sync path, doSync() and the command handling run without a phone.
+// Latency is accounted on a simulated clock instead of sleeping, so
+// thousands of runs finish in seconds and give a latency distribution.
+
+#ifndef PHONE_SIM_RUNS
+#define PHONE_SIM_RUNS 2000                 // Runs in the boot benchmark
+#endif
+#ifndef PHONE_SIM_SOAK_CYCLES
+#define PHONE_SIM_SOAK_CYCLES 3000          // Sync/server cycles in the boot soak test
+#endif
+#ifndef PHONE_SIM_SOAK_SLACK
+#define PHONE_SIM_SOAK_SLACK 0              // Bytes of heap loss tolerated by the soak test
+#endif
+#define PHONE_SIM_SOAK_WARMUP 20            // Cycles before the baseline (lazy init in the stacks)
+#ifndef PHONE_SIM_SOAK_FORCE_EVERY
+#define PHONE_SIM_SOAK_FORCE_EVERY 100      // Every Nth soak cycle is a forced sync (full refresh, permit write)
+#endif
+#ifndef PHONE_SIM_COMMAND_INTERVAL_MS
+#define PHONE_SIM_COMMAND_INTERVAL_MS 60000 // Simulated "SYNC" writes from the app (0 = off)
+#endif
+
+#ifndef PHONE_SIM_AUTH_RUNS
+#define PHONE_SIM_AUTH_RUNS 1000            // Verifications per payload size in the auth benchmark
+#endif
+
+#ifndef PHONE_SIM_CORPUS_RUNS
+#define PHONE_SIM_CORPUS_RUNS 500           // Ingests per payload in the corpus benchmark
+#endif
+#define PHONE_SIM_CORPUS_QUEUE 60           // Queue entries in the oversized payload (overflows the JSON arena)
+
+#ifndef PHONE_SIM_SYNC_RUNS
+#define PHONE_SIM_SYNC_RUNS 10              // Coordinated syncs per scenario and plan
+#endif
+#ifndef PHONE_SIM_TIME_SCALE
+#define PHONE_SIM_TIME_SCALE 20             // Coordinator runs sleep this many times shorter than real
+#endif
+
+#define PHONE_SIM_BUCKET_MS 100
+#define PHONE_SIM_BUCKETS 400               // 0..40 s, last bucket collects the rest
+
+static const char *PHONE_SIM_PAYLOAD =
+    "{\"permitNumber\":\"T6103268\",\"plateNumber\":\"CSEB187\","
+    "\"validFrom\":\"Sep 05, 2025: 01:08\",\"validTo\":\"Sep 12, 2025: 01:08\","
+    "\"barcodeValue\":\"6103268\",\"barcodeLabel\":\"00435\",\"displayFlipped\":false}";
+
+static const char *PHONE_SIM_MALFORMED[] = {
+    "{\"permitNumber\":\"T6103268\",\"plateNumber\":",   // Truncated read
+    "{\"permitNumber\":\"\"}",                           // App not synced yet
+    "{\"permitNumber\":\"T6103268\",\"plateNumber\":\"CSEB187\"}", // Missing fields
+    "not json at all"};
+
+// Pairing key the simulated app signs with (RAM only, never saved)
+static const uint8_t PHONE_SIM_KEY[PERMIT_AUTH_KEY_SIZE] = {
+    0x3b, 0x91, 0x0e, 0x5c, 0xa2, 0x47, 0xd8, 0x16, 0x6f, 0xc3, 0x29, 0x84, 0xe0, 0x7a, 0x15, 0xbd,
+    0x58, 0x02, 0xf6, 0x9e, 0x33, 0xcb, 0x71, 0x4d, 0xa9, 0x10, 0x8e, 0x65, 0xd4, 0x27, 0xbf, 0x0a};
+
+// Probabilities are in percent; latencies are uniform in [min, max] ms
+struct PhoneSimScript
+{
+    uint32_t scanMinMs, scanMaxMs;       // Until the advertisement is seen
+    uint32_t connectMinMs, connectMaxMs; // Per connection attempt (failed ones too)
+    uint32_t readMinMs, readMaxMs;       // Sync-type write + permit read
+    uint8_t notFoundPct;                 // Phone out of range for the whole scan
+    uint8_t dropPct;                     // A connection attempt fails
+    uint8_t missingServicePct;
+    uint8_t missingSyncTypePct;          // Old app without the sync-type characteristic
+    uint8_t missingPermitCharPct;
+    uint8_t malformedPct;                // Payload replaced by a PHONE_SIM_MALFORMED entry
+    uint8_t tamperedPct;                 // Signed payload altered on the way
+    const char *payload;
+};
+
+static PhoneSimScript phoneSimScript = {
+    300, 2500,
+    150, 900,
+    40, 250,
+    10, 15, 2, 5, 1, 3, 1,
+    PHONE_SIM_PAYLOAD};
+
+class SimulatedPhoneLink : public PhoneLink
+{
+public:
+    uint32_t clockMs = 0;  // Simulated time spent in link operations
+
+    bool scan(uint32_t seconds)
+    {
+        if (chance(phoneSimScript.notFoundPct))
+        {
+            clockMs += seconds * 1000;
+            found = false;
+            return false;
+        }
+        clockMs += between(phoneSimScript.scanMinMs, phoneSimScript.scanMaxMs);
+        found = true;
+        return true;
+    }
+
+    PhoneLinkStatus connect()
+    {
+        if (!found)
+        {
+            return LINK_NOT_FOUND;
+        }
+
+        clockMs += between(phoneSimScript.connectMinMs, phoneSimScript.connectMaxMs);
+        if (chance(phoneSimScript.dropPct))
+        {
+            return LINK_CONNECT_FAILED;
+        }
+        if (chance(phoneSimScript.missingServicePct))
+        {
+            return LINK_NO_SERVICE;
+        }
+        return LINK_OK;
+    }
+
+    bool writeSyncType(uint8_t syncType)
+    {
+        lastSyncType = syncType;
+        return !chance(phoneSimScript.missingSyncTypePct);
+    }
+
+    PhoneLinkStatus readPermit(std::string *out)
+    {
+        clockMs += between(phoneSimScript.readMinMs, phoneSimScript.readMaxMs);
+        if (chance(phoneSimScript.missingPermitCharPct))
+        {
+            return LINK_NO_PERMIT_CHAR;
+        }
+        if (chance(phoneSimScript.malformedPct))
+        {
+            *out = PHONE_SIM_MALFORMED[random(sizeof(PHONE_SIM_MALFORMED) / sizeof(PHONE_SIM_MALFORMED[0]))];
+        }
+        else
+        {
+            *out = phoneSimScript.payload;
+        }
+
+        // Signed the way the app does it once paired
+        std::string json = *out;
+        out->resize(json.length() + PERMIT_AUTH_TRAILER_SIZE);
+        permitAuthSign(PHONE_SIM_KEY, json.data(), json.length(), ++counter, (uint8_t *)&(*out)[0]);
+        if (chance(phoneSimScript.tamperedPct))
+        {
+            (*out)[random(json.length())] ^= 0x20;
+        }
+        return LINK_OK;
+    }
+
+    void disconnect() {}
+
+    void release()
+    {
+        found = false;
+    }
+
+    const char *peerName()
+    {
+        return "simulated phone";
+    }
+
+    // The app tags what it serves; the simulator uses the payload's CRC
+    bool advertisedTag(uint32_t *tag)
+    {
+        *tag = crc32(phoneSimScript.payload, strlen(phoneSimScript.payload));
+        return found;
+    }
+
+    void wait(uint32_t ms)
+    {
+        clockMs += ms;
+    }
+
+    uint32_t now()
+    {
+        return clockMs;
+    }
+
+    uint8_t lastSyncType = 0;
+
+private:
+    bool found = false;
+    uint32_t counter = 0;  // App's payload counter
+
+    static bool chance(uint8_t pct)
+    {
+        return pct > 0 && random(100) < pct;
+    }
+
+    static uint32_t between(uint32_t lo, uint32_t hi)
+    {
+        return hi > lo ? lo + random(hi - lo + 1) : lo;
+    }
+};
+
+static SimulatedPhoneLink simPhoneLink;
+
+// Route all phone traffic through the simulator
+void phoneSimInstall()
+{
+    setPhoneLink(&simPhoneLink);
+    memcpy(permitAuth.key, PHONE_SIM_KEY, PERMIT_AUTH_KEY_SIZE);
+    permitAuth.paired = true;
+    LOG_W("Phone simulator active - no real phone will be contacted");
+}
+
+static uint32_t phoneSimPercentile(const uint16_t *hist, uint32_t total, float pct)
+{
+    uint32_t target = (uint32_t)(total * pct);
+    uint32_t seen = 0;
+    for (int i = 0; i < PHONE_SIM_BUCKETS; i++)
+    {
+        seen += hist[i];
+        if (seen > target)
+        {
+            return (i + 1) * PHONE_SIM_BUCKET_MS;
+        }
+    }
+    return PHONE_SIM_BUCKETS * PHONE_SIM_BUCKET_MS;
+}
+
+// Run scan + fetch (with retries) many times and report outcome counts and
+// the simulated sync-latency distribution
+void phoneSimBenchmark(int runs)
+{
+    static uint16_t hist[PHONE_SIM_BUCKETS];
+    uint32_t outcomes[3] = {0, 0, 0};
+    uint32_t notFound = 0;
+    uint32_t maxMs = 0;
+    uint64_t sumMs = 0;
+    memset(hist, 0, sizeof(hist));
+    memset(syncFailureCounts, 0, sizeof(syncFailureCounts));
+
+    LOG_STAT("\n=== Phone simulator: %d sync runs ===", runs);
+    unsigned long wallStart = millis();
+
+    for (int i = 0; i < runs; i++)
+    {
+        PermitData permit;
+        PermitQueue queue;
+        simPhoneLink.clockMs = 0;
+
+        int result = 0;
+        if (phoneLink->scan(BLE_SCAN_TIME))
+        {
+            result = fetchPermitWithRetries(&permit, "", SYNC_TYPE_AUTO, &queue);
+        }
+        else
+        {
+            notFound++;
+        }
+        phoneLink->release();
+
+        outcomes[result]++;
+        uint32_t ms = simPhoneLink.clockMs;
+        sumMs += ms;
+        maxMs = max(maxMs, ms);
+        hist[min((uint32_t)(PHONE_SIM_BUCKETS - 1), ms / PHONE_SIM_BUCKET_MS)]++;
+    }
+
+    LOG_STAT("Runs: %d in %lu ms wall time", runs, millis() - wallStart);
+    LOG_STAT("  updated %lu, unchanged %lu, failed %lu (not found %lu)",
+             (unsigned long)outcomes[1], (unsigned long)outcomes[2],
+             (unsigned long)outcomes[0], (unsigned long)notFound);
+    LOG_STAT("  latency ms: mean %lu, p50 %lu, p90 %lu, p99 %lu, max %lu",
+             (unsigned long)(sumMs / runs),
+             (unsigned long)phoneSimPercentile(hist, runs, 0.50f),
+             (unsigned long)phoneSimPercentile(hist, runs, 0.90f),
+             (unsigned long)phoneSimPercentile(hist, runs, 0.99f),
+             (unsigned long)maxMs);
+    char line[LOG_LINE_MAX];
+    int len = 0;
+    for (int i = 1; i < SYNC_FAIL_CLASS_COUNT && len < (int)sizeof(line); i++)
+    {
+        len += snprintf(line + len, sizeof(line) - len, " %s %lu;",
+                        SYNC_FAILURE_NAMES[i], (unsigned long)syncFailureCounts[i]);
+    }
+    line[min(len, (int)sizeof(line) - 1)] = '\0';
+    LOG_STAT("  failed attempts by class:%s", line);
+}
+
+// Run the real doSync() (passed in by main: background scan and server
+// stop/start, the coordinator's source tasks, status band and flash writes)
+// against the simulated phone, with a forced sync every
+// PHONE_SIM_SOAK_FORCE_EVERY cycles for the full refresh and permit write.
+// Fails if free heap or the largest free block shrinks between the
+// warmed-up baseline and the end. What the soak stores is kept: on this
+// build the simulator is the phone.
+bool phoneSimSoak(int cycles, EnergyOp (*doSync)(bool forceUpdate, bool silent))
+{
+    MemSample base, now;
+    int outcomes[ENERGY_OP_COUNT] = {};
+    LOG_STAT("\n=== Phone simulator: %d cycle soak ===", cycles);
+
+    for (int i = 0; i < PHONE_SIM_SOAK_WARMUP + cycles; i++)
+    {
+        if (i == PHONE_SIM_SOAK_WARMUP)
+        {
+            panelWaitIdle();
+            memSample(&base);
+        }
+
+        bool force = i % PHONE_SIM_SOAK_FORCE_EVERY == 0;
+        outcomes[doSync(force, !force)]++;
+
+        if (i > PHONE_SIM_SOAK_WARMUP && (i - PHONE_SIM_SOAK_WARMUP) % 500 == 0)
+        {
+            memSample(&now);
+            LOG_STAT("Soak %d/%d: heap %ld, largest block %ld vs baseline",
+                     i - PHONE_SIM_SOAK_WARMUP, cycles,
+                     (long)now.freeHeap - (long)base.freeHeap,
+                     (long)now.largestBlock - (long)base.largestBlock);
+        }
+    }
+    panelWaitIdle();
+    LOG_STAT("Soak syncs: %d updated, %d unchanged, %d skipped, %d failed",
+             outcomes[ENERGY_OP_SYNC_UPDATED], outcomes[ENERGY_OP_SYNC_UNCHANGED],
+             outcomes[ENERGY_OP_SYNC_SKIPPED], outcomes[ENERGY_OP_SYNC_FAILED]);
+    memSample(&now);
+    bool ok = now.freeHeap + PHONE_SIM_SOAK_SLACK >= base.freeHeap &&
+              now.largestBlock + PHONE_SIM_SOAK_SLACK >= base.largestBlock;
+    LOG_STAT("Soak %s: heap %lu -> %lu, largest block %lu -> %lu",
+             ok ? "PASSED" : "FAILED",
+             (unsigned long)base.freeHeap, (unsigned long)now.freeHeap,
+             (unsigned long)base.largestBlock, (unsigned long)now.largestBlock);
+    memPrintReport("after soak");
+    return ok;
+}
+
+// Periodically act like the app writing "SYNC" to the command characteristic
+void phoneSimTick()
+{
+#if PHONE_SIM_COMMAND_INTERVAL_MS > 0
+    static unsigned long last = 0;
+    if (millis() - last >= PHONE_SIM_COMMAND_INTERVAL_MS)
+    {
+        last = millis();
+        LOG_I("Simulated phone: writing SYNC command");
+        pendingCommand = 1;
+    }
+#endif
+}
+
+// Time payload verification on the mbedTLS (SHA accelerator) path against
+// the software SHA-256, next to parsing the same payload, to show what
+// authentication adds to a sync
+void phoneSimAuthBenchmark(int runs)
+{
+    static uint8_t signedPayload[1024 + PERMIT_AUTH_TRAILER_SIZE];
+    static char filler[1024];
+    const size_t simLen = strlen(PHONE_SIM_PAYLOAD);
+    const size_t sizes[] = {simLen, sizeof(filler)};
+    memset(filler, 'x', sizeof(filler));
+    memcpy(filler, PHONE_SIM_PAYLOAD, simLen);
+
+    LOG_STAT("\n=== Payload auth: %d verifications per size ===", runs);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        size_t len = sizes[s];
+        permitAuthSign(PHONE_SIM_KEY, filler, len, 1, signedPayload);
+
+        uint32_t totalUs[2] = {0, 0}, maxUs[2] = {0, 0};
+        bool ok = true;
+        for (int i = 0; i < runs; i++)
+        {
+            for (int sw = 0; sw < 2; sw++)
+            {
+                size_t jsonLen;
+                permitAuth.lastCounter = 0;
+                uint32_t start = micros();
+                PermitAuthResult result = sw
+                    ? permitAuthVerify<PermitAuthShaSw>(signedPayload, len + PERMIT_AUTH_TRAILER_SIZE, &jsonLen)
+                    : permitAuthVerify<PermitAuthShaHw>(signedPayload, len + PERMIT_AUTH_TRAILER_SIZE, &jsonLen);
+                uint32_t us = micros() - start;
+                ok = ok && result == AUTH_OK;
+                totalUs[sw] += us;
+                maxUs[sw] = max(maxUs[sw], us);
+            }
+        }
+        LOG_STAT("%u bytes: mbedTLS/SHA accelerator mean %lu us (max %lu), software mean %lu us (max %lu)%s",
+                 (unsigned)len, (unsigned long)(totalUs[0] / runs), (unsigned long)maxUs[0],
+                 (unsigned long)(totalUs[1] / runs), (unsigned long)maxUs[1],
+                 ok ? "" : " - VERIFY FAILED");
+    }
+    permitAuth.lastCounter = 0;
+
+    PermitData permit;
+    PermitIngestInfo info;
+    uint32_t start = micros();
+    for (int i = 0; i < runs; i++)
+    {
+        ingestPermitPayload(PHONE_SIM_PAYLOAD, simLen, "", &permit, nullptr, &info);
+    }
+    LOG_STAT("For comparison, parsing the %u byte payload: mean %lu us",
+             (unsigned)simLen, (unsigned long)((micros() - start) / runs));
+}
+
+// Payload corpus for ingestPermitPayload(): what the app sends, and what a
+// broken or newer app, or a bad read, could send instead
+struct PhoneSimCorpusCase
+{
+    const char *name;
+    const char *json;
+    PermitIngestResult expect;
+};
+
+static const PhoneSimCorpusCase PHONE_SIM_CORPUS[] = {
+    {"valid", nullptr, INGEST_UPDATED},  // PHONE_SIM_PAYLOAD
+    {"valid + queue",
+     "{\"permitNumber\":\"T6103268\",\"plateNumber\":\"CSEB187\",\"validFrom\":\"Sep 05, 2025: 01:08\","
+     "\"validTo\":\"Sep 12, 2025: 01:08\",\"barcodeValue\":\"6103268\",\"barcodeLabel\":\"00435\",\"now\":1757000000,"
+     "\"queue\":[{\"permitNumber\":\"T6103269\",\"plateNumber\":\"CSEB187\",\"validFrom\":\"Sep 12, 2025: 01:08\","
+     "\"validTo\":\"Sep 19, 2025: 01:08\",\"barcodeValue\":\"6103269\",\"barcodeLabel\":\"00436\"}]}",
+     INGEST_UPDATED},
+    {"oversized fields",
+     "{\"permitNumber\":\"T610326800000000000000000000\",\"plateNumber\":\"CSEB187CSEB187CSEB187CSEB187\","
+     "\"validFrom\":\"Sep 05, 2025: 01:08 Eastern Daylight Time\",\"validTo\":\"Sep 12, 2025: 01:08\","
+     "\"barcodeValue\":\"61032686103268610326861032686103268\",\"barcodeLabel\":\"00435\"}",
+     INGEST_UPDATED},  // Cut to the PermitData buffers, flagged as truncated
+    {"oversized queue", nullptr, INGEST_ERROR_PARSE},  // Built at run time; overflows the JSON arena
+    {"missing field",
+     "{\"permitNumber\":\"T6103268\",\"plateNumber\":\"CSEB187\",\"validFrom\":\"Sep 05, 2025: 01:08\","
+     "\"barcodeValue\":\"6103268\",\"barcodeLabel\":\"00435\"}",
+     INGEST_ERROR_INCOMPLETE},
+    {"unknown keys",
+     "{\"version\":7,\"permitNumber\":\"T6103268\",\"plateNumber\":\"CSEB187\",\"validFrom\":\"Sep 05, 2025: 01:08\","
+     "\"validTo\":\"Sep 12, 2025: 01:08\",\"barcodeValue\":\"6103268\",\"barcodeLabel\":\"00435\","
+     "\"zone\":{\"id\":42,\"streets\":[\"Queen St W\",\"King St W\"]},\"price\":61.88,\"renew\":true}",
+     INGEST_UPDATED},
+    {"non-ASCII",
+     "{\"permitNumber\":\"T6103268\",\"plateNumber\":\"CS\xc3\x89" "B187\",\"validFrom\":\"Sep 05, 2025: 01:08\","
+     "\"validTo\":\"Sep 12, 2025: 01:08\",\"barcodeValue\":\"6103268\",\"barcodeLabel\":\"\\u00e9\\u00e8\"}",
+     INGEST_UPDATED},  // Raw UTF-8 and escaped code points both end up flagged
+    {"truncated read", "{\"permitNumber\":\"T6103268\",\"plateNumber\":", INGEST_ERROR_PARSE},
+    {"empty permit", "{\"permitNumber\":\"\"}", INGEST_ERROR_EMPTY},
+    {"no permit number", "{\"plateNumber\":\"CSEB187\"}", INGEST_ERROR_NO_PERMIT},
+    {"not JSON", "not json at all", INGEST_ERROR_PARSE},
+};
+#define PHONE_SIM_CORPUS_COUNT (sizeof(PHONE_SIM_CORPUS) / sizeof(PHONE_SIM_CORPUS[0]))
+
+// Ingest every corpus payload runs times: outcome against the expected
+// one, time and throughput, JSON arena high-water mark and field flags.
+// Returns false if any payload ends differently than expected.
+bool phoneSimCorpusBenchmark(int runs)
+{
+    // Oversized queue: many more entries than PERMIT_QUEUE_MAX
+    static char oversized[PHONE_SIM_CORPUS_QUEUE * 200 + 256];
+    size_t n = snprintf(oversized, sizeof(oversized), "%.*s,\"queue\":[",
+                        (int)strlen(PHONE_SIM_PAYLOAD) - 1, PHONE_SIM_PAYLOAD);
+    for (int i = 0; i < PHONE_SIM_CORPUS_QUEUE; i++)
+    {
+        n += snprintf(oversized + n, sizeof(oversized) - n,
+                      "%s{\"permitNumber\":\"T61%05d\",\"plateNumber\":\"CSEB187\","
+                      "\"validFrom\":\"Oct %02d, 2025: 01:08\",\"validTo\":\"Nov %02d, 2025: 01:08\","
+                      "\"barcodeValue\":\"61%05d\",\"barcodeLabel\":\"%05d\"}",
+                      i ? "," : "", i, 1 + i % 28, 1 + i % 28, i, i);
+    }
+    snprintf(oversized + n, sizeof(oversized) - n, "]}");
+
+    LOG_STAT("\n=== Ingest corpus: %d runs per payload, JSON arena %u bytes ===", runs,
+             (unsigned)PERMIT_JSON_ARENA_SIZE);
+    static PermitQueue queue;
+    PermitData permit;
+    PermitIngestInfo info;
+    bool ok = true;
+    for (size_t c = 0; c < PHONE_SIM_CORPUS_COUNT; c++)
+    {
+        const PhoneSimCorpusCase &tc = PHONE_SIM_CORPUS[c];
+        const char *json = tc.json ? tc.json : (c == 0 ? PHONE_SIM_PAYLOAD : oversized);
+        size_t len = strlen(json);
+
+        PermitIngestResult result = INGEST_RESULT_COUNT;
+        uint32_t totalUs = 0, maxUs = 0;
+        int wrong = 0;
+        permitJsonArena.reset();
+        permitJsonArena.resetPeak();
+        for (int i = 0; i < runs; i++)
+        {
+            uint32_t start = micros();
+            result = ingestPermitPayload(json, len, "T0000000", &permit, &queue, &info);
+            uint32_t us = micros() - start;
+            totalUs += us;
+            maxUs = max(maxUs, us);
+            wrong += result == tc.expect ? 0 : 1;
+        }
+        ok &= wrong == 0;
+
+        float mbPerS = totalUs ? (float)len * runs / totalUs : 0;  // Bytes per us = MB/s
+        LOG_STAT("  %-16s %5u B  %-16s %s  mean %lu us (max %lu), %.2f MB/s, arena peak %u",
+                 tc.name, (unsigned)len, INGEST_RESULT_NAMES[result], wrong ? "FAIL" : "ok  ",
+                 (unsigned long)(totalUs / runs), (unsigned long)maxUs, mbPerS,
+                 (unsigned)permitJsonArena.peak());
+        if (result == INGEST_ERROR_PARSE)
+        {
+            LOG_STAT("    %s", info.parseError);
+        }
+        else if (info.missingFields | info.truncatedFields | info.nonAsciiFields)
+        {
+            LOG_STAT("    fields missing 0x%02x, truncated 0x%02x, non-ASCII 0x%02x, queue %u",
+                     info.missingFields, info.truncatedFields, info.nonAsciiFields, (unsigned)queue.count);
+        }
+    }
+    LOG_STAT("Ingest corpus %s", ok ? "passed" : "FAILED");
+    return ok;
+}
+
+// Scripted source for the coordinator benchmark. Unlike SimulatedPhoneLink
+// it really sleeps (scaled down by PHONE_SIM_TIME_SCALE), because the
+// coordinator races real tasks against each other.
+struct SimSourceScript
+{
+    uint8_t upPct;          // Reachable (phone in range, WiFi up)
+    uint32_t minMs, maxMs;  // Time to a permit when reachable
+    uint32_t downMs;        // Time to give up when not
+};
+
+class SimPermitSource : public PermitSource
+{
+public:
+    explicit SimPermitSource(const char *label) : label(label) {}
+
+    SimSourceScript script = {100, 0, 0, 0};
+
+    const char *name()
+    {
+        return label;
+    }
+
+    int fetch(const PermitRequest &request, PermitFetch *out)
+    {
+        bool up = script.upPct > 0 && random(100) < script.upPct;
+        uint32_t ms = up ? script.minMs + random(script.maxMs - script.minMs + 1) : script.downMs;
+        uint32_t until = millis() + ms / PHONE_SIM_TIME_SCALE;
+        while ((int32_t)(millis() - until) < 0)
+        {
+            if (cancelled)
+            {
+                out->failure = SYNC_FAIL_CANCELLED;
+                return 0;
+            }
+            delay(1);
+        }
+        if (!up)
+        {
+            out->failure = SYNC_FAIL_OUT_OF_RANGE;
+            return 0;
+        }
+
+        static uint8_t payload[512];
+        size_t jsonLen = strlen(PHONE_SIM_PAYLOAD);
+        permitAuthSign(PHONE_SIM_KEY, PHONE_SIM_PAYLOAD, jsonLen, ++counter, payload);
+        out->hasQueue = true;
+        return acceptPermitPayload(payload, jsonLen + PERMIT_AUTH_TRAILER_SIZE, false,
+                                   request.current->permitNumber, &out->data, &out->queue, &out->failure);
+    }
+
+    static uint32_t counter;  // Shared, like one app signing for both paths
+
+private:
+    const char *label;
+};
+
+uint32_t SimPermitSource::counter = 0;
+
+// Time to permit for ordered and racing plans when only the phone, only
+// WiFi, or both can be reached. Latencies follow the phone simulator and
+// the WiFi fast path (cached AP + resumed TLS); giving up takes a full BLE
+// scan or a failed join.
+void phoneSimSyncBenchmark(int runs)
+{
+    static SimPermitSource simBle("sim BLE");
+    static SimPermitSource simWifi("sim WiFi");
+    const uint32_t bleDownMs = BLE_SCAN_TIME * 1000;
+    const uint32_t wifiDownMs = 8000;  // Cached AP attempt, scan, one network timeout
+
+    struct Scenario
+    {
+        const char *label;
+        uint8_t phonePct, wifiPct;
+    };
+    const Scenario scenarios[] = {{"phone away, WiFi up", 0, 100},
+                                  {"phone near, WiFi down", 100, 0},
+                                  {"both reachable", 100, 100}};
+
+    SyncPlan plans[3];
+    const char *planNames[3] = {"BLE then WiFi", "WiFi then BLE", "race"};
+    for (int p = 0; p < 3; p++)
+    {
+        bool wifiFirst = p == 1;
+        plans[p].mode = p == 2 ? SYNC_MODE_RACE : SYNC_MODE_ORDERED;
+        plans[p].count = 2;
+        plans[p].slots[wifiFirst ? 1 : 0] = {&simBle, SYNC_BLE_DEADLINE_MS / PHONE_SIM_TIME_SCALE};
+        plans[p].slots[wifiFirst ? 0 : 1] = {&simWifi, SYNC_WIFI_DEADLINE_MS / PHONE_SIM_TIME_SCALE};
+    }
+
+    LOG_STAT("\n=== Sync coordinator: %d runs per scenario and plan, time x1/%d ===", runs, PHONE_SIM_TIME_SCALE);
+    uint32_t savedCounter = permitAuth.lastCounter;
+    SimPermitSource::counter = permitAuth.lastCounter;
+    PermitData empty = {};
+    PermitRequest request = {&empty, SYNC_TYPE_AUTO};
+    static SyncOutcome outcome;
+
+    for (const Scenario &sc : scenarios)
+    {
+        simBle.script = {sc.phonePct, 500, 3650, bleDownMs};
+        simWifi.script = {sc.wifiPct, 800, 2500, wifiDownMs};
+        for (int p = 0; p < 3; p++)
+        {
+            uint64_t sumMs = 0;
+            uint32_t maxMs = 0;
+            int got = 0;
+            for (int i = 0; i < runs; i++)
+            {
+                if (syncCoordinatorRun(plans[p], request, &outcome) != 0)
+                {
+                    uint32_t ms = outcome.timeToPermitMs * PHONE_SIM_TIME_SCALE;
+                    sumMs += ms;
+                    maxMs = max(maxMs, ms);
+                    got++;
+                }
+            }
+            LOG_STAT("  %-22s %-14s time to permit mean %lu ms, max %lu ms (%d/%d runs)",
+                     sc.label, planNames[p], got ? (unsigned long)(sumMs / got) : 0UL,
+                     (unsigned long)maxMs, got, runs);
+        }
+    }
+    permitAuth.lastCounter = savedCounter;
+}
+
+#endif
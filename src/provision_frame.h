@@ -0,0 +1,209 @@
+#ifndef PROVISION_FRAME_H
+#define PROVISION_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+
+// Framing for bench provisioning over the native USB port (usb_provision.h
+// on the display, tools/usb_provision.py on the host). No Serial or flash
+// calls in here so it can be built and fed on the host.
+//
+//   A5 5A | type | seq | length (2, LE) | payload | CRC-32 (4, LE)
+//
+// The CRC (crc32.h) covers type through payload. The host sends one
+// request at a time and waits for the reply, which carries the same seq
+// with PROV_REPLY set in the type and a status byte first in the payload.
+// A request that is repeated with the same type and seq (the reply was
+// lost) gets the same reply again without being applied twice. Frames
+// that fail the CRC are answered with PROV_NAK. Log text shares the port;
+// the parser skips anything outside a frame.
+
+#define PROV_SYNC0 0xA5
+#define PROV_SYNC1 0x5A
+#define PROV_HEADER_SIZE 6
+#define PROV_CRC_SIZE 4
+#define PROV_PAYLOAD_MAX 1024
+#define PROV_FRAME_MAX (PROV_HEADER_SIZE + PROV_PAYLOAD_MAX + PROV_CRC_SIZE)
+#define PROV_PROTOCOL_VERSION 1
+
+enum ProvType
+{
+    PROV_HELLO = 1,   // -> version, payload max, frame size, device id, build
+    PROV_PERMIT,      // Permit JSON as the phone sends it (queue and trailer optional)
+    PROV_QUEUE,       // {"queue": [...], "now": ...} - replaces the upcoming permits only
+    PROV_SETTINGS,    // mask, flags, then the fields named in mask (see usb_provision.h)
+    PROV_FRAME,       // offset (2, LE) + framebuffer bytes
+    PROV_FRAME_SHOW,  // CRC-32 (4, LE) of the whole framebuffer -> draw it
+    PROV_DIAG,        // -> "key=value" lines
+};
+
+#define PROV_REPLY 0x80  // Set in the type of every answer
+#define PROV_NAK 0xFF    // Answer to a frame that failed its CRC or length check
+
+enum ProvStatus
+{
+    PROV_OK = 0,
+    PROV_ERR_CRC,
+    PROV_ERR_LENGTH,
+    PROV_ERR_TYPE,      // Unknown request
+    PROV_ERR_BAD_DATA,  // Payload could not be used
+    PROV_ERR_AUTH,      // Signed payload failed the check
+    PROV_ERR_FLASH,     // Accepted, but could not be saved
+    PROV_ERR_MEMORY,
+    PROV_ERR_BUSY,
+};
+
+static const char *PROV_STATUS_NAMES[] = {
+    "ok", "crc error", "bad length", "unknown type", "bad data", "auth", "flash error", "out of memory", "busy"};
+
+struct ProvFrame
+{
+    uint8_t type;
+    uint8_t seq;
+    uint16_t len;
+    uint8_t payload[PROV_PAYLOAD_MAX];
+};
+
+// Write a frame into out (room for PROV_FRAME_MAX); returns its length
+static inline size_t provEncode(uint8_t *out, uint8_t type, uint8_t seq, const uint8_t *payload, size_t len)
+{
+    out[0] = PROV_SYNC0;
+    out[1] = PROV_SYNC1;
+    out[2] = type;
+    out[3] = seq;
+    out[4] = len & 0xFF;
+    out[5] = len >> 8;
+    if (len)
+    {
+        memcpy(out + PROV_HEADER_SIZE, payload, len);
+    }
+    uint32_t crc = crc32(out + 2, PROV_HEADER_SIZE - 2 + len);
+    uint8_t *tail = out + PROV_HEADER_SIZE + len;
+    for (int i = 0; i < 4; i++)
+    {
+        tail[i] = crc >> (8 * i);
+    }
+    return PROV_HEADER_SIZE + len + PROV_CRC_SIZE;
+}
+
+enum ProvParseResult
+{
+    PROV_PARSE_MORE = 0,    // Keep feeding
+    PROV_PARSE_FRAME,       // frame() holds a checked frame
+    PROV_PARSE_BAD_CRC,     // frame() holds the header of a frame that failed
+    PROV_PARSE_BAD_LENGTH,  // Announced length over PROV_PAYLOAD_MAX
+};
+
+class ProvParser
+{
+public:
+    void reset()
+    {
+        state = WAIT_SYNC0;
+    }
+
+    // Feed one byte from the port
+    ProvParseResult feed(uint8_t b)
+    {
+        switch (state)
+        {
+        case WAIT_SYNC0:
+            if (b == PROV_SYNC0)
+            {
+                state = WAIT_SYNC1;
+            }
+            else
+            {
+                skipped++;
+            }
+            return PROV_PARSE_MORE;
+        case WAIT_SYNC1:
+            state = b == PROV_SYNC1 ? HEADER : b == PROV_SYNC0 ? WAIT_SYNC1 : WAIT_SYNC0;
+            pos = 0;
+            return PROV_PARSE_MORE;
+        case HEADER:
+            header[pos++] = b;
+            if (pos < sizeof(header))
+            {
+                return PROV_PARSE_MORE;
+            }
+            current.type = header[0];
+            current.seq = header[1];
+            current.len = header[2] | (header[3] << 8);
+            if (current.len > PROV_PAYLOAD_MAX)
+            {
+                state = WAIT_SYNC0;
+                return PROV_PARSE_BAD_LENGTH;
+            }
+            crc = crc32(header, sizeof(header));
+            pos = 0;
+            state = current.len ? PAYLOAD : CRC;
+            return PROV_PARSE_MORE;
+        case PAYLOAD:
+            current.payload[pos++] = b;
+            if (pos == current.len)
+            {
+                crc = crc32Update(crc, current.payload, current.len);
+                pos = 0;
+                state = CRC;
+            }
+            return PROV_PARSE_MORE;
+        case CRC:
+            received |= (uint32_t)b << (8 * pos);
+            if (++pos < PROV_CRC_SIZE)
+            {
+                return PROV_PARSE_MORE;
+            }
+            state = WAIT_SYNC0;
+            {
+                bool ok = received == crc;
+                received = 0;
+                return ok ? PROV_PARSE_FRAME : PROV_PARSE_BAD_CRC;
+            }
+        }
+        return PROV_PARSE_MORE;
+    }
+
+    const ProvFrame &frame() const
+    {
+        return current;
+    }
+
+    uint32_t skipped = 0;  // Bytes outside frames (log text, line noise)
+
+private:
+    enum State
+    {
+        WAIT_SYNC0,
+        WAIT_SYNC1,
+        HEADER,
+        PAYLOAD,
+        CRC
+    };
+    State state = WAIT_SYNC0;
+    uint8_t header[4];
+    uint16_t pos = 0;
+    uint32_t crc = 0;
+    uint32_t received = 0;
+    ProvFrame current;
+};
+
+static inline uint16_t provGet16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t provGet32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void provPut16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef RENDER_PROFILER_H
+#define RENDER_PROFILER_H
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include "rle_font.h"
+#include "panel_async.h"
+#include "permit_config.h"
+#include "log_helper.h"
+
+// Render profiling. ProfiledGfx<T> stands in for a GFX target (the panel or
+// a canvas) in the drawing code and counts what a render asks of it: fills,
+// lines, bitmaps and glyphs, and the pixels they cover (a glyph counts its
+// box). Every call is forwarded unchanged, glyphs included, so the target
+// keeps its own fast paths and the numbers describe the real render.
+//
+// Each render becomes a RenderSample: the counts, the CPU time from the
+// wrapper's creation to finish() (drawing into the buffer, no panel I/O),
+// and the time the panel worker then spent in update(). The last
+// RENDER_PROFILE_HISTORY samples of each kind are kept as a rolling window
+// and summarised as median/p90/max in the USB diagnostics reply
+// (usb_provision.h) and in a readable characteristic on the display service.
+
+#define BLE_RENDER_STATS_CHAR_UUID "0000ff15-0000-1000-8000-00805f9b34fb"
+#define RENDER_PROFILE_HISTORY 32     // Samples kept per kind
+#define RENDER_PROFILE_LINE_MAX 96    // One kind's summary line
+
+enum RenderKind
+{
+    RENDER_PERMIT = 0,   // displayPermit()
+    RENDER_MESSAGE,      // displayMessage()
+    RENDER_STATUS,       // Status band, partial refresh
+    RENDER_FRAME,        // Ready-made frame blitted to the panel (pre-render or USB)
+    RENDER_PRERENDER,    // Next permit drawn offscreen, no refresh
+    RENDER_KIND_COUNT
+};
+
+static const char *RENDER_KIND_NAMES[RENDER_KIND_COUNT] = {
+    "permit", "message", "status", "frame", "prerender"};
+
+struct RenderOps
+{
+    uint16_t fills;      // fillRect, fillScreen, clearMemory
+    uint16_t lines;      // drawLine, fast H/V lines
+    uint16_t bitmaps;
+    uint16_t glyphs;
+    uint32_t pixels;
+};
+
+struct RenderSample
+{
+    RenderOps ops;
+    uint32_t rasterUs;
+    uint32_t updateMs;   // 0 when the render did not refresh the panel
+};
+
+struct RenderHistory
+{
+    RenderSample samples[RENDER_PROFILE_HISTORY];
+    uint8_t next;
+    uint8_t count;
+    uint32_t total;      // Renders since boot
+};
+
+static RenderHistory renderHistory[RENDER_KIND_COUNT];
+
+template <class Target>
+class ProfiledGfx
+{
+public:
+    RenderOps ops = {};
+
+    explicit ProfiledGfx(Target *target) : target(target), startUs(micros()) {}
+
+    Target *unwrap() { return target; }
+    int16_t width() { return target->width(); }
+    int16_t height() { return target->height(); }
+
+    void clearMemory()
+    {
+        ops.fills++;
+        ops.pixels += (uint32_t)SCREEN_W * SCREEN_H;
+        target->clearMemory();
+    }
+
+    void fillScreen(uint16_t color)
+    {
+        ops.fills++;
+        ops.pixels += (uint32_t)SCREEN_W * SCREEN_H;
+        target->fillScreen(color);
+    }
+
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+    {
+        ops.fills++;
+        ops.pixels += (uint32_t)max(0, (int)w) * max(0, (int)h);
+        target->fillRect(x, y, w, h, color);
+    }
+
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+    {
+        ops.lines++;
+        ops.pixels += max(abs(x1 - x0), abs(y1 - y0)) + 1;
+        target->drawLine(x0, y0, x1, y1, color);
+    }
+
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+    {
+        ops.lines++;
+        ops.pixels += max(0, (int)w);
+        target->drawFastHLine(x, y, w, color);
+    }
+
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+    {
+        ops.lines++;
+        ops.pixels += max(0, (int)h);
+        target->drawFastVLine(x, y, h, color);
+    }
+
+    void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color)
+    {
+        ops.bitmaps++;
+        ops.pixels += (uint32_t)max(0, (int)w) * max(0, (int)h);
+        target->drawBitmap(x, y, bitmap, w, h, color);
+    }
+
+    // Close the render: counts so far and the time since construction
+    RenderSample finish()
+    {
+        return {ops, (uint32_t)(micros() - startUs), 0};
+    }
+
+private:
+    Target *target;
+    uint32_t startUs;
+};
+
+// Glyphs drawn through the wrapper (rleDrawText() finds this by argument
+// lookup) go to the target's own rleDrawChar(), canvas fast path included
+template <class Target>
+int16_t rleDrawChar(ProfiledGfx<Target> *gfx, const RleFont *font, int16_t x, int16_t y, char c, uint16_t color)
+{
+    const RleGlyph *g = rleFontGlyph(font, c);
+    gfx->ops.glyphs++;
+    gfx->ops.pixels += g->width * g->height;
+    return rleDrawChar(gfx->unwrap(), font, x, y, c, color);
+}
+
+// A render waiting for its panel update to finish
+static struct
+{
+    bool active;
+    RenderKind kind;
+    RenderSample sample;
+    PanelTicket ticket;
+} renderPending;
+
+static BLECharacteristic *renderStatsChar = nullptr;
+
+template <class Field>
+static void renderPercentiles(const RenderHistory &h, Field field, uint32_t *median, uint32_t *p90, uint32_t *maxValue)
+{
+    uint32_t values[RENDER_PROFILE_HISTORY];
+    for (int i = 0; i < h.count; i++)
+    {
+        uint32_t v = field(h.samples[i]);
+        int j = i;
+        for (; j > 0 && values[j - 1] > v; j--)
+        {
+            values[j] = values[j - 1];
+        }
+        values[j] = v;
+    }
+    *median = values[(h.count - 1) / 2];
+    *p90 = values[(h.count * 9 - 1) / 10];
+    *maxValue = values[h.count - 1];
+}
+
+// One kind's window, kept short for the USB diagnostics payload:
+// "n=<renders> us=<raster> ms=<update> px=<pixels> ops=<fills>/<lines>/<bitmaps>/<glyphs>"
+// with us/ms as median/p90/max, px the median and ops the latest render's.
+// Returns the length, 0 if nothing was rendered.
+int renderProfileLine(RenderKind kind, char *out, size_t size)
+{
+    const RenderHistory &h = renderHistory[kind];
+    if (h.count == 0)
+    {
+        return 0;
+    }
+    uint32_t us[3], ms[3], px[3];
+    renderPercentiles(h, [](const RenderSample &s) { return s.rasterUs; }, &us[0], &us[1], &us[2]);
+    renderPercentiles(h, [](const RenderSample &s) { return s.updateMs; }, &ms[0], &ms[1], &ms[2]);
+    renderPercentiles(h, [](const RenderSample &s) { return s.ops.pixels; }, &px[0], &px[1], &px[2]);
+    const RenderOps &last = h.samples[(h.next + RENDER_PROFILE_HISTORY - 1) % RENDER_PROFILE_HISTORY].ops;
+    int len = snprintf(out, size, "n=%lu us=%lu/%lu/%lu ms=%lu/%lu/%lu px=%lu ops=%u/%u/%u/%u",
+                       (unsigned long)h.total, (unsigned long)us[0], (unsigned long)us[1], (unsigned long)us[2],
+                       (unsigned long)ms[0], (unsigned long)ms[1], (unsigned long)ms[2], (unsigned long)px[0],
+                       last.fills, last.lines, last.bitmaps, last.glyphs);
+    return min(len, (int)size - 1);
+}
+
+// All kinds, one "<kind> <line>" per line, for the BLE characteristic
+static int renderProfileText(char *out, size_t size)
+{
+    int len = 0;
+    for (int k = 0; k < RENDER_KIND_COUNT && len < (int)size - 1; k++)
+    {
+        char line[RENDER_PROFILE_LINE_MAX];
+        if (renderProfileLine((RenderKind)k, line, sizeof(line)))
+        {
+            len += snprintf(out + len, size - len, "%s %s\n", RENDER_KIND_NAMES[k], line);
+        }
+    }
+    return min(len, (int)size - 1);
+}
+
+static void renderPublish()
+{
+    if (!renderStatsChar)
+    {
+        return;
+    }
+    char text[RENDER_KIND_COUNT * (RENDER_PROFILE_LINE_MAX + 12)];
+    int len = renderProfileText(text, sizeof(text));
+    renderStatsChar->setValue((uint8_t *)text, len);
+}
+
+static void renderSettle()
+{
+    RenderSample &s = renderPending.sample;
+    // The worker's last wall time is this render's while no later update has finished
+    if (renderPending.ticket && panelCompleted == renderPending.ticket)
+    {
+        s.updateMs = panelLastWallMs;
+    }
+    renderPending.active = false;
+
+    RenderHistory &h = renderHistory[renderPending.kind];
+    h.samples[h.next] = s;
+    h.next = (h.next + 1) % RENDER_PROFILE_HISTORY;
+    h.count = min(h.count + 1, RENDER_PROFILE_HISTORY);
+    h.total++;
+    LOG_STAT("Render %s: %u fills, %u lines, %u bitmaps, %u glyphs, %lu px; %lu us raster, %lu ms update",
+             RENDER_KIND_NAMES[renderPending.kind], s.ops.fills, s.ops.lines, s.ops.bitmaps, s.ops.glyphs,
+             (unsigned long)s.ops.pixels, (unsigned long)s.rasterUs, (unsigned long)s.updateMs);
+    renderPublish();
+}
+
+// Call from loop(): files the pending render once its panel update is done
+void renderProfileTick()
+{
+    if (renderPending.active && panelUpdateDone(renderPending.ticket))
+    {
+        renderSettle();
+    }
+}
+
+// Hand over a finished render and the ticket of the update that shows it
+// (0 for none). It is filed when that update completes.
+void renderProfileRecord(RenderKind kind, const RenderSample &sample, PanelTicket ticket = 0)
+{
+    if (renderPending.active)
+    {
+        // Renders wait for the panel before drawing, so the previous update is done
+        renderSettle();
+    }
+    renderPending.active = true;
+    renderPending.kind = kind;
+    renderPending.sample = sample;
+    renderPending.ticket = ticket;
+    renderProfileTick();
+}
+
+// Add the render stats characteristic to the display service (before service->start())
+void renderProfileAttach(BLEService *service)
+{
+    renderStatsChar = service->createCharacteristic(
+        BLE_RENDER_STATS_CHAR_UUID,
+        BLECharacteristic::PROPERTY_READ);
+    renderPublish();
+}
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef RLE_FONT_H
+#define RLE_FONT_H
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+
+// Fonts subset to the characters the display draws, with run-length coded
+// glyphs. tools/font_subset.py generates them (src/Fonts/*_rle.h) from the
+// Adafruit GFX fonts before each build; the character sets are in
+// platformio.ini. Characters outside a subset are drawn as '?'.
+//
+// A glyph is its box read row by row as one pixel stream, coded as pairs of
+// (background run, ink run) with per-font bit widths; a pair may repeat.
+// Glyphs are packed back to back without byte alignment.
+// Ink runs are drawn as horizontal spans instead of pixel by pixel: into a
+// GFXcanvas1 buffer directly, or with drawFastHLine on anything else.
+// Positions work as with GFX fonts: y is the baseline.
+//
+// Tables are read in place; flash is mapped into the data space on ESP32.
+
+struct RleGlyph
+{
+    uint16_t offset;  // Into the font's data, in bits
+    uint8_t width, height, xAdvance;
+    int8_t xOffset, yOffset;
+};
+
+struct RleFont
+{
+    const uint8_t *data;
+    const RleGlyph *glyphs;
+    const uint8_t *map;  // Glyph index for each of first..last, 0xFF = not in the subset
+    uint8_t first, last;
+    uint8_t yAdvance;
+    uint8_t bits0, bits1;  // Widths of the background and ink run fields
+};
+
+#define RLE_NO_GLYPH 0xFF
+
+static inline const RleGlyph *rleFontGlyph(const RleFont *font, uint8_t c)
+{
+    uint8_t index = c >= font->first && c <= font->last ? font->map[c - font->first] : RLE_NO_GLYPH;
+    if (index == RLE_NO_GLYPH)
+    {
+        index = font->map['?' - font->first];  // Always in the subset
+    }
+    return &font->glyphs[index];
+}
+
+// LSB-first bit reader over a glyph's data
+struct RleBits
+{
+    const uint8_t *p;
+    uint32_t acc;
+    uint8_t count;
+
+    uint32_t get(uint8_t bits)
+    {
+        while (count < bits)
+        {
+            acc |= (uint32_t)*p++ << count;
+            count += 8;
+        }
+        uint32_t value = acc & ((1u << bits) - 1);
+        acc >>= bits;
+        count -= bits;
+        return value;
+    }
+};
+
+// Walk a glyph's ink as horizontal spans: span(x, y, length)
+template <class Span>
+static inline void rleDecodeGlyph(const RleFont *font, const RleGlyph *g, int16_t x, int16_t y, Span span)
+{
+    if (g->width == 0 || g->height == 0)
+    {
+        return;
+    }
+    RleBits bits = {font->data + (g->offset >> 3), 0, 0};
+    bits.get(g->offset & 7);
+    int w = g->width;
+    int col = 0, row = 0;
+    while (row < g->height)
+    {
+        int zeros = bits.get(font->bits0);
+        int ones = bits.get(font->bits1);
+        do
+        {
+            col += zeros;
+            while (col >= w)
+            {
+                col -= w;
+                row++;
+            }
+            for (int left = ones; left > 0 && row < g->height;)
+            {
+                int n = min(left, w - col);
+                span(x + col, y + row, n);
+                left -= n;
+                col += n;
+                if (col == w)
+                {
+                    col = 0;
+                    row++;
+                }
+            }
+        } while (bits.get(1) && row < g->height);
+    }
+}
+
+// Set or clear a span straight in a GFXcanvas1 buffer (rotation 0), clipped
+static inline void rleCanvasSpan(uint8_t *buf, int16_t canvasW, int16_t canvasH,
+                                 int16_t x, int16_t y, int16_t len, bool ink)
+{
+    if (y < 0 || y >= canvasH)
+    {
+        return;
+    }
+    if (x < 0)
+    {
+        len += x;
+        x = 0;
+    }
+    if (x + len > canvasW)
+    {
+        len = canvasW - x;
+    }
+    if (len <= 0)
+    {
+        return;
+    }
+    uint8_t *row = buf + y * ((canvasW + 7) / 8);
+    int16_t end = x + len;  // Exclusive
+    int16_t first = x >> 3, last = (end - 1) >> 3;
+    uint8_t headMask = 0xFF >> (x & 7);
+    uint8_t tailMask = 0xFF << (7 - ((end - 1) & 7));
+    if (first == last)
+    {
+        uint8_t mask = headMask & tailMask;
+        row[first] = ink ? row[first] | mask : row[first] & ~mask;
+        return;
+    }
+    row[first] = ink ? row[first] | headMask : row[first] & ~headMask;
+    if (last - first > 1)
+    {
+        memset(row + first + 1, ink ? 0xFF : 0x00, last - first - 1);
+    }
+    row[last] = ink ? row[last] | tailMask : row[last] & ~tailMask;
+}
+
+// Draw one character with its origin at (x, y); returns the x advance
+template <class Gfx>
+int16_t rleDrawChar(Gfx *gfx, const RleFont *font, int16_t x, int16_t y, char c, uint16_t color)
+{
+    const RleGlyph *g = rleFontGlyph(font, c);
+    rleDecodeGlyph(font, g, x + g->xOffset, y + g->yOffset,
+                   [&](int16_t sx, int16_t sy, int16_t n) { gfx->drawFastHLine(sx, sy, n, color); });
+    return g->xAdvance;
+}
+
+// Canvas fast path: spans go straight into the buffer unless it is rotated
+int16_t rleDrawChar(GFXcanvas1 *canvas, const RleFont *font, int16_t x, int16_t y, char c, uint16_t color)
+{
+    if (canvas->getRotation() != 0)
+    {
+        return rleDrawChar<GFXcanvas1>(canvas, font, x, y, c, color);
+    }
+    const RleGlyph *g = rleFontGlyph(font, c);
+    uint8_t *buf = canvas->getBuffer();
+    int16_t w = canvas->width(), h = canvas->height();
+    rleDecodeGlyph(font, g, x + g->xOffset, y + g->yOffset,
+                   [&](int16_t sx, int16_t sy, int16_t n) { rleCanvasSpan(buf, w, h, sx, sy, n, color != 0); });
+    return g->xAdvance;
+}
+
+// Draw a string with the first baseline at y; '\n' starts a new line at x.
+// Returns the x after the last character.
+template <class Gfx>
+int16_t rleDrawText(Gfx *gfx, const RleFont *font, int16_t x, int16_t y, const char *text, uint16_t color)
+{
+    int16_t cx = x;
+    for (const char *p = text; *p; p++)
+    {
+        if (*p == '\n')
+        {
+            cx = x;
+            y += font->yAdvance;
+        }
+        else if (*p != '\r')
+        {
+            cx += rleDrawChar(gfx, font, cx, y, *p, color);
+        }
+    }
+    return cx;
+}
+
+// Box of the ink rleDrawText() would draw, as GFX getTextBounds() reports it
+void rleTextBounds(const RleFont *font, const char *text, int16_t x, int16_t y,
+                   int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h)
+{
+    int16_t minX = INT16_MAX, minY = INT16_MAX, maxX = INT16_MIN, maxY = INT16_MIN;
+    int16_t cx = x;
+    for (const char *p = text; *p; p++)
+    {
+        if (*p == '\n')
+        {
+            cx = x;
+            y += font->yAdvance;
+            continue;
+        }
+        if (*p == '\r')
+        {
+            continue;
+        }
+        const RleGlyph *g = rleFontGlyph(font, *p);
+        if (g->width && g->height)
+        {
+            minX = min(minX, (int16_t)(cx + g->xOffset));
+            minY = min(minY, (int16_t)(y + g->yOffset));
+            maxX = max(maxX, (int16_t)(cx + g->xOffset + g->width - 1));
+            maxY = max(maxY, (int16_t)(y + g->yOffset + g->height - 1));
+        }
+        cx += g->xAdvance;
+    }
+    if (maxX < minX)
+    {
+        *x1 = x;
+        *y1 = y;
+        *w = *h = 0;
+        return;
+    }
+    *x1 = minX;
+    *y1 = minY;
+    *w = maxX - minX + 1;
+    *h = maxY - minY + 1;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SHA256_COMPAT_H
+#define SHA256_COMPAT_H
+
+#include <mbedtls/version.h>
+#include <mbedtls/sha256.h>
+
+// mbedTLS 2.x (ESP-IDF 4.x) only has the _ret variants without warnings.
+// On the ESP32-S3 these run on the SHA accelerator.
+#if MBEDTLS_VERSION_MAJOR >= 3
+#define SHA256_STARTS(ctx) mbedtls_sha256_starts(ctx, 0)
+#define SHA256_UPDATE(ctx, buf, len) mbedtls_sha256_update(ctx, buf, len)
+#define SHA256_FINISH(ctx, out) mbedtls_sha256_finish(ctx, out)
+#else
+#define SHA256_STARTS(ctx) mbedtls_sha256_starts_ret(ctx, 0)
+#define SHA256_UPDATE(ctx, buf, len) mbedtls_sha256_update_ret(ctx, buf, len)
+#define SHA256_FINISH(ctx, out) mbedtls_sha256_finish_ret(ctx, out)
+#endif
+
+#endif
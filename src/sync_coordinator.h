@@ -0,0 +1,356 @@
+#ifndef SYNC_COORDINATOR_H
+#define SYNC_COORDINATOR_H
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "permit_source.h"
+#include "log_helper.h"
+
+// Runs the permit sources for one sync and picks the result.
+//
+// SYNC_MODE_RACE starts every source at once, each in its own task. BLE and
+// WiFi share the 2.4 GHz radio through the ESP32's coexistence arbiter, so
+// neither has to finish first. SYNC_MODE_ORDERED tries the sources one at
+// a time in plan order. Either way each source may have a deadline, after
+// which it is cancelled (and in ordered mode the next one starts at once).
+//
+// The first usable result wins: a permit that is not older (by validFrom)
+// than the one on screen. The other sources are then cancelled. While they
+// wind down, a result that turns out newer than the winner replaces it, so
+// waiting for them costs nothing extra. Passive sources (serial) listen for
+// the whole sync and are cancelled once every active source is done.
+//
+// Each plan slot has a worker task that is created the first time the slot
+// runs and then kept, waiting for the next sync; like the panel task it is
+// created static, so a sync never creates a task. The stack (at least
+// SYNC_TASK_STACK) is allocated once, so a long uptime cannot leave the
+// heap too fragmented to start one.
+
+enum SyncMode
+{
+    SYNC_MODE_RACE = 0,
+    SYNC_MODE_ORDERED
+};
+
+static const char *SYNC_MODE_NAMES[] = {"race", "ordered"};
+
+#ifndef SYNC_MODE
+#define SYNC_MODE SYNC_MODE_RACE
+#endif
+
+// Per-source deadlines (override with -D build flags)
+#ifndef SYNC_BLE_DEADLINE_MS
+#define SYNC_BLE_DEADLINE_MS 30000   // Scan plus the retry budget
+#endif
+#ifndef SYNC_WIFI_DEADLINE_MS
+#define SYNC_WIFI_DEADLINE_MS 30000  // Join (cache, then scan) plus the HTTP timeout
+#endif
+
+#define SYNC_SOURCES_MAX 4
+#define SYNC_TASK_PRIORITY 1   // Same as loop(), below the BLE and WiFi stacks
+#define SYNC_TASK_CORE 1
+// Smallest worker stack, so a slot fits any of the firmware's sources
+// whichever plan uses it first (the phone simulator's run before the real one)
+#ifndef SYNC_TASK_STACK
+#ifdef PERMIT_WIFI
+#define SYNC_TASK_STACK 12288  // WifiPermitSource: mbedTLS handshake
+#else
+#define SYNC_TASK_STACK 8192
+#endif
+#endif
+
+struct SyncSlot
+{
+    PermitSource *source;
+    uint32_t deadlineMs;  // From the start of the source's turn; 0 = none
+};
+
+struct SyncPlan
+{
+    SyncMode mode;
+    uint8_t count;
+    SyncSlot slots[SYNC_SOURCES_MAX];  // Priority order
+};
+
+struct SyncOutcome
+{
+    int result;               // 0 = no permit, 1 = updated, 2 = already up to date
+    SyncFailure failure;      // Highest-priority active source's failure (result 0)
+    int winner;               // Slot that delivered, -1 if none
+    PermitFetch fetch;        // The winner's result
+    uint32_t timeToPermitMs;  // Until the winning result came in
+    uint32_t totalMs;         // Until every source had stopped
+};
+
+struct SyncRun
+{
+    PermitSource *source;
+    const PermitRequest *request;
+    PermitFetch fetch;
+    uint8_t index;
+    bool started;
+    bool done;
+    bool cancelled;
+    uint32_t startedAt;
+    uint32_t deadlineMs;
+};
+
+struct SyncWorker
+{
+    TaskHandle_t handle;
+    SemaphoreHandle_t start;
+    StaticTask_t taskBuffer;
+    StaticSemaphore_t startBuffer;
+    StackType_t *stack;
+    uint32_t stackSize;
+    SyncRun *volatile run;
+};
+
+static SyncRun syncRuns[SYNC_SOURCES_MAX];
+static SyncWorker syncWorkers[SYNC_SOURCES_MAX];
+static QueueHandle_t syncDoneQueue = nullptr;
+
+static void syncWorkerTask(void *arg)
+{
+    SyncWorker *worker = (SyncWorker *)arg;
+    for (;;)
+    {
+        xSemaphoreTake(worker->start, portMAX_DELAY);
+        SyncRun *run = worker->run;
+        run->fetch.result = run->source->fetch(*run->request, &run->fetch);
+        run->fetch.elapsedMs = millis() - run->startedAt;
+        xQueueSend(syncDoneQueue, &run->index, portMAX_DELAY);
+    }
+}
+
+// The slot's worker, created on first use; nullptr if it cannot be, or its
+// stack is smaller than this source needs
+static SyncWorker *syncWorker(uint8_t slot, uint32_t stackSize)
+{
+    SyncWorker *worker = &syncWorkers[slot];
+    if (!worker->handle)
+    {
+        stackSize = max(stackSize, (uint32_t)SYNC_TASK_STACK);
+        worker->stack = (StackType_t *)heap_caps_malloc(stackSize, MALLOC_CAP_8BIT);  // Kept for good
+        if (!worker->stack)
+        {
+            return nullptr;
+        }
+        worker->stackSize = stackSize;
+        worker->start = xSemaphoreCreateBinaryStatic(&worker->startBuffer);
+        char name[12];
+        snprintf(name, sizeof(name), "sync%u", (unsigned)slot);
+        worker->handle = xTaskCreateStaticPinnedToCore(syncWorkerTask, name, stackSize, worker,
+                                                       SYNC_TASK_PRIORITY, worker->stack,
+                                                       &worker->taskBuffer, SYNC_TASK_CORE);
+    }
+    return worker->stackSize >= stackSize ? worker : nullptr;
+}
+
+static bool syncStart(SyncRun *run)
+{
+    memset(&run->fetch, 0, sizeof(run->fetch));
+    run->source->reset();
+    run->started = true;
+    run->startedAt = millis();
+    SyncWorker *worker = syncWorker(run->index, run->source->stackSize());
+    if (!worker)
+    {
+        LOG_E("Sync: could not start %s", run->source->name());
+        run->done = true;
+        run->fetch.failure = SYNC_FAIL_CANCELLED;
+        return false;
+    }
+    worker->run = run;
+    xSemaphoreGive(worker->start);
+    return true;
+}
+
+static void syncCancel(SyncRun *run)
+{
+    if (run->started && !run->done && !run->cancelled)
+    {
+        run->cancelled = true;
+        run->source->cancel();
+    }
+}
+
+// a was issued after b (validFrom); false if either cannot be parsed
+static bool permitNewer(const PermitData *a, const PermitData *b)
+{
+    time_t ta, tb;
+    return parsePermitTime(a->validFrom, &ta) && parsePermitTime(b->validFrom, &tb) && ta > tb;
+}
+
+// Start the next active source that has not run yet (ordered mode)
+static bool syncStartNext(const SyncPlan &plan)
+{
+    for (int i = 0; i < plan.count; i++)
+    {
+        SyncRun *run = &syncRuns[i];
+        if (!run->started && !run->source->passive())
+        {
+            if (syncStart(run))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Run the plan; blocks until every source has stopped. Returns out->result.
+int syncCoordinatorRun(const SyncPlan &plan, const PermitRequest &request, SyncOutcome *out)
+{
+    permitSourcesBegin();
+    if (!syncDoneQueue)
+    {
+        syncDoneQueue = xQueueCreate(SYNC_SOURCES_MAX, sizeof(uint8_t));
+    }
+    memset(out, 0, sizeof(SyncOutcome));
+    out->winner = -1;
+
+    LOG_I("Sync: %d source(s), %s", plan.count, SYNC_MODE_NAMES[plan.mode]);
+    uint32_t start = millis();
+    int running = 0;
+    for (int i = 0; i < plan.count; i++)
+    {
+        SyncRun *run = &syncRuns[i];
+        memset(run, 0, sizeof(SyncRun));
+        run->source = plan.slots[i].source;
+        run->request = &request;
+        run->index = i;
+        run->deadlineMs = plan.slots[i].deadlineMs;
+    }
+    for (int i = 0; i < plan.count; i++)
+    {
+        SyncRun *run = &syncRuns[i];
+        if (run->source->passive() || plan.mode == SYNC_MODE_RACE)
+        {
+            running += syncStart(run) ? 1 : 0;
+        }
+    }
+    if (plan.mode == SYNC_MODE_ORDERED)
+    {
+        running += syncStartNext(plan) ? 1 : 0;
+    }
+
+    while (running > 0)
+    {
+        // Sleep until a source finishes or the nearest deadline
+        uint32_t now = millis();
+        uint32_t waitMs = portMAX_DELAY;
+        for (int i = 0; i < plan.count; i++)
+        {
+            SyncRun *run = &syncRuns[i];
+            if (run->started && !run->done && !run->cancelled && run->deadlineMs)
+            {
+                uint32_t used = now - run->startedAt;
+                waitMs = min(waitMs, used >= run->deadlineMs ? 0 : run->deadlineMs - used);
+            }
+        }
+
+        uint8_t index;
+        if (xQueueReceive(syncDoneQueue, &index, waitMs == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(waitMs)) != pdTRUE)
+        {
+            for (int i = 0; i < plan.count; i++)
+            {
+                SyncRun *run = &syncRuns[i];
+                if (run->started && !run->done && !run->cancelled && run->deadlineMs &&
+                    millis() - run->startedAt >= run->deadlineMs)
+                {
+                    LOG_W("Sync: %s missed its %lu ms deadline", run->source->name(), (unsigned long)run->deadlineMs);
+                    syncCancel(run);
+                    if (plan.mode == SYNC_MODE_ORDERED && out->winner < 0)
+                    {
+                        running += syncStartNext(plan) ? 1 : 0;
+                    }
+                }
+            }
+            continue;
+        }
+
+        SyncRun *run = &syncRuns[index];
+        run->done = true;
+        running--;
+        const PermitFetch &fetch = run->fetch;
+        LOG_STAT("Sync: %s %s in %lu ms", run->source->name(),
+                 fetch.result == 1 ? "updated" : fetch.result == 2 ? "unchanged" : SYNC_FAILURE_NAMES[fetch.failure],
+                 (unsigned long)fetch.elapsedMs);
+
+        bool usable = fetch.result != 0;
+        if (usable && permitNewer(request.current, &fetch.data))
+        {
+            LOG_W("Sync: %s has an older permit (%s) than the one shown - ignored",
+                  run->source->name(), fetch.data.permitNumber);
+            usable = false;
+        }
+        if (usable && (out->winner < 0 || permitNewer(&fetch.data, &syncRuns[out->winner].fetch.data)))
+        {
+            if (out->winner < 0)
+            {
+                out->timeToPermitMs = millis() - start;
+            }
+            else
+            {
+                LOG_I("Sync: %s has a newer permit than %s", run->source->name(),
+                      syncRuns[out->winner].source->name());
+            }
+            out->winner = index;
+        }
+
+        if (out->winner >= 0)
+        {
+            for (int i = 0; i < plan.count; i++)
+            {
+                syncCancel(&syncRuns[i]);
+            }
+            continue;
+        }
+        if (plan.mode == SYNC_MODE_ORDERED && !run->source->passive() && !run->cancelled)
+        {
+            running += syncStartNext(plan) ? 1 : 0;
+        }
+
+        // No active source left: stop listening
+        bool activeLeft = false;
+        for (int i = 0; i < plan.count; i++)
+        {
+            SyncRun *other = &syncRuns[i];
+            activeLeft |= !other->source->passive() && (!other->started || !other->done);
+        }
+        if (!activeLeft)
+        {
+            for (int i = 0; i < plan.count; i++)
+            {
+                syncCancel(&syncRuns[i]);
+            }
+        }
+    }
+    out->totalMs = millis() - start;
+
+    if (out->winner >= 0)
+    {
+        out->fetch = syncRuns[out->winner].fetch;
+        out->result = out->fetch.result;
+        LOG_STAT("Time to permit: %lu ms via %s (%s, all sources stopped after %lu ms)",
+                 (unsigned long)out->timeToPermitMs, syncRuns[out->winner].source->name(),
+                 SYNC_MODE_NAMES[plan.mode], (unsigned long)out->totalMs);
+    }
+    else
+    {
+        out->failure = SYNC_FAIL_CANCELLED;
+        for (int i = plan.count - 1; i >= 0; i--)
+        {
+            if (!syncRuns[i].source->passive() && syncRuns[i].started)
+            {
+                out->failure = syncRuns[i].fetch.failure;
+            }
+        }
+        LOG_STAT("No permit from any source after %lu ms (%s)", (unsigned long)out->totalMs,
+                 SYNC_FAILURE_NAMES[out->failure]);
+    }
+    return out->result;
+}
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef SYNC_PATH_BENCH_H
+#define SYNC_PATH_BENCH_H
+
+#include <Arduino.h>
+#include "bluetooth_helper.h"
+#ifdef PERMIT_BROADCAST
+#include "permit_broadcast.h"
+#endif
+#include "sync_coordinator.h"
+#include "permit_auth.h"
+#include "permit_store.h"
+#include "energy_model.h"
+#include "log_helper.h"
+
+// Time and charge of the ways an auto sync can end with the real phone
+// (build with -DSYNC_PATH_BENCH, see env:vision_e290_pathbench; the app
+// must be open, in range and paired):
+//
+//   connected  scan, connect, discover and read (no tag applied yet)
+//   scan only  the phone advertises the tag of the payload applied last
+//   broadcast  the permit from the app's extended advertisement
+//              (PERMIT_BROADCAST builds)
+//
+// Every run is a real auto sync through the coordinator, as syncPermit()
+// does it, but nothing is applied or saved. Time is millis() around the
+// run and charge is what energyEnd() makes of the radio windows and the
+// wall time it took. A run that ends another way (phone not found, no
+// tag advertised, broadcast not heard so the display connected) is left
+// out of its path's figures and counted.
+//
+// The replay counter is put back before each run, since the app may serve
+// the same signed payload again, and the energy totals are put back at the
+// end so the per-day estimate only sees real syncs.
+
+#ifndef SYNC_PATH_BENCH_RUNS
+#define SYNC_PATH_BENCH_RUNS 20      // Auto syncs per path
+#endif
+#define SYNC_PATH_BENCH_GAP_MS 1000  // Between runs, for the app to advertise again
+
+enum SyncBenchPath
+{
+    SYNC_BENCH_CONNECTED = 0,
+    SYNC_BENCH_SCAN_ONLY,
+    SYNC_BENCH_BROADCAST,
+    SYNC_BENCH_PATHS
+};
+
+static const char *SYNC_BENCH_PATH_NAMES[SYNC_BENCH_PATHS] = {"connected", "scan only", "broadcast"};
+
+struct SyncBenchResult
+{
+    int took;        // Runs that ended on this path
+    int runs;
+    uint32_t sumMs;
+    uint32_t maxMs;
+    float sumMah;
+    uint32_t tag;    // Tag the phone advertised (connected runs), 0 = none seen
+};
+
+// Did the run end the way the path is meant to?
+static inline bool syncBenchTookPath(SyncBenchPath path, int result, const PermitFetch &fetch)
+{
+    if (result == 0)
+    {
+        return false;
+    }
+    switch (path)
+    {
+    case SYNC_BENCH_SCAN_ONLY:
+        return fetch.skipped;
+    case SYNC_BENCH_BROADCAST:
+        return !fetch.skipped && !fetch.hasQueue;  // The connected path brings the queue
+    default:
+        return !fetch.skipped;
+    }
+}
+
+static void syncBenchRunPath(SyncBenchPath path, const SyncPlan &plan, const PermitRequest &request,
+                             uint32_t appliedTag, int runs, SyncBenchResult *r)
+{
+    static SyncOutcome outcome;
+    uint32_t counter = permitAuth.lastCounter;
+    uint32_t newest = counter;
+    memset(r, 0, sizeof(SyncBenchResult));
+
+    for (int i = 0; i < runs; i++)
+    {
+        permitStoreAdvertTag = appliedTag;
+        permitAuth.lastCounter = counter;
+
+        energyBegin();
+        uint32_t start = millis();
+        int result = syncCoordinatorRun(plan, request, &outcome);
+        cleanupBluetooth();
+        uint32_t ms = millis() - start;
+        EnergyOp op = result == 0              ? ENERGY_OP_SYNC_FAILED
+                      : outcome.fetch.skipped ? ENERGY_OP_SYNC_SKIPPED
+                      : result == 1           ? ENERGY_OP_SYNC_UPDATED
+                                              : ENERGY_OP_SYNC_UNCHANGED;
+        float mah = energyEnd(op);
+
+        r->runs++;
+        if (syncBenchTookPath(path, result, outcome.fetch))
+        {
+            r->took++;
+            r->sumMs += ms;
+            r->maxMs = max(r->maxMs, ms);
+            r->sumMah += mah;
+        }
+        if (result != 0 && permitStoreAdvertTag != appliedTag)
+        {
+            r->tag = permitStoreAdvertTag;  // Learned from the advertisement
+        }
+        newest = max(newest, permitAuth.lastCounter);
+        delay(SYNC_PATH_BENCH_GAP_MS);
+    }
+    permitAuth.lastCounter = newest;
+}
+
+static void syncBenchReport(SyncBenchPath path, const SyncBenchResult &r, const SyncBenchResult &connected)
+{
+    if (!r.took)
+    {
+        LOG_STAT("  %-10s no run took this path (%d runs)", SYNC_BENCH_PATH_NAMES[path], r.runs);
+        return;
+    }
+    uint32_t meanMs = r.sumMs / r.took;
+    float meanMah = r.sumMah / r.took;
+    LOG_STAT("  %-10s mean %lu ms, max %lu ms, %.4f mAh per sync (%d/%d runs)", SYNC_BENCH_PATH_NAMES[path],
+             (unsigned long)meanMs, (unsigned long)r.maxMs, meanMah, r.took, r.runs);
+    if (path != SYNC_BENCH_CONNECTED && connected.took)
+    {
+        uint32_t connectedMs = connected.sumMs / connected.took;
+        float connectedMah = connected.sumMah / connected.took;
+        LOG_STAT("  %-10s saves %ld ms and %.4f mAh per sync over connecting (%.0f%% of the charge)", "",
+                 (long)connectedMs - (long)meanMs, connectedMah - meanMah,
+                 connectedMah > 0 ? 100.0f * (connectedMah - meanMah) / connectedMah : 0.0f);
+    }
+}
+
+// Run every path against the phone and print the comparison. current is
+// the permit on the display (only read).
+void syncPathBenchmark(const PermitData *current, int runs)
+{
+    LOG_STAT("\n=== Sync paths: %d auto syncs per path against the phone ===", runs);
+    static EnergyOpStats savedStats[ENERGY_OP_COUNT];
+    memcpy(savedStats, energyStats, sizeof(energyStats));
+    uint32_t savedTag = permitStoreAdvertTag;
+    uint32_t savedSkipped = advertSkippedSyncs;
+    PermitRequest request = {current, SYNC_TYPE_AUTO};
+    SyncBenchResult results[SYNC_BENCH_PATHS] = {};
+
+    SyncPlan plan = {SYNC_MODE_ORDERED, 1, {{&blePermitSource, SYNC_BLE_DEADLINE_MS}}};
+    syncBenchRunPath(SYNC_BENCH_CONNECTED, plan, request, 0, runs, &results[SYNC_BENCH_CONNECTED]);
+    if (results[SYNC_BENCH_CONNECTED].tag)
+    {
+        syncBenchRunPath(SYNC_BENCH_SCAN_ONLY, plan, request, results[SYNC_BENCH_CONNECTED].tag, runs,
+                         &results[SYNC_BENCH_SCAN_ONLY]);
+    }
+    else
+    {
+        LOG_W("Phone advertises no permit tag - scan-only path not measured");
+    }
+#ifdef PERMIT_BROADCAST
+    plan.slots[0] = {&broadcastPermitSource, SYNC_BLE_DEADLINE_MS + BROADCAST_LISTEN_MS};
+    syncBenchRunPath(SYNC_BENCH_BROADCAST, plan, request, 0, runs, &results[SYNC_BENCH_BROADCAST]);
+#endif
+
+    LOG_STAT("\n=== Sync paths ===");
+    for (int p = 0; p < SYNC_BENCH_PATHS; p++)
+    {
+#ifndef PERMIT_BROADCAST
+        if (p == SYNC_BENCH_BROADCAST)
+        {
+            continue;
+        }
+#endif
+        syncBenchReport((SyncBenchPath)p, results[p], results[SYNC_BENCH_CONNECTED]);
+    }
+
+    memcpy(energyStats, savedStats, sizeof(energyStats));
+    permitStoreAdvertTag = savedTag;
+    advertSkippedSyncs = savedSkipped;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef SYNC_POLICY_H
+#define SYNC_POLICY_H
+
+#include <stdint.h>
+
+// Retry policy for permit downloads. Each failed attempt is classified and
+// the class decides whether to retry and how long to back off. Backoff is
+// exponential with full jitter: delay = random(0, min(max, base * 2^n)).
+// Classes that retrying cannot fix fail fast with a single attempt.
+
+enum SyncFailure
+{
+    SYNC_FAIL_NONE = 0,
+    SYNC_FAIL_OUT_OF_RANGE,    // Phone not advertising / not found by scan
+    SYNC_FAIL_GATT,            // Found, but connection attempt failed
+    SYNC_FAIL_MISSING_SERVICE, // Connected, permit service/characteristic missing
+    SYNC_FAIL_PARSE,           // Payload not valid JSON (e.g. truncated read)
+    SYNC_FAIL_BAD_DATA,        // Valid JSON without a usable permit
+    SYNC_FAIL_AUTH,            // Payload not signed with the pairing key, or replayed
+    SYNC_FAIL_NETWORK,         // No WiFi, or the permit server could not be reached
+    SYNC_FAIL_CANCELLED,       // Stopped by the coordinator (deadline, or another source won)
+    SYNC_FAIL_CLASS_COUNT
+};
+
+static const char *SYNC_FAILURE_NAMES[SYNC_FAIL_CLASS_COUNT] = {
+    "none", "out of range", "GATT error", "missing service", "parse error", "bad data", "auth", "network", "cancelled"};
+
+struct RetryPolicy
+{
+    uint8_t maxAttempts;   // Total attempts including the first (1 = fail fast)
+    uint16_t baseDelayMs;  // Backoff ceiling before the second attempt
+    uint16_t maxDelayMs;   // Upper bound for the backoff ceiling
+};
+
+// ---- Tunables (override with -D build flags) ----
+#ifndef RETRY_GATT_ATTEMPTS
+#define RETRY_GATT_ATTEMPTS 4
+#endif
+#ifndef RETRY_GATT_BASE_MS
+#define RETRY_GATT_BASE_MS 250
+#endif
+#ifndef RETRY_GATT_MAX_MS
+#define RETRY_GATT_MAX_MS 2000
+#endif
+#ifndef RETRY_SERVICE_ATTEMPTS
+#define RETRY_SERVICE_ATTEMPTS 2    // App may still be registering its service
+#endif
+#ifndef RETRY_SERVICE_BASE_MS
+#define RETRY_SERVICE_BASE_MS 500
+#endif
+#ifndef RETRY_PARSE_ATTEMPTS
+#define RETRY_PARSE_ATTEMPTS 2      // A truncated read usually succeeds next time
+#endif
+#ifndef RETRY_PARSE_BASE_MS
+#define RETRY_PARSE_BASE_MS 100
+#endif
+#ifndef RETRY_DEADLINE_MS
+#define RETRY_DEADLINE_MS 15000     // Give up once this much time has gone into retries
+#endif
+
+static RetryPolicy retryPolicies[SYNC_FAIL_CLASS_COUNT] = {
+    {1, 0, 0},                                                          // none
+    {1, 0, 0},                                                          // out of range: the scan already waited
+    {RETRY_GATT_ATTEMPTS, RETRY_GATT_BASE_MS, RETRY_GATT_MAX_MS},       // GATT error
+    {RETRY_SERVICE_ATTEMPTS, RETRY_SERVICE_BASE_MS, RETRY_SERVICE_BASE_MS},
+    {RETRY_PARSE_ATTEMPTS, RETRY_PARSE_BASE_MS, RETRY_PARSE_BASE_MS},
+    {1, 0, 0},                                                          // bad data: phone has nothing better
+    {1, 0, 0},                                                          // auth: reading again gets the same bytes
+    {1, 0, 0},                                                          // network: the HTTP client already timed out
+    {1, 0, 0},                                                          // cancelled
+};
+
+// Backoff before the next attempt, given how many attempts of this class
+// have failed so far. rand32 is any uniformly distributed 32-bit value.
+static inline uint32_t retryBackoffMs(const RetryPolicy &policy, uint8_t failures, uint32_t rand32)
+{
+    if (policy.baseDelayMs == 0)
+    {
+        return 0;
+    }
+    uint8_t shift = failures > 0 ? failures - 1 : 0;
+    uint32_t ceiling = shift >= 16 ? policy.maxDelayMs : (uint32_t)policy.baseDelayMs << shift;
+    if (ceiling > policy.maxDelayMs)
+    {
+        ceiling = policy.maxDelayMs;
+    }
+    return rand32 % (ceiling + 1);
+}
+
+// Whether another attempt is allowed after `failures` failures of this class
+static inline bool retryAllowed(const RetryPolicy &policy, uint8_t failures, uint32_t elapsedMs)
+{
+    return failures < policy.maxAttempts && elapsedMs < RETRY_DEADLINE_MS;
+}
+
+#endif
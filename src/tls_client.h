@@ -0,0 +1,539 @@
+#ifndef TLS_CLIENT_H
+#define TLS_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/pk.h>
+#include "sha256_compat.h"
+#include "crc32.h"
+#include "log_helper.h"
+
+// TLS for the WiFi permit fetch, with session resumption and key pinning.
+//
+// WiFiClientSecure does a full handshake on every connect and has no way to
+// hand mbedTLS a saved session. This client runs mbedTLS itself over the
+// socket of a plain WiFiClient. After each handshake the session (ticket or
+// session ID plus master secret) is serialized into RTC memory, and the next
+// connect to the same host offers it, so the server can skip the
+// certificate exchange and key agreement. RTC memory survives deep sleep but
+// not power loss; a server that no longer knows the session just answers
+// with a full handshake.
+//
+// The pin list is a comma-separated list of hex SHA-256 digests of public
+// keys (over the DER SubjectPublicKeyInfo). The server is trusted if the
+// key of its own certificate (depth 0) is listed, or if a CA certificate
+// higher in the chain is listed and every certificate below it verifies:
+// signed by its parent, issued for the host name. A key pin survives
+// certificate renewals that keep the key; list a backup key too, e.g. the
+// issuing CA's. A listed key anywhere else proves nothing, since anyone can
+// send a public CA certificate after their own. Expiry is not checked (the
+// clock may not be set) and there is no CA bundle. A resumed handshake has
+// no certificates to check, but only a pinned full handshake can produce
+// the session it resumes.
+
+#define TLS_SESSION_MAX 2048         // Serialized session (includes the peer certificate)
+#define TLS_SESSION_MAGIC 0x544C5331 // "TLS1"
+#define TLS_SPKI_MAX 800             // DER public key, RSA-4096 fits
+#define TLS_PIN_HEX_LEN 64
+#define TLS_CHAIN_MAX 10             // Certificates checked per chain; deeper ones cannot be the pin
+// Chain errors that do not count against a pinned CA: no trusted clock
+#define TLS_FLAGS_IGNORED (MBEDTLS_X509_BADCERT_EXPIRED | MBEDTLS_X509_BADCERT_FUTURE)
+
+struct TlsSessionCache
+{
+    uint32_t magic;
+    char host[64];
+    uint16_t port;
+    uint16_t len;
+    uint32_t crc; // CRC-32 of data[0..len)
+    uint8_t data[TLS_SESSION_MAX];
+};
+
+RTC_DATA_ATTR static TlsSessionCache tlsSessionCache;
+
+static mbedtls_entropy_context tlsEntropy;
+static mbedtls_ctr_drbg_context tlsDrbg;
+static bool tlsDrbgReady = false;
+
+static bool tlsRngBegin()
+{
+    if (tlsDrbgReady)
+    {
+        return true;
+    }
+    static const char pers[] = "permit-tls";
+    mbedtls_entropy_init(&tlsEntropy);
+    mbedtls_ctr_drbg_init(&tlsDrbg);
+    int ret = mbedtls_ctr_drbg_seed(&tlsDrbg, mbedtls_entropy_func, &tlsEntropy,
+                                    (const unsigned char *)pers, sizeof(pers) - 1);
+    if (ret != 0)
+    {
+        LOG_E("TLS: RNG seed failed (-0x%04x)", (unsigned)-ret);
+        return false;
+    }
+    tlsDrbgReady = true;
+    return true;
+}
+
+void tlsSessionClear()
+{
+    memset(&tlsSessionCache, 0, offsetof(TlsSessionCache, data));
+}
+
+static bool tlsSessionMatches(const char *host, uint16_t port)
+{
+    return tlsSessionCache.magic == TLS_SESSION_MAGIC &&
+           tlsSessionCache.port == port &&
+           strncmp(tlsSessionCache.host, host, sizeof(tlsSessionCache.host)) == 0 &&
+           tlsSessionCache.len <= TLS_SESSION_MAX &&
+           tlsSessionCache.crc == crc32(tlsSessionCache.data, tlsSessionCache.len);
+}
+
+// Offer the cached session for host:port on the next handshake
+static bool tlsSessionOffer(mbedtls_ssl_context *ssl, const char *host, uint16_t port)
+{
+    if (!tlsSessionMatches(host, port))
+    {
+        return false;
+    }
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    bool ok = mbedtls_ssl_session_load(&session, tlsSessionCache.data, tlsSessionCache.len) == 0 &&
+              mbedtls_ssl_set_session(ssl, &session) == 0;
+    mbedtls_ssl_session_free(&session);
+    if (!ok)
+    {
+        tlsSessionClear();
+    }
+    return ok;
+}
+
+static void tlsSessionStore(mbedtls_ssl_context *ssl, const char *host, uint16_t port)
+{
+    if (strlen(host) >= sizeof(tlsSessionCache.host))
+    {
+        return;
+    }
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t len = 0;
+    int ret = mbedtls_ssl_get_session(ssl, &session);
+    if (ret == 0)
+    {
+        ret = mbedtls_ssl_session_save(&session, tlsSessionCache.data, TLS_SESSION_MAX, &len);
+    }
+    mbedtls_ssl_session_free(&session);
+    if (ret != 0)
+    {
+        LOG_W("TLS: session not cached (-0x%04x)", (unsigned)-ret);
+        tlsSessionClear();
+        return;
+    }
+    tlsSessionCache.magic = TLS_SESSION_MAGIC;
+    strcpy(tlsSessionCache.host, host);
+    tlsSessionCache.port = port;
+    tlsSessionCache.len = len;
+    tlsSessionCache.crc = crc32(tlsSessionCache.data, len);
+}
+
+// SHA-256 of a certificate's DER SubjectPublicKeyInfo, as lowercase hex
+static bool tlsKeyPin(mbedtls_x509_crt *crt, char hex[TLS_PIN_HEX_LEN + 1])
+{
+    unsigned char der[TLS_SPKI_MAX];
+    int len = mbedtls_pk_write_pubkey_der(&crt->pk, der, sizeof(der));
+    if (len <= 0)
+    {
+        return false;
+    }
+    uint8_t hash[32];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    SHA256_STARTS(&ctx);
+    SHA256_UPDATE(&ctx, der + sizeof(der) - len, len); // Written at the end of the buffer
+    SHA256_FINISH(&ctx, hash);
+    mbedtls_sha256_free(&ctx);
+    for (int i = 0; i < 32; i++)
+    {
+        sprintf(hex + 2 * i, "%02x", hash[i]);
+    }
+    return true;
+}
+
+static bool tlsPinListed(const char *pins, const char *hex)
+{
+    const char *p = pins;
+    while (*p)
+    {
+        while (*p == ',' || *p == ' ')
+        {
+            p++;
+        }
+        size_t n = strcspn(p, ", ");
+        if (n == TLS_PIN_HEX_LEN && strncasecmp(p, hex, n) == 0)
+        {
+            return true;
+        }
+        p += n;
+    }
+    return false;
+}
+
+class PinnedTlsClient : public WiFiClient
+{
+public:
+    explicit PinnedTlsClient(const char *pins) : pins(pins) {}
+
+    ~PinnedTlsClient()
+    {
+        tlsEnd();
+    }
+
+    // Timings of the last connect
+    unsigned long tcpMs = 0;
+    unsigned long handshakeMs = 0;
+    bool offered = false; // A cached session was offered
+    bool resumed = false; // ...and the server accepted it
+
+    // The host name is resolved once here; the TLS path below never goes
+    // back through the host overloads (WiFiClient's own host connect calls
+    // the IPAddress one, which would land here again).
+    int connect(IPAddress ip, uint16_t port) override
+    {
+        return connect(ip, port, 0);
+    }
+
+    int connect(IPAddress ip, uint16_t port, int32_t timeoutMs) override
+    {
+        String host = ip.toString();
+        return connectTls(ip, host.c_str(), port, timeoutMs);
+    }
+
+    int connect(const char *host, uint16_t port) override
+    {
+        return connect(host, port, 0);
+    }
+
+    int connect(const char *host, uint16_t port, int32_t timeoutMs) override
+    {
+        IPAddress ip;
+        if (!WiFi.hostByName(host, ip))
+        {
+            LOG_E("TLS: cannot resolve %s", host);
+            return 0;
+        }
+        return connectTls(ip, host, port, timeoutMs);
+    }
+
+    size_t write(uint8_t data) override
+    {
+        return write(&data, 1);
+    }
+
+    size_t write(const uint8_t *buf, size_t size) override
+    {
+        if (!active)
+        {
+            return 0;
+        }
+        size_t sent = 0;
+        unsigned long start = millis();
+        while (sent < size && millis() - start < 10000)
+        {
+            int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+            if (ret > 0)
+            {
+                sent += ret;
+            }
+            else if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+            {
+                delay(1);
+            }
+            else
+            {
+                break;
+            }
+        }
+        return sent;
+    }
+
+    int available() override
+    {
+        if (!active)
+        {
+            return 0;
+        }
+        if (mbedtls_ssl_get_bytes_avail(&ssl) == 0)
+        {
+            // Pull the next record off the socket (non-blocking)
+            mbedtls_ssl_read(&ssl, nullptr, 0);
+        }
+        return mbedtls_ssl_get_bytes_avail(&ssl) + (peeked >= 0 ? 1 : 0);
+    }
+
+    int read() override
+    {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+
+    int read(uint8_t *buf, size_t size) override
+    {
+        if (!active || size == 0)
+        {
+            return -1;
+        }
+        size_t got = 0;
+        if (peeked >= 0)
+        {
+            buf[got++] = (uint8_t)peeked;
+            peeked = -1;
+        }
+        if (got < size)
+        {
+            int ret = mbedtls_ssl_read(&ssl, buf + got, size - got);
+            if (ret > 0)
+            {
+                got += ret;
+            }
+        }
+        return got ? (int)got : -1;
+    }
+
+    int peek() override
+    {
+        if (peeked < 0)
+        {
+            uint8_t c;
+            if (active && mbedtls_ssl_read(&ssl, &c, 1) == 1)
+            {
+                peeked = c;
+            }
+        }
+        return peeked;
+    }
+
+    void flush() override {}
+
+    uint8_t connected() override
+    {
+        return active && (WiFiClient::connected() || available() > 0);
+    }
+
+    void stop() override
+    {
+        if (active)
+        {
+            mbedtls_ssl_close_notify(&ssl);
+        }
+        tlsEnd();
+        WiFiClient::stop();
+    }
+
+private:
+    const char *pins;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_net_context net;
+    bool active = false;
+    int peeked = -1;
+    int certsSeen = 0;
+    uint32_t pinnedDepths = 0;               // Bit d: the key at depth d is listed
+    uint32_t chainFlags[TLS_CHAIN_MAX];      // mbedTLS verify flags by depth
+    char leafPin[TLS_PIN_HEX_LEN + 1];
+
+    // TCP to ip with the base class, then the handshake for host (SNI and
+    // the session cache)
+    int connectTls(IPAddress ip, const char *host, uint16_t port, int32_t timeoutMs)
+    {
+        stop();
+        unsigned long timeout = timeoutMs > 0 ? timeoutMs : 10000;
+        unsigned long start = millis();
+        if (!WiFiClient::connect(ip, port, (int32_t)timeout))
+        {
+            return 0;
+        }
+        tcpMs = millis() - start;
+        if (!handshake(host, port, timeout))
+        {
+            stop();
+            return 0;
+        }
+        return 1;
+    }
+
+    // Called for every certificate in the chain on a full handshake.
+    // Records the pin match and chain errors per depth (authmode OPTIONAL
+    // lets the handshake finish); pinMatched() decides afterwards.
+    static int verifyPin(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+    {
+        PinnedTlsClient *self = (PinnedTlsClient *)ctx;
+        char hex[TLS_PIN_HEX_LEN + 1];
+        self->certsSeen++;
+        if (depth < 0 || depth >= TLS_CHAIN_MAX)
+        {
+            return 0;
+        }
+        self->chainFlags[depth] = *flags & ~TLS_FLAGS_IGNORED;
+        if (tlsKeyPin(crt, hex))
+        {
+            if (depth == 0)
+            {
+                strcpy(self->leafPin, hex);
+            }
+            if (tlsPinListed(self->pins, hex))
+            {
+                self->pinnedDepths |= 1u << depth;
+            }
+        }
+        return 0;
+    }
+
+    // The leaf key is listed, or a listed CA vouches for every certificate
+    // below it
+    bool pinMatched() const
+    {
+        uint32_t flagsBelow = 0;
+        for (int depth = 0; depth < TLS_CHAIN_MAX; depth++)
+        {
+            if ((pinnedDepths & (1u << depth)) && flagsBelow == 0)
+            {
+                return true;
+            }
+            flagsBelow |= chainFlags[depth];
+        }
+        return false;
+    }
+
+    bool handshake(const char *host, uint16_t port, unsigned long timeoutMs)
+    {
+        if (!tlsRngBegin())
+        {
+            return false;
+        }
+        mbedtls_ssl_init(&ssl);
+        mbedtls_ssl_config_init(&conf);
+        active = true;
+        peeked = -1;
+        certsSeen = 0;
+        pinnedDepths = 0;
+        memset(chainFlags, 0, sizeof(chainFlags));
+        leafPin[0] = '\0';
+
+        int ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                              MBEDTLS_SSL_PRESET_DEFAULT);
+        if (ret == 0)
+        {
+            mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
+            mbedtls_ssl_conf_verify(&conf, verifyPin, this);
+            mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &tlsDrbg);
+            ret = mbedtls_ssl_setup(&ssl, &conf);
+        }
+        if (ret == 0)
+        {
+            ret = mbedtls_ssl_set_hostname(&ssl, host);
+        }
+        if (ret != 0)
+        {
+            LOG_E("TLS: setup failed (-0x%04x)", (unsigned)-ret);
+            return false;
+        }
+
+        // The socket stays owned by WiFiClient; mbedTLS only reads and writes it
+        mbedtls_net_init(&net);
+        net.fd = fd();
+        mbedtls_net_set_nonblock(&net);
+        mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+        offered = tlsSessionOffer(&ssl, host, port);
+        unsigned long start = millis();
+        while ((ret = mbedtls_ssl_handshake(&ssl)) != 0)
+        {
+            if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+            {
+                LOG_E("TLS: handshake with %s failed (-0x%04x)", host, (unsigned)-ret);
+                tlsSessionClear();
+                return false;
+            }
+            if (millis() - start > timeoutMs)
+            {
+                LOG_E("TLS: handshake with %s timed out", host);
+                return false;
+            }
+            delay(1);
+        }
+        handshakeMs = millis() - start;
+        resumed = certsSeen == 0;
+
+        if (!resumed && !pinMatched())
+        {
+            LOG_E("TLS: %s key is not pinned%s (server key sha256 %s)", host,
+                  pinnedDepths ? ", or the chain below the pinned CA does not verify" : "",
+                  leafPin[0] ? leafPin : "?");
+            tlsSessionClear();
+            return false;
+        }
+        tlsSessionStore(&ssl, host, port);
+        LOG_D("TLS: %s handshake with %s in %lu ms (TCP %lu ms)", resumed ? "resumed" : "full",
+              host, handshakeMs, tcpMs);
+        return true;
+    }
+
+    void tlsEnd()
+    {
+        if (active)
+        {
+            mbedtls_ssl_free(&ssl);
+            mbedtls_ssl_config_free(&conf);
+            active = false;
+        }
+    }
+};
+
+// Handshake time with and without resumption. Point it at the local stand-in:
+//   python tools/permit_server.py --cert cert.pem --key key.pem --port 8443
+// which prints the pin to pass here. Full handshakes clear the cached
+// session first; resumed ones reuse whatever the previous connect saved.
+void benchmarkTlsHandshake(const char *host, uint16_t port, const char *pins, int runs)
+{
+    const char *modeNames[] = {"full", "resumed"};
+    LOG_STAT("\n=== TLS handshake benchmark: %d runs per mode, %s:%u ===", runs, host, port);
+
+    for (int mode = 0; mode < 2; mode++)
+    {
+        unsigned long totalMs = 0, maxMs = 0, tcpTotalMs = 0;
+        uint32_t minHeap = ESP.getFreeHeap();
+        int failures = 0, resumedCount = 0;
+
+        for (int i = 0; i < runs; i++)
+        {
+            if (mode == 0)
+            {
+                tlsSessionClear();
+            }
+            PinnedTlsClient client(pins);
+            if (!client.connect(host, port, 10000))
+            {
+                failures++;
+                continue;
+            }
+            minHeap = min(minHeap, ESP.getFreeHeap());
+            totalMs += client.handshakeMs;
+            tcpTotalMs += client.tcpMs;
+            maxMs = max(maxMs, client.handshakeMs);
+            resumedCount += client.resumed ? 1 : 0;
+            client.stop();
+        }
+
+        int ok = runs - failures;
+        LOG_STAT("  %-7s mean %lu ms, max %lu ms (TCP connect %lu ms), %d resumed, %d failed, min free heap %lu",
+                 modeNames[mode], ok ? totalMs / ok : 0, maxMs, ok ? tcpTotalMs / ok : 0,
+                 resumedCount, failures, (unsigned long)minHeap);
+    }
+}
+
+#endif
@@ -0,0 +1,388 @@
+#ifndef USB_PROVISION_H
+#define USB_PROVISION_H
+
+#include <Arduino.h>
+#include "provision_frame.h"
+#include "permit_config.h"
+#include "permit_source.h"
+#include "permit_store.h"
+#include "permit_queue.h"
+#include "ble_pairing.h"
+#include "bluetooth_helper.h"
+#include "render_profiler.h"
+#include "mem_telemetry.h"
+#include "log_helper.h"
+
+// Bench provisioning over the native USB port, so a batch of displays can
+// be set up without pairing each one with a phone. tools/usb_provision.py
+// drives it; the framing is in provision_frame.h.
+//
+// Writes are acknowledged once they are in flash, so an OK means the
+// display keeps them over a power cut. USB needs the device in hand, so
+// unsigned permits are accepted even when paired (as for permit_serial.h).
+// The port is only read from loop(): frames sent while a sync is running
+// are taken by the serial permit source and lost, and the host retries.
+//
+// PROV_SETTINGS payload: mask, flags, then the fields named in mask
+//   PROV_SET_FLIP   flags bit 0 is the new display rotation
+//   PROV_SET_KEY    32-byte payload key (as pairing would set it)
+//   PROV_SET_CLOCK  local time, seconds since 1970 (4, LE)
+
+#define PROV_SET_FLIP 0x01
+#define PROV_SET_KEY 0x02
+#define PROV_SET_CLOCK 0x04
+#define PROV_FLAG_FLIPPED 0x01
+
+#define PROVISION_RX_BUFFER (2 * PROV_FRAME_MAX)  // Serial.setRxBufferSize(), before Serial.begin()
+#define PROVISION_ACTIVE_MS 2000                  // Poll fast for this long after a frame
+#define PROVISION_FRAME_BYTES (((SCREEN_W + 7) / 8) * SCREEN_H)  // GFXcanvas1 layout
+
+// What changed; provisionPoll() returns these as flags for loop() to act on
+#define PROVISION_PERMIT 0x01    // Permit replaced (and the queue with it)
+#define PROVISION_QUEUE 0x02     // Upcoming permits replaced
+#define PROVISION_SETTINGS 0x04  // Rotation, key or clock changed
+#define PROVISION_FRAME 0x08     // provisionFrameBuffer() holds a frame to draw
+
+struct ProvisionStats
+{
+    uint32_t frames;      // Requests handled
+    uint32_t duplicates;  // Repeated requests answered from the last reply
+    uint32_t badFrames;   // CRC or length errors
+    uint32_t bytesIn;
+};
+
+static ProvisionStats provisionStats;
+static ProvParser provParser;
+static uint8_t provReply[PROV_FRAME_MAX];  // Last reply, kept for repeats
+static size_t provReplyLen = 0;
+static uint8_t provLastType = 0;
+static uint8_t provLastSeq = 0;
+static unsigned long provLastFrameAt = 0;
+static uint8_t *provFrameBuf = nullptr;     // Allocated by the first PROV_FRAME chunk
+static PermitData *provPermit = nullptr;    // loop()'s permit and queue
+static PermitQueue *provQueue = nullptr;
+
+// Hand over the permit and queue that provisioning replaces
+void provisionBegin(PermitData *permit, PermitQueue *queue)
+{
+    provPermit = permit;
+    provQueue = queue;
+}
+
+// True shortly after a frame came in; loop() polls faster meanwhile
+bool provisionActive()
+{
+    return provLastFrameAt && millis() - provLastFrameAt < PROVISION_ACTIVE_MS;
+}
+
+const uint8_t *provisionFrameBuffer()
+{
+    return provFrameBuf;
+}
+
+// Free the framebuffer once it has been drawn
+void provisionFrameRelease()
+{
+    free(provFrameBuf);
+    provFrameBuf = nullptr;
+}
+
+static void provSend(uint8_t type, uint8_t seq, ProvStatus status, const uint8_t *data = nullptr, size_t len = 0)
+{
+    uint8_t payload[PROV_PAYLOAD_MAX];
+    payload[0] = status;
+    len = min(len, (size_t)PROV_PAYLOAD_MAX - 1);
+    if (len)
+    {
+        memcpy(payload + 1, data, len);
+    }
+    provReplyLen = provEncode(provReply, type, seq, payload, len + 1);
+    Serial.write(provReply, provReplyLen);  // One write, so log output cannot split it
+}
+
+static ProvStatus provHandlePermit(const ProvFrame &f, uint8_t *changed)
+{
+    static PermitData staged;
+    static PermitQueue stagedQueue;
+    SyncFailure failure;
+    permitSourcesBegin();
+    int result = acceptPermitPayload(f.payload, f.len, true, provPermit->permitNumber,
+                                     &staged, &stagedQueue, &failure);
+    if (result == 0)
+    {
+        return failure == SYNC_FAIL_AUTH ? PROV_ERR_AUTH : PROV_ERR_BAD_DATA;
+    }
+
+    *provPermit = staged;
+    *provQueue = stagedQueue;
+    permitStoreAuthCounter = permitAuth.lastCounter;
+    *changed |= PROVISION_PERMIT;
+    if (!savePermitData(provPermit) || !savePermitQueue(provQueue))
+    {
+        return PROV_ERR_FLASH;
+    }
+    return savePermitAuthCounter() ? PROV_OK : PROV_ERR_FLASH;
+}
+
+static ProvStatus provHandleQueue(const ProvFrame &f, uint8_t *changed)
+{
+    permitSourcesBegin();
+    xSemaphoreTake(permitAcceptLock, portMAX_DELAY);  // Shares the JSON arena with the sources
+    permitJsonArena.reset();
+    JsonDocument doc(&permitJsonArena);
+    DeserializationError error = deserializeJson(doc, (const char *)f.payload, f.len);
+    bool ok = !error && doc["queue"].is<JsonArrayConst>();
+    if (ok)
+    {
+        permitQueueFromJson(provQueue, doc["queue"], provPermit->displayFlipped);
+        permitQueueRemove(provQueue, provPermit->permitNumber);
+        if (doc["now"].is<uint32_t>())
+        {
+            permitSetClock(doc["now"].as<uint32_t>());
+        }
+    }
+    xSemaphoreGive(permitAcceptLock);
+
+    if (!ok)
+    {
+        LOG_W("Provision: queue payload rejected (%s)", error ? error.c_str() : "no queue array");
+        return PROV_ERR_BAD_DATA;
+    }
+    LOG_I("Provision: %d upcoming permit(s)", provQueue->count);
+    *changed |= PROVISION_QUEUE;
+    return savePermitQueue(provQueue) ? PROV_OK : PROV_ERR_FLASH;
+}
+
+static ProvStatus provHandleSettings(const ProvFrame &f, uint8_t *changed)
+{
+    if (f.len < 2)
+    {
+        return PROV_ERR_LENGTH;
+    }
+    uint8_t mask = f.payload[0];
+    uint8_t flags = f.payload[1];
+    size_t need = 2 + ((mask & PROV_SET_KEY) ? PERMIT_AUTH_KEY_SIZE : 0) + ((mask & PROV_SET_CLOCK) ? 4 : 0);
+    if (f.len != need)
+    {
+        return PROV_ERR_LENGTH;
+    }
+    // The rotation is saved with the permit record, so it needs a permit
+    if ((mask & PROV_SET_FLIP) && provPermit->permitNumber[0] == '\0')
+    {
+        LOG_W("Provision: rotation needs a permit first");
+        return PROV_ERR_BAD_DATA;
+    }
+
+    const uint8_t *p = f.payload + 2;
+    ProvStatus status = PROV_OK;
+    if (mask & PROV_SET_KEY)
+    {
+        if (!pairingStoreKey(p))
+        {
+            status = PROV_ERR_FLASH;
+        }
+        permitStoreAuthCounter = 0;
+        if (!savePermitAuthCounter())
+        {
+            status = PROV_ERR_FLASH;
+        }
+        p += PERMIT_AUTH_KEY_SIZE;
+    }
+    if (mask & PROV_SET_CLOCK)
+    {
+        permitSetClock(provGet32(p));
+    }
+    if (mask & PROV_SET_FLIP)
+    {
+        provPermit->displayFlipped = flags & PROV_FLAG_FLIPPED;
+        for (int i = 0; i < provQueue->count; i++)
+        {
+            provQueue->entries[i].displayFlipped = provPermit->displayFlipped;
+        }
+        if (!savePermitData(provPermit) || !savePermitQueue(provQueue))
+        {
+            status = PROV_ERR_FLASH;
+        }
+    }
+    *changed |= PROVISION_SETTINGS;
+    return status;
+}
+
+static ProvStatus provHandleFrame(const ProvFrame &f)
+{
+    if (f.len < 2)
+    {
+        return PROV_ERR_LENGTH;
+    }
+    uint16_t offset = provGet16(f.payload);
+    size_t len = f.len - 2;
+    if (offset + len > PROVISION_FRAME_BYTES)
+    {
+        return PROV_ERR_LENGTH;
+    }
+    if (!provFrameBuf)
+    {
+        provFrameBuf = (uint8_t *)calloc(1, PROVISION_FRAME_BYTES);
+        if (!provFrameBuf)
+        {
+            return PROV_ERR_MEMORY;
+        }
+    }
+    memcpy(provFrameBuf + offset, f.payload + 2, len);
+    return PROV_OK;
+}
+
+static ProvStatus provHandleFrameShow(const ProvFrame &f, uint8_t *changed)
+{
+    if (f.len != 4)
+    {
+        return PROV_ERR_LENGTH;
+    }
+    if (!provFrameBuf || crc32(provFrameBuf, PROVISION_FRAME_BYTES) != provGet32(f.payload))
+    {
+        LOG_W("Provision: framebuffer incomplete or corrupt");
+        return PROV_ERR_BAD_DATA;
+    }
+    *changed |= PROVISION_FRAME;
+    return PROV_OK;
+}
+
+// Reply to PROV_HELLO: version, payload max, frame size, device id, build
+static void provSendHello(const ProvFrame &f)
+{
+    uint8_t info[64];
+    info[0] = PROV_PROTOCOL_VERSION;
+    provPut16(info + 1, PROV_PAYLOAD_MAX);
+    provPut16(info + 3, SCREEN_W);
+    provPut16(info + 5, SCREEN_H);
+    uint64_t mac = ESP.getEfuseMac();
+    for (int i = 0; i < 6; i++)
+    {
+        info[7 + i] = mac >> (8 * i);
+    }
+    int len = 13 + snprintf((char *)info + 13, sizeof(info) - 13, "%s %s", __DATE__, __TIME__);
+    provSend(f.type | PROV_REPLY, f.seq, PROV_OK, info, min(len, (int)sizeof(info) - 1));
+}
+
+// Reply to PROV_DIAG: one "key=value" per line
+static void provSendDiag(const ProvFrame &f)
+{
+    static char text[PROV_PAYLOAD_MAX - 1];
+    MemSample mem;
+    memSample(&mem);
+    int len = snprintf(text, sizeof(text),
+                       "uptime_ms=%lu\npermit=%s\nplate=%s\nvalid_from=%s\nvalid_to=%s\nflipped=%d\n"
+                       "queue=%d\npaired=%d\nauth_counter=%lu\nclock=%ld\n"
+                       "heap_free=%lu\nheap_min=%lu\nheap_largest=%lu\n"
+                       "store_writes=%lu\nstore_skipped=%lu\ningest_calls=%lu\nlog_dropped=%lu\n"
+                       "prov_frames=%lu\nprov_duplicates=%lu\nprov_bad_frames=%lu\nprov_skipped=%lu\n",
+                       millis(), provPermit->permitNumber, provPermit->plateNumber,
+                       provPermit->validFrom, provPermit->validTo, provPermit->displayFlipped,
+                       provQueue->count, permitAuth.paired, (unsigned long)permitAuth.lastCounter,
+                       permitClockValid() ? (long)time(nullptr) : 0L,
+                       (unsigned long)mem.freeHeap, (unsigned long)mem.minFreeHeap,
+                       (unsigned long)mem.largestBlock,
+                       (unsigned long)permitStoreStats.writes, (unsigned long)permitStoreStats.skippedWrites,
+                       (unsigned long)permitIngestStats.calls, (unsigned long)logStats.dropped,
+                       (unsigned long)provisionStats.frames, (unsigned long)provisionStats.duplicates,
+                       (unsigned long)provisionStats.badFrames, (unsigned long)provParser.skipped);
+    for (int i = 1; i < SYNC_FAIL_CLASS_COUNT && len < (int)sizeof(text); i++)
+    {
+        len += snprintf(text + len, sizeof(text) - len, "sync_fail[%s]=%lu\n",
+                        SYNC_FAILURE_NAMES[i], (unsigned long)syncFailureCounts[i]);
+    }
+    for (int k = 0; k < RENDER_KIND_COUNT && len < (int)sizeof(text); k++)
+    {
+        char line[RENDER_PROFILE_LINE_MAX];
+        if (renderProfileLine((RenderKind)k, line, sizeof(line)))
+        {
+            len += snprintf(text + len, sizeof(text) - len, "render[%s]=%s\n", RENDER_KIND_NAMES[k], line);
+        }
+    }
+    provSend(f.type | PROV_REPLY, f.seq, PROV_OK, (const uint8_t *)text, min(len, (int)sizeof(text) - 1));
+}
+
+static void provHandle(const ProvFrame &f, uint8_t *changed)
+{
+    provLastFrameAt = millis();
+    if (provReplyLen && f.type == provLastType && f.seq == provLastSeq)
+    {
+        // Our reply was lost: answer again, do not apply twice
+        provisionStats.duplicates++;
+        Serial.write(provReply, provReplyLen);
+        return;
+    }
+    provisionStats.frames++;
+    provLastType = f.type;
+    provLastSeq = f.seq;
+
+    ProvStatus status;
+    switch (f.type)
+    {
+    case PROV_HELLO:
+        provSendHello(f);
+        return;
+    case PROV_DIAG:
+        provSendDiag(f);
+        return;
+    case PROV_PERMIT:
+        status = provHandlePermit(f, changed);
+        break;
+    case PROV_QUEUE:
+        status = provHandleQueue(f, changed);
+        break;
+    case PROV_SETTINGS:
+        status = provHandleSettings(f, changed);
+        break;
+    case PROV_FRAME:
+        status = provHandleFrame(f);
+        break;
+    case PROV_FRAME_SHOW:
+        status = provHandleFrameShow(f, changed);
+        break;
+    default:
+        status = PROV_ERR_TYPE;
+        break;
+    }
+    if (status != PROV_OK)
+    {
+        LOG_W("Provision: request %d failed: %s", f.type, PROV_STATUS_NAMES[status]);
+    }
+    provSend(f.type | PROV_REPLY, f.seq, status);
+}
+
+// Call from loop(). Handles whatever frames have arrived and returns the
+// PROVISION_* flags for what changed.
+uint8_t provisionPoll()
+{
+    uint8_t changed = 0;
+    if (!provPermit)
+    {
+        return 0;
+    }
+    int n;
+    while ((n = Serial.available()) > 0)
+    {
+        uint8_t buf[64];
+        n = Serial.readBytes(buf, min(n, (int)sizeof(buf)));
+        provisionStats.bytesIn += n;
+        for (int i = 0; i < n; i++)
+        {
+            ProvParseResult result = provParser.feed(buf[i]);
+            if (result == PROV_PARSE_FRAME)
+            {
+                provHandle(provParser.frame(), &changed);
+            }
+            else if (result != PROV_PARSE_MORE)
+            {
+                provisionStats.badFrames++;
+                provSend(PROV_NAK, provParser.frame().seq,
+                         result == PROV_PARSE_BAD_CRC ? PROV_ERR_CRC : PROV_ERR_LENGTH);
+                provReplyLen = 0;  // A NAK is never repeated for a retry
+            }
+        }
+    }
+    return changed;
+}
+
+#endif
@@ -2,11 +2,17 @@
 #define WIFI_HELPER_H
 
 #include <WiFi.h>
-#include <WiFiClientSecure.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <Preferences.h>
 #include "wifi_config.h"
+#include "permit_store.h"
+#include "permit_ingest.h"
+#include "permit_source.h"
+#include "crc32.h"
+#include "energy_model.h"
+#include "tls_client.h"
+#include "log_helper.h"
 
 // WiFi timeout for connection attempts (milliseconds)
 #ifndef WIFI_TIMEOUT
@@ -20,338 +26,554 @@
 #define COLOR_YELLOW  "\033[33m"
 #define COLOR_MAGENTA "\033[35m"
 
-static Preferences preferences;
+// SHA-256 pins of the server's public keys (see tls_client.h), normally set in wifi_config.h.
+// With none set every https fetch fails, and the log shows the key to pin.
+#ifndef SERVER_PIN_SHA256
+#define SERVER_PIN_SHA256 ""
+#endif
+
+// Fast path timeout: straight to the cached BSSID/channel, before falling back to a scan
+#ifndef WIFI_FAST_TIMEOUT
+#define WIFI_FAST_TIMEOUT 3000
+#endif
+
+// Reuse the last DHCP lease as a static IP on the fast path (skips DHCP).
+// If the network hands out a different address later, the fast path fails
+// once and the scan path picks up a fresh lease.
+#ifndef WIFI_REUSE_LEASE
+#define WIFI_REUSE_LEASE 1
+#endif
+
+#define WIFI_NVS_NAMESPACE "wifi"
+#define WIFI_CACHE_MAGIC 0x57464331  // "WFC1"
+
+struct WifiNetwork {
+  const char* ssid;
+  const char* password;
+  const char* name;
+};
+
+static const WifiNetwork WIFI_NETWORKS[] = {
+  {WIFI_SSID_1, WIFI_PASS_1, "Vytis_Svecias"},
+  {WIFI_SSID_2, WIFI_PASS_2, "phone"},
+  {WIFI_SSID_3, WIFI_PASS_3, "36Batavia"}
+};
+#define WIFI_NETWORK_COUNT (sizeof(WIFI_NETWORKS) / sizeof(WIFI_NETWORKS[0]))
 
-struct PermitData {
-  char permitNumber[20];
-  char plateNumber[20];
-  char validFrom[30];
-  char validTo[30];
-  char barcodeValue[20];
-  char barcodeLabel[20];
+// Last network that worked. Kept in RTC memory (survives deep sleep) and
+// in NVS (survives power loss); RTC is checked first since it is free to read.
+struct WifiCache {
+  uint32_t magic;
+  uint8_t network;     // Index into WIFI_NETWORKS
+  uint8_t channel;
+  uint8_t bssid[6];
+  uint32_t ip;         // DHCP lease to reuse (0 = use DHCP)
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t crc;        // CRC-32 of all bytes before this field
 };
 
-// Helper function to safely copy JSON string to char array
-void safeJsonCopy(char* dest, size_t destSize, JsonDocument& doc, const char* key) {
-  const char* value = doc[key] | "";
-  strncpy(dest, value, destSize - 1);
-  dest[destSize - 1] = '\0';
+RTC_DATA_ATTR static WifiCache wifiRtcCache;
+
+static bool wifiCacheValid(const WifiCache* cache) {
+  return cache->magic == WIFI_CACHE_MAGIC &&
+         cache->network < WIFI_NETWORK_COUNT &&
+         cache->crc == crc32(cache, offsetof(WifiCache, crc));
 }
 
-// Load permit data from flash memory
-bool loadPermitData(PermitData* data) {
-  preferences.begin("permit", true); // true = read-only
-  
-  bool hasData = preferences.isKey("permitNum");
-  
-  if (hasData) {
-    preferences.getString("permitNum", data->permitNumber, sizeof(data->permitNumber));
-    preferences.getString("plateNum", data->plateNumber, sizeof(data->plateNumber));
-    preferences.getString("validFrom", data->validFrom, sizeof(data->validFrom));
-    preferences.getString("validTo", data->validTo, sizeof(data->validTo));
-    preferences.getString("barcodeVal", data->barcodeValue, sizeof(data->barcodeValue));
-    preferences.getString("barcodeLabel", data->barcodeLabel, sizeof(data->barcodeLabel));
-    
-    preferences.end();
-    Serial.print(COLOR_GREEN);
-    Serial.print("Loaded permit data from flash. Permit #: ");
-    Serial.print(data->permitNumber);
-    Serial.print(COLOR_RESET);
-    Serial.println();
+static bool wifiCacheLoad(WifiCache* cache) {
+  if (wifiCacheValid(&wifiRtcCache)) {
+    *cache = wifiRtcCache;
     return true;
   }
-  
-  preferences.end();
-  Serial.print(COLOR_YELLOW);
-  Serial.print("No saved permit data found in flash.");
-  Serial.print(COLOR_RESET);
-  Serial.println();
-  return false;
+  Preferences prefs;
+  prefs.begin(WIFI_NVS_NAMESPACE, true);
+  bool ok = prefs.getBytes("cache", cache, sizeof(WifiCache)) == sizeof(WifiCache) && wifiCacheValid(cache);
+  prefs.end();
+  if (ok) {
+    wifiRtcCache = *cache;
+  }
+  return ok;
+}
+
+// Store the network we are connected to (NVS only written when it changed)
+static void wifiCacheSave(uint8_t network) {
+  WifiCache cache;
+  memset(&cache, 0, sizeof(cache));
+  cache.magic = WIFI_CACHE_MAGIC;
+  cache.network = network;
+  cache.channel = WiFi.channel();
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.ip = (uint32_t)WiFi.localIP();
+  cache.gateway = (uint32_t)WiFi.gatewayIP();
+  cache.subnet = (uint32_t)WiFi.subnetMask();
+  cache.dns = (uint32_t)WiFi.dnsIP();
+  cache.crc = crc32(&cache, offsetof(WifiCache, crc));
+
+  if (wifiCacheValid(&wifiRtcCache) && memcmp(&cache, &wifiRtcCache, sizeof(cache)) == 0) {
+    return;
+  }
+  wifiRtcCache = cache;
+  Preferences prefs;
+  prefs.begin(WIFI_NVS_NAMESPACE, false);
+  prefs.putBytes("cache", &cache, sizeof(cache));
+  prefs.end();
 }
 
-// Save permit data to flash memory
-void savePermitData(PermitData* data) {
-  preferences.begin("permit", false); // false = read/write
-  
-  preferences.putString("permitNum", data->permitNumber);
-  preferences.putString("plateNum", data->plateNumber);
-  preferences.putString("validFrom", data->validFrom);
-  preferences.putString("validTo", data->validTo);
-  preferences.putString("barcodeVal", data->barcodeValue);
-  preferences.putString("barcodeLabel", data->barcodeLabel);
-  
-  preferences.end();
-  Serial.print(COLOR_GREEN);
-  Serial.print("Saved permit data to flash. Permit #: ");
-  Serial.print(data->permitNumber);
-  Serial.print(COLOR_RESET);
-  Serial.println();
+static void wifiCacheClear() {
+  memset(&wifiRtcCache, 0, sizeof(wifiRtcCache));
+  Preferences prefs;
+  prefs.begin(WIFI_NVS_NAMESPACE, false);
+  prefs.remove("cache");
+  prefs.end();
 }
 
-// OPTIMIZED: Scan-first WiFi connection for faster connection
-bool connectToWiFi() {
-  Serial.println("\n=== WiFi Connection Attempt ===");
-  Serial.println("Scanning for available networks...");
-  
+static void wifiBegin(const WifiNetwork& net, int32_t channel, const uint8_t* bssid) {
+  // Open networks have an empty password
+  WiFi.begin(net.ssid, strlen(net.password) ? net.password : nullptr, channel, bssid);
+}
+
+static bool wifiWaitConnected(unsigned long timeoutMs) {
+  unsigned long startTime = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - startTime < timeoutMs) {
+    delay(20);
+  }
+  return WiFi.status() == WL_CONNECTED;
+}
+
+// Go straight to the cached access point, skipping the scan (and DHCP if a lease is cached)
+static bool connectFromCache() {
+  WifiCache cache;
+  if (!wifiCacheLoad(&cache)) {
+    return false;
+  }
+  const WifiNetwork& net = WIFI_NETWORKS[cache.network];
+  LOG_I("Fast connect to %s (channel %d, %02x:%02x:%02x:%02x:%02x:%02x)...", net.name, cache.channel,
+        cache.bssid[0], cache.bssid[1], cache.bssid[2], cache.bssid[3], cache.bssid[4], cache.bssid[5]);
+
+  WiFi.mode(WIFI_STA);
+  if (WIFI_REUSE_LEASE && cache.ip) {
+    WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+  }
+  wifiBegin(net, cache.channel, cache.bssid);
+  if (wifiWaitConnected(WIFI_FAST_TIMEOUT)) {
+    LOG_I(COLOR_GREEN "Connected to %s!" COLOR_RESET, net.name);
+    return true;
+  }
+
+  LOG_W(COLOR_YELLOW "Fast connect failed - falling back to scan" COLOR_RESET);
+  WiFi.disconnect();
+  // Back to DHCP for the scan path
+  WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+  wifiCacheClear();
+  return false;
+}
+
+// Scan, then try the configured networks in range from strongest to weakest
+static bool connectFromScan() {
+  LOG_I("Scanning for available networks...");
+
   // Scan for networks (async=false, show_hidden=false, passive=false, max_ms=200)
   int n = WiFi.scanNetworks(false, false, false, 200);
-  
-  if (n == 0) {
-    Serial.print(COLOR_RED);
-    Serial.print("No networks found!");
-    Serial.print(COLOR_RESET);
-    Serial.println();
+
+  if (n <= 0) {
+    LOG_W(COLOR_RED "No networks found!" COLOR_RESET);
     return false;
   }
-  
-  Serial.print("Found ");
-  Serial.print(n);
-  Serial.println(" networks");
-  
-  // Priority order: check which networks are in range
-  struct NetworkPriority {
-    const char* ssid;
-    const char* password;
-    const char* name;
-    int rssi;  // Signal strength
-    bool found;
-  };
-  
-  NetworkPriority networks[] = {
-    {WIFI_SSID_1, WIFI_PASS_1, "Vytis_Svecias", -999, false},
-    {WIFI_SSID_2, WIFI_PASS_2, "phone", -999, false},
-    {WIFI_SSID_3, WIFI_PASS_3, "36Batavia", -999, false}
+
+  LOG_I("Found %d networks", n);
+
+  // Strongest access point seen for each configured network
+  struct Candidate {
+    uint8_t network;
+    int32_t rssi;
+    int32_t channel;
+    uint8_t bssid[6];
   };
-  
-  // Check which of our networks are available
+  Candidate candidates[WIFI_NETWORK_COUNT];
+  int count = 0;
+
   for (int i = 0; i < n; i++) {
     String ssid = WiFi.SSID(i);
-    int rssi = WiFi.RSSI(i);
-    
-    for (int j = 0; j < 3; j++) {
-      if (ssid == networks[j].ssid) {
-        networks[j].found = true;
-        networks[j].rssi = rssi;
-        Serial.print("  Found: ");
-        Serial.print(networks[j].name);
-        Serial.print(" (RSSI: ");
-        Serial.print(rssi);
-        Serial.println(" dBm)");
+    for (uint8_t j = 0; j < WIFI_NETWORK_COUNT; j++) {
+      if (ssid != WIFI_NETWORKS[j].ssid) {
+        continue;
       }
-    }
-  }
-  
-  // Try to connect in priority order
-  for (int i = 0; i < 3; i++) {
-    if (networks[i].found) {
-      Serial.print("Connecting to ");
-      Serial.print(networks[i].name);
-      Serial.println("...");
-      
-      // Check if password is empty (open network)
-      if (strlen(networks[i].password) == 0) {
-        WiFi.begin(networks[i].ssid);
-      } else {
-        WiFi.begin(networks[i].ssid, networks[i].password);
+      int k = 0;
+      while (k < count && candidates[k].network != j) {
+        k++;
       }
-      
-      unsigned long startTime = millis();
-      while (WiFi.status() != WL_CONNECTED && millis() - startTime < WIFI_TIMEOUT) {
-        delay(100);
-        Serial.print(".");
+      int32_t rssi = WiFi.RSSI(i);
+      if (k == count) {
+        count++;
+      } else if (rssi <= candidates[k].rssi) {
+        continue;
       }
-      
-      if (WiFi.status() == WL_CONNECTED) {
-        Serial.println();
-        Serial.print(COLOR_GREEN);
-        Serial.print("Connected to ");
-        Serial.print(networks[i].name);
-        Serial.print("!");
-        Serial.print(COLOR_RESET);
-        Serial.println();
-        Serial.print("  IP: ");
-        Serial.println(WiFi.localIP());
-        Serial.print("  Signal: ");
-        Serial.print(networks[i].rssi);
-        Serial.println(" dBm");
-        return true;
-      }
-      
-      Serial.println();
-      Serial.print(COLOR_YELLOW);
-      Serial.print("Failed to connect to ");
-      Serial.print(networks[i].name);
-      Serial.print(COLOR_RESET);
-      Serial.println();
-      WiFi.disconnect();
+      candidates[k].network = j;
+      candidates[k].rssi = rssi;
+      candidates[k].channel = WiFi.channel(i);
+      memcpy(candidates[k].bssid, WiFi.BSSID(i), sizeof(candidates[k].bssid));
+      LOG_I("  Found: %s (RSSI: %d dBm, channel %d)", WIFI_NETWORKS[j].name, (int)rssi, (int)candidates[k].channel);
+    }
+  }
+  WiFi.scanDelete();
+
+  // Strongest first
+  for (int i = 1; i < count; i++) {
+    Candidate key = candidates[i];
+    int j = i - 1;
+    while (j >= 0 && candidates[j].rssi < key.rssi) {
+      candidates[j + 1] = candidates[j];
+      j--;
     }
+    candidates[j + 1] = key;
+  }
+
+  for (int i = 0; i < count; i++) {
+    const WifiNetwork& net = WIFI_NETWORKS[candidates[i].network];
+    LOG_I("Connecting to %s...", net.name);
+    wifiBegin(net, candidates[i].channel, candidates[i].bssid);
+
+    if (wifiWaitConnected(WIFI_TIMEOUT)) {
+      LOG_I(COLOR_GREEN "Connected to %s!" COLOR_RESET, net.name);
+      LOG_I("  Signal: %d dBm", (int)candidates[i].rssi);
+      wifiCacheSave(candidates[i].network);
+      return true;
+    }
+
+    LOG_W(COLOR_YELLOW "Failed to connect to %s" COLOR_RESET, net.name);
+    WiFi.disconnect();
+  }
+
+  LOG_W(COLOR_RED "None of your configured networks are in range." COLOR_RESET);
+  return false;
+}
+
+static bool wifiRadioCounted = false;  // energyRadioOn() done, until disconnectWiFi()
+
+// Cached access point first, scan + RSSI-ranked attempts only if that fails
+bool connectToWiFi() {
+  LOG_I("\n=== WiFi Connection Attempt ===");
+  unsigned long start = millis();
+  if (!wifiRadioCounted) {
+    energyRadioOn();
+    wifiRadioCounted = true;
   }
-  
-  Serial.print(COLOR_RED);
-  Serial.print("None of your configured networks are in range.");
-  Serial.print(COLOR_RESET);
-  Serial.println();
+
+  if (connectFromCache()) {
+    LOG_STAT("WiFi connected via cache in %lu ms (IP %s)", millis() - start, WiFi.localIP().toString().c_str());
+    return true;
+  }
+
+  unsigned long scanStart = millis();
+  if (connectFromScan()) {
+    LOG_STAT("WiFi connected via scan in %lu ms (%lu ms total, IP %s)",
+             millis() - scanStart, millis() - start, WiFi.localIP().toString().c_str());
+    return true;
+  }
+
+  LOG_STAT("WiFi connect failed after %lu ms", millis() - start);
   return false;
 }
 
-// FIXED: Added forceUpdate parameter
+void disconnectWiFi() {
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  if (wifiRadioCounted) {
+    energyRadioOff();
+    wifiRadioCounted = false;
+  }
+  LOG_I("WiFi disconnected to save power.");
+}
+
+// HTTP validators from the last permit download, kept in the permit's NVS
+// namespace so they live and die with the saved permit. Sent as
+// If-None-Match / If-Modified-Since so an unchanged permit comes back as a
+// bodyless 304.
+#define PERMIT_NVS_ETAG "etag"
+#define PERMIT_NVS_LAST_MODIFIED "lastMod"
+
+struct HttpValidators {
+  char etag[72];
+  char lastModified[40];
+};
+
+static void httpValidatorsLoad(HttpValidators* v) {
+  memset(v, 0, sizeof(HttpValidators));
+  Preferences prefs;
+  prefs.begin(PERMIT_NVS_NAMESPACE, true);
+  if (prefs.isKey(PERMIT_NVS_ETAG)) {
+    prefs.getString(PERMIT_NVS_ETAG, v->etag, sizeof(v->etag));
+  }
+  if (prefs.isKey(PERMIT_NVS_LAST_MODIFIED)) {
+    prefs.getString(PERMIT_NVS_LAST_MODIFIED, v->lastModified, sizeof(v->lastModified));
+  }
+  prefs.end();
+}
+
+static void httpValidatorsFromResponse(HTTPClient& http, HttpValidators* v) {
+  memset(v, 0, sizeof(HttpValidators));
+  strncpy(v->etag, http.header("ETag").c_str(), sizeof(v->etag) - 1);
+  strncpy(v->lastModified, http.header("Last-Modified").c_str(), sizeof(v->lastModified) - 1);
+}
+
+// Save only when they changed (every 200 would otherwise cost a flash write)
+static void httpValidatorsSave(const HttpValidators* v) {
+  HttpValidators old;
+  httpValidatorsLoad(&old);
+  if (memcmp(&old, v, sizeof(HttpValidators)) == 0) {
+    return;
+  }
+  Preferences prefs;
+  prefs.begin(PERMIT_NVS_NAMESPACE, false);
+  prefs.putString(PERMIT_NVS_ETAG, v->etag);
+  prefs.putString(PERMIT_NVS_LAST_MODIFIED, v->lastModified);
+  prefs.end();
+}
+
+// Start a GET for url over TLS (pinned, resumed when possible) or plain HTTP (local test servers).
+// Bodies are read straight off the socket, so ask for HTTP/1.0: no chunked encoding.
+static int httpGetPermit(HTTPClient& http, PinnedTlsClient& secureClient, WiFiClient& plainClient,
+                         const char* url, const HttpValidators* validators) {
+  if (strncmp(url, "https://", 8) == 0) {
+    http.begin(secureClient, url);
+  } else {
+    http.begin(plainClient, url);
+  }
+  http.setTimeout(10000);  // 10 second timeout
+  http.useHTTP10(true);
+
+  static const char* headerKeys[] = {"ETag", "Last-Modified"};
+  http.collectHeaders(headerKeys, 2);
+  if (validators) {
+    if (validators->etag[0]) {
+      http.addHeader("If-None-Match", validators->etag);
+    }
+    if (validators->lastModified[0]) {
+      http.addHeader("If-Modified-Since", validators->lastModified);
+    }
+  }
+  return http.GET();
+}
+
+// Largest permit.json accepted from the server (it has no queue, so a few hundred bytes)
+#ifndef WIFI_PAYLOAD_MAX
+#define WIFI_PAYLOAD_MAX 2048
+#endif
+
+// Fetch the permit from url and hand it to acceptPermitStream().
+// A 304 means the server still has the permit we are showing.
 // Returns: 0 = error, 1 = updated, 2 = already up to date
-int downloadPermitData(PermitData* data, const char* currentPermitNumber, bool forceUpdate = false) {
+int wifiFetchPermit(const char* url, const PermitRequest& request, PermitFetch* out) {
+  const PermitData* current = request.current;
+  bool forceUpdate = request.syncType == SYNC_TYPE_FORCE;
+  out->hasQueue = false;
+
   if (WiFi.status() != WL_CONNECTED) {
-    Serial.print(COLOR_RED);
-    Serial.print("Not connected to WiFi!");
-    Serial.print(COLOR_RESET);
-    Serial.println();
+    LOG_E(COLOR_RED "Not connected to WiFi!" COLOR_RESET);
+    out->failure = SYNC_FAIL_NETWORK;
     return 0;
   }
 
-  WiFiClientSecure client;
-  client.setInsecure();  // Skip certificate validation for simplicity
-
+  PinnedTlsClient secureClient(SERVER_PIN_SHA256);
+  WiFiClient plainClient;
   HTTPClient http;
 
-  // Add cache-busting parameter for force updates to bypass GitHub CDN cache
-  String url = SERVER_URL;
+  // Force updates skip the validators and add a cache-busting parameter to bypass the GitHub CDN cache.
+  // Otherwise ask for the permit only if it changed since the one we have.
+  char forceUrl[256];
+  HttpValidators validators;
+  const HttpValidators* sendValidators = nullptr;
   if (forceUpdate) {
-    url += "?t=";
-    url += String(millis());  // Add timestamp to make URL unique
-    Serial.print(COLOR_MAGENTA);
-    Serial.print("Force update - bypassing CDN cache");
-    Serial.print(COLOR_RESET);
-    Serial.println();
+    snprintf(forceUrl, sizeof(forceUrl), "%s%st=%lu", url, strchr(url, '?') ? "&" : "?", millis());
+    url = forceUrl;
+    LOG_I(COLOR_MAGENTA "Force update - bypassing CDN cache" COLOR_RESET);
+  } else if (current->permitNumber[0]) {
+    httpValidatorsLoad(&validators);
+    sendValidators = &validators;
   }
 
-  http.begin(client, url.c_str());
-  http.setTimeout(10000);  // 10 second timeout
+  LOG_I("Downloading permit data from %s", url);
 
-  Serial.print("Downloading permit data from ");
-  Serial.println(url);
-
-  int httpCode = http.GET();
-  
-  if (httpCode == 200) {
-    String payload = http.getString();
-    Serial.println("Download successful!");
-    
-    // Parse JSON
-    // ArduinoJson v7 uses JsonDocument with automatic memory management
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, payload);
-    
-    if (error) {
-      Serial.print(COLOR_RED);
-      Serial.print("JSON parsing failed: ");
-      Serial.print(error.c_str());
-      Serial.print(" (Check JSON format)");
-      Serial.print(COLOR_RESET);
-      Serial.println();
-      http.end();
-      return 0;
-    }
-    
-    Serial.println("Permit data raw:");
-    Serial.print(payload);
-    Serial.println();
-    
-    // Validate that required field exists and is a string
-    if (!doc[JSON_PERMIT_NUMBER].is<const char*>()) {
-      Serial.print(COLOR_RED);
-      Serial.print("JSON missing required field: permit number");
-      Serial.print(COLOR_RESET);
-      Serial.println();
-      http.end();
-      return 0;
-    }
-    
-    const char* newPermitNumber = doc[JSON_PERMIT_NUMBER];
-    
-    // Check if permit number is empty
-    if (strlen(newPermitNumber) == 0) {
-      Serial.print(COLOR_RED);
-      Serial.print("Permit number is empty in JSON response");
-      Serial.print(COLOR_RESET);
-      Serial.println();
-      http.end();
-      return 0;
-    }
-    
-    Serial.print(COLOR_MAGENTA);
-    Serial.print("Server permit #: ");
-    Serial.print(newPermitNumber);
-    Serial.print(COLOR_RESET);
-    Serial.println();
-    Serial.print(COLOR_MAGENTA);
-    Serial.print("Current permit #: ");
-    Serial.print(currentPermitNumber);
-    Serial.print(COLOR_RESET);
-    Serial.println();
-    
-    // FIXED: Compare permit numbers (skip check if forcing update)
-    if (!forceUpdate && strcmp(newPermitNumber, currentPermitNumber) == 0) {
-      Serial.print(COLOR_YELLOW);
-      Serial.print("Permit number matches. No changes needed.");
-      Serial.print(COLOR_RESET);
-      Serial.println();
-      http.end();
-      return 2;  // Already up to date
-    }
-    
-    // FIXED: Show appropriate message based on forceUpdate flag
-    if (forceUpdate) {
-      Serial.print(COLOR_MAGENTA);
-      Serial.print("Force update - downloading regardless of permit number");
-      Serial.print(COLOR_RESET);
-      Serial.println();
-    } else {
-      Serial.print(COLOR_GREEN);
-      Serial.print("New permit detected! Updating...");
-      Serial.print(COLOR_RESET);
-      Serial.println();
-    }
-    
-    // Extract data from JSON using helper function
-    safeJsonCopy(data->permitNumber, sizeof(data->permitNumber), doc, JSON_PERMIT_NUMBER);
-    safeJsonCopy(data->plateNumber, sizeof(data->plateNumber), doc, JSON_PLATE_NUMBER);
-    safeJsonCopy(data->validFrom, sizeof(data->validFrom), doc, JSON_VALID_FROM);
-    safeJsonCopy(data->validTo, sizeof(data->validTo), doc, JSON_VALID_TO);
-    safeJsonCopy(data->barcodeValue, sizeof(data->barcodeValue), doc, JSON_BARCODE_VALUE);
-    safeJsonCopy(data->barcodeLabel, sizeof(data->barcodeLabel), doc, JSON_BARCODE_LABEL);
-    
+  unsigned long start = millis();
+  int httpCode = httpGetPermit(http, secureClient, plainClient, url, sendValidators);
+  unsigned long responseMs = millis() - start;
+  if (secureClient.handshakeMs) {
+    LOG_STAT("TLS: %s handshake in %lu ms (TCP connect %lu ms)",
+             secureClient.resumed ? "resumed" : (secureClient.offered ? "full (session refused)" : "full"),
+             secureClient.handshakeMs, secureClient.tcpMs);
+  }
+
+  if (httpCode == HTTP_CODE_NOT_MODIFIED) {
     http.end();
-    Serial.print(COLOR_GREEN);
-    Serial.print("Permit data parsed successfully!");
-    Serial.print(COLOR_RESET);
-    Serial.println();
-    
-    // Save to flash memory
-    savePermitData(data);
-    
-    return 1;  // Updated
-  } else {
-    Serial.print(COLOR_RED);
-    Serial.print("HTTP request failed: ");
+    LOG_I(COLOR_YELLOW "Permit not modified (304). No changes needed." COLOR_RESET);
+    LOG_STAT("Permit fetch: 304 in %lu ms, no body", responseMs);
+    out->data = *current;
+    return 2;  // Already up to date
+  }
+
+  if (httpCode != HTTP_CODE_OK) {
     if (httpCode > 0) {
-      Serial.print("HTTP ");
-      Serial.print(httpCode);
-      if (httpCode == 404) Serial.print(" (File not found)");
-      else if (httpCode == 403) Serial.print(" (Access denied)");
-      else if (httpCode == 500) Serial.print(" (Server error)");
+      const char* reason = "";
+      if (httpCode == 404) reason = " (File not found)";
+      else if (httpCode == 403) reason = " (Access denied)";
+      else if (httpCode == 500) reason = " (Server error)";
+      LOG_E(COLOR_RED "HTTP request failed: HTTP %d%s" COLOR_RESET, httpCode, reason);
     } else {
-      Serial.print("Network error (");
-      Serial.print(httpCode);
-      Serial.print(")");
+      LOG_E(COLOR_RED "HTTP request failed: Network error (%d)" COLOR_RESET, httpCode);
     }
-    Serial.print(COLOR_RESET);
-    Serial.println();
     http.end();
-    return 0;  // Error
+    out->failure = SYNC_FAIL_NETWORK;
+    return 0;
+  }
+
+  // Parsed and its signature checked straight off the socket: no body buffer.
+  // Pinned TLS vouches for the host, not for what was uploaded to it, so a
+  // paired display wants the payload signed like the phone's.
+  HttpValidators received;
+  httpValidatorsFromResponse(http, &received);
+  int size = http.getSize();
+  int result = acceptPermitStream(*http.getStreamPtr(), size, WIFI_PAYLOAD_MAX, false, current->permitNumber,
+                                  &out->data, nullptr, &out->failure);
+  http.end();
+  LOG_STAT("Permit fetch: 200 in %lu ms, %d byte body streamed in %lu ms",
+           responseMs, size, millis() - start - responseMs);
+  if (result != 0) {
+    // The flip setting comes from the phone app, not the server
+    out->data.displayFlipped = current->displayFlipped;
+    httpValidatorsSave(&received);
   }
+  return result;
 }
 
-void disconnectWiFi() {
-  WiFi.disconnect(true);
-  WiFi.mode(WIFI_OFF);
-  Serial.println("WiFi disconnected to save power.");
+// The permit server as a permit source: join WiFi, fetch, drop WiFi again
+class WifiPermitSource : public PermitSource {
+ public:
+  const char* name() {
+    return "WiFi";
+  }
+
+  uint32_t stackSize() {
+    return 12288;  // mbedTLS handshake
+  }
+
+  int fetch(const PermitRequest& request, PermitFetch* out) {
+    int result = 0;
+    if (!connectToWiFi()) {
+      out->failure = SYNC_FAIL_NETWORK;
+    } else if (cancelled) {
+      out->failure = SYNC_FAIL_CANCELLED;
+    } else {
+      result = wifiFetchPermit(SERVER_URL, request, out);
+    }
+    disconnectWiFi();
+    return result;
+  }
+};
+
+static WifiPermitSource wifiPermitSource;
+
+// Compare the old download (body buffered in a String, then parsed), the
+// streamed parse, and a conditional GET answered with 304. Point it at
+// tools/permit_server.py on the LAN, e.g. "http://192.168.1.20:8080/permit.json".
+void benchmarkPermitDownload(const char* url, int runs) {
+  const char* modeNames[] = {"buffered", "streamed", "conditional"};
+  LOG_STAT("\n=== Permit download benchmark: %d runs per mode, %s ===", runs, url);
+
+  HttpValidators validators;
+  memset(&validators, 0, sizeof(validators));
+  for (int mode = 0; mode < 3; mode++) {
+    unsigned long totalMs = 0, maxMs = 0;
+    uint32_t minHeap = ESP.getFreeHeap();
+    int failures = 0;
+
+    for (int i = 0; i < runs; i++) {
+      PinnedTlsClient secureClient(SERVER_PIN_SHA256);
+      WiFiClient plainClient;
+      HTTPClient http;
+      unsigned long start = millis();
+      int httpCode = httpGetPermit(http, secureClient, plainClient, url, mode == 2 ? &validators : nullptr);
+      bool ok;
+
+      if (mode == 0 && httpCode == HTTP_CODE_OK) {
+        String payload = http.getString();
+        JsonDocument doc;
+        ok = !deserializeJson(doc, payload) && doc[JSON_PERMIT_NUMBER].is<const char*>();
+        minHeap = min(minHeap, ESP.getFreeHeap());
+      } else if (mode == 1 && httpCode == HTTP_CODE_OK) {
+        // As the sync reads it: hashed for the signature while it is parsed
+        PermitAuthStreamVerify<> verify;
+        verify.begin();
+        PermitStreamReader<WiFiClient> reader = {http.getStreamPtr(), &verify, 0, WIFI_PAYLOAD_MAX};
+        permitJsonArena.reset();
+        JsonDocument doc(&permitJsonArena);
+        ok = !deserializeJson(doc, reader) && doc[JSON_PERMIT_NUMBER].is<const char*>();
+        verify.abort();
+        minHeap = min(minHeap, ESP.getFreeHeap());
+        httpValidatorsFromResponse(http, &validators);
+      } else {
+        ok = mode == 2 && httpCode == HTTP_CODE_NOT_MODIFIED;
+      }
+      http.end();
+
+      unsigned long ms = millis() - start;
+      totalMs += ms;
+      maxMs = max(maxMs, ms);
+      failures += ok ? 0 : 1;
+    }
+
+    LOG_STAT("  %-11s mean %lu ms, max %lu ms, %d failed, min free heap %lu",
+             modeNames[mode], totalMs / runs, maxMs, failures, (unsigned long)minHeap);
+  }
 }
 
+#ifdef WIFI_BENCH
+#ifndef WIFI_BENCH_URL
+#define WIFI_BENCH_URL SERVER_URL
+#endif
+#ifndef WIFI_BENCH_RUNS
+#define WIFI_BENCH_RUNS 20  // Runs per mode in each benchmark
+#endif
+
+// Host and port of an https URL; false for anything else
+static bool httpsHostPort(const char* url, char* host, size_t hostSize, uint16_t* port) {
+  if (strncmp(url, "https://", 8) != 0) {
+    return false;
+  }
+  const char* start = url + 8;
+  size_t len = strcspn(start, ":/");
+  if (len == 0 || len >= hostSize) {
+    return false;
+  }
+  memcpy(host, start, len);
+  host[len] = '\0';
+  *port = start[len] == ':' ? (uint16_t)atoi(start + len + 1) : 443;
+  return true;
+}
+
+// Boot benchmarks of the WiFi fetch (build with -DWIFI_BENCH, see
+// env:vision_e290_wifibench): the three download modes against
+// WIFI_BENCH_URL, then full versus resumed TLS handshakes with its host
+// when it is https. Set WIFI_BENCH_URL in wifi_config.h to point them at
+// tools/permit_server.py instead of the real server.
+void wifiBenchmark() {
+  if (!connectToWiFi()) {
+    LOG_W("WiFi benchmarks skipped: no network");
+    disconnectWiFi();
+    return;
+  }
+  benchmarkPermitDownload(WIFI_BENCH_URL, WIFI_BENCH_RUNS);
+
+  char host[64];
+  uint16_t port;
+  if (httpsHostPort(WIFI_BENCH_URL, host, sizeof(host), &port)) {
+    benchmarkTlsHandshake(host, port, SERVER_PIN_SHA256, WIFI_BENCH_RUNS);
+  } else {
+    LOG_STAT("TLS handshake benchmark skipped: %s is not https", WIFI_BENCH_URL);
+  }
+  disconnectWiFi();
+}
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+"""Subset the Adafruit GFX fonts in src/Fonts to the characters the display
+draws and store the glyphs run-length coded (see src/rle_font.h).
+
+Runs before every PlatformIO build (extra_scripts in platformio.ini) and
+can be run by hand:
+
+    python tools/font_subset.py
+
+The character sets come from custom_font_subsets in platformio.ini, one
+font per line: the font name, then characters, with "0-9"-style ranges.
+Space and '?' (drawn for characters outside the subset) are always kept.
+Output goes to src/Fonts/<font>_rle.h and is only rewritten when it
+changes, so unchanged fonts do not trigger a rebuild.
+
+Glyph coding (after u8g2): each glyph's box is read row by row as one
+stream of pixels and stored as pairs of (background run, ink run) with
+fixed bit widths chosen per font to make it smallest. A pair can be
+followed by 1 bits, each repeating it once, and a closing 0 bit. Glyphs
+are packed back to back and found by bit offset.
+"""
+
+import configparser
+import os
+import re
+import sys
+
+GLYPH_STRUCT_SIZE = 8  # GFXglyph and RleGlyph: uint16 + 5 bytes, padded
+
+
+def parse_gfx_font(path):
+    text = open(path).read()
+    bitmap_text = re.search(r"Bitmaps\[\]\s*PROGMEM\s*=\s*\{(.*?)\};", text, re.S).group(1)
+    bitmap = bytes(int(v, 16) for v in re.findall(r"0x[0-9A-Fa-f]{2}", bitmap_text))
+    glyph_text = re.search(r"Glyphs\[\]\s*PROGMEM\s*=\s*\{(.*?)\};", text, re.S).group(1)
+    glyphs = [tuple(int(v) for v in g.split(","))
+              for g in re.findall(r"\{\s*(-?\d+\s*,\s*-?\d+\s*,\s*-?\d+\s*,\s*-?\d+\s*,\s*-?\d+\s*,\s*-?\d+)\s*\}",
+                                  glyph_text)]
+    first, last, y_advance = (int(v, 0) for v in
+                              re.search(r"\(GFXglyph \*\)\w+,\s*(\w+),\s*(\w+),\s*(\w+)\s*\}", text).groups())
+    assert len(glyphs) == last - first + 1, path
+    return bitmap, glyphs, first, last, y_advance
+
+
+def glyph_pixels(bitmap, glyph):
+    offset, width, height = glyph[:3]
+    bits = []
+    for i in range(width * height):
+        byte = bitmap[offset + i // 8]
+        bits.append((byte >> (7 - i % 8)) & 1)
+    return bits
+
+
+def run_pairs(pixels, max0, max1):
+    """(background, ink) run pairs covering every pixel, trailing background included."""
+    pairs, i, n = [], 0, len(pixels)
+    while i < n:
+        zeros = 0
+        while i < n and pixels[i] == 0 and zeros < max0:
+            zeros += 1
+            i += 1
+        ones = 0
+        while i < n and pixels[i] == 1 and ones < max1:
+            ones += 1
+            i += 1
+        pairs.append((zeros, ones))
+    return pairs
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.bits = 0
+
+    def put(self, value, count):
+        for k in range(count):  # LSB first
+            if self.bits % 8 == 0:
+                self.out.append(0)
+            self.out[-1] |= ((value >> k) & 1) << (self.bits % 8)
+            self.bits += 1
+
+
+def encode_glyph(pixels, bits0, bits1, writer=None):
+    """Append a glyph to writer (a new one by default); returns the writer."""
+    pairs = run_pairs(pixels, (1 << bits0) - 1, (1 << bits1) - 1)
+    writer = writer or BitWriter()
+    i = 0
+    while i < len(pairs):
+        zeros, ones = pairs[i]
+        writer.put(zeros, bits0)
+        writer.put(ones, bits1)
+        i += 1
+        while i < len(pairs) and pairs[i] == (zeros, ones):
+            writer.put(1, 1)
+            i += 1
+        writer.put(0, 1)
+    return writer
+
+
+def parse_charset(tokens):
+    chars = set(" ?")
+    for token in tokens:
+        if len(token) == 3 and token[1] == "-":
+            chars.update(chr(c) for c in range(ord(token[0]), ord(token[2]) + 1))
+        else:
+            chars.update(token)
+    return chars
+
+
+def subset_font(font_dir, name, chars):
+    bitmap, glyphs, first, last, y_advance = parse_gfx_font(os.path.join(font_dir, name + ".h"))
+    codes = sorted(c for c in map(ord, chars) if first <= c <= last)
+    pixels = {c: glyph_pixels(bitmap, glyphs[c - first]) for c in codes}
+
+    best = None
+    for bits0 in range(1, 8):
+        for bits1 in range(1, 8):
+            size = sum(encode_glyph(pixels[c], bits0, bits1).bits for c in codes)
+            if best is None or size < best[0]:
+                best = (size, bits0, bits1)
+    _, bits0, bits1 = best
+
+    writer = BitWriter()
+    table = []
+    for c in codes:
+        _, width, height, x_advance, x_offset, y_offset = glyphs[c - first]
+        table.append((writer.bits, width, height, x_advance, x_offset, y_offset, c))
+        encode_glyph(pixels[c], bits0, bits1, writer)
+    data = bytes(writer.out)
+    assert writer.bits < 1 << 16, f"{name}: glyph data too large for 16-bit offsets"
+
+    sub_first, sub_last = codes[0], codes[-1]
+    index = {c: i for i, c in enumerate(codes)}
+    glyph_map = [index.get(c, 0xFF) for c in range(sub_first, sub_last + 1)]
+
+    gfx_size = len(bitmap) + GLYPH_STRUCT_SIZE * len(glyphs)
+    rle_size = len(data) + GLYPH_STRUCT_SIZE * len(table) + len(glyph_map)
+    bitmap_bits = sum(glyphs[c - first][1] * glyphs[c - first][2] for c in codes)
+    charset = "".join(chr(c) for c in codes)
+    summary = (f"{len(codes)} of {len(glyphs)} glyphs, {rle_size} bytes "
+               f"(GFX font {gfx_size} bytes, {100 * rle_size / gfx_size:.0f}%); "
+               f"glyph data {len(data)} bytes, {(bitmap_bits + 7) // 8} as a bitmap; runs {bits0}+{bits1} bits")
+
+    lines = [
+        f"// Generated by tools/font_subset.py from {name}.h - do not edit.",
+        f"// {summary}",
+        f"// Characters: {charset}",
+        "#pragma once",
+        '#include "../rle_font.h"',
+        "",
+        f"const uint8_t {name}RleData[] PROGMEM = {{",
+    ]
+    for i in range(0, len(data), 12):
+        lines.append("  " + ", ".join(f"0x{b:02X}" for b in data[i:i + 12]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append(f"const RleGlyph {name}RleGlyphs[] PROGMEM = {{")
+    for offset, width, height, x_advance, x_offset, y_offset, c in table:
+        char = "\\\\" if chr(c) == "\\" else chr(c)
+        lines.append(f"  {{ {offset:5}, {width:3}, {height:3}, {x_advance:3}, {x_offset:4}, {y_offset:4} }},  // '{char}'")
+    lines.append("};")
+    lines.append("")
+    lines.append(f"const uint8_t {name}RleMap[] PROGMEM = {{")
+    for i in range(0, len(glyph_map), 16):
+        lines.append("  " + ", ".join(f"{v:3}" for v in glyph_map[i:i + 16]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append(f"const RleFont {name}Rle PROGMEM = {{")
+    lines.append(f"  {name}RleData, {name}RleGlyphs, {name}RleMap,")
+    lines.append(f"  0x{sub_first:02X}, 0x{sub_last:02X}, {y_advance}, {bits0}, {bits1} }};")
+    return "\n".join(lines) + "\n", summary
+
+
+def read_subsets(option_text):
+    subsets = {}
+    for line in option_text.strip().splitlines():
+        fields = line.split()
+        if fields:
+            subsets[fields[0]] = parse_charset(fields[1:])
+    return subsets
+
+
+def project_option(root):
+    config = configparser.ConfigParser(interpolation=None, inline_comment_prefixes=("#", ";"))  # As PlatformIO reads it
+    config.read(os.path.join(root, "platformio.ini"))
+    for section in config.sections():
+        if config.has_option(section, "custom_font_subsets"):
+            return config.get(section, "custom_font_subsets")
+    return ""
+
+
+def generate(root, option_text):
+    font_dir = os.path.join(root, "src", "Fonts")
+    for name, chars in read_subsets(option_text).items():
+        text, summary = subset_font(font_dir, name, chars)
+        path = os.path.join(font_dir, name + "_rle.h")
+        old = open(path).read() if os.path.exists(path) else None
+        if text != old:
+            with open(path, "w") as f:
+                f.write(text)
+        print(f"Font {name}: {summary}")
+
+
+if __name__ == "__main__":
+    project = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    generate(project, project_option(project))
+    sys.exit(0)
+elif "Import" in globals():  # Run by PlatformIO's SCons as an extra script
+    Import("env")  # noqa: F821
+    generate(env.subst("$PROJECT_DIR"), env.GetProjectOption("custom_font_subsets", ""))  # noqa: F821
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Send a firmware image to the display over BLE (see src/ble_ota.h).
+
+    pip install bleak
+    pio run -e vision_e290
+    python tools/ota_send.py .pio/build/vision_e290/firmware.bin --key <64 hex digits>
+
+The key is the display's payload key (from pairing or usb_provision.py --key);
+the BEGIN request is signed with it. The host must be bonded with the display,
+since the update characteristics only accept writes over an encrypted link.
+The image is zlib-compressed here and inflated on the display while it is
+written to the inactive OTA partition.
+"""
+
+import argparse
+import asyncio
+import hashlib
+import hmac
+import struct
+import sys
+import time
+import zlib
+
+from bleak import BleakClient, BleakScanner
+
+DEVICE_NAME = "ParkingDisplay"
+CONTROL_UUID = "0000ff12-0000-1000-8000-00805f9b34fb"
+DATA_UUID = "0000ff13-0000-1000-8000-00805f9b34fb"
+
+OP_BEGIN, OP_END, OP_ABORT = 1, 2, 3
+STATE_NAMES = ["idle", "receiving", "applied", "failed"]
+ERROR_NAMES = ["none", "busy", "bad request", "out of memory", "flash error", "window overflow",
+               "decode error", "size mismatch", "hash mismatch", "timeout", "aborted", "not authorized"]
+
+WINDOW_BYTES = 12288  # OTA_WINDOW_BYTES on the display
+
+
+async def send(path, address, key, counter):
+    image = open(path, "rb").read()
+    packed = zlib.compress(image, 9)
+    digest = hashlib.sha256(image).digest()
+    print(f"Image {len(image)} bytes, compressed {len(packed)} bytes ({100 * len(packed) / len(image):.0f}%)")
+
+    if address is None:
+        device = await BleakScanner.find_device_by_name(DEVICE_NAME, timeout=15)
+        if device is None:
+            sys.exit(f"{DEVICE_NAME} not found")
+        address = device.address
+
+    async with BleakClient(address) as client:
+        chunk = max(20, client.mtu_size - 3)
+        print(f"Connected to {address}, MTU {client.mtu_size}, {chunk} byte chunks")
+
+        acked = 0
+        state = 0
+        progress = asyncio.Event()
+
+        def on_notify(_, data):
+            nonlocal acked, state
+            state, error, consumed = struct.unpack("<BBI", data[:6])
+            acked = consumed
+            if error:
+                print(f"\nDisplay reported {STATE_NAMES[state]}: {ERROR_NAMES[error]}")
+                state = 3
+            progress.set()
+
+        await client.start_notify(CONTROL_UUID, on_notify)
+        begin = struct.pack("<BII", OP_BEGIN, len(packed), len(image)) + digest + struct.pack("<I", counter)
+        begin += hmac.new(key, begin, hashlib.sha256).digest()
+        await client.write_gatt_char(CONTROL_UUID, begin, response=True)
+
+        # Wait until the display has opened the partition
+        await asyncio.wait_for(progress.wait(), 10)
+        if state != 1:
+            sys.exit(1)
+
+        start = time.monotonic()
+        sent = 0
+        while sent < len(packed):
+            if state == 3:
+                sys.exit(1)
+            if sent - acked >= WINDOW_BYTES:
+                progress.clear()
+                await asyncio.wait_for(progress.wait(), 10)
+                continue
+            part = packed[sent:sent + min(chunk, WINDOW_BYTES - (sent - acked))]
+            await client.write_gatt_char(DATA_UUID, part, response=False)
+            sent += len(part)
+            rate = sent / 1024 / max(time.monotonic() - start, 1e-3)
+            print(f"\r{sent}/{len(packed)} bytes, {rate:.1f} KB/s", end="")
+
+        await client.write_gatt_char(CONTROL_UUID, bytes([OP_END]), response=True)
+        while state == 1:
+            progress.clear()
+            await asyncio.wait_for(progress.wait(), 30)
+
+        elapsed = time.monotonic() - start
+        print(f"\n{STATE_NAMES[state]}: {len(packed) / 1024:.1f} KB in {elapsed:.1f} s "
+              f"({len(packed) / 1024 / elapsed:.1f} KB/s, {len(image) / 1024 / elapsed:.1f} KB/s of image)")
+        if state != 2:
+            sys.exit(1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("firmware", help="firmware.bin from the PlatformIO build")
+    parser.add_argument("--address", help="display BLE address (default: scan for " + DEVICE_NAME + ")")
+    parser.add_argument("--key", required=True, help="display payload key, 64 hex digits")
+    parser.add_argument("--counter", type=int, default=int(time.time()),
+                        help="must be above the last update's (default: current time)")
+    args = parser.parse_args()
+    try:
+        key = bytes.fromhex(args.key)
+    except ValueError:
+        key = b""
+    if len(key) != 32:
+        parser.error("--key needs 32 bytes (64 hex digits)")
+    asyncio.run(send(args.firmware, args.address, key, args.counter))
+
+
+if __name__ == "__main__":
+    main()
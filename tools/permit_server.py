@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Local stand-in for the permit server, for benchmarking the WiFi download
+(see benchmarkPermitDownload() in src/wifi_helper.h).
+
+    python tools/permit_server.py                       # serves a built-in sample
+    python tools/permit_server.py --file permit.json --port 8080 --delay 40
+    python tools/permit_server.py --cert cert.pem --key key.pem --port 8443
+    python tools/permit_server.py --payload-key <64 hex digits>   # for a paired display
+
+Serves the permit JSON at /permit.json with an ETag and Last-Modified and
+answers If-None-Match / If-Modified-Since with a bodyless 304, like the
+GitHub raw CDN does. Query strings (the display's cache-busting ?t=) are
+ignored. Use --no-validators to see how the display behaves without them.
+
+A paired display only takes signed payloads over WiFi too. With
+--payload-key the body gets the same trailer the phone app adds (see
+src/permit_auth.h), with the file's modification time as the counter, so
+the counter goes up when the file changes and the ETag stays put when it
+does not. A forced fetch of a file the display already took is rejected
+as a replay.
+
+With --cert/--key it serves HTTPS instead, for the TLS handshake benchmark
+(benchmarkTlsHandshake() in src/tls_client.h), and prints the key pin the
+display needs. Session tickets are on, so resumed handshakes can be
+measured. A throwaway certificate:
+
+    openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+        -keyout key.pem -out cert.pem -days 365 -subj /CN=permit-local
+"""
+
+import argparse
+import email.utils
+import hashlib
+import hmac
+import http.server
+import json
+import os
+import ssl
+import struct
+import time
+
+SAMPLE = {
+    "permitNumber": "T6103268",
+    "plateNumber": "CSEB187",
+    "validFrom": "Sep 05, 2025: 01:08",
+    "validTo": "Sep 12, 2025: 01:08",
+    "barcodeValue": "6103268",
+    "barcodeLabel": "00435",
+}
+
+
+class PermitHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    args = None
+    stats = {"200": 0, "304": 0}
+
+    def load(self):
+        if self.args.file:
+            body = open(self.args.file, "rb").read()
+            mtime = os.path.getmtime(self.args.file)
+        else:
+            body = json.dumps(SAMPLE, indent=2).encode()
+            mtime = self.server.started
+        if self.args.payload_key:
+            body += b"PAU1" + struct.pack("<I", int(mtime))
+            body += hmac.new(self.args.payload_key, body, hashlib.sha256).digest()
+        etag = '"' + hashlib.sha1(body).hexdigest()[:16] + '"'
+        return body, etag, email.utils.formatdate(int(mtime), usegmt=True), int(mtime)
+
+    def do_GET(self):
+        if self.path.split("?")[0] != "/permit.json":
+            self.send_error(404)
+            return
+        if self.args.delay:
+            time.sleep(self.args.delay / 1000)
+
+        body, etag, last_modified, mtime = self.load()
+        if not self.args.no_validators and self.not_modified(etag, mtime):
+            self.send_response(304)
+            self.send_header("ETag", etag)
+            self.send_header("Last-Modified", last_modified)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            self.stats["304"] += 1
+            return
+
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        if not self.args.no_validators:
+            self.send_header("ETag", etag)
+            self.send_header("Last-Modified", last_modified)
+        self.end_headers()
+        self.wfile.write(body)
+        self.stats["200"] += 1
+
+    def not_modified(self, etag, mtime):
+        if_none_match = self.headers.get("If-None-Match")
+        if if_none_match is not None:
+            return etag in [tag.strip() for tag in if_none_match.split(",")]
+        if_modified_since = self.headers.get("If-Modified-Since")
+        if if_modified_since:
+            try:
+                return mtime <= email.utils.parsedate_to_datetime(if_modified_since).timestamp()
+            except (TypeError, ValueError):
+                return False
+        return False
+
+    def log_message(self, fmt, *args):
+        print(f"{self.address_string()} {fmt % args}  (200: {self.stats['200']}, 304: {self.stats['304']})")
+
+
+def der_items(der, pos, end):
+    """Yield (tag, element start, content start, end) for each DER element in der[pos:end]."""
+    while pos < end:
+        start = pos
+        tag, length = der[pos], der[pos + 1]
+        pos += 2
+        if length & 0x80:
+            n = length & 0x7F
+            length = int.from_bytes(der[pos:pos + n], "big")
+            pos += n
+        yield tag, start, pos, pos + length
+        pos += length
+
+
+def key_pin(cert_file):
+    """SHA-256 of the certificate's DER SubjectPublicKeyInfo, as the display pins it."""
+    der = ssl.PEM_cert_to_DER_cert(open(cert_file).read())
+    _, _, start, end = next(der_items(der, 0, len(der)))     # Certificate
+    _, _, start, end = next(der_items(der, start, end))      # tbsCertificate
+    fields = list(der_items(der, start, end))
+    if fields[0][0] == 0xA0:                                 # [0] version
+        fields = fields[1:]
+    # serialNumber, signature, issuer, validity, subject, subjectPublicKeyInfo
+    _, spki_start, _, spki_end = fields[5]
+    return hashlib.sha256(der[spki_start:spki_end]).hexdigest()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--file", help="permit JSON to serve (default: built-in sample)")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--delay", type=int, default=0, help="added latency per request in ms")
+    parser.add_argument("--no-validators", action="store_true", help="send no ETag/Last-Modified, never 304")
+    parser.add_argument("--cert", help="PEM certificate: serve HTTPS (needs --key)")
+    parser.add_argument("--key", help="PEM private key for --cert")
+    parser.add_argument("--payload-key", help="sign the permit with the display's payload key, 64 hex digits")
+    args = parser.parse_args()
+    if args.payload_key:
+        try:
+            args.payload_key = bytes.fromhex(args.payload_key)
+        except ValueError:
+            args.payload_key = b""
+        if len(args.payload_key) != 32:
+            parser.error("--payload-key needs 32 bytes (64 hex digits)")
+
+    PermitHandler.args = args
+    server = http.server.ThreadingHTTPServer(("", args.port), PermitHandler)
+    server.started = time.time()
+    scheme = "http"
+    if args.cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.cert, args.key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+        scheme = "https"
+        print(f"Key pin (SERVER_PIN_SHA256): {key_pin(args.cert)}")
+    print(f"Serving permit on {scheme}://0.0.0.0:{args.port}/permit.json")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
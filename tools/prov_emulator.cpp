@@ -0,0 +1,406 @@
+// Emulated displays for tools/usb_provision.py --emulate: each one is a
+// pseudo-terminal answered with the firmware's own framing
+// (src/provision_frame.h: ProvParser, provEncode, crc32). The script builds
+// and starts it; by hand:
+//
+//   g++ -std=c++17 -O2 -Isrc tools/prov_emulator.cpp -o prov_emulator
+//   ./prov_emulator 4 0.2    # 4 displays, drop 20% of the replies
+//
+// It prints one pty path per line, then answers until stdin closes. Like
+// provHandle() in src/usb_provision.h, a repeated request gets the last
+// reply again without being applied twice and a damaged frame gets
+// PROV_NAK. What a request does is only kept for PROV_DIAG: the JSON is
+// looked at for the permit number and queue length, not parsed. POSIX only.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include "provision_frame.h"
+
+#define EMU_MAX 64
+#define EMU_SCREEN_W 296
+#define EMU_SCREEN_H 128
+#define EMU_FRAME_BYTES (((EMU_SCREEN_W + 7) / 8) * EMU_SCREEN_H)  // GFXcanvas1 layout
+#define EMU_LOG_LINE "I (emulated) handled request\n"  // Log text shares the port
+
+// Same bits as src/usb_provision.h
+#define PROV_SET_FLIP 0x01
+#define PROV_SET_KEY 0x02
+#define PROV_SET_CLOCK 0x04
+#define PROV_FLAG_FLIPPED 0x01
+
+struct EmuDisplay
+{
+    int master;
+    int slave;  // Kept open so the pty stays up while the script reopens it
+    char path[64];
+    ProvParser parser;
+    uint8_t reply[PROV_FRAME_MAX];  // Last reply, kept for repeats
+    size_t replyLen;
+    uint8_t lastType;
+    uint8_t lastSeq;
+    uint8_t mac[6];
+    char permit[32];
+    int queue;
+    int flipped;
+    int paired;
+    uint32_t clock;
+    uint32_t frames;
+    uint32_t duplicates;
+    uint32_t badFrames;
+    uint8_t frame[EMU_FRAME_BYTES];
+};
+
+static EmuDisplay displays[EMU_MAX];
+static float loss = 0;
+
+static bool emuDrop()
+{
+    return loss > 0 && rand() < loss * ((float)RAND_MAX + 1);
+}
+
+static void emuWrite(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+            {
+                continue;
+            }
+            return;
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+static void emuSend(EmuDisplay *d, uint8_t type, uint8_t seq, uint8_t status, const uint8_t *data = nullptr,
+                    size_t len = 0)
+{
+    static uint8_t payload[PROV_PAYLOAD_MAX];
+    payload[0] = status;
+    if (len)
+    {
+        memcpy(payload + 1, data, len);
+    }
+    d->replyLen = provEncode(d->reply, type, seq, payload, len + 1);
+    if (!emuDrop())
+    {
+        emuWrite(d->master, EMU_LOG_LINE, sizeof(EMU_LOG_LINE) - 1);
+        emuWrite(d->master, d->reply, d->replyLen);
+    }
+}
+
+// Start of the value of "key" in the JSON text, or nullptr
+static const char *emuJsonValue(const ProvFrame &f, const char *key)
+{
+    char quoted[40];
+    int n = snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+    const char *end = (const char *)f.payload + f.len;
+    for (const char *p = (const char *)f.payload; p + n <= end; p++)
+    {
+        if (memcmp(p, quoted, n) == 0)
+        {
+            p += n;
+            while (p < end && (*p == ' ' || *p == ':' || *p == '\t' || *p == '\r' || *p == '\n'))
+            {
+                p++;
+            }
+            return p < end ? p : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// Objects in the "queue" array, or -1 if there is none
+static int emuJsonQueueLength(const ProvFrame &f)
+{
+    const char *p = emuJsonValue(f, "queue");
+    const char *end = (const char *)f.payload + f.len;
+    if (!p || *p != '[')
+    {
+        return -1;
+    }
+    int depth = 0;
+    int count = 0;
+    bool inString = false;
+    for (; p < end; p++)
+    {
+        if (inString)
+        {
+            if (*p == '\\')
+            {
+                p++;
+            }
+            else if (*p == '"')
+            {
+                inString = false;
+            }
+            continue;
+        }
+        if (*p == '"')
+        {
+            inString = true;
+        }
+        else if (*p == '[' || *p == '{')
+        {
+            if (++depth == 2 && *p == '{')
+            {
+                count++;
+            }
+        }
+        else if ((*p == ']' || *p == '}') && --depth == 0)
+        {
+            return count;
+        }
+    }
+    return -1;
+}
+
+static ProvStatus emuHandlePermit(EmuDisplay *d, const ProvFrame &f)
+{
+    const char *p = emuJsonValue(f, "permitNumber");
+    const char *end = (const char *)f.payload + f.len;
+    if (!f.len || f.payload[0] != '{' || !p || *p != '"')
+    {
+        return PROV_ERR_BAD_DATA;
+    }
+    size_t n = 0;
+    for (p++; p < end && *p != '"' && n < sizeof(d->permit) - 1; p++)
+    {
+        if (*p == '\\' && p + 1 < end)
+        {
+            p++;  // Escapes are kept as the character they stand for, close enough for DIAG
+        }
+        d->permit[n++] = *p;
+    }
+    d->permit[n] = '\0';
+    const char *flip = emuJsonValue(f, "displayFlipped");
+    d->flipped = flip && end - flip >= 4 && memcmp(flip, "true", 4) == 0;
+    int queue = emuJsonQueueLength(f);
+    d->queue = queue < 0 ? 0 : queue;
+    return PROV_OK;
+}
+
+static ProvStatus emuHandleQueue(EmuDisplay *d, const ProvFrame &f)
+{
+    int queue = emuJsonQueueLength(f);
+    if (queue < 0)
+    {
+        return PROV_ERR_BAD_DATA;
+    }
+    d->queue = queue;
+    return PROV_OK;
+}
+
+static ProvStatus emuHandleSettings(EmuDisplay *d, const ProvFrame &f)
+{
+    if (f.len < 2)
+    {
+        return PROV_ERR_LENGTH;
+    }
+    uint8_t mask = f.payload[0];
+    size_t need = 2 + (mask & PROV_SET_KEY ? 32 : 0) + (mask & PROV_SET_CLOCK ? 4 : 0);
+    if (f.len != need)
+    {
+        return PROV_ERR_LENGTH;
+    }
+    if ((mask & PROV_SET_FLIP) && !d->permit[0])
+    {
+        return PROV_ERR_BAD_DATA;  // Nothing to rotate yet
+    }
+    if (mask & PROV_SET_FLIP)
+    {
+        d->flipped = f.payload[1] & PROV_FLAG_FLIPPED;
+    }
+    if (mask & PROV_SET_KEY)
+    {
+        d->paired = 1;
+    }
+    if (mask & PROV_SET_CLOCK)
+    {
+        d->clock = provGet32(f.payload + f.len - 4);
+    }
+    return PROV_OK;
+}
+
+static ProvStatus emuHandleFrame(EmuDisplay *d, const ProvFrame &f)
+{
+    if (f.len < 2)
+    {
+        return PROV_ERR_LENGTH;
+    }
+    uint16_t offset = provGet16(f.payload);
+    size_t len = f.len - 2;
+    if (offset + len > EMU_FRAME_BYTES)
+    {
+        return PROV_ERR_LENGTH;
+    }
+    memcpy(d->frame + offset, f.payload + 2, len);
+    return PROV_OK;
+}
+
+static void emuSendHello(EmuDisplay *d, const ProvFrame &f)
+{
+    uint8_t info[64];
+    info[0] = PROV_PROTOCOL_VERSION;
+    provPut16(info + 1, PROV_PAYLOAD_MAX);
+    provPut16(info + 3, EMU_SCREEN_W);
+    provPut16(info + 5, EMU_SCREEN_H);
+    memcpy(info + 7, d->mac, 6);
+    int len = 13 + snprintf((char *)info + 13, sizeof(info) - 13, "emulated");
+    emuSend(d, f.type | PROV_REPLY, f.seq, PROV_OK, info, len);
+}
+
+static void emuSendDiag(EmuDisplay *d, const ProvFrame &f)
+{
+    char text[256];
+    int len = snprintf(text, sizeof(text),
+                       "permit=%s\nflipped=%d\nqueue=%d\npaired=%d\nclock=%lu\n"
+                       "prov_frames=%lu\nprov_duplicates=%lu\nprov_bad_frames=%lu\nprov_skipped=%lu\n",
+                       d->permit, d->flipped, d->queue, d->paired, (unsigned long)d->clock,
+                       (unsigned long)d->frames, (unsigned long)d->duplicates, (unsigned long)d->badFrames,
+                       (unsigned long)d->parser.skipped);
+    emuSend(d, f.type | PROV_REPLY, f.seq, PROV_OK, (const uint8_t *)text, len);
+}
+
+static void emuHandle(EmuDisplay *d, const ProvFrame &f)
+{
+    if (d->replyLen && f.type == d->lastType && f.seq == d->lastSeq)
+    {
+        // Our reply was lost: answer again, do not apply twice
+        d->duplicates++;
+        if (!emuDrop())
+        {
+            emuWrite(d->master, d->reply, d->replyLen);
+        }
+        return;
+    }
+    d->frames++;
+    d->lastType = f.type;
+    d->lastSeq = f.seq;
+
+    ProvStatus status;
+    switch (f.type)
+    {
+    case PROV_HELLO:
+        emuSendHello(d, f);
+        return;
+    case PROV_DIAG:
+        emuSendDiag(d, f);
+        return;
+    case PROV_PERMIT:
+        status = emuHandlePermit(d, f);
+        break;
+    case PROV_QUEUE:
+        status = emuHandleQueue(d, f);
+        break;
+    case PROV_SETTINGS:
+        status = emuHandleSettings(d, f);
+        break;
+    case PROV_FRAME:
+        status = emuHandleFrame(d, f);
+        break;
+    case PROV_FRAME_SHOW:
+        status = f.len != 4                                              ? PROV_ERR_LENGTH
+                 : crc32(d->frame, EMU_FRAME_BYTES) != provGet32(f.payload) ? PROV_ERR_BAD_DATA
+                                                                            : PROV_OK;
+        break;
+    default:
+        status = PROV_ERR_TYPE;
+        break;
+    }
+    emuSend(d, f.type | PROV_REPLY, f.seq, status);
+}
+
+static void emuPoll(EmuDisplay *d)
+{
+    uint8_t buf[256];
+    ssize_t n = read(d->master, buf, sizeof(buf));
+    for (ssize_t i = 0; i < n; i++)
+    {
+        ProvParseResult result = d->parser.feed(buf[i]);
+        if (result == PROV_PARSE_FRAME)
+        {
+            emuHandle(d, d->parser.frame());
+        }
+        else if (result != PROV_PARSE_MORE)
+        {
+            d->badFrames++;
+            emuSend(d, PROV_NAK, d->parser.frame().seq,
+                    result == PROV_PARSE_BAD_CRC ? PROV_ERR_CRC : PROV_ERR_LENGTH);
+            d->replyLen = 0;  // A NAK is never repeated for a retry
+        }
+    }
+}
+
+static bool emuOpen(EmuDisplay *d, int index)
+{
+    d->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (d->master < 0 || grantpt(d->master) || unlockpt(d->master) || !ptsname(d->master))
+    {
+        return false;
+    }
+    snprintf(d->path, sizeof(d->path), "%s", ptsname(d->master));
+    d->slave = open(d->path, O_RDWR | O_NOCTTY);
+    if (d->slave < 0)
+    {
+        return false;
+    }
+    struct termios raw;
+    tcgetattr(d->slave, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(d->slave, TCSANOW, &raw);
+    uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, (uint8_t)index};
+    memcpy(d->mac, mac, sizeof(mac));
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1;
+    loss = argc > 2 ? atof(argv[2]) : 0;
+    if (count < 1 || count > EMU_MAX)
+    {
+        fprintf(stderr, "usage: %s [displays 1-%d] [reply loss 0-1]\n", argv[0], EMU_MAX);
+        return 2;
+    }
+
+    struct pollfd fds[EMU_MAX + 1];
+    for (int i = 0; i < count; i++)
+    {
+        if (!emuOpen(&displays[i], i))
+        {
+            perror("pty");
+            return 1;
+        }
+        fds[i] = {displays[i].master, POLLIN, 0};
+        printf("%s\n", displays[i].path);
+    }
+    fflush(stdout);
+    fds[count] = {STDIN_FILENO, POLLIN, 0};  // Closed when the script is done
+
+    while (poll(fds, count + 1, -1) >= 0 || errno == EINTR)
+    {
+        if (fds[count].revents)
+        {
+            return 0;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (fds[i].revents & POLLIN)
+            {
+                emuPoll(&displays[i]);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,328 @@
+#!/usr/bin/env python3
+"""Provision displays over their native USB port (see src/usb_provision.h).
+
+    python tools/usb_provision.py /dev/ttyACM0 --permit permit.json --flip --clock
+    python tools/usb_provision.py '/dev/ttyACM*' --permit permit.json --key KEY --diag
+    python tools/usb_provision.py --emulate 8 --permit permit.json --frame test.pbm
+
+Every port given (globs are expanded) is provisioned in parallel: permit,
+queue, settings and framebuffer in that order, then diagnostics. Each
+write is acknowledged once the display has it in flash; lost or corrupt
+frames are retried. The permit file is the JSON the phone would send, so a
+"queue" array in it replaces the upcoming permits as well.
+
+--frame takes a binary PBM (P4) or raw GFXcanvas1 bytes of the panel size
+(296x128, set bits are black), e.g. convert in.png -monochrome out.pbm.
+
+--emulate N adds N emulated displays on pseudo-terminals, to try a batch
+without hardware; --emulate-loss drops a share of their replies to
+exercise the retries. They are tools/prov_emulator.cpp, which answers with
+the firmware's own frame parser and encoder (src/provision_frame.h) and is
+built with the host C++ compiler ($CXX, else c++) on first use. POSIX
+only (termios), no extra packages needed.
+"""
+
+import argparse
+import concurrent.futures
+import glob
+import json
+import os
+import random
+import select
+import struct
+import subprocess
+import sys
+import tempfile
+import termios
+import time
+import tty
+import zlib
+
+SYNC = b"\xA5\x5A"
+PAYLOAD_MAX = 1024
+REPLY, NAK = 0x80, 0xFF
+HELLO, PERMIT, QUEUE, SETTINGS, FRAME, FRAME_SHOW, DIAG = range(1, 8)
+TYPE_NAMES = {HELLO: "hello", PERMIT: "permit", QUEUE: "queue", SETTINGS: "settings",
+              FRAME: "frame", FRAME_SHOW: "frame show", DIAG: "diag"}
+STATUS_NAMES = ["ok", "crc error", "bad length", "unknown type", "bad data", "auth", "flash error",
+                "out of memory", "busy"]
+SET_FLIP, SET_KEY, SET_CLOCK = 0x01, 0x02, 0x04
+FLAG_FLIPPED = 0x01
+
+
+def encode(ftype, seq, payload=b""):
+    body = struct.pack("<BBH", ftype, seq, len(payload)) + payload
+    return SYNC + body + struct.pack("<I", zlib.crc32(body))
+
+
+class FrameReader:
+    """Splits what the port sends into frames and the log text around them."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.text = bytearray()
+
+    def feed(self, data):
+        self.buf += data
+        frames = []
+        while True:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                keep = 1 if self.buf.endswith(SYNC[:1]) else 0
+                self.text += self.buf[:len(self.buf) - keep]
+                del self.buf[:len(self.buf) - keep]
+                return frames
+            self.text += self.buf[:start]
+            del self.buf[:start]
+            if len(self.buf) < 6:
+                return frames
+            ftype, seq, length = struct.unpack("<BBH", self.buf[2:6])
+            if length > PAYLOAD_MAX:
+                del self.buf[:1]
+                continue
+            if len(self.buf) < 10 + length:
+                return frames
+            body = bytes(self.buf[2:6 + length])
+            crc, = struct.unpack("<I", self.buf[6 + length:10 + length])
+            if crc != zlib.crc32(body):
+                del self.buf[:1]  # Not a frame after all, or damaged: look for the next sync
+                continue
+            frames.append((ftype, seq, body[4:], crc))
+            del self.buf[:10 + length]
+
+    def lines(self):
+        """Complete log lines received so far."""
+        *done, rest = bytes(self.text).split(b"\n")
+        self.text = bytearray(rest)
+        return [line.decode(errors="replace").rstrip("\r") for line in done]
+
+
+def open_port(path):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    attrs[4] = attrs[5] = termios.B115200  # Ignored by USB CDC, but a real UART bridge needs it
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+class Display:
+    def __init__(self, path, verbose=False, timeout=2.0, retries=4):
+        self.path = path
+        self.fd = open_port(path)
+        self.reader = FrameReader()
+        self.verbose = verbose
+        self.timeout = timeout
+        self.retries = retries
+        self.seq = random.randrange(256)
+        self.stats = {"frames": 0, "retries": 0, "bytes": 0}
+
+    def close(self):
+        os.close(self.fd)
+
+    def request(self, ftype, payload=b""):
+        """Send one request and wait for its reply; returns (status, data)."""
+        self.seq = (self.seq + 1) & 0xFF
+        frame = encode(ftype, self.seq, payload)
+        for attempt in range(self.retries + 1):
+            if attempt:
+                self.stats["retries"] += 1
+            os.write(self.fd, frame)
+            self.stats["frames"] += 1
+            self.stats["bytes"] += len(frame)
+            reply = self.wait_reply(ftype)
+            if reply is not None:
+                return reply
+        raise IOError(f"no reply to {TYPE_NAMES[ftype]} after {self.retries + 1} tries")
+
+    def wait_reply(self, ftype):
+        deadline = time.monotonic() + self.timeout
+        while True:
+            left = deadline - time.monotonic()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                return None
+            try:
+                data = os.read(self.fd, 4096)
+            except OSError:
+                return None
+            for rtype, seq, payload, _ in self.reader.feed(data):
+                if seq != self.seq:
+                    continue  # Late reply to an earlier try
+                if rtype == NAK:
+                    return None  # Damaged on the way: send again right away
+                if rtype == ftype | REPLY and payload:
+                    return payload[0], payload[1:]
+            for line in self.reader.lines():
+                if self.verbose:
+                    print(f"{self.path}: {line}")
+
+    def write(self, ftype, payload=b""):
+        status, data = self.request(ftype, payload)
+        if status != 0:
+            name = STATUS_NAMES[status] if status < len(STATUS_NAMES) else str(status)
+            raise IOError(f"{TYPE_NAMES[ftype]} refused: {name}")
+        return data
+
+
+def load_frame(path, width, height):
+    data = open(path, "rb").read()
+    stride = (width + 7) // 8
+    if data.startswith(b"P4"):
+        fields, pos = [], 2
+        while len(fields) < 2:
+            while data[pos:pos + 1].isspace():
+                pos += 1
+            if data[pos:pos + 1] == b"#":
+                pos = data.index(b"\n", pos)
+                continue
+            end = pos
+            while not data[end:end + 1].isspace():
+                end += 1
+            fields.append(int(data[pos:end]))
+            pos = end
+        data = data[pos + 1:]
+        if fields != [width, height]:
+            raise ValueError(f"{path} is {fields[0]}x{fields[1]}, the panel is {width}x{height}")
+    if len(data) != stride * height:
+        raise ValueError(f"{path}: {len(data)} bytes, expected {stride * height}")
+    return data
+
+
+def provision(path, args):
+    start = time.monotonic()
+    display = None
+    done = []
+    try:
+        display = Display(path, args.verbose, args.timeout, args.retries)
+        info = display.write(HELLO)
+        version, payload_max, width, height = struct.unpack("<BHHH", info[:7])
+        device = ":".join(f"{b:02x}" for b in info[7:13])
+        build = info[13:].decode(errors="replace")
+        chunk = min(payload_max, PAYLOAD_MAX) - 2
+
+        if args.permit:
+            display.write(PERMIT, open(args.permit, "rb").read())
+            done.append("permit")
+        if args.queue:
+            display.write(QUEUE, open(args.queue, "rb").read())
+            done.append("queue")
+
+        mask, flags, extra = 0, 0, b""
+        if args.flip is not None:
+            mask |= SET_FLIP
+            flags |= FLAG_FLIPPED if args.flip else 0
+            done.append("flipped" if args.flip else "not flipped")
+        if args.key:
+            mask |= SET_KEY
+            extra += bytes.fromhex(args.key)
+            done.append("key")
+        if args.clock:
+            mask |= SET_CLOCK
+            now = time.time()
+            extra += struct.pack("<I", int(now + time.localtime(now).tm_gmtoff))  # Local time, as the phone sends
+            done.append("clock")
+        if mask:
+            display.write(SETTINGS, bytes([mask, flags]) + extra)
+
+        if args.frame:
+            image = load_frame(args.frame, width, height)
+            for offset in range(0, len(image), chunk):
+                display.write(FRAME, struct.pack("<H", offset) + image[offset:offset + chunk])
+            display.write(FRAME_SHOW, struct.pack("<I", zlib.crc32(image)))
+            done.append(f"frame {len(image)} B")
+
+        diag = {}
+        if args.diag:
+            for line in display.write(DIAG).decode(errors="replace").splitlines():
+                key, _, value = line.partition("=")
+                diag[key] = value
+        elapsed = time.monotonic() - start
+        return {"path": path, "ok": True, "device": device, "build": build, "version": version,
+                "done": done, "diag": diag, "elapsed": elapsed, **display.stats}
+    except (IOError, OSError, ValueError) as e:
+        stats = display.stats if display else {"frames": 0, "retries": 0, "bytes": 0}
+        return {"path": path, "ok": False, "error": str(e), "done": done,
+                "elapsed": time.monotonic() - start, **stats}
+    finally:
+        if display:
+            display.close()
+
+
+def start_emulator(count, loss):
+    """Build tools/prov_emulator.cpp (the firmware's framing, see its header)
+    and start it with count displays; returns the process and its pty paths."""
+    here = os.path.dirname(os.path.abspath(__file__))
+    source = os.path.join(here, "prov_emulator.cpp")
+    binary = os.path.join(tempfile.gettempdir(), f"prov_emulator-{os.getuid()}")
+    headers = glob.glob(os.path.join(here, "..", "src", "*.h"))
+    if not os.path.exists(binary) or os.path.getmtime(binary) < max(map(os.path.getmtime, headers + [source])):
+        compiler = os.environ.get("CXX", "c++")
+        subprocess.run([compiler, "-std=c++17", "-O2", "-I", os.path.join(here, "..", "src"), source,
+                        "-o", binary], check=True)
+    process = subprocess.Popen([binary, str(count), str(loss)], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                               text=True)
+    paths = [process.stdout.readline().strip() for _ in range(count)]
+    if not all(paths):
+        raise OSError("emulator did not start")
+    return process, paths
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("ports", nargs="*", help="serial ports or globs, e.g. '/dev/ttyACM*'")
+    parser.add_argument("--permit", help="permit JSON to push (as the phone sends it)")
+    parser.add_argument("--queue", help='JSON with a "queue" array of upcoming permits')
+    flip = parser.add_mutually_exclusive_group()
+    flip.add_argument("--flip", dest="flip", action="store_true", default=None, help="rotate the display 180 degrees")
+    flip.add_argument("--no-flip", dest="flip", action="store_false", help="normal rotation")
+    parser.add_argument("--key", help="payload key, 64 hex digits (replaces pairing with the phone)")
+    parser.add_argument("--clock", action="store_true", help="set the display clock to this computer's local time")
+    parser.add_argument("--frame", help="framebuffer to draw: PBM (P4) or raw bytes of the panel size")
+    parser.add_argument("--diag", action="store_true", help="print the display's diagnostics")
+    parser.add_argument("--timeout", type=float, default=2.0, help="seconds to wait for each reply")
+    parser.add_argument("--retries", type=int, default=4)
+    parser.add_argument("--emulate", type=int, default=0, metavar="N", help="add N emulated displays")
+    parser.add_argument("--emulate-loss", type=float, default=0.0, metavar="P",
+                        help="share of emulated replies to drop (0-1)")
+    parser.add_argument("-v", "--verbose", action="store_true", help="show the displays' log output")
+    args = parser.parse_args()
+
+    if args.key and len(bytes.fromhex(args.key)) != 32:
+        parser.error("--key needs 32 bytes (64 hex digits)")
+    paths = []
+    for pattern in args.ports:
+        paths += sorted(glob.glob(pattern)) or [pattern]
+    emulator = None
+    if args.emulate:
+        emulator, emulated = start_emulator(args.emulate, args.emulate_loss)
+        paths += emulated
+    if not paths:
+        parser.error("no ports")
+
+    start = time.monotonic()
+    with concurrent.futures.ThreadPoolExecutor(max_workers=len(paths)) as pool:
+        results = list(pool.map(lambda p: provision(p, args), paths))
+    elapsed = time.monotonic() - start
+    if emulator:
+        emulator.stdin.close()  # Tells it to exit
+        emulator.wait()
+
+    failed = 0
+    for r in results:
+        rate = r["bytes"] / 1024 / max(r["elapsed"], 1e-3)
+        summary = ", ".join(r["done"]) or "nothing to write"
+        if r["ok"]:
+            print(f"{r['path']}: {r['device']} ok - {summary} in {r['elapsed']:.2f} s "
+                  f"({r['frames']} frames, {r['retries']} retries, {rate:.1f} KB/s)")
+            for key, value in r["diag"].items():
+                print(f"    {key} = {value}")
+        else:
+            failed += 1
+            print(f"{r['path']}: FAILED - {r['error']} (done: {summary}, {r['retries']} retries)")
+    print(f"{len(results) - failed}/{len(results)} displays provisioned in {elapsed:.2f} s")
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()